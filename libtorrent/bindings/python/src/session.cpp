@@ -451,6 +451,7 @@ void bind_session()
         .def_readonly("writes", &cache_status::writes)
         .def_readonly("blocks_read", &cache_status::blocks_read)
         .def_readonly("blocks_read_hit", &cache_status::blocks_read_hit)
+        .def_readonly("blocks_read_uncached", &cache_status::blocks_read_uncached)
         .def_readonly("reads", &cache_status::reads)
         .def_readonly("cache_size", &cache_status::cache_size)
         .def_readonly("read_cache_size", &cache_status::read_cache_size)
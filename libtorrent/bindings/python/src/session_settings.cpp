@@ -120,6 +120,8 @@ void bind_session_settings()
         .def_readwrite("volatile_read_cache", &session_settings::volatile_read_cache)
         .def_readwrite("guided_read_cache", &session_settings::guided_read_cache)
         .def_readwrite("default_cache_min_age", &session_settings::default_cache_min_age)
+        .def_readwrite("read_cache_hit_age", &session_settings::read_cache_hit_age)
+        .def_readwrite("read_cache_priority_age", &session_settings::read_cache_priority_age)
         .def_readwrite("num_optimistic_unchoke_slots", &session_settings::num_optimistic_unchoke_slots)
         .def_readwrite("no_atime_storage", &session_settings::no_atime_storage)
         .def_readwrite("default_est_reciprocation_rate", &session_settings::default_est_reciprocation_rate)
@@ -165,6 +167,10 @@ void bind_session_settings()
         .def_readwrite("read_job_every", &session_settings::read_job_every)
         .def_readwrite("use_disk_read_ahead", &session_settings::use_disk_read_ahead)
         .def_readwrite("lock_files", &session_settings::lock_files)
+        .def_readwrite("ssl_session_cache_size", &session_settings::ssl_session_cache_size)
+        .def_readwrite("ssl_session_tickets", &session_settings::ssl_session_tickets)
+        .def_readwrite("ssl_ciphers", &session_settings::ssl_ciphers)
+        .def_readwrite("use_kernel_tls", &session_settings::use_kernel_tls)
     ;
 
     enum_<proxy_settings::proxy_type>("proxy_type")
@@ -121,6 +121,13 @@ namespace libtorrent {
 
 		virtual std::auto_ptr<alert> clone() const = 0;
 
+#ifndef TORRENT_DISABLE_POOL_ALLOCATOR
+		// alerts are allocated for every post and freed by whoever pops
+		// them, small ones are recycled through size class pools
+		static void* operator new(std::size_t size);
+		static void operator delete(void* p, std::size_t size);
+#endif
+
 	private:
 		ptime m_timestamp;
 	};
@@ -133,6 +140,9 @@ namespace libtorrent {
 		~alert_manager();
 
 		void post_alert(const alert& alert_);
+		// takes ownership of the alert, for alerts that are
+		// expensive to copy
+		void post_alert_ptr(alert* alert_);
 		bool pending() const;
 		std::auto_ptr<alert> get();
 		void get_all(std::deque<alert*>* alerts);
@@ -1320,6 +1320,19 @@ namespace libtorrent
 		error_code error;
 	};
 
+	// posted in response to session::post_torrent_updates(), holds the
+	// status of every torrent that changed since the previous call
+	struct TORRENT_EXPORT state_update_alert : alert
+	{
+		TORRENT_DEFINE_ALERT(state_update_alert);
+
+		const static int static_category = alert::status_notification;
+		virtual std::string message() const;
+		virtual bool discardable() const { return false; }
+
+		std::vector<torrent_status> status;
+	};
+
 }
 
 
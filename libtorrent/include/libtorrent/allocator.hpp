@@ -50,6 +50,21 @@ namespace libtorrent
 		static void free(char* const block);
 	};
 
+	// allocates blocks of huge_page_size or more on huge page
+	// boundaries and asks the kernel to back them with
+	// transparent huge pages, where that's supported. Smaller
+	// blocks are page aligned
+	struct TORRENT_EXPORT huge_page_allocator
+	{
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		enum { huge_page_size = 2 * 1024 * 1024 };
+
+		static char* malloc(const size_type bytes);
+		static void free(char* const block);
+	};
+
 	struct TORRENT_EXPORT aligned_holder
 	{
 		aligned_holder(): m_buf(0) {}
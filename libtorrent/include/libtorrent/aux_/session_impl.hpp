@@ -84,6 +84,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/address.hpp"
 #include "libtorrent/utp_socket_manager.hpp"
 #include "libtorrent/bloom_filter.hpp"
+#include "libtorrent/hash_index.hpp"
 #include "libtorrent/rss.hpp"
 
 #if TORRENT_COMPLETE_TYPES_REQUIRED
@@ -329,6 +330,9 @@ namespace libtorrent
 				, boost::uint32_t flags) const;
 			void refresh_torrent_status(std::vector<torrent_status>* ret
 				, boost::uint32_t flags) const;
+			void post_torrent_updates();
+			void add_to_update_queue(boost::weak_ptr<torrent> t)
+			{ m_state_updates.push_back(t); }
 
 			std::vector<torrent_handle> get_torrents() const;
 			
@@ -377,6 +381,15 @@ namespace libtorrent
 			address listen_address() const;
                         boost::uint16_t listen_port() const;
                         boost::uint16_t ssl_listen_port() const;
+
+#ifdef TORRENT_USE_OPENSSL
+			// applies the cipher policy and the TLS session resumption
+			// settings to ctx. Used for m_ssl_ctx, which accepts, and the
+			// contexts of SSL torrents, which connect
+			void setup_ssl_context(SSL_CTX* ctx, bool accepting) const;
+			void setup_ssl_session_cache(SSL_CTX* ctx, bool accepting) const;
+			void enable_kernel_tls(socket_type& s);
+#endif
 			
 			void abort();
 			
@@ -461,6 +474,12 @@ namespace libtorrent
 				m_total_failed_bytes += b;
 			}
 
+			void add_copied_payload(int b)
+			{
+				TORRENT_ASSERT(b > 0);
+				m_total_payload_copied += b;
+			}
+
 			char* allocate_buffer();
 			void free_buffer(char* buf);
 
@@ -646,7 +665,13 @@ namespace libtorrent
 
 			tracker_manager m_tracker_manager;
 			torrent_map m_torrents;
-			std::map<std::string, boost::shared_ptr<torrent> > m_uuids;
+
+			// the torrents in m_torrents, by info-hash. Used for lookups,
+			// which happen for every incoming connection, m_torrents is
+			// still what is iterated over and what holds the torrents
+			hash_index<sha1_hash, torrent*, info_hash_hash> m_torrent_index;
+
+			hash_index<std::string, boost::shared_ptr<torrent>, string_hash> m_uuids;
 
 			// these are all the torrents using full AES-256 encryption of
 			// all peer connections. When receiving a handshake that's encrypred
@@ -659,6 +684,11 @@ namespace libtorrent
 			// this has all torrents that wants to be checked in it
 			check_queue_t m_queued_for_checking;
 
+			// torrents whose status has changed since the last
+			// post_torrent_updates(). A torrent is only in here once,
+			// guarded by torrent::m_in_state_updates
+			std::vector<boost::weak_ptr<torrent> > m_state_updates;
+
 			// this maps sockets to their peer_connection
 			// object. It is the complete list of all connected
 			// peers.
@@ -701,7 +731,8 @@ namespace libtorrent
 			std::list<listen_socket_t> m_listen_sockets;
 
 #ifdef TORRENT_USE_OPENSSL
-                        void ssl_handshake(error_code const& ec, boost::shared_ptr<socket_type> s);
+                        void ssl_handshake(error_code const& ec, boost::shared_ptr<socket_type> s
+                                , ptime started);
 #endif
 
 			// when as a socks proxy is used for peers, also
@@ -1082,6 +1113,24 @@ namespace libtorrent
 			size_type m_total_failed_bytes;
 			size_type m_total_redundant_bytes;
 
+			// payload copied out of receive buffers
+			size_type m_total_payload_copied;
+
+			// incoming SSL handshake counters, reported in session_status
+			size_type m_total_ssl_handshakes;
+			size_type m_total_ssl_handshake_failures;
+			size_type m_total_ssl_handshake_time;
+			size_type m_ssl_handshake_histogram[session_status::num_ssl_handshake_buckets];
+			size_type m_total_ssl_handshakes_resumed;
+
+			// outgoing SSL handshakes that completed, and how many of
+			// them resumed a cached session
+			size_type m_total_outgoing_ssl_handshakes;
+			size_type m_total_outgoing_ssl_handshakes_resumed;
+
+			// SSL connections the kernel encrypts the sent data of
+			size_type m_total_kernel_tls_connections;
+
 			std::vector<boost::shared_ptr<feed> > m_feeds;
 
 			// the main working thread
@@ -296,14 +296,14 @@ public:
 		// peer_connection functions of the same names
 		virtual void append_const_send_buffer(char const* buffer, int size);
 		void send_buffer(char const* buf, int size, int flags = 0);
-		template <class Destructor>
-		void append_send_buffer(char* buffer, int size, Destructor const& destructor)
+		void append_send_buffer(char* buffer, int size, free_buffer_fun destructor
+			, void* userdata)
 		{
 #ifndef TORRENT_DISABLE_ENCRYPTION
 			if (m_rc4_encrypted)
 				m_enc_handler->encrypt(buffer, size);
 #endif
-			peer_connection::append_send_buffer(buffer, size, destructor, true);
+			peer_connection::append_send_buffer(buffer, size, destructor, userdata, true);
 		}
 
 private:
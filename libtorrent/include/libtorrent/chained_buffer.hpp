@@ -35,14 +35,13 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/config.hpp"
 
-#include <boost/function/function1.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/version.hpp>
 #if BOOST_VERSION < 103500
 #include <asio/buffer.hpp>
 #else
 #include <boost/asio/buffer.hpp>
 #endif
-#include <list>
 #include <string.h> // for memcpy
 
 namespace libtorrent
@@ -50,18 +49,25 @@ namespace libtorrent
 #if BOOST_VERSION >= 103500
 	namespace asio = boost::asio;
 #endif
-	struct TORRENT_EXPORT chained_buffer
+
+	// called when a buffer has been sent, with the userdata
+	// it was appended with. A null function means the buffer
+	// is not owned by the chain
+	typedef void (*free_buffer_fun)(char* buf, void* userdata);
+
+	// the send buffer of a peer connection. Buffers are kept
+	// in a ring, which starts out inline and doubles in size
+	// when it fills up, and the iovec handed to async_write_some
+	// is built into a fixed array. Once a connection has grown
+	// its ring, queueing and sending buffers doesn't allocate
+	struct TORRENT_EXPORT chained_buffer : boost::noncopyable
 	{
-		chained_buffer(): m_bytes(0), m_capacity(0)
-		{
-#if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
-			m_destructed = false;
-#endif
-		}
+		chained_buffer();
 
 		struct buffer_t
 		{
-			boost::function<void(char*)> free; // destructs the buffer
+			free_buffer_fun free; // destructs the buffer
+			void* userdata; // passed to free
 			char* buf; // the first byte of the buffer
 			int size; // the total size of the buffer
 
@@ -69,6 +75,26 @@ namespace libtorrent
 			int used_size; // this is the number of bytes to send/receive
 		};
 
+		// a ConstBufferSequence referring to the iovec array
+		// of the chain. It's valid until the next call to
+		// build_iovec() or pop_front()
+		struct iovec_t
+		{
+			typedef asio::const_buffer value_type;
+			typedef asio::const_buffer const* const_iterator;
+			iovec_t(const_iterator b, const_iterator e): m_begin(b), m_end(e) {}
+			const_iterator begin() const { return m_begin; }
+			const_iterator end() const { return m_end; }
+			int size() const { return int(m_end - m_begin); }
+		private:
+			const_iterator m_begin;
+			const_iterator m_end;
+		};
+
+		// asio doesn't pass more buffers than this to one
+		// writev() call anyway
+		enum { max_iovec = 64 };
+
 		bool empty() const { return m_bytes == 0; }
 		int size() const { return m_bytes; }
 		int capacity() const { return m_capacity; }
@@ -76,7 +102,7 @@ namespace libtorrent
 		void pop_front(int bytes_to_pop);
 
 		void append_buffer(char* buffer, int s, int used_size
-			, boost::function<void(char*)> const& destructor);
+			, free_buffer_fun destructor, void* userdata = 0);
 
 		// returns the number of bytes available at the
 		// end of the last chained buffer.
@@ -92,15 +118,31 @@ namespace libtorrent
 		// enough room, returns 0
 		char* allocate_appendix(int s);
 
-		std::list<asio::const_buffer> const& build_iovec(int to_send);
+		// the buffers holding the first to_send bytes, at
+		// most max_iovec of them
+		iovec_t build_iovec(int to_send);
 
 		~chained_buffer();
 
 	private:
 
-		// this is the list of all the buffers we want to
-		// send
-		std::list<buffer_t> m_vec;
+		buffer_t& at(int i)
+		{ return m_ring[(m_head + i) & (m_ring_size - 1)]; }
+
+		buffer_t& back() { return at(m_num_buffers - 1); }
+
+		void grow_ring();
+
+		// the ring of all the buffers we want to send. It
+		// points to m_inline_ring until more than
+		// inline_buffers are queued. m_ring_size is always
+		// a power of 2
+		enum { inline_buffers = 8 };
+		buffer_t* m_ring;
+		int m_ring_size;
+		int m_head;
+		int m_num_buffers;
+		buffer_t m_inline_ring[inline_buffers];
 
 		// this is the number of bytes in the send buf.
 		// this will always be equal to the sum of the
@@ -113,7 +155,7 @@ namespace libtorrent
 
 		// this is the vector of buffers used when
 		// invoking the async write call
-		std::list<asio::const_buffer> m_tmp_vec;
+		asio::const_buffer m_tmp_vec[max_iovec];
 
 #if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 		bool m_destructed;
@@ -161,6 +161,11 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_USE_NETLINK 1
 #define TORRENT_USE_IFCONF 1
 #define TORRENT_HAS_SALEN 0
+// preadv() and pwritev() were added in glibc 2.10
+#if !defined TORRENT_USE_PREADV && defined __GLIBC__ \
+	&& (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 10))
+#define TORRENT_USE_PREADV 1
+#endif
 
 // ==== CYGWIN ===
 #elif defined __CYGWIN__
@@ -320,6 +325,16 @@ inline int snprintf(char* buf, int len, char const* fmt, ...)
 #define TORRENT_USE_LOCALE 0
 #endif
 
+// kernel TLS, where the kernel encrypts the data sent on an SSL
+// connection once the handshake is done. Linux 4.13 and later
+#ifndef TORRENT_USE_KTLS
+#if defined TORRENT_LINUX && defined TORRENT_USE_OPENSSL
+#define TORRENT_USE_KTLS 1
+#else
+#define TORRENT_USE_KTLS 0
+#endif
+#endif
+
 // set this to true if close() may block on your system
 // Mac OS X does this if the file being closed is not fully
 // allocated on disk yet for instance. When defined, the disk
@@ -382,6 +397,13 @@ inline int snprintf(char* buf, int len, char const* fmt, ...)
 #define TORRENT_USE_READV 1
 #endif
 
+// preadv() and pwritev() replace the lseek() + readv()/writev() pairs,
+// so they're only used where those are
+#if !defined TORRENT_USE_PREADV || !TORRENT_USE_READV || !TORRENT_USE_WRITEV
+#undef TORRENT_USE_PREADV
+#define TORRENT_USE_PREADV 0
+#endif
+
 #ifndef TORRENT_NO_FPU
 #define TORRENT_NO_FPU 0
 #endif
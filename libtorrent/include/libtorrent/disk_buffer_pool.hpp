@@ -37,6 +37,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/thread.hpp"
 #include "libtorrent/session_settings.hpp"
 #include "libtorrent/allocator.hpp"
+#include "libtorrent/size_type.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/asio/detail/tss_ptr.hpp>
+#include <vector>
 
 #ifndef TORRENT_DISABLE_POOL_ALLOCATOR
 #include <boost/pool/pool.hpp>
@@ -48,12 +54,15 @@ POSSIBILITY OF SUCH DAMAGE.
 
 namespace libtorrent
 {
+	// Every thread that allocates or frees disk buffers gets a small
+	// cache of free buffers of its own. Buffers move between a thread's
+	// cache and the shared pool in batches, so the network thread
+	// allocating receive buffers and the disk thread freeing them only
+	// take the pool mutex once every thread_cache::batch buffers
 	struct TORRENT_EXPORT disk_buffer_pool : boost::noncopyable
 	{
 		disk_buffer_pool(int block_size);
-#if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 		~disk_buffer_pool();
-#endif
 
 #if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 		bool is_disk_buffer(char* buffer
@@ -69,17 +78,29 @@ namespace libtorrent
 
 #ifdef TORRENT_STATS
 		int disk_allocations() const
-		{ return m_allocations; }
+		{ return m_in_use; }
 #endif
 
 #ifdef TORRENT_DISK_STATS
 		std::ofstream m_disk_access_log;
 #endif
 
+		// returns the free buffers of the calling thread's cache and
+		// any unused chunks of the pool to the system
 		void release_memory();
 
 		int in_use() const { return m_in_use; }
 
+		// allocations and frees served by the calling thread's cache,
+		// and how often the shared pool was locked and found busy
+		void pool_stats(size_type& cache_hits, size_type& locks
+			, size_type& contended) const;
+
+		// read, write and seek system calls the storage made for
+		// the disk thread's reads and writes
+		void add_disk_syscalls(int n) { m_disk_syscalls += n; }
+		size_type disk_syscalls() const { return m_disk_syscalls; }
+
 	protected:
 
 		void free_buffer_impl(char* buf, mutex::scoped_lock& l);
@@ -88,24 +109,63 @@ namespace libtorrent
 		// protocol defines the block size to 16 KiB.
 		const int m_block_size;
 
-		// number of disk buffers currently allocated
-		int m_in_use;
-
 		session_settings m_settings;
 
 	private:
 
+		struct thread_cache
+		{
+			enum { capacity = 32, batch = 16 };
+			thread_cache(): num_buffers(0), hits(0) {}
+			char* buffers[capacity];
+			int num_buffers;
+			// only written by the owning thread
+			size_type hits;
+		};
+
+		// locks the pool and counts the acquisition, and whether
+		// another thread was holding or waiting for the lock
+		struct pool_lock
+		{
+			pool_lock(disk_buffer_pool const& p);
+			~pool_lock();
+			disk_buffer_pool const& pool;
+			bool contended;
+			mutex::scoped_lock l;
+		};
+
+		bool use_thread_cache() const;
+		thread_cache* get_thread_cache();
+		void refill(thread_cache& c);
+		void flush(thread_cache& c, int num);
+		char* allocate_impl(mutex::scoped_lock& l);
+		int chunk_size() const;
+
+		// number of disk buffers currently allocated, not
+		// counting the ones held in thread caches
+		boost::detail::atomic_count m_in_use;
+
 		mutable mutex m_pool_mutex;
 
+		// the calling thread's cache. m_caches owns all of them
+		// and is protected by m_pool_mutex
+		boost::asio::detail::tss_ptr<thread_cache> m_thread_cache;
+		std::vector<thread_cache*> m_caches;
+
+		// pool lock counters, protected by m_pool_mutex
+		mutable size_type m_pool_locks;
+		mutable size_type m_pool_contended;
+		mutable boost::detail::atomic_count m_pool_waiters;
+
+		// only written by the disk thread
+		size_type m_disk_syscalls;
+
 #ifndef TORRENT_DISABLE_POOL_ALLOCATOR
 		// memory pool for read and write operations
 		// and disk cache
-		boost::pool<page_aligned_allocator> m_pool;
+		boost::pool<huge_page_allocator> m_pool;
 #endif
 
-#if defined TORRENT_DISK_STATS || defined TORRENT_STATS
-		int m_allocations;
-#endif
 #ifdef TORRENT_DISK_STATS
 	public:
 		void rename_buffer(char* buf, char const* category);
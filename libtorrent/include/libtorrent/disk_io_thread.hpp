@@ -67,6 +67,9 @@ namespace libtorrent
 		std::vector<bool> blocks;
 		ptime last_use;
 		int next_to_hash;
+		// the number of times blocks were served from this
+		// read cache line (saturates)
+		int hits;
 		enum kind_t { read_cache = 0, write_cache = 1 };
 		kind_t kind;
 	};
@@ -81,6 +84,7 @@ namespace libtorrent
 			, offset(0)
 			, max_cache_line(0)
 			, cache_min_time(0)
+			, cache_priority(0)
 		{}
 
 		enum action_t
@@ -128,6 +132,11 @@ namespace libtorrent
 		// line caused by this operation stays in the cache
 		int cache_min_time;
 
+		// the cache priority hint of the torrent this job belongs
+		// to. Read cache lines touched by this job are kept
+		// read_cache_priority_age seconds longer per level
+		int cache_priority;
+
 		boost::shared_ptr<entry> resume_data;
 
 		// the error code from the file operation
@@ -156,6 +165,7 @@ namespace libtorrent
 			, writes(0)
 			, blocks_read(0)
 			, blocks_read_hit(0)
+			, blocks_read_uncached(0)
 			, reads(0)
 			, queued_bytes(0)
 			, cache_size(0)
@@ -175,6 +185,10 @@ namespace libtorrent
 			, cumulative_sort_time(0)
 			, total_read_back(0)
 			, read_queue_size(0)
+			, buffer_cache_hits(0)
+			, buffer_pool_locks(0)
+			, buffer_pool_contended(0)
+			, disk_syscalls(0)
 		{}
 
 		// the number of 16kB blocks written
@@ -189,6 +203,9 @@ namespace libtorrent
 		size_type blocks_read;
 		// the number of blocks that was just copied from the read cache
 		size_type blocks_read_hit;
+		// the number of blocks read straight from disk because
+		// no read cache line could be evicted to make room for them
+		size_type blocks_read_uncached;
 		// the number of read operations used
 		size_type reads;
 
@@ -220,6 +237,19 @@ namespace libtorrent
 		boost::uint32_t cumulative_sort_time;
 		int total_read_back;
 		int read_queue_size;
+
+		// disk buffers allocated from or freed to a thread's own
+		// cache, without touching the shared pool
+		size_type buffer_cache_hits;
+		// the number of times the shared pool was locked, and how
+		// many of those found another thread holding or waiting for it
+		size_type buffer_pool_locks;
+		size_type buffer_pool_contended;
+
+		// read, write and seek system calls used for the reads and
+		// writes, disk_syscalls / (reads + writes) is the number of
+		// calls per operation
+		size_type disk_syscalls;
 	};
 	
 	// this is a singleton consisting of the thread and a queue
@@ -292,6 +322,14 @@ namespace libtorrent
 			// is used to determine if flushing a range would force us
 			// to read it back later when hashing
 			int next_block_to_hash;
+			// the number of times blocks were served from this
+			// piece while in the read cache, saturates at
+			// max_read_cache_hits. Each hit extends the time the
+			// piece is protected from eviction
+			int hits;
+			// the cache priority of the torrent as of the last
+			// access to this piece
+			int priority;
 			
 			std::pair<void*, int> storage_piece_pair() const
 			{ return std::pair<void*, int>(storage.get(), piece); }
@@ -309,6 +347,12 @@ namespace libtorrent
 		typedef cache_t::nth_index<0>::type cache_piece_index_t;
 		typedef cache_t::nth_index<1>::type cache_lru_index_t;
 
+		// the number of hits after which a read cache line stops
+		// gaining protection from eviction
+		enum { max_read_cache_hits = 8 };
+
+		int read_cache_age(cached_piece_entry const& p, int cache_min_time) const;
+
 	private:
 
 		int add_job(disk_io_job const& j
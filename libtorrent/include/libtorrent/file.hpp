@@ -239,8 +239,12 @@ namespace libtorrent
 		// this when in unbuffered mode
 		int size_alignment() const;
 
-		size_type writev(size_type file_offset, iovec_t const* bufs, int num_bufs, error_code& ec);
-		size_type readv(size_type file_offset, iovec_t const* bufs, int num_bufs, error_code& ec);
+		// if num_syscalls is set, the number of read, write and seek
+		// system calls issued is added to it (not counted on windows)
+		size_type writev(size_type file_offset, iovec_t const* bufs, int num_bufs
+			, error_code& ec, int* num_syscalls = 0);
+		size_type readv(size_type file_offset, iovec_t const* bufs, int num_bufs
+			, error_code& ec, int* num_syscalls = 0);
 		void hint_read(size_type file_offset, int len);
 
 		size_type get_size(error_code& ec) const;
@@ -0,0 +1,182 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_HASH_INDEX_HPP_INCLUDED
+#define TORRENT_HASH_INDEX_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <boost/cstdint.hpp>
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/peer_id.hpp"
+
+namespace libtorrent
+{
+	// info-hashes are SHA-1 digests, any 32 bits of them
+	// are as good a hash as can be computed from them
+	struct info_hash_hash
+	{
+		boost::uint32_t operator()(sha1_hash const& h) const
+		{
+			boost::uint32_t ret;
+			std::memcpy(&ret, &h[0], sizeof(ret));
+			return ret;
+		}
+	};
+
+	// FNV-1a
+	struct string_hash
+	{
+		boost::uint32_t operator()(std::string const& s) const
+		{
+			boost::uint32_t ret = 2166136261u;
+			for (std::string::const_iterator i = s.begin(), end(s.end()); i != end; ++i)
+			{
+				ret ^= boost::uint8_t(*i);
+				ret *= 16777619u;
+			}
+			return ret;
+		}
+	};
+
+	// an unordered index with open addressing and linear probing. The
+	// slots are kept in a single array that is at most half full, so a
+	// lookup is typically one or two adjacent slots rather than a walk
+	// down a tree of separately allocated nodes. Erasing shifts the
+	// following entries of the probe sequence back instead of leaving
+	// tombstones. Pointers returned by find() are invalidated by
+	// insert() and erase()
+	template <class Key, class T, class Hash>
+	class hash_index
+	{
+	public:
+
+		hash_index(): m_size(0) {}
+
+		T* find(Key const& k)
+		{
+			if (m_size == 0) return 0;
+			int const mask = int(m_slots.size()) - 1;
+			for (int i = m_hash(k) & mask;; i = (i + 1) & mask)
+			{
+				slot& s = m_slots[i];
+				if (!s.used) return 0;
+				if (s.key == k) return &s.value;
+			}
+		}
+
+		// returns false, and leaves the index unchanged, if the
+		// key is already in it
+		bool insert(Key const& k, T const& v)
+		{
+			if ((m_size + 1) * 2 > int(m_slots.size())) grow();
+			int const mask = int(m_slots.size()) - 1;
+			int i = m_hash(k) & mask;
+			for (; m_slots[i].used; i = (i + 1) & mask)
+				if (m_slots[i].key == k) return false;
+			slot& s = m_slots[i];
+			s.key = k;
+			s.value = v;
+			s.used = true;
+			++m_size;
+			return true;
+		}
+
+		bool erase(Key const& k)
+		{
+			if (m_size == 0) return false;
+			int const mask = int(m_slots.size()) - 1;
+			int i = m_hash(k) & mask;
+			for (; m_slots[i].used; i = (i + 1) & mask)
+				if (m_slots[i].key == k) break;
+			if (!m_slots[i].used) return false;
+
+			// move entries that probed past the hole back into it
+			for (int j = (i + 1) & mask; m_slots[j].used; j = (j + 1) & mask)
+			{
+				int home = m_hash(m_slots[j].key) & mask;
+				// the entry at j can fill the hole at i unless its home
+				// slot lies cyclically in (i, j]
+				if (((j - home) & mask) < ((j - i) & mask)) continue;
+				m_slots[i].key = m_slots[j].key;
+				m_slots[i].value = m_slots[j].value;
+				i = j;
+			}
+			m_slots[i] = slot();
+			--m_size;
+			return true;
+		}
+
+		void clear()
+		{
+			m_slots.clear();
+			m_size = 0;
+		}
+
+		int size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+	private:
+
+		struct slot
+		{
+			slot(): key(), value(), used(false) {}
+			Key key;
+			T value;
+			bool used;
+		};
+
+		void grow()
+		{
+			std::vector<slot> old;
+			old.swap(m_slots);
+			m_slots.resize(old.empty() ? 16 : old.size() * 2);
+			m_size = 0;
+			for (typename std::vector<slot>::iterator i = old.begin()
+				, end(old.end()); i != end; ++i)
+			{
+				if (i->used) insert(i->key, i->value);
+			}
+		}
+
+		// the number of slots is always a power of 2
+		std::vector<slot> m_slots;
+		int m_size;
+		Hash m_hash;
+	};
+}
+
+#endif // TORRENT_HASH_INDEX_HPP_INCLUDED
+
@@ -0,0 +1,85 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_KTLS_HPP_INCLUDED
+#define TORRENT_KTLS_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/socket.hpp"
+
+#ifdef TORRENT_USE_OPENSSL
+
+extern "C"
+{
+#include <openssl/ssl.h>
+}
+
+namespace libtorrent
+{
+	// hands the send keys of the established connection ssl, on socket fd,
+	// to the kernel, which encrypts everything written to the socket from
+	// then on. Plaintext has to be written straight to the socket after this
+	// returns true, OpenSSL's send state is stale. Only TLS 1.2 with AES-GCM
+	// is supported. Returns false and leaves the connection as it was if the
+	// cipher, the kernel or OpenSSL doesn't allow it.
+	TORRENT_EXPORT bool enable_ktls_send(SSL* ssl, int fd, error_code& ec);
+
+	// the send side of a TLS 1.2 AES-GCM connection, as enable_ktls_send()
+	// hands it to the kernel: the write key, the implicit part of the
+	// nonce and the sequence number of the next record
+	struct ktls_send_state
+	{
+		int key_len;
+		unsigned char key[32];
+		unsigned char salt[4];
+		unsigned char rec_seq[8];
+	};
+
+	// derives the send state of the established connection ssl from its
+	// master secret. Returns false for anything enable_ktls_send() doesn't
+	// support
+	TORRENT_EXPORT bool derive_ktls_send_state(SSL* ssl, ktls_send_state& st
+		, error_code& ec);
+
+	// the file descriptor of sockets kernel TLS can be enabled on, -1
+	// for any other stream
+	template <class Stream>
+	int ktls_socket(Stream&) { return -1; }
+
+	inline int ktls_socket(stream_socket& s) { return s.native_handle(); }
+}
+
+#endif // TORRENT_USE_OPENSSL
+
+#endif // TORRENT_KTLS_HPP_INCLUDED
+
@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <ctime>
 #include <algorithm>
 #include <vector>
+#include <list>
 #include <string>
 
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_ERROR_LOGGING || defined TORRENT_MINIMAL_LOGGING
@@ -550,9 +551,8 @@ namespace libtorrent
 		void log_buffer_usage(char* buffer, int size, char const* label);
 #endif
 
-		template <class Destructor>
-		void append_send_buffer(char* buffer, int size, Destructor const& destructor
-			, bool encrypted = false)
+		void append_send_buffer(char* buffer, int size, free_buffer_fun destructor
+			, void* userdata, bool encrypted = false)
 		{
 #if defined TORRENT_DISK_STATS
 			log_buffer_usage(buffer, size, "queued send buffer");
@@ -562,7 +562,7 @@ namespace libtorrent
 			// encryption. bt_peer_connection overrides this function with
 			// its own version.
 			TORRENT_ASSERT(encrypted || type() != bittorrent_connection);
-			m_send_buffer.append_buffer(buffer, size, size, destructor);
+			m_send_buffer.append_buffer(buffer, size, size, destructor, userdata);
 		}
 
 		virtual void append_const_send_buffer(char const* buffer, int size);
@@ -144,6 +144,14 @@ namespace libtorrent
 			ignore_whole_pieces = 64
 		};
 
+		enum
+		{
+			// bitfields with at most this many pieces update the
+			// piece order one piece at a time, larger ones have it
+			// rebuilt at the next pick
+			max_incremental_refcount = 64
+		};
+
 		struct downloading_piece
 		{
 			downloading_piece(): state(none), index(-1), info(0)
@@ -185,6 +185,12 @@ namespace libtorrent
 		void refresh_torrent_status(std::vector<torrent_status>* ret
 			, boost::uint32_t flags = 0) const;
 
+		// posts a state_update_alert with the status of every torrent
+		// whose status changed since the last call. This is a cheaper
+		// way to poll many torrents than calling torrent_handle::status()
+		// on each of them.
+		void post_torrent_updates();
+
 		// returns a list of all torrents in this session
 		std::vector<torrent_handle> get_torrents() const;
 		
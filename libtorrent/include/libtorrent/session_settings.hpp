@@ -217,6 +217,8 @@ namespace libtorrent
 			, volatile_read_cache(false)
 			, guided_read_cache(false)
 			, default_cache_min_age(1)
+			, read_cache_hit_age(0)
+			, read_cache_priority_age(0)
 			, num_optimistic_unchoke_slots(0)
 			, no_atime_storage(true)
 			, default_est_reciprocation_rate(16000)
@@ -225,6 +227,7 @@ namespace libtorrent
 			, incoming_starts_queued_torrents(false)
 			, report_true_downloaded(false)
 			, strict_end_game_mode(true)
+			, peer_affinity_picking(false)
 			, default_peer_upload_rate(0)
 			, default_peer_download_rate(0)
 			, broadcast_lsd(true)
@@ -272,6 +275,11 @@ namespace libtorrent
 			, use_disk_read_ahead(true)
 			, lock_files(false)
 			, ssl_listen(4433)
+			, ssl_session_cache_size(256)
+			, ssl_session_tickets(true)
+			, ssl_ciphers()
+			, use_kernel_tls(false)
+			, disk_cache_huge_pages(false)
 #ifdef TORRENT_CALLBACK_LOGGER
 		        , loggingCallBack(NULL)
 #endif
@@ -859,6 +867,18 @@ namespace libtorrent
 		// is kept in the cache.
 		int default_cache_min_age;
 
+		// the number of seconds added to the minimum age of
+		// a read cache line each time a block is served from it.
+		// Lines that keep getting hit are protected from eviction
+		// while lines that were only read once are evicted first.
+		// 0 means plain LRU
+		int read_cache_hit_age;
+
+		// the number of seconds added to the minimum age of a
+		// read cache line for each level of cache priority of the
+		// torrent it belongs to (see torrent_handle::set_cache_priority)
+		int read_cache_priority_age;
+
 		// the global number of optimistic unchokes
 		// 0 means automatic
 		int num_optimistic_unchoke_slots;
@@ -899,6 +919,12 @@ namespace libtorrent
 		// until every piece is requested
 		bool strict_end_game_mode;
 
+		// in end game, only request the blocks expected to arrive
+		// last a second time, and only from peers expected to deliver
+		// them sooner. Sequential downloads also keep fast and slow
+		// peers on separate pieces
+		bool peer_affinity_picking;
+
 		// each peer will have these limits set on it
 		int default_peer_upload_rate;
 		int default_peer_download_rate;
@@ -1097,6 +1123,28 @@ namespace libtorrent
                 // open an ssl listen socket for ssl torrents on this port
                 int ssl_listen;
 
+		// the max number of TLS sessions kept for resumption, both
+		// server side and, per SSL torrent, for outgoing connections.
+		// 0 disables session resumption
+		int ssl_session_cache_size;
+
+		// allow resumption through RFC 5077 session tickets, which
+		// don't need any server side state
+		bool ssl_session_tickets;
+
+		// the OpenSSL cipher list for SSL torrent connections. Empty
+		// means the built-in policy, see default_ssl_cipher_list()
+		std::string ssl_ciphers;
+
+		// once the handshake of an SSL torrent connection over TCP is
+		// done, have the kernel encrypt what is sent on it (Linux kernel
+		// TLS). Limits SSL connections to TLS 1.2
+		bool use_kernel_tls;
+
+		// grow the disk buffer pool in chunks of at least 2 MiB,
+		// backed by transparent huge pages where the system has them
+		bool disk_cache_huge_pages;
+
 		// logging call back function
 #ifdef TORRENT_CALLBACK_LOGGER
 		void (*loggingCallBack) (std::string);
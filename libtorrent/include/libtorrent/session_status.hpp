@@ -113,6 +113,11 @@ namespace libtorrent
 		size_type total_redundant_bytes;
 		size_type total_failed_bytes;
 
+		// payload bytes copied from a receive buffer into a disk
+		// buffer. Bittorrent peers receive blocks straight into
+		// disk buffers, only web and http seeds copy
+		size_type total_payload_copied;
+
 		int num_peers;
 		int num_unchoked;
 		int allowed_upload_slots;
@@ -142,6 +147,34 @@ namespace libtorrent
 		utp_status utp_stats;
 
 		int peerlist_size;
+
+		// incoming SSL handshakes that completed and that failed, and the
+		// total time, in milliseconds, spent in the completed ones.
+		// ssl_handshake_histogram[i] counts completed handshakes that took
+		// at most ssl_handshake_bucket_limit(i) milliseconds and more than
+		// the previous bucket's limit. The last bucket is unbounded.
+		enum { num_ssl_handshake_buckets = 8 };
+		size_type total_ssl_handshakes;
+		size_type total_ssl_handshake_failures;
+		size_type total_ssl_handshake_time;
+		size_type ssl_handshake_histogram[num_ssl_handshake_buckets];
+
+		// the completed incoming handshakes that resumed a session, and
+		// the completed outgoing handshakes and how many of those resumed
+		size_type total_ssl_handshakes_resumed;
+		size_type total_outgoing_ssl_handshakes;
+		size_type total_outgoing_ssl_handshakes_resumed;
+
+		// SSL connections whose sent data the kernel encrypts
+		size_type total_kernel_tls_connections;
+
+		// returns -1 for the last, unbounded, bucket
+		static int ssl_handshake_bucket_limit(int i)
+		{
+			static const int limits[num_ssl_handshake_buckets]
+				= { 10, 25, 50, 100, 250, 500, 1000, -1 };
+			return limits[i];
+		}
 	};
 
 }
@@ -198,6 +198,17 @@ namespace libtorrent
 		std::size_t available(error_code& ec) const;
 		int type();
 
+#ifdef TORRENT_USE_OPENSSL
+		// the OpenSSL connection object of SSL sockets, 0 for
+		// any other socket type
+		SSL* native_ssl();
+
+		// hands encryption of what is sent on an SSL over TCP socket to
+		// the kernel, see ssl_stream::enable_kernel_send(). Fails for any
+		// other socket type
+		bool enable_kernel_tls(error_code& ec);
+#endif
+
 
 		template <class Mutable_Buffers>
 		std::size_t read_some(Mutable_Buffers const& buffers, error_code& ec)
@@ -0,0 +1,71 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_SSL_CIPHERS_HPP_INCLUDED
+#define TORRENT_SSL_CIPHERS_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+
+#ifdef TORRENT_USE_OPENSSL
+
+#include <string>
+
+extern "C"
+{
+#include <openssl/ssl.h>
+}
+
+namespace libtorrent
+{
+	// true if the CPU has AES instructions (AES-NI on x86, the
+	// crypto extension on ARMv8)
+	TORRENT_EXPORT bool cpu_has_aes();
+
+	// the cipher list used for SSL torrents when session_settings::ssl_ciphers
+	// is empty. AEAD suites with ECDHE key exchange come first, AES-GCM ahead
+	// of ChaCha20-Poly1305 if the CPU accelerates AES and the other way around
+	// if it doesn't. CBC suites are left at the end for older peers.
+	TORRENT_EXPORT char const* default_ssl_cipher_list();
+
+	// the TLS 1.3 cipher suites, in the same order of preference
+	TORRENT_EXPORT char const* default_tls13_cipher_suites();
+
+	// applies the cipher list, or the default policy if it's empty,
+	// and enables ECDHE on ctx. Returns false if none of the ciphers
+	// in the list is supported, ctx is left unchanged in that case
+	TORRENT_EXPORT bool set_ssl_cipher_policy(SSL_CTX* ctx, std::string const& ciphers);
+}
+
+#endif // TORRENT_USE_OPENSSL
+
+#endif // TORRENT_SSL_CIPHERS_HPP_INCLUDED
+
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_SSL_STREAM_HPP_INCLUDED
 
 #include "libtorrent/socket.hpp"
+#include "libtorrent/ktls.hpp"
 #include <boost/bind.hpp>
 #if BOOST_VERSION < 103500
 #include <asio/ssl.hpp>
@@ -53,6 +54,8 @@ public:
 
 	explicit ssl_stream(io_service& io_service, asio::ssl::context& ctx)
 		: m_sock(io_service, ctx)
+		, m_kernel_send(false)
+		, m_keep_session(false)
 	{
 	}
 
@@ -67,6 +70,26 @@ public:
 
 	SSL* native_handle() { return m_sock.native_handle(); }
 
+	// once the handshake is done, hands encryption of everything sent on
+	// this stream to the kernel. Writes then go straight to the underlying
+	// socket, reads are still decrypted by OpenSSL. Returns false and
+	// leaves the stream untouched if kernel TLS can't be used for it
+	bool enable_kernel_send(error_code& ec)
+	{
+		if (m_kernel_send) return true;
+		m_kernel_send = enable_ktls_send(m_sock.native_handle()
+			, ktls_socket(m_sock.next_layer()), ec);
+		return m_kernel_send;
+	}
+
+	bool kernel_send() const { return m_kernel_send; }
+
+	// set when the connection ends without an error, closing it then
+	// leaves its TLS session resumable. The session of a connection that
+	// is closed otherwise is dropped from the cache when the SSL object is
+	// freed, as a session of a connection that failed must not be resumed
+	void set_keep_session(bool k) { m_keep_session = k; }
+
 	typedef boost::function<void(error_code const&)> handler_type;
 
 	template <class Handler>
@@ -102,11 +125,22 @@ public:
 	template <class Handler>
 	void async_shutdown(Handler const& handler)
 	{
+		// OpenSSL no longer has the send keys to write a close_notify with
+		if (m_kernel_send)
+		{
+			m_sock.get_io_service().post(boost::bind<void>(handler, error_code()));
+			return;
+		}
 		m_sock.async_shutdown(handler);
 	}
 
 	void shutdown(error_code& ec)
 	{
+		if (m_kernel_send)
+		{
+			ec.clear();
+			return;
+		}
 		m_sock.shutdown(ec);
 	}
 
@@ -159,12 +193,17 @@ public:
 	template <class Const_Buffers, class Handler>
 	void async_write_some(Const_Buffers const& buffers, Handler const& handler)
 	{
-		m_sock.async_write_some(buffers, handler);
+		if (m_kernel_send)
+			m_sock.next_layer().async_write_some(buffers, handler);
+		else
+			m_sock.async_write_some(buffers, handler);
 	}
 
 	template <class Const_Buffers>
 	std::size_t write_some(Const_Buffers const& buffers, error_code& ec)
 	{
+		if (m_kernel_send)
+			return m_sock.next_layer().write_some(buffers, ec);
 		return m_sock.write_some(buffers, ec);
 	}
 
@@ -208,12 +247,14 @@ public:
 #ifndef BOOST_NO_EXCEPTIONS
 	void close()
 	{
+		if (m_keep_session) keep_session();
 		m_sock.next_layer().close();
 	}
 #endif
 
 	void close(error_code& ec)
 	{
+		if (m_keep_session) keep_session();
 		m_sock.next_layer().close(ec);
 	}
 
@@ -275,7 +316,25 @@ private:
 		(*h)(e);
 	}
 
+	// when the SSL object of a connection that wasn't shut down is freed,
+	// OpenSSL takes its session out of the cache and marks it as not
+	// resumable. Peers just close the socket, so a connection that got
+	// through the handshake and ended normally is marked as shut down
+	// instead, which doesn't send anything
+	void keep_session()
+	{
+		SSL* ssl = m_sock.native_handle();
+		if (SSL_is_init_finished(ssl))
+			SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+	}
+
 	asio::ssl::stream<Stream> m_sock;
+
+	// true once the kernel encrypts what is sent on the stream
+	bool m_kernel_send;
+
+	// see set_keep_session()
+	bool m_keep_session;
 };
 
 }
@@ -214,7 +214,8 @@ namespace libtorrent
 		struct fileop
 		{
 			size_type (file::*regular_op)(size_type file_offset
-				, file::iovec_t const* bufs, int num_bufs, error_code& ec);
+				, file::iovec_t const* bufs, int num_bufs, error_code& ec
+				, int* num_syscalls);
 			size_type (default_storage::*unaligned_op)(boost::intrusive_ptr<file> const& f
 				, size_type file_offset, file::iovec_t const* bufs, int num_bufs
 				, error_code& ec);
@@ -249,6 +250,12 @@ namespace libtorrent
 
 		int m_page_size;
 		bool m_allocate_files;
+
+		// the piece and the range of it last passed to
+		// file::hint_read(), to hint each piece only once
+		int m_hint_slot;
+		int m_hint_start;
+		int m_hint_end;
 	};
 
 	// this storage implementation does not write anything to disk
@@ -323,16 +330,19 @@ namespace libtorrent
 			peer_request const& r
 			, boost::function<void(int, disk_io_job const&)> const& handler
 			, int cache_line_size = 0
-			, int cache_expiry = 0);
+			, int cache_expiry = 0
+			, int cache_priority = 0);
 
 		void async_read_and_hash(
 			peer_request const& r
 			, boost::function<void(int, disk_io_job const&)> const& handler
-			, int cache_expiry = 0);
+			, int cache_expiry = 0
+			, int cache_priority = 0);
 
 		void async_cache(int piece
 			, boost::function<void(int, disk_io_job const&)> const& handler
-			, int cache_expiry = 0);
+			, int cache_expiry = 0
+			, int cache_priority = 0);
 
 		// returns the write queue size
 		int async_write(
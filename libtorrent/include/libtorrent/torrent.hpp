@@ -209,6 +209,11 @@ namespace libtorrent
 		torrent_status::state_t state() const { return (torrent_status::state_t)m_state; }
 		void set_state(torrent_status::state_t s);
 
+		// marks this torrent as having changed status since the
+		// last call to session::post_torrent_updates()
+		void state_updated();
+		void clear_in_state_update() { m_in_state_updates = false; }
+
 		session_settings const& settings() const;
 		
 		aux::session_impl& session() { return m_ses; }
@@ -327,6 +332,18 @@ namespace libtorrent
 			m_priority = prio;
 		}
 
+		// the read cache priority hint for this torrent's pieces,
+		// 0 is normal, higher values keep its pieces in the read
+		// cache longer
+		int cache_priority() const { return m_cache_priority; }
+		void set_cache_priority(int prio)
+		{
+			TORRENT_ASSERT(prio <= 7 && prio >= 0);
+			if (prio > 7) prio = 7;
+			else if (prio < 0) prio = 0;
+			m_cache_priority = prio;
+		}
+
 #ifndef TORRENT_DISABLE_RESOLVE_COUNTRIES
 		void resolve_countries(bool r)
 		{ m_resolve_countries = r; }
@@ -849,6 +866,13 @@ namespace libtorrent
 			, std::string const& passphrase);
 		bool is_ssl_torrent() const { return m_ssl_ctx; } 
 		boost::asio::ssl::context* ssl_ctx() const { return m_ssl_ctx.get(); } 
+
+		// outgoing connections offer the TLS session of the previous
+		// connection to the same peer. The sessions the peer hands out
+		// reach save_ssl_session() through the context's new session
+		// callback, which returns true when it took the reference
+		void resume_ssl_session(tcp::endpoint const& ep, SSL* ssl);
+		bool save_ssl_session(tcp::endpoint const& ep, SSL_SESSION* sess);
 #endif
 
 	private:
@@ -937,6 +961,9 @@ namespace libtorrent
 #ifdef TORRENT_USE_OPENSSL
 		boost::shared_ptr<asio::ssl::context> m_ssl_ctx;
 
+		// TLS sessions of outgoing connections, by peer endpoint
+		std::map<tcp::endpoint, SSL_SESSION*> m_ssl_sessions;
+
 		void init_ssl(std::string const& cert);
 #endif
 
@@ -1223,6 +1250,10 @@ namespace libtorrent
 		// connection to this torrent
 		bool m_has_incoming:1;
 
+		// this is true while this torrent is in the session's
+		// list of torrents to include in the next state_update_alert
+		bool m_in_state_updates:1;
+
 		// this is set to true when the files are checked
 		// before the files are checked, we don't try to
 		// connect to peers
@@ -1361,6 +1392,10 @@ namespace libtorrent
 		// on the local network
 		bool m_allow_rfc1918_conections:1;
 
+		// the read cache priority hint passed along with every
+		// read job issued for this torrent. See set_cache_priority()
+		boost::uint8_t m_cache_priority:3;
+
 #if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 	public:
 		// set to false until we've loaded resume data
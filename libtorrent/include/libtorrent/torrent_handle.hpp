@@ -184,6 +184,9 @@ namespace libtorrent
 		void reset_piece_deadline(int index) const;
 
 		void set_priority(int prio) const;
+
+		void set_cache_priority(int prio) const;
+		int cache_priority() const;
 		
 #ifndef TORRENT_NO_DEPRECATE
 #if !TORRENT_NO_FPU
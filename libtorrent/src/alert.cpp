@@ -45,12 +45,85 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/extensions.hpp"
 #include <boost/bind.hpp>
 
+#ifndef TORRENT_DISABLE_POOL_ALLOCATOR
+#include <boost/pool/pool.hpp>
+#include <new>
+#endif
+
 namespace libtorrent {
 
 	alert::alert() : m_timestamp(time_now()) {}
 	alert::~alert() {}
 	ptime alert::timestamp() const { return m_timestamp; }
 
+#ifndef TORRENT_DISABLE_POOL_ALLOCATOR
+	namespace
+	{
+		// alerts are allocated by the network thread and freed by the
+		// thread popping them, so the pools are shared under a lock
+		struct alert_allocator
+		{
+			enum
+			{
+				granularity = 32,
+				num_classes = 8,
+				max_pooled_size = granularity * num_classes
+			};
+
+			alert_allocator()
+			{
+				for (int i = 0; i < num_classes; ++i)
+					m_pools[i] = new boost::pool<>((i + 1) * granularity, 64);
+			}
+
+			void* malloc(std::size_t size)
+			{
+				mutex::scoped_lock l(m_mutex);
+				return m_pools[(size - 1) / granularity]->malloc();
+			}
+
+			void free(void* p, std::size_t size)
+			{
+				mutex::scoped_lock l(m_mutex);
+				m_pools[(size - 1) / granularity]->free(p);
+			}
+
+		private:
+			mutex m_mutex;
+			boost::pool<>* m_pools[num_classes];
+		};
+
+		// never destructed, alerts may still be freed by static
+		// destructors at exit
+		alert_allocator& allocator()
+		{
+			static alert_allocator* a = new alert_allocator;
+			return *a;
+		}
+	}
+
+	void* alert::operator new(std::size_t size)
+	{
+		if (size == 0 || size > alert_allocator::max_pooled_size)
+			return ::operator new(size);
+
+		void* ret = allocator().malloc(size);
+		if (ret == 0) throw std::bad_alloc();
+		return ret;
+	}
+
+	void alert::operator delete(void* p, std::size_t size)
+	{
+		if (p == 0) return;
+		if (size == 0 || size > alert_allocator::max_pooled_size)
+		{
+			::operator delete(p);
+			return;
+		}
+		allocator().free(p, size);
+	}
+#endif
+
 
 	std::string torrent_alert::message() const
 	{
@@ -434,6 +507,35 @@ namespace libtorrent {
 
 	}
 
+	void alert_manager::post_alert_ptr(alert* alert_)
+	{
+		std::auto_ptr<alert> a(alert_);
+
+#ifndef TORRENT_DISABLE_EXTENSIONS
+		for (ses_extension_list_t::iterator i = m_ses_extensions.begin()
+			, end(m_ses_extensions.end()); i != end; ++i)
+		{
+			TORRENT_TRY {
+				(*i)->on_alert(a.get());
+			} TORRENT_CATCH(std::exception&) {}
+		}
+#endif
+
+		mutex::scoped_lock lock(m_mutex);
+
+		if (m_dispatch)
+		{
+			TORRENT_ASSERT(m_alerts.empty());
+			TORRENT_TRY {
+				m_dispatch(a);
+			} TORRENT_CATCH(std::exception&) {}
+		}
+		else if (m_alerts.size() < m_queue_size_limit || !a->discardable())
+		{
+			m_alerts.push_back(a.release());
+		}
+	}
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 	void alert_manager::add_extension(boost::shared_ptr<plugin> ext)
 	{
@@ -599,5 +701,12 @@ namespace libtorrent {
 		return msg;
 	}
 
+	std::string state_update_alert::message() const
+	{
+		char msg[600];
+		snprintf(msg, sizeof(msg), "state updates for %d torrents", int(status.size()));
+		return msg;
+	}
+
 } // namespace libtorrent
 
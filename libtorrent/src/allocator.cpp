@@ -48,6 +48,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <malloc.h> // memalign
 #endif
 
+#ifdef TORRENT_LINUX
+#include <sys/mman.h> // madvise
+#endif
+
 #ifdef TORRENT_DEBUG_BUFFERS
 #include <sys/mman.h>
 #include "libtorrent/size_type.hpp"
@@ -159,6 +163,28 @@ namespace libtorrent
 #endif
 	}
 
+	char* huge_page_allocator::malloc(size_type bytes)
+	{
+#if defined TORRENT_LINUX && defined MADV_HUGEPAGE && !defined TORRENT_DEBUG_BUFFERS
+		if (bytes >= huge_page_size)
+		{
+			void* ret;
+			if (posix_memalign(&ret, huge_page_size, bytes) != 0) return 0;
+			// this is only a hint. Kernels without transparent
+			// huge pages fail it and we keep the normal pages
+			madvise(ret, bytes, MADV_HUGEPAGE);
+			return (char*)ret;
+		}
+#endif
+		return page_aligned_allocator::malloc(bytes);
+	}
+
+	void huge_page_allocator::free(char* const block)
+	{
+		// on linux both kinds of blocks are released with ::free()
+		page_aligned_allocator::free(block);
+	}
+
 
 }
 
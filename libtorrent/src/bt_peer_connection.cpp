@@ -69,6 +69,14 @@ using libtorrent::aux::session_impl;
 
 namespace libtorrent
 {
+	namespace
+	{
+		void free_malloc_buffer(char* buf, void*) { ::free(buf); }
+
+		void free_disk_buffer(char* buf, void* ses)
+		{ static_cast<session_impl*>(ses)->free_disk_buffer(buf); }
+	}
+
 	const bt_peer_connection::message_handler
 	bt_peer_connection::m_message_handler[] =
 	{
@@ -675,7 +683,7 @@ namespace libtorrent
 			// since we'll mutate it
 			char* buf = (char*)malloc(size);
 			memcpy(buf, buffer, size);
-			bt_peer_connection::append_send_buffer(buf, size, boost::bind(&::free, _1));
+			bt_peer_connection::append_send_buffer(buf, size, &free_malloc_buffer, 0);
 		}
 		else
 #endif
@@ -2347,9 +2355,7 @@ namespace libtorrent
 			send_buffer(msg, 13);
 		}
 
-		append_send_buffer(buffer.get(), r.length
-			, boost::bind(&session_impl::free_disk_buffer
-			, boost::ref(m_ses), _1));
+		append_send_buffer(buffer.get(), r.length, &free_disk_buffer, &m_ses);
 		buffer.release();
 
 		m_payloads.push_back(range(send_buffer_size() - r.length, r.length));
@@ -33,6 +33,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/disk_buffer_pool.hpp"
 #include "libtorrent/assert.hpp"
 
+#include <algorithm>
+
 #if TORRENT_USE_MLOCK && !defined TORRENT_WINDOWS
 #include <sys/mman.h>
 #endif
@@ -42,13 +44,14 @@ namespace libtorrent
 	disk_buffer_pool::disk_buffer_pool(int block_size)
 		: m_block_size(block_size)
 		, m_in_use(0)
+		, m_pool_locks(0)
+		, m_pool_contended(0)
+		, m_pool_waiters(0)
+		, m_disk_syscalls(0)
 #ifndef TORRENT_DISABLE_POOL_ALLOCATOR
 		, m_pool(block_size, m_settings.cache_buffer_chunk_size)
 #endif
 	{
-#if defined TORRENT_DISK_STATS || defined TORRENT_STATS
-		m_allocations = 0;
-#endif
 #ifdef TORRENT_DISK_STATS
 		m_log.open("disk_buffers.log", std::ios::trunc);
 		m_categories["read cache"] = 0;
@@ -61,13 +64,46 @@ namespace libtorrent
 #endif
 	}
 
-#if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 	disk_buffer_pool::~disk_buffer_pool()
 	{
 		TORRENT_ASSERT(m_magic == 0x1337);
+		// no other thread may use the pool anymore, so it's safe
+		// to empty every thread's cache
+		mutex::scoped_lock l(m_pool_mutex);
+		for (std::vector<thread_cache*>::iterator i = m_caches.begin()
+			, end(m_caches.end()); i != end; ++i)
+		{
+			thread_cache* c = *i;
+			for (int k = 0; k < c->num_buffers; ++k)
+			{
+#ifdef TORRENT_DISABLE_POOL_ALLOCATOR
+				page_aligned_allocator::free(c->buffers[k]);
+#else
+				m_pool.free(c->buffers[k]);
+#endif
+			}
+			delete c;
+		}
+		m_caches.clear();
+		l.unlock();
+#if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 		m_magic = 0;
-	}
 #endif
+	}
+
+	disk_buffer_pool::pool_lock::pool_lock(disk_buffer_pool const& p)
+		: pool(p)
+		, contended(++p.m_pool_waiters > 1)
+		, l(p.m_pool_mutex)
+	{
+		++pool.m_pool_locks;
+		if (contended) ++pool.m_pool_contended;
+	}
+
+	disk_buffer_pool::pool_lock::~pool_lock()
+	{
+		--pool.m_pool_waiters;
+	}
 
 #if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS || defined TORRENT_DISK_STATS
 	bool disk_buffer_pool::is_disk_buffer(char* buffer
@@ -92,16 +128,100 @@ namespace libtorrent
 	}
 #endif
 
-	char* disk_buffer_pool::allocate_buffer(char const* category)
+	bool disk_buffer_pool::use_thread_cache() const
+	{
+#ifdef TORRENT_DISK_STATS
+		// every buffer is tracked by category under the pool mutex
+		return false;
+#else
+		// locked buffers are unlocked as they're freed. Keeping
+		// them in a cache would pin memory we report as free
+		return !m_settings.lock_disk_cache;
+#endif
+	}
+
+	disk_buffer_pool::thread_cache* disk_buffer_pool::get_thread_cache()
+	{
+		thread_cache* c = m_thread_cache;
+		if (c) return c;
+		c = new thread_cache;
+		{
+			mutex::scoped_lock l(m_pool_mutex);
+			m_caches.push_back(c);
+		}
+		m_thread_cache = c;
+		return c;
+	}
+
+	int disk_buffer_pool::chunk_size() const
+	{
+		if (!m_settings.disk_cache_huge_pages) return m_settings.cache_buffer_chunk_size;
+		// make every chunk span at least one huge page
+		return (std::max)(m_settings.cache_buffer_chunk_size
+			, huge_page_allocator::huge_page_size / m_block_size);
+	}
+
+	char* disk_buffer_pool::allocate_impl(mutex::scoped_lock& l)
 	{
-		mutex::scoped_lock l(m_pool_mutex);
-		TORRENT_ASSERT(m_magic == 0x1337);
 #ifdef TORRENT_DISABLE_POOL_ALLOCATOR
-		char* ret = page_aligned_allocator::malloc(m_block_size);
+		return page_aligned_allocator::malloc(m_block_size);
 #else
 		char* ret = (char*)m_pool.ordered_malloc();
-		m_pool.set_next_size(m_settings.cache_buffer_chunk_size);
+		m_pool.set_next_size(chunk_size());
+		return ret;
 #endif
+	}
+
+	void disk_buffer_pool::refill(thread_cache& c)
+	{
+		TORRENT_ASSERT(c.num_buffers == 0);
+		pool_lock pl(*this);
+		for (int i = 0; i < thread_cache::batch; ++i)
+		{
+			char* buf = allocate_impl(pl.l);
+			if (buf == 0) break;
+			c.buffers[c.num_buffers++] = buf;
+		}
+	}
+
+	void disk_buffer_pool::flush(thread_cache& c, int num)
+	{
+		TORRENT_ASSERT(num <= c.num_buffers);
+		if (num == 0) return;
+		char** begin = c.buffers + c.num_buffers - num;
+		// return the buffers in address order, like free_multiple_buffers
+		std::sort(begin, begin + num);
+		pool_lock pl(*this);
+		for (int i = 0; i < num; ++i)
+		{
+#ifdef TORRENT_DISABLE_POOL_ALLOCATOR
+			page_aligned_allocator::free(begin[i]);
+#else
+			m_pool.free(begin[i]);
+#endif
+		}
+		c.num_buffers -= num;
+	}
+
+	char* disk_buffer_pool::allocate_buffer(char const* category)
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+		if (use_thread_cache())
+		{
+			thread_cache* c = get_thread_cache();
+			if (c->num_buffers > 0) ++c->hits;
+			else refill(*c);
+			if (c->num_buffers == 0) return 0;
+			char* ret = c->buffers[--c->num_buffers];
+			++m_in_use;
+			TORRENT_ASSERT(is_disk_buffer(ret));
+			return ret;
+		}
+
+		pool_lock pl(*this);
+		mutex::scoped_lock& l = pl.l;
+		char* ret = allocate_impl(l);
+		if (ret == 0) return 0;
 		++m_in_use;
 #if TORRENT_USE_MLOCK
 		if (m_settings.lock_disk_cache)
@@ -114,15 +234,12 @@ namespace libtorrent
 		}
 #endif
 
-#if defined TORRENT_DISK_STATS || defined TORRENT_STATS
-		++m_allocations;
-#endif
 #ifdef TORRENT_DISK_STATS
 		++m_categories[category];
 		m_buf_to_category[ret] = category;
 		m_log << log_time() << " " << category << ": " << m_categories[category] << "\n";
 #endif
-		TORRENT_ASSERT(ret == 0 || is_disk_buffer(ret, l));
+		TORRENT_ASSERT(is_disk_buffer(ret, l));
 		return ret;
 	}
 
@@ -151,19 +268,34 @@ namespace libtorrent
 		// sort the pointers in order to maximize cache hits
 		std::sort(bufvec, end);
 
-		mutex::scoped_lock l(m_pool_mutex);
+		pool_lock pl(*this);
 		for (; bufvec != end; ++bufvec)
 		{
 			char* buf = *bufvec;
 			TORRENT_ASSERT(buf);
-			free_buffer_impl(buf, l);;
+			free_buffer_impl(buf, pl.l);
 		}
 	}
 
 	void disk_buffer_pool::free_buffer(char* buf)
 	{
-		mutex::scoped_lock l(m_pool_mutex);
-		free_buffer_impl(buf, l);
+		TORRENT_ASSERT(buf);
+		if (use_thread_cache())
+		{
+			TORRENT_ASSERT(m_magic == 0x1337);
+			TORRENT_ASSERT(is_disk_buffer(buf));
+			thread_cache* c = get_thread_cache();
+			if (c->num_buffers == thread_cache::capacity)
+				flush(*c, thread_cache::batch);
+			else
+				++c->hits;
+			c->buffers[c->num_buffers++] = buf;
+			--m_in_use;
+			return;
+		}
+
+		pool_lock pl(*this);
+		free_buffer_impl(buf, pl.l);
 	}
 
 	void disk_buffer_pool::free_buffer_impl(char* buf, mutex::scoped_lock& l)
@@ -171,9 +303,6 @@ namespace libtorrent
 		TORRENT_ASSERT(buf);
 		TORRENT_ASSERT(m_magic == 0x1337);
 		TORRENT_ASSERT(is_disk_buffer(buf, l));
-#if defined TORRENT_DISK_STATS || defined TORRENT_STATS
-		--m_allocations;
-#endif
 #ifdef TORRENT_DISK_STATS
 		TORRENT_ASSERT(m_categories.find(m_buf_to_category[buf])
 			!= m_categories.end());
@@ -200,13 +329,26 @@ namespace libtorrent
 		--m_in_use;
 	}
 
+	void disk_buffer_pool::pool_stats(size_type& cache_hits, size_type& locks
+		, size_type& contended) const
+	{
+		mutex::scoped_lock l(m_pool_mutex);
+		cache_hits = 0;
+		for (std::vector<thread_cache*>::const_iterator i = m_caches.begin()
+			, end(m_caches.end()); i != end; ++i)
+			cache_hits += (*i)->hits;
+		locks = m_pool_locks;
+		contended = m_pool_contended;
+	}
+
 	void disk_buffer_pool::release_memory()
 	{
 		TORRENT_ASSERT(m_magic == 0x1337);
+		thread_cache* c = m_thread_cache;
+		if (c) flush(*c, c->num_buffers);
 #ifndef TORRENT_DISABLE_POOL_ALLOCATOR
-		mutex::scoped_lock l(m_pool_mutex);
+		pool_lock pl(*this);
 		m_pool.release_memory();
 #endif
 	}
 }
-
@@ -42,7 +42,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/error.hpp"
 #include "libtorrent/file_pool.hpp"
-#include <boost/scoped_array.hpp>
+#include "libtorrent/allocator.hpp"
 #include <boost/bind.hpp>
 
 #include "libtorrent/time.hpp"
@@ -151,6 +151,7 @@ namespace libtorrent
 			info.next_to_hash = i->next_block_to_hash;
 			info.piece = i->piece;
 			info.last_use = i->expire;
+			info.hits = 0;
 			info.kind = cached_piece_info::write_cache;
 			int blocks_in_piece = (ti.piece_size(i->piece) + (m_block_size) - 1) / m_block_size;
 			info.blocks.resize(blocks_in_piece);
@@ -167,6 +168,7 @@ namespace libtorrent
 			info.next_to_hash = i->next_block_to_hash;
 			info.piece = i->piece;
 			info.last_use = i->expire;
+			info.hits = i->hits;
 			info.kind = cached_piece_info::read_cache;
 			int blocks_in_piece = (ti.piece_size(i->piece) + (m_block_size) - 1) / m_block_size;
 			info.blocks.resize(blocks_in_piece);
@@ -186,6 +188,9 @@ namespace libtorrent
 
 		ret.job_queue_length = m_jobs.size() + m_sorted_read_jobs.size();
 		ret.read_queue_size = m_sorted_read_jobs.size();
+		pool_stats(ret.buffer_cache_hits, ret.buffer_pool_locks
+			, ret.buffer_pool_contended);
+		ret.disk_syscalls = disk_syscalls();
 
 		return ret;
 	}
@@ -233,6 +238,35 @@ namespace libtorrent
 		int expire;
 	};
 
+	// the number of seconds a read cache line is guaranteed to stay in
+	// the cache after being touched. Lines that only were read in once
+	// get the minimum age, which makes them the first ones to go. Every
+	// hit and every level of cache priority of the torrent protects the
+	// line a bit longer, which approximates keeping the most frequently
+	// requested pieces resident
+	int disk_io_thread::read_cache_age(cached_piece_entry const& p, int cache_min_time) const
+	{
+		return cache_min_time
+			+ p.hits * m_settings.read_cache_hit_age
+			+ p.priority * m_settings.read_cache_priority_age;
+	}
+
+	struct update_read_use
+	{
+		update_read_use(disk_io_thread const& t, disk_io_job const& j, bool h)
+			: thread(t), job(j), hit(h) {}
+		void operator()(disk_io_thread::cached_piece_entry& p)
+		{
+			TORRENT_ASSERT(p.storage);
+			if (hit && p.hits < disk_io_thread::max_read_cache_hits) ++p.hits;
+			p.priority = job.cache_priority;
+			p.expire = time_now() + seconds(thread.read_cache_age(p, job.cache_min_time));
+		}
+		disk_io_thread const& thread;
+		disk_io_job const& job;
+		bool hit;
+	};
+
 	disk_io_thread::cache_piece_index_t::iterator disk_io_thread::find_cached_piece(
 		disk_io_thread::cache_t& cache
 		, disk_io_job const& j, mutex::scoped_lock& l)
@@ -585,10 +619,12 @@ namespace libtorrent
 		int buffer_size = 0;
 		int offset = 0;
 
-		boost::scoped_array<char> buf;
+		// the buffer is page aligned, so files opened in no_buffer
+		// mode can write it directly rather than through write_unaligned
+		aligned_holder buf;
 		file::iovec_t* iov = 0;
 		int iov_counter = 0;
-		if (m_settings.coalesce_writes) buf.reset(new (std::nothrow) char[piece_size]);
+		if (m_settings.coalesce_writes) buf.reset(page_aligned_allocator::malloc(piece_size));
 		else iov = TORRENT_ALLOCA(file::iovec_t, blocks_in_piece);
 
 		end = (std::min)(end, blocks_in_piece);
@@ -611,7 +647,7 @@ namespace libtorrent
 				}
 				else
 				{
-					TORRENT_ASSERT(buf);
+					TORRENT_ASSERT(buf.get());
 					file::iovec_t b = { buf.get(), buffer_size };
 					int ret = p.storage->write_impl(&b, p.piece, (std::min)(
 						i * m_block_size, piece_size) - buffer_size, 1);
@@ -629,14 +665,14 @@ namespace libtorrent
 			TORRENT_ASSERT(offset + block_size > 0);
 			if (iov)
 			{
-				TORRENT_ASSERT(!buf);
+				TORRENT_ASSERT(!buf.get());
 				iov[iov_counter].iov_base = p.blocks[i].buf;
 				iov[iov_counter].iov_len = block_size;
 				++iov_counter;
 			}
 			else
 			{
-				TORRENT_ASSERT(buf);
+				TORRENT_ASSERT(buf.get());
 				TORRENT_ASSERT(iov == 0);
 				std::memcpy(buf.get() + offset, p.blocks[i].buf, block_size);
 				offset += m_block_size;
@@ -719,6 +755,8 @@ namespace libtorrent
 		p.num_blocks = 1;
 		p.num_contiguous_blocks = 1;
 		p.next_block_to_hash = 0;
+		p.hits = 0;
+		p.priority = 0;
 		p.blocks.reset(new (std::nothrow) cached_block_entry[blocks_in_piece]);
 		if (!p.blocks) return -1;
 		int block = j.offset / m_block_size;
@@ -751,7 +789,7 @@ namespace libtorrent
 
 		int ret = 0;
 
-		boost::scoped_array<char> buf;
+		aligned_holder buf;
 		for (int i = start_block; i < blocks_in_piece
 			&& ((options & ignore_cache_size)
 				|| in_use() < m_settings.cache_size); ++i)
@@ -807,9 +845,9 @@ namespace libtorrent
 		TORRENT_ASSERT(buffer_size + start_block * m_block_size <= piece_size);
 
 		if (m_settings.coalesce_reads)
-			buf.reset(new (std::nothrow) char[buffer_size]);
+			buf.reset(page_aligned_allocator::malloc(buffer_size));
 
-		if (buf)
+		if (buf.get())
 		{
 			l.unlock();
 			file::iovec_t b = { buf.get(), buffer_size };
@@ -896,16 +934,23 @@ namespace libtorrent
 			int clear = in_use() + blocks_to_read - m_settings.cache_size;
 			if (flush_cache_blocks(l, clear, ignore_t(j.piece, j.storage.get())
 				, dont_flush_write_blocks) < clear)
+			{
+				// every line in the read cache is still protected,
+				// don't let this read displace any of them
+				++m_cache_stats.blocks_read_uncached;
 				return -2;
+			}
 		}
 
 		cached_piece_entry p;
 		p.piece = j.piece;
 		p.storage = j.storage;
-		p.expire = time_now() + seconds(j.cache_min_time);
 		p.num_blocks = 0;
 		p.num_contiguous_blocks = 0;
 		p.next_block_to_hash = 0;
+		p.hits = 0;
+		p.priority = j.cache_priority;
+		p.expire = time_now() + seconds(read_cache_age(p, j.cache_min_time));
 		p.blocks.reset(new (std::nothrow) cached_block_entry[blocks_in_piece]);
 		if (!p.blocks) return -1;
 
@@ -1014,7 +1059,7 @@ namespace libtorrent
 				, options, blocks_in_piece, l);
 			hit = false;
 			if (ret < 0) return ret;
-			idx.modify(p, update_last_use(j.cache_min_time));
+			idx.modify(p, update_read_use(*this, j, false));
 		}
 		else if (p == m_read_pieces.end())
 		{
@@ -1026,10 +1071,12 @@ namespace libtorrent
 			cached_piece_entry pe;
 			pe.piece = j.piece;
 			pe.storage = j.storage;
-			pe.expire = time_now() + seconds(j.cache_min_time);
 			pe.num_blocks = 0;
 			pe.num_contiguous_blocks = 0;
 			pe.next_block_to_hash = 0;
+			pe.hits = 0;
+			pe.priority = j.cache_priority;
+			pe.expire = time_now() + seconds(read_cache_age(pe, j.cache_min_time));
 			pe.blocks.reset(new (std::nothrow) cached_block_entry[blocks_in_piece]);
 			if (!pe.blocks) return -1;
 			ret = read_into_piece(pe, 0, options, INT_MAX, l);
@@ -1041,7 +1088,7 @@ namespace libtorrent
 		}
 		else
 		{
-			idx.modify(p, update_last_use(j.cache_min_time));
+			idx.modify(p, update_read_use(*this, j, false));
 		}
 		TORRENT_ASSERT(!m_read_pieces.empty());
 		TORRENT_ASSERT(p->piece == j.piece);
@@ -1088,7 +1135,7 @@ namespace libtorrent
 		if (ret < 0) return ret;
 		cache_piece_index_t& idx = m_read_pieces.get<0>();
 		if (p->num_blocks == 0) idx.erase(p);
-		else idx.modify(p, update_last_use(j.cache_min_time));
+		else idx.modify(p, update_read_use(*this, j, hit));
 
 		// if read cache is disabled or we exceeded the
 		// limit, remove this piece from the cache
@@ -1278,7 +1325,7 @@ namespace libtorrent
 		ret = copy_from_piece(const_cast<cached_piece_entry&>(*p), hit, j, l);
 		if (ret < 0) return ret;
 		if (p->num_blocks == 0) idx.erase(p);
-		else idx.modify(p, update_last_use(j.cache_min_time));
+		else idx.modify(p, update_read_use(*this, j, hit));
 
 		ret = j.buffer_size;
 		++m_cache_stats.blocks_read;
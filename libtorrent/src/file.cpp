@@ -1025,6 +1025,36 @@ namespace libtorrent
 
 	// defined in storage.cpp
 	int bufs_size(file::iovec_t const* bufs, int num_bufs);
+
+#ifndef TORRENT_WINDOWS
+	namespace
+	{
+		// with preadv()/pwritev() a read or write is a single system
+		// call that doesn't move the file position, otherwise the
+		// caller has to lseek() to file_offset first
+#if TORRENT_USE_READV
+		int iov_read(int fd, file::iovec_t const* bufs, int num_bufs, size_type file_offset)
+		{
+#if TORRENT_USE_PREADV
+			return ::preadv(fd, bufs, num_bufs, file_offset);
+#else
+			return ::readv(fd, bufs, num_bufs);
+#endif
+		}
+#endif
+
+#if TORRENT_USE_WRITEV
+		int iov_write(int fd, file::iovec_t const* bufs, int num_bufs, size_type file_offset)
+		{
+#if TORRENT_USE_PREADV
+			return ::pwritev(fd, bufs, num_bufs, file_offset);
+#else
+			return ::writev(fd, bufs, num_bufs);
+#endif
+		}
+#endif
+	}
+#endif
 	
 #if defined TORRENT_WINDOWS || defined TORRENT_LINUX || defined TORRENT_DEBUG
 
@@ -1053,7 +1083,8 @@ namespace libtorrent
 #endif
 	}
 
-	size_type file::readv(size_type file_offset, iovec_t const* bufs, int num_bufs, error_code& ec)
+	size_type file::readv(size_type file_offset, iovec_t const* bufs, int num_bufs
+		, error_code& ec, int* num_syscalls)
 	{
 		TORRENT_ASSERT((m_open_mode & rw_mask) == read_only || (m_open_mode & rw_mask) == read_write);
 		TORRENT_ASSERT(bufs);
@@ -1184,12 +1215,17 @@ namespace libtorrent
 
 #else // TORRENT_WINDOWS
 
+#if !TORRENT_USE_PREADV
 		size_type ret = lseek(m_fd, file_offset, SEEK_SET);
+		if (num_syscalls) ++*num_syscalls;
 		if (ret < 0)
 		{
 			ec.assign(errno, get_posix_category());
 			return -1;
 		}
+#else
+		size_type ret = 0;
+#endif
 #if TORRENT_USE_READV
 
 		ret = 0;
@@ -1197,20 +1233,20 @@ namespace libtorrent
 		{
 			int nbufs = (std::min)(num_bufs, TORRENT_IOV_MAX);
 			int tmp_ret = 0;
+			int size = bufs_size(bufs, nbufs);
 #ifdef TORRENT_LINUX
 			bool aligned = false;
-			int size = 0;
 			// if we're not opened in no-buffer mode, we don't need alignment
 			if ((m_open_mode & no_buffer) == 0) aligned = true;
 			if (!aligned)
 			{
-				size = bufs_size(bufs, nbufs);
 				if ((size & (size_alignment()-1)) == 0) aligned = true;
 			}
 			if (aligned)
 #endif // TORRENT_LINUX
 			{
-				tmp_ret = ::readv(m_fd, bufs, nbufs);
+				tmp_ret = iov_read(m_fd, bufs, nbufs, file_offset);
+				if (num_syscalls) ++*num_syscalls;
 				if (tmp_ret < 0)
 				{
 					ec.assign(errno, get_posix_category());
@@ -1225,16 +1261,22 @@ namespace libtorrent
 				memcpy(temp_bufs, bufs, sizeof(file::iovec_t) * nbufs);
 				iovec_t& last = temp_bufs[nbufs-1];
 				last.iov_len = (last.iov_len & ~(size_alignment()-1)) + m_page_size;
-				tmp_ret = ::readv(m_fd, temp_bufs, nbufs);
+				tmp_ret = iov_read(m_fd, temp_bufs, nbufs, file_offset);
+				if (num_syscalls) ++*num_syscalls;
 				if (tmp_ret < 0)
 				{
 					ec.assign(errno, get_posix_category());
 					return -1;
 				}
-				ret += (std::min)(tmp_ret, size);
+				tmp_ret = (std::min)(tmp_ret, size);
+				ret += tmp_ret;
 			}
 #endif // TORRENT_LINUX
 
+			// a short read means we hit the end of the file
+			if (tmp_ret < size) break;
+
+			file_offset += tmp_ret;
 			num_bufs -= nbufs;
 			bufs += nbufs;
 		}
@@ -1247,6 +1289,7 @@ namespace libtorrent
 		for (file::iovec_t const* i = bufs, *end(bufs + num_bufs); i < end; ++i)
 		{
 			int tmp = read(m_fd, i->iov_base, i->iov_len);
+			if (num_syscalls) ++*num_syscalls;
 			if (tmp < 0)
 			{
 				ec.assign(errno, get_posix_category());
@@ -1262,7 +1305,8 @@ namespace libtorrent
 #endif // TORRENT_WINDOWS
 	}
 
-	size_type file::writev(size_type file_offset, iovec_t const* bufs, int num_bufs, error_code& ec)
+	size_type file::writev(size_type file_offset, iovec_t const* bufs, int num_bufs
+		, error_code& ec, int* num_syscalls)
 	{
 		TORRENT_ASSERT((m_open_mode & rw_mask) == write_only || (m_open_mode & rw_mask) == read_write);
 		TORRENT_ASSERT(bufs);
@@ -1476,12 +1520,17 @@ namespace libtorrent
 
 		return ret;
 #else
+#if !TORRENT_USE_PREADV
 		size_type ret = lseek(m_fd, file_offset, SEEK_SET);
+		if (num_syscalls) ++*num_syscalls;
 		if (ret < 0)
 		{
 			ec.assign(errno, get_posix_category());
 			return -1;
 		}
+#else
+		size_type ret = 0;
+#endif
 
 #if TORRENT_USE_WRITEV
 
@@ -1490,20 +1539,20 @@ namespace libtorrent
 		{
 			int nbufs = (std::min)(num_bufs, TORRENT_IOV_MAX);
 			int tmp_ret = 0;
+			int size = bufs_size(bufs, nbufs);
 #ifdef TORRENT_LINUX
 			bool aligned = false;
-			int size = 0;
 			// if we're not opened in no-buffer mode, we don't need alignment
 			if ((m_open_mode & no_buffer) == 0) aligned = true;
 			if (!aligned)
 			{
-				size = bufs_size(bufs, nbufs);
 				if ((size & (size_alignment()-1)) == 0) aligned = true;
 			}
 			if (aligned)
 #endif
 			{
-				tmp_ret = ::writev(m_fd, bufs, nbufs);
+				tmp_ret = iov_write(m_fd, bufs, nbufs, file_offset);
+				if (num_syscalls) ++*num_syscalls;
 				if (tmp_ret < 0)
 				{
 					ec.assign(errno, get_posix_category());
@@ -1518,7 +1567,8 @@ namespace libtorrent
 				memcpy(temp_bufs, bufs, sizeof(file::iovec_t) * nbufs);
 				iovec_t& last = temp_bufs[nbufs-1];
 				last.iov_len = (last.iov_len & ~(size_alignment()-1)) + size_alignment();
-				tmp_ret = ::writev(m_fd, temp_bufs, nbufs);
+				tmp_ret = iov_write(m_fd, temp_bufs, nbufs, file_offset);
+				if (num_syscalls) *num_syscalls += 2;
 				if (tmp_ret < 0)
 				{
 					ec.assign(errno, get_posix_category());
@@ -1529,10 +1579,15 @@ namespace libtorrent
 					ec.assign(errno, get_posix_category());
 					return -1;
 				}
-				ret += (std::min)(tmp_ret, size);
+				tmp_ret = (std::min)(tmp_ret, size);
+				ret += tmp_ret;
 			}
 #endif // TORRENT_LINUX
 
+			// a short write means we hit the end of the file, or the disk is full
+			if (tmp_ret < size) break;
+
+			file_offset += tmp_ret;
 			num_bufs -= nbufs;
 			bufs += nbufs;
 		}
@@ -1545,6 +1600,7 @@ namespace libtorrent
 		for (file::iovec_t const* i = bufs, *end(bufs + num_bufs); i < end; ++i)
 		{
 			int tmp = write(m_fd, i->iov_base, i->iov_len);
+			if (num_syscalls) ++*num_syscalls;
 			if (tmp < 0)
 			{
 				ec.assign(errno, get_posix_category());
@@ -0,0 +1,247 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/ktls.hpp"
+
+#if defined TORRENT_USE_OPENSSL
+
+#if TORRENT_USE_KTLS
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <cstring>
+
+extern "C"
+{
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <openssl/objects.h>
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+#include <openssl/kdf.h>
+#endif
+}
+#endif
+
+namespace libtorrent
+{
+#if TORRENT_USE_KTLS && OPENSSL_VERSION_NUMBER >= 0x10100000L
+
+	namespace
+	{
+		// from <linux/tls.h>, which older kernel headers don't have
+		const int ulp_option = 31; // TCP_ULP
+		const int sol_tls = 282;
+		const int tls_tx = 1;
+		const boost::uint16_t tls_1_2_version = 0x0303;
+		const boost::uint16_t tls_cipher_aes_gcm_128 = 51;
+		const boost::uint16_t tls_cipher_aes_gcm_256 = 52;
+
+		struct tls12_crypto_info_aes_gcm_128
+		{
+			boost::uint16_t version;
+			boost::uint16_t cipher_type;
+			unsigned char iv[8];
+			unsigned char key[16];
+			unsigned char salt[4];
+			unsigned char rec_seq[8];
+		};
+
+		struct tls12_crypto_info_aes_gcm_256
+		{
+			boost::uint16_t version;
+			boost::uint16_t cipher_type;
+			unsigned char iv[8];
+			unsigned char key[32];
+			unsigned char salt[4];
+			unsigned char rec_seq[8];
+		};
+
+		// the TLS 1.2 PRF (RFC 5246 section 5)
+		bool tls12_prf(EVP_MD const* md, unsigned char const* secret, int secret_len
+			, char const* label, unsigned char const* seed, int seed_len
+			, unsigned char* out, size_t out_len)
+		{
+			EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, 0);
+			if (pctx == 0) return false;
+			bool ret = EVP_PKEY_derive_init(pctx) > 0
+				&& EVP_PKEY_CTX_set_tls1_prf_md(pctx, md) > 0
+				&& EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, secret, secret_len) > 0
+				&& EVP_PKEY_CTX_add1_tls1_prf_seed(pctx
+					, reinterpret_cast<unsigned char const*>(label), int(std::strlen(label))) > 0
+				&& EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, seed, seed_len) > 0
+				&& EVP_PKEY_derive(pctx, out, &out_len) > 0;
+			EVP_PKEY_CTX_free(pctx);
+			return ret;
+		}
+
+		template <class CryptoInfo>
+		bool install_send_keys(int fd, CryptoInfo& info, boost::uint16_t cipher_type
+			, ktls_send_state const& st, error_code& ec)
+		{
+			info.version = tls_1_2_version;
+			info.cipher_type = cipher_type;
+			std::memcpy(info.key, st.key, sizeof(info.key));
+			std::memcpy(info.salt, st.salt, sizeof(info.salt));
+			std::memcpy(info.rec_seq, st.rec_seq, sizeof(info.rec_seq));
+
+			// the explicit nonce only has to be unique, it starts out
+			// as the sequence number
+			std::memcpy(info.iv, info.rec_seq, sizeof(info.iv));
+
+			if (setsockopt(fd, SOL_TCP, ulp_option, "tls", sizeof("tls")) < 0
+				|| setsockopt(fd, sol_tls, tls_tx, &info, sizeof(info)) < 0)
+			{
+				// without TLS_TX the socket still sends as it did before
+				ec.assign(errno, get_posix_category());
+				return false;
+			}
+			return true;
+		}
+	}
+
+	bool derive_ktls_send_state(SSL* ssl, ktls_send_state& st, error_code& ec)
+	{
+		SSL_CIPHER const* cipher = SSL_get_current_cipher(ssl);
+		SSL_SESSION* session = SSL_get_session(ssl);
+		if (cipher == 0 || session == 0 || SSL_version(ssl) != TLS1_2_VERSION)
+		{
+			ec = asio::error::operation_not_supported;
+			return false;
+		}
+
+		// every TLS 1.2 AES-GCM suite uses SHA-256 for the PRF with
+		// 128 bit keys and SHA-384 with 256 bit keys
+		int key_len;
+		EVP_MD const* md;
+		switch (SSL_CIPHER_get_cipher_nid(cipher))
+		{
+			case NID_aes_128_gcm: key_len = 16; md = EVP_sha256(); break;
+			case NID_aes_256_gcm: key_len = 32; md = EVP_sha384(); break;
+			default:
+				ec = asio::error::operation_not_supported;
+				return false;
+		}
+
+		unsigned char master_key[SSL_MAX_MASTER_KEY_LENGTH];
+		int master_len = int(SSL_SESSION_get_master_key(session, master_key, sizeof(master_key)));
+
+		// key_block = PRF(master_secret, "key expansion", server_random + client_random)
+		unsigned char seed[2 * SSL3_RANDOM_SIZE];
+		SSL_get_server_random(ssl, seed, SSL3_RANDOM_SIZE);
+		SSL_get_client_random(ssl, seed + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+		// AEAD suites have no MAC keys, the key block is the client and
+		// server write keys followed by the 4 byte implicit nonces
+		unsigned char key_block[2 * 32 + 2 * 4];
+		int block_len = 2 * key_len + 2 * 4;
+		bool ret = tls12_prf(md, master_key, master_len, "key expansion"
+			, seed, sizeof(seed), key_block, block_len);
+		OPENSSL_cleanse(master_key, sizeof(master_key));
+		if (!ret)
+		{
+			ec = asio::error::operation_not_supported;
+			return false;
+		}
+
+		bool server = SSL_is_server(ssl);
+		st.key_len = key_len;
+		std::memcpy(st.key, key_block + (server ? key_len : 0), key_len);
+		std::memcpy(st.salt, key_block + 2 * key_len + (server ? 4 : 0), sizeof(st.salt));
+		OPENSSL_cleanse(key_block, sizeof(key_block));
+
+		// the Finished message was record 0 of the new keys, and
+		// nothing has been sent since
+		std::memset(st.rec_seq, 0, sizeof(st.rec_seq));
+		st.rec_seq[7] = 1;
+		return true;
+	}
+
+	bool enable_ktls_send(SSL* ssl, int fd, error_code& ec)
+	{
+		if (fd < 0)
+		{
+			ec = asio::error::operation_not_supported;
+			return false;
+		}
+
+		ktls_send_state st;
+		if (!derive_ktls_send_state(ssl, st, ec)) return false;
+
+		bool ret;
+		if (st.key_len == 16)
+		{
+			tls12_crypto_info_aes_gcm_128 info;
+			ret = install_send_keys(fd, info, tls_cipher_aes_gcm_128, st, ec);
+			OPENSSL_cleanse(&info, sizeof(info));
+		}
+		else
+		{
+			tls12_crypto_info_aes_gcm_256 info;
+			ret = install_send_keys(fd, info, tls_cipher_aes_gcm_256, st, ec);
+			OPENSSL_cleanse(&info, sizeof(info));
+		}
+		OPENSSL_cleanse(&st, sizeof(st));
+		if (!ret) return false;
+
+		// OpenSSL still decrypts what is read, and answers some of it with
+		// alerts, or a close_notify on shutdown. Those would be encrypted
+		// with the stale send state and then once more by the kernel, so
+		// what OpenSSL writes from now on goes to a BIO that drops it
+		SSL_set0_wbio(ssl, BIO_new(BIO_s_null()));
+
+#ifdef SSL_OP_NO_RENEGOTIATION
+		// OpenSSL can't send anything on this connection anymore
+		SSL_set_options(ssl, SSL_OP_NO_RENEGOTIATION);
+#endif
+		return true;
+	}
+
+#else
+
+	bool derive_ktls_send_state(SSL*, ktls_send_state&, error_code& ec)
+	{
+		ec = asio::error::operation_not_supported;
+		return false;
+	}
+
+	bool enable_ktls_send(SSL*, int, error_code& ec)
+	{
+		ec = asio::error::operation_not_supported;
+		return false;
+	}
+
+#endif // TORRENT_USE_KTLS
+}
+
+#endif // TORRENT_USE_OPENSSL
+
@@ -919,6 +919,10 @@ namespace libtorrent
 		if (t->is_sequential_download())
 		{
 			ret |= piece_picker::sequential | piece_picker::ignore_whole_pieces;
+			// keep fast and slow peers on separate pieces, so a
+			// piece isn't held up by its slowest block
+			if (t->settings().peer_affinity_picking)
+				ret |= piece_picker::speed_affinity;
 		}
 		else if (t->num_have() < t->settings().initial_picker_threshold)
 		{
@@ -1044,7 +1048,10 @@ namespace libtorrent
 		if (rate < 50) rate = 50;
 		boost::shared_ptr<torrent> t = m_torrent.lock();
 		TORRENT_ASSERT(t);
-		return seconds((m_outstanding_bytes + m_queued_time_critical * t->block_size()) / rate);
+		boost::int64_t bytes = boost::int64_t(m_outstanding_bytes) + extra_bytes
+			+ m_queued_time_critical * t->block_size();
+		return milliseconds(int((std::min)(bytes * 1000 / rate
+			, boost::int64_t((std::numeric_limits<int>::max)()))));
 	}
 
 	void peer_connection::add_stat(size_type downloaded, size_type uploaded)
@@ -2254,6 +2261,7 @@ namespace libtorrent
 		}
 		disk_buffer_holder holder(m_ses, buffer);
 		std::memcpy(buffer, data, p.length);
+		m_ses.add_copied_payload(p.length);
 		incoming_piece(p, holder);
 	}
 
@@ -3411,6 +3419,29 @@ namespace libtorrent
 	// the error argument defaults to 0, which means deliberate disconnect
 	// 1 means unexpected disconnect/error
 	// 2 protocol error (client sent something invalid)
+#ifdef TORRENT_USE_OPENSSL
+	namespace
+	{
+		// the reasons a connection ends when neither side did anything
+		// wrong, their TLS sessions may be resumed
+		bool is_normal_close(error_code const& ec)
+		{
+			return ec == error::eof
+				|| ec == error_code(errors::upload_upload_connection)
+				|| ec == error_code(errors::uninteresting_upload_peer)
+				|| ec == error_code(errors::torrent_paused)
+				|| ec == error_code(errors::torrent_aborted)
+				|| ec == error_code(errors::torrent_removed)
+				|| ec == error_code(errors::stopping_torrent)
+				|| ec == error_code(errors::session_closing)
+				|| ec == error_code(errors::too_many_connections)
+				|| ec == error_code(errors::timed_out_inactivity)
+				|| ec == error_code(errors::timed_out_no_interest)
+				|| ec == error_code(errors::timed_out_no_request);
+		}
+	}
+#endif
+
 	void peer_connection::disconnect(error_code const& ec, int error)
 	{
 #if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
@@ -3565,13 +3596,21 @@ namespace libtorrent
 		error_code e;
 
 #ifdef TORRENT_USE_OPENSSL
-		// for SSL connections, first do an async_shutdown, before closing the socket
+		// for SSL connections, first do an async_shutdown, before closing the
+		// socket. A connection that ends in an error is closed without a
+		// shutdown, which drops its session from the cache
 #define CASE(t) case socket_type_int_impl<ssl_stream<t> >::value: \
-		if (ec == error_code(errors::upload_upload_connection)) \
+		if (error > 1 || !is_normal_close(ec)) \
+		{ \
+			m_socket->close(e); \
+		} \
+		else if (ec == error_code(errors::upload_upload_connection)) \
 		{ \
+			m_socket->get<ssl_stream<t> >()->set_keep_session(true); \
 			m_socket->get<ssl_stream<t> >()->shutdown(e); \
 			close_socket(m_socket);\
 		} else { \
+			m_socket->get<ssl_stream<t> >()->set_keep_session(true); \
 			m_socket->get<ssl_stream<t> >()->async_shutdown(boost::bind(&close_socket, m_socket)); \
 		} \
 		break;
@@ -4416,14 +4455,14 @@ namespace libtorrent
 			 ||  (t->seed_mode() && t->disable_seed_hash()))
 			{
 				t->filesystem().async_read(r, boost::bind(&peer_connection::on_disk_read_complete
-					, self(), _1, _2, r), cache.first, cache.second);
+					, self(), _1, _2, r), cache.first, cache.second, t->cache_priority());
 			}
 			else
 			{
 				// this means we're in seed mode and we haven't yet
 				// verified this piece (r.piece)
 				t->filesystem().async_read_and_hash(r, boost::bind(&peer_connection::on_disk_read_complete
-					, self(), _1, _2, r), cache.second);
+					, self(), _1, _2, r), cache.second, t->cache_priority());
 				t->verified(r.piece);
 			}
 
@@ -4738,7 +4777,7 @@ namespace libtorrent
 #ifdef TORRENT_VERBOSE_LOGGING
 		peer_log(">>> ASYNC_WRITE [ bytes: %d ]", amount_to_send);
 #endif
-		std::list<asio::const_buffer> const& vec = m_send_buffer.build_iovec(amount_to_send);
+		chained_buffer::iovec_t vec = m_send_buffer.build_iovec(amount_to_send);
 #if defined TORRENT_ASIO_DEBUGGING
 		add_outstanding_async("peer_connection::on_send_data");
 #endif
@@ -5012,11 +5051,15 @@ namespace libtorrent
 		m_packet_size = packet_size;
 	}
 
-	void nop(char*) {}
+	namespace
+	{
+		void free_send_buffer(char* buf, void* ses)
+		{ static_cast<session_impl*>(ses)->free_buffer(buf); }
+	}
 
 	void peer_connection::append_const_send_buffer(char const* buffer, int size)
 	{
-		m_send_buffer.append_buffer((char*)buffer, size, size, &nop);
+		m_send_buffer.append_buffer((char*)buffer, size, size, 0);
 #if defined TORRENT_STATS && defined TORRENT_DISK_STATS
 		m_ses.m_buffer_usage_logger << log_time() << " append_const_send_buffer: " << size << std::endl;
 		m_ses.log_buffer_usage();
@@ -5066,7 +5109,7 @@ namespace libtorrent
 			buf += buf_size;
 			size -= buf_size;
 			m_send_buffer.append_buffer(chain_buf, aux::session_impl::send_buffer_size, buf_size
-				, boost::bind(&session_impl::free_buffer, boost::ref(m_ses), _1));
+				, &free_send_buffer, &m_ses);
 			++i;
 		}
 		setup_send();
@@ -5396,6 +5439,24 @@ namespace libtorrent
 
 		m_statistics.received_synack(m_remote.address().is_v6());
 
+#ifdef TORRENT_USE_OPENSSL
+		// for SSL sockets the connect includes the handshake
+		if (SSL* ssl = m_socket->native_ssl())
+		{
+			++m_ses.m_total_outgoing_ssl_handshakes;
+			if (SSL_session_reused(ssl))
+				++m_ses.m_total_outgoing_ssl_handshakes_resumed;
+
+			m_ses.enable_kernel_tls(*m_socket);
+
+#if defined TORRENT_VERBOSE_LOGGING
+			peer_log("*** SSL [ cipher: %s version: %s resumed: %d ]"
+				, SSL_get_cipher_name(ssl), SSL_get_version(ssl)
+				, int(SSL_session_reused(ssl)));
+#endif
+		}
+#endif
+
 		TORRENT_ASSERT(m_socket);
 #if defined TORRENT_VERBOSE_LOGGING
 		peer_log(">>> COMPLETED [ ep: %s rtt: %d ]", print_endpoint(m_remote).c_str(), m_rtt);
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <numeric>
 
@@ -62,6 +63,72 @@ namespace libtorrent
 
 	const piece_block piece_block::invalid(0x3FFFF, 0x3FFF);
 
+	namespace
+	{
+		template <class Fun>
+		void for_each_bit_in_byte(unsigned int b, int index, Fun& f)
+		{
+			for (; b != 0; b = (b << 1) & 0xff, ++index)
+				if (b & 0x80) f(index);
+		}
+
+		// calls f(index) for every set bit in the bitfield. The
+		// bitfield is read 64 bits at a time, so runs of pieces a peer
+		// doesn't have are skipped and runs it has are handed out
+		// without testing each bit
+		template <class Fun>
+		void for_each_set_bit(bitfield const& bits, Fun& f)
+		{
+			unsigned char const* b = (unsigned char const*)bits.bytes();
+			int const num_bytes = (bits.size() + 7) / 8;
+			int i = 0;
+			for (; i + 8 <= num_bytes; i += 8)
+			{
+				boost::uint64_t word;
+				std::memcpy(&word, b + i, 8);
+				if (word == 0) continue;
+				if (word == ~boost::uint64_t(0))
+				{
+					for (int index = i * 8, end(i * 8 + 64); index != end; ++index)
+						f(index);
+					continue;
+				}
+				for (int k = i; k < i + 8; ++k)
+					for_each_bit_in_byte(b[k], k * 8, f);
+			}
+			// the trailing bits of the last byte are always clear
+			for (; i < num_bytes; ++i)
+				for_each_bit_in_byte(b[i], i * 8, f);
+		}
+
+		struct add_peer_count
+		{
+			add_peer_count(std::vector<piece_picker::piece_pos>& m, int d)
+				: map(m), delta(d) {}
+			void operator()(int index)
+			{
+				TORRENT_ASSERT(delta > 0 || map[index].peer_count > 0);
+				map[index].peer_count += delta;
+			}
+			std::vector<piece_picker::piece_pos>& map;
+			int delta;
+		};
+
+		struct inc_piece_refcount
+		{
+			inc_piece_refcount(piece_picker& p): picker(p) {}
+			void operator()(int index) { picker.inc_refcount(index); }
+			piece_picker& picker;
+		};
+
+		struct dec_piece_refcount
+		{
+			dec_piece_refcount(piece_picker& p): picker(p) {}
+			void operator()(int index) { picker.dec_refcount(index); }
+			piece_picker& picker;
+		};
+	}
+
 	piece_picker::piece_picker()
 		: m_seeds(0)
 		, m_priority_boundries(1, int(m_pieces.size()))
@@ -929,19 +996,22 @@ namespace libtorrent
 #endif
 		TORRENT_ASSERT(bitmask.size() == m_piece_map.size());
 
-		int index = 0;
-		bool updated = false;
-		for (bitfield::const_iterator i = bitmask.begin()
-			, end(bitmask.end()); i != end; ++i, ++index)
+		int num_pieces = bitmask.count();
+		if (num_pieces == 0) return;
+
+		// a peer with only a few pieces moves them within the
+		// piece order, like HAVE messages would. Rebuilding the
+		// order at the next pick costs a pass over every piece
+		if (!m_dirty && num_pieces <= max_incremental_refcount)
 		{
-			if (*i)
-			{
-				++m_piece_map[index].peer_count;
-				updated = true;
-			}
+			inc_piece_refcount f(*this);
+			for_each_set_bit(bitmask, f);
+			return;
 		}
 
-		if (updated) m_dirty = true;
+		add_peer_count f(m_piece_map, 1);
+		for_each_set_bit(bitmask, f);
+		m_dirty = true;
 	}
 
 	void piece_picker::dec_refcount(bitfield const& bitmask)
@@ -951,19 +1021,22 @@ namespace libtorrent
 #endif
 		TORRENT_ASSERT(bitmask.size() == m_piece_map.size());
 
-		int index = 0;
-		bool updated = false;
-		for (bitfield::const_iterator i = bitmask.begin()
-			, end(bitmask.end()); i != end; ++i, ++index)
+		int num_pieces = bitmask.count();
+		if (num_pieces == 0) return;
+
+		// a peer with only a few pieces moves them within the
+		// piece order, like HAVE messages would. Rebuilding the
+		// order at the next pick costs a pass over every piece
+		if (!m_dirty && num_pieces <= max_incremental_refcount)
 		{
-			if (*i)
-			{
-				--m_piece_map[index].peer_count;
-				updated = true;
-			}
+			dec_piece_refcount f(*this);
+			for_each_set_bit(bitmask, f);
+			return;
 		}
 
-		if (updated) m_dirty = true;
+		add_peer_count f(m_piece_map, -1);
+		for_each_set_bit(bitmask, f);
+		m_dirty = true;
 	}
 
 	void piece_picker::update_pieces() const
@@ -1018,7 +1091,10 @@ namespace libtorrent
 			, end(m_priority_boundries.end()); i != end; ++i)
 		{
 			if (start == *i) continue;
-			std::random_shuffle(&m_pieces[0] + start, &m_pieces[0] + *i);
+			// shuffle with our own generator, std::random_shuffle
+			// goes through rand() and its lock for every piece
+			for (int k = *i - 1; k > start; --k)
+				std::swap(m_pieces[k], m_pieces[start + random() % (k - start + 1)]);
 			start = *i;
 		}
 
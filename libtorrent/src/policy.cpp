@@ -104,6 +104,15 @@ namespace
 	};
 #endif
 
+	// when the block is expected to arrive from the peer it's
+	// requested from, at that peer's current download rate
+	ptime busy_block_arrival(piece_picker const& p, piece_block b)
+	{
+		policy::peer* pp = static_cast<policy::peer*>(p.get_downloader(b));
+		if (pp == 0 || pp->connection == 0) return max_time();
+		return time_now() + pp->connection->download_queue_time();
+	}
+
 }
 
 namespace libtorrent
@@ -238,6 +247,12 @@ namespace libtorrent
 		// that some other peer is currently downloading
 		piece_block busy_block = piece_block::invalid;
 
+		// with peer affinity picking, the busy block is the one
+		// expected to arrive last, and it's only requested again
+		// if this peer is expected to deliver it sooner
+		bool const affinity = ses.m_settings.peer_affinity_picking;
+		ptime busy_arrival = min_time();
+
 		for (std::vector<piece_block>::iterator i = interesting_pieces.begin(); 
 				 i != interesting_pieces.end(); ++i)
 		{
@@ -259,7 +274,18 @@ namespace libtorrent
 				if (dont_pick_busy_blocks) break;
 
 				TORRENT_ASSERT(p.num_peers(*i) > 0);
+				if (!affinity)
+				{
+					busy_block = *i;
+					continue;
+				}
+
+				// every block is requested from at most two peers
+				if (num_block_requests > 1) continue;
+				ptime arrival = busy_block_arrival(p, *i);
+				if (arrival <= busy_arrival) continue;
 				busy_block = *i;
+				busy_arrival = arrival;
 				continue;
 			}
 
@@ -319,6 +345,12 @@ namespace libtorrent
 			return;
 		}
 
+		if (affinity && time_now() + c.download_queue_time(t.block_size())
+			>= busy_arrival)
+		{
+			return;
+		}
+
 #ifdef TORRENT_STATS
 		++ses.m_end_game_piece_picker_blocks;
 #endif
@@ -147,6 +147,7 @@ namespace
 #ifdef TORRENT_USE_OPENSSL
 
 #include <openssl/crypto.h>
+#include "libtorrent/ssl_ciphers.hpp"
 
 namespace
 {
@@ -391,6 +392,8 @@ namespace aux {
 		TORRENT_SETTING(boolean, volatile_read_cache)
 		TORRENT_SETTING(boolean, guided_read_cache)
 		TORRENT_SETTING(integer, default_cache_min_age)
+		TORRENT_SETTING(integer, read_cache_hit_age)
+		TORRENT_SETTING(integer, read_cache_priority_age)
 		TORRENT_SETTING(integer, num_optimistic_unchoke_slots)
 		TORRENT_SETTING(boolean, no_atime_storage)
 		TORRENT_SETTING(integer, default_est_reciprocation_rate)
@@ -399,6 +402,7 @@ namespace aux {
 		TORRENT_SETTING(boolean, incoming_starts_queued_torrents)
 		TORRENT_SETTING(boolean, report_true_downloaded)
 		TORRENT_SETTING(boolean, strict_end_game_mode)
+		TORRENT_SETTING(boolean, peer_affinity_picking)
 		TORRENT_SETTING(integer, default_peer_upload_rate)
 		TORRENT_SETTING(integer, default_peer_download_rate)
 		TORRENT_SETTING(boolean, broadcast_lsd)
@@ -442,6 +446,11 @@ namespace aux {
 		TORRENT_SETTING(integer, read_job_every)
 		TORRENT_SETTING(boolean, use_disk_read_ahead)
 		TORRENT_SETTING(boolean, lock_files)
+		TORRENT_SETTING(integer, ssl_session_cache_size)
+		TORRENT_SETTING(boolean, ssl_session_tickets)
+		TORRENT_SETTING(std_string, ssl_ciphers)
+		TORRENT_SETTING(boolean, use_kernel_tls)
+		TORRENT_SETTING(boolean, disk_cache_huge_pages)
 	};
 
 #undef TORRENT_SETTING
@@ -660,6 +669,14 @@ namespace aux {
 #endif
 		, m_total_failed_bytes(0)
 		, m_total_redundant_bytes(0)
+		, m_total_payload_copied(0)
+		, m_total_ssl_handshakes(0)
+		, m_total_ssl_handshake_failures(0)
+		, m_total_ssl_handshake_time(0)
+		, m_total_ssl_handshakes_resumed(0)
+		, m_total_outgoing_ssl_handshakes(0)
+		, m_total_outgoing_ssl_handshakes_resumed(0)
+		, m_total_kernel_tls_connections(0)
 #if (defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS) && defined BOOST_HAS_PTHREADS
 		, m_network_thread(0)
 #endif
@@ -669,6 +686,8 @@ namespace aux {
 		m_disk_queues[0] = 0;
 		m_disk_queues[1] = 0;
 
+		memset(m_ssl_handshake_histogram, 0, sizeof(m_ssl_handshake_histogram));
+
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING || defined TORRENT_MINIMAL_LOGGING
 #ifndef TORRENT_CALLBACK_LOGGER
 		m_logger = create_log("main_session", listen_port(), false);
@@ -683,6 +702,12 @@ namespace aux {
 		m_ssl_ctx.set_verify_mode(asio::ssl::context::verify_none, ec);
                 SSL_CTX_set_tlsext_servername_callback(m_ssl_ctx.native_handle(), servername_callback);
                 SSL_CTX_set_tlsext_servername_arg(m_ssl_ctx.native_handle(), this);
+
+		// OpenSSL looks up sessions, and decrypts tickets, in the context
+		// the connection was accepted with, before the SNI callback moves it
+		// to the torrent's context. So this is where the server side
+		// session cache and ticket keys live
+		setup_ssl_context(m_ssl_ctx.native_handle(), true);
 #endif
 
 #ifndef TORRENT_DISABLE_DHT
@@ -1908,8 +1933,29 @@ namespace aux {
 		if (m_settings.dht_upload_rate_limit != s.dht_upload_rate_limit)
 			m_udp_socket.set_rate_limit(s.dht_upload_rate_limit);
 
+#ifdef TORRENT_USE_OPENSSL
+		bool ssl_settings_changed
+			= m_settings.ssl_session_cache_size != s.ssl_session_cache_size
+			|| m_settings.ssl_session_tickets != s.ssl_session_tickets
+			|| m_settings.ssl_ciphers != s.ssl_ciphers
+			|| m_settings.use_kernel_tls != s.use_kernel_tls;
+#endif
+
 		m_settings = s;
 
+#ifdef TORRENT_USE_OPENSSL
+		if (ssl_settings_changed)
+		{
+			setup_ssl_context(m_ssl_ctx.native_handle(), true);
+			for (torrent_map::iterator i = m_torrents.begin()
+				, end(m_torrents.end()); i != end; ++i)
+			{
+				if (i->second->is_ssl_torrent())
+					setup_ssl_context(i->second->ssl_ctx()->native_handle(), false);
+			}
+		}
+#endif
+
 		if (m_settings.cache_buffer_chunk_size <= 0)
 			m_settings.cache_buffer_chunk_size = 1;
 
@@ -2514,7 +2560,7 @@ namespace aux {
                         // for SSL connections, incoming_connection() is called
                         // after the handshake is done
                         s->get<ssl_stream<stream_socket> >()->async_accept_handshake(
-                                boost::bind(&session_impl::ssl_handshake, this, _1, s));
+                                boost::bind(&session_impl::ssl_handshake, this, _1, s, time_now_hires()));
                 }
                 else
 #endif
@@ -2531,15 +2577,103 @@ namespace aux {
         //   -CAfile <torrent-cert>.pem  -debug -connect 127.0.0.1:4433 -tls1 \
         //   -servername <hex-encoded-info-hash>
  
-        void session_impl::ssl_handshake(error_code const& ec, boost::shared_ptr<socket_type> s)
+	void session_impl::setup_ssl_context(SSL_CTX* ctx, bool accepting) const
+	{
+		// a list none of whose ciphers are supported falls back to the
+		// default policy rather than leaving the context without one
+		if (!set_ssl_cipher_policy(ctx, m_settings.ssl_ciphers))
+			set_ssl_cipher_policy(ctx, std::string());
+
+#if TORRENT_USE_KTLS && OPENSSL_VERSION_NUMBER >= 0x10100000L
+		// the kernel is only handed TLS 1.2 keys, see enable_ktls_send()
+		SSL_CTX_set_max_proto_version(ctx, m_settings.use_kernel_tls ? TLS1_2_VERSION : 0);
+#endif
+
+		setup_ssl_session_cache(ctx, accepting);
+	}
+
+	void session_impl::enable_kernel_tls(socket_type& s)
+	{
+		if (!m_settings.use_kernel_tls) return;
+
+		error_code ec;
+		if (s.enable_kernel_tls(ec))
+			++m_total_kernel_tls_connections;
+#if defined(TORRENT_VERBOSE_LOGGING) || defined(TORRENT_LOGGING)
+		else
+			(*m_logger) << time_now_string() << " *** kernel TLS not used: "
+				<< ec.message() << "\n";
+#endif
+	}
+
+	void session_impl::setup_ssl_session_cache(SSL_CTX* ctx, bool accepting) const
+	{
+		// the id context has to be the same in every context an incoming
+		// connection may end up in, or resumed sessions are rejected
+		static unsigned char const session_id_context[] = "libtorrent";
+		SSL_CTX_set_session_id_context(ctx, session_id_context
+			, sizeof(session_id_context) - 1);
+
+		if (m_settings.ssl_session_cache_size > 0)
+		{
+			// incoming connections keep the listen context as their session
+			// context after the SNI callback, so only its cache serves
+			// them. The torrents' contexts make the outgoing connections,
+			// whose sessions go to the torrent through the new session
+			// callback rather than the internal cache
+			if (accepting)
+				SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+			else
+				SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT
+					| SSL_SESS_CACHE_NO_INTERNAL_STORE);
+			SSL_CTX_sess_set_cache_size(ctx, m_settings.ssl_session_cache_size);
+		}
+		else
+		{
+			SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+		}
+
+		if (m_settings.ssl_session_tickets && m_settings.ssl_session_cache_size > 0)
+			SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+		else
+			SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	}
+
+        void session_impl::ssl_handshake(error_code const& ec, boost::shared_ptr<socket_type> s
+                , ptime started)
         {
+                if (ec)
+                {
+                        ++m_total_ssl_handshake_failures;
+                }
+                else
+                {
+                        int ms = total_milliseconds(time_now_hires() - started);
+                        int bucket = 0;
+                        while (bucket < session_status::num_ssl_handshake_buckets - 1
+                                && ms > session_status::ssl_handshake_bucket_limit(bucket))
+                                ++bucket;
+                        ++m_ssl_handshake_histogram[bucket];
+                        ++m_total_ssl_handshakes;
+                        m_total_ssl_handshake_time += ms;
+
+                        SSL* ssl = s->native_ssl();
+                        if (ssl && SSL_session_reused(ssl))
+                                ++m_total_ssl_handshakes_resumed;
+
+                        enable_kernel_tls(*s);
+                }
+
                 error_code e;
                 tcp::endpoint endp = s->remote_endpoint(e);
                 if (e) return;
  
 #if defined(TORRENT_VERBOSE_LOGGING) || defined(TORRENT_LOGGING)
+                SSL* ssl_conn = s->native_ssl();
                 (*m_logger) << time_now_string() << " *** peer SSL handshake done [ ip: "
-                        << endp << " ec: " << ec.message() << "]\n";
+                        << endp << " ec: " << ec.message()
+                        << " cipher: " << (ssl_conn && !ec ? SSL_get_cipher_name(ssl_conn) : "none")
+                        << "]\n";
 #endif
  
                 if (ec)
@@ -4450,6 +4584,7 @@ namespace aux {
 		(*m_logger) << time_now_string() << " cleaning up torrents\n";
 #endif
 		m_torrents.clear();
+		m_torrent_index.clear();
 
 		TORRENT_ASSERT(m_torrents.empty());
 		TORRENT_ASSERT(m_connections.empty());
@@ -4466,8 +4601,7 @@ namespace aux {
 	{
 		TORRENT_ASSERT(is_network_thread());
 
-		std::map<sha1_hash, boost::shared_ptr<torrent> >::iterator i
-			= m_torrents.find(info_hash);
+		torrent** t = m_torrent_index.find(info_hash);
 #ifdef TORRENT_DEBUG
 		for (std::map<sha1_hash, boost::shared_ptr<torrent> >::iterator j
 			= m_torrents.begin(); j != m_torrents.end(); ++j)
@@ -4475,8 +4609,9 @@ namespace aux {
 			torrent* p = boost::get_pointer(j->second);
 			TORRENT_ASSERT(p);
 		}
+		TORRENT_ASSERT((t == 0) == (m_torrents.find(info_hash) == m_torrents.end()));
 #endif
-		if (i != m_torrents.end()) return i->second;
+		if (t) return (*t)->shared_from_this();
 		return boost::weak_ptr<torrent>();
 	}
 
@@ -4484,9 +4619,8 @@ namespace aux {
 	{
 		TORRENT_ASSERT(is_network_thread());
 
-		std::map<std::string, boost::shared_ptr<torrent> >::iterator i
-			= m_uuids.find(uuid);
-		if (i != m_uuids.end()) return i->second;
+		boost::shared_ptr<torrent>* t = m_uuids.find(uuid);
+		if (t) return *t;
 		return boost::weak_ptr<torrent>();
 	}
 
@@ -4535,6 +4669,30 @@ namespace aux {
 		}
 	}
 
+	void session_impl::post_torrent_updates()
+	{
+		TORRENT_ASSERT(is_network_thread());
+
+		// the alert is posted even if status notifications are masked
+		// out, the caller explicitly asked for it
+		std::auto_ptr<state_update_alert> alert(new state_update_alert());
+		alert->status.reserve(m_state_updates.size());
+
+		for (std::vector<boost::weak_ptr<torrent> >::iterator i = m_state_updates.begin()
+			, end(m_state_updates.end()); i != end; ++i)
+		{
+			boost::shared_ptr<torrent> t = i->lock();
+			if (!t) continue;
+			t->clear_in_state_update();
+			if (t->is_aborted()) continue;
+			alert->status.push_back(torrent_status());
+			t->status(&alert->status.back(), 0xffffffff);
+		}
+		m_state_updates.clear();
+
+		m_alerts.post_alert_ptr(alert.release());
+	}
+
 	std::vector<torrent_handle> session_impl::get_torrents() const
 	{
 		std::vector<torrent_handle> ret;
@@ -4662,9 +4820,10 @@ namespace aux {
 #endif
 
 		m_torrents.insert(std::make_pair(*ih, torrent_ptr));
+		m_torrent_index.insert(*ih, torrent_ptr.get());
 		if (!params.uuid.empty() || !params.url.empty())
-			m_uuids.insert(std::make_pair(params.uuid.empty()
-				? params.url : params.uuid, torrent_ptr));
+			m_uuids.insert(params.uuid.empty()
+				? params.url : params.uuid, torrent_ptr);
 
 		if (m_alerts.should_post<torrent_added_alert>())
 			m_alerts.post_alert(torrent_added_alert(torrent_ptr->get_handle()));
@@ -4746,11 +4905,7 @@ namespace aux {
 
 		// remove from uuid list
 		if (!tptr->uuid().empty())
-		{
-			std::map<std::string, boost::shared_ptr<torrent> >::iterator j
-				= m_uuids.find(tptr->uuid());
-			if (j != m_uuids.end()) m_uuids.erase(j);
-		}
+			m_uuids.erase(tptr->uuid());
 
 		session_impl::torrent_map::iterator i =
 			m_torrents.find(tptr->torrent_file().info_hash());
@@ -4781,6 +4936,7 @@ namespace aux {
 		if (i == m_next_connect_torrent)
 			++m_next_connect_torrent;
 
+		m_torrent_index.erase(i->first);
 		m_torrents.erase(i);
 
 #ifndef TORRENT_DISABLE_DHT
@@ -5001,6 +5157,17 @@ namespace aux {
 
 		s.total_redundant_bytes = m_total_redundant_bytes;
 		s.total_failed_bytes = m_total_failed_bytes;
+		s.total_payload_copied = m_total_payload_copied;
+
+		s.total_ssl_handshakes = m_total_ssl_handshakes;
+		s.total_ssl_handshake_failures = m_total_ssl_handshake_failures;
+		s.total_ssl_handshake_time = m_total_ssl_handshake_time;
+		s.total_ssl_handshakes_resumed = m_total_ssl_handshakes_resumed;
+		s.total_outgoing_ssl_handshakes = m_total_outgoing_ssl_handshakes;
+		s.total_outgoing_ssl_handshakes_resumed = m_total_outgoing_ssl_handshakes_resumed;
+		s.total_kernel_tls_connections = m_total_kernel_tls_connections;
+		std::copy(m_ssl_handshake_histogram, m_ssl_handshake_histogram
+			+ session_status::num_ssl_handshake_buckets, s.ssl_handshake_histogram);
 
 		s.up_bandwidth_queue = m_upload_rate.queue_size();
 		s.down_bandwidth_queue = m_download_rate.queue_size();
@@ -5798,6 +5965,8 @@ namespace aux {
 			}
 		}
 
+		TORRENT_ASSERT(m_torrent_index.size() == int(m_torrents.size()));
+
 		// the queue is either empty, or it has exactly one checking torrent in it
 		TORRENT_ASSERT(m_queued_for_checking.empty() || num_checking == 1 || (m_paused && num_checking == 0));
 //		TORRENT_ASSERT(m_queued_for_checking.size() == num_queued_for_checking);
@@ -166,6 +166,34 @@ namespace libtorrent
 
 	int socket_type::type() { return m_type; }
 
+#ifdef TORRENT_USE_OPENSSL
+	SSL* socket_type::native_ssl()
+	{
+		switch (m_type)
+		{
+			case socket_type_int_impl<ssl_stream<stream_socket> >::value:
+				return get<ssl_stream<stream_socket> >()->native_handle();
+			case socket_type_int_impl<ssl_stream<socks5_stream> >::value:
+				return get<ssl_stream<socks5_stream> >()->native_handle();
+			case socket_type_int_impl<ssl_stream<http_stream> >::value:
+				return get<ssl_stream<http_stream> >()->native_handle();
+			case socket_type_int_impl<ssl_stream<utp_stream> >::value:
+				return get<ssl_stream<utp_stream> >()->native_handle();
+			default: return 0;
+		}
+	}
+
+	bool socket_type::enable_kernel_tls(error_code& ec)
+	{
+		if (m_type != socket_type_int_impl<ssl_stream<stream_socket> >::value)
+		{
+			ec = asio::error::operation_not_supported;
+			return false;
+		}
+		return get<ssl_stream<stream_socket> >()->enable_kernel_send(ec);
+	}
+#endif
+
 #ifndef BOOST_NO_EXCEPTIONS
 	void socket_type::open(protocol_type const& p)
 	{ TORRENT_SOCKTYPE_FORWARD(open(p)) }
@@ -0,0 +1,150 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/ssl_ciphers.hpp"
+
+#if defined TORRENT_USE_OPENSSL
+
+#if (defined __GNUC__ || defined __clang__) && (defined __i386__ || defined __x86_64__)
+#include <cpuid.h>
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#include <intrin.h>
+#elif defined __linux__ && defined __aarch64__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+extern "C"
+{
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/objects.h>
+}
+
+namespace libtorrent
+{
+	namespace
+	{
+		char const* aes_first_ciphers =
+			"ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256"
+			":ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384"
+			":ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305"
+			":DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384"
+			":HIGH:!aNULL:!eNULL:!MD5:!RC4:!3DES";
+
+		char const* chacha_first_ciphers =
+			"ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305"
+			":ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256"
+			":ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384"
+			":DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384"
+			":HIGH:!aNULL:!eNULL:!MD5:!RC4:!3DES";
+
+		char const* aes_first_suites =
+			"TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256";
+
+		char const* chacha_first_suites =
+			"TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384";
+	}
+
+	bool cpu_has_aes()
+	{
+#if (defined __GNUC__ || defined __clang__) && (defined __i386__ || defined __x86_64__)
+		unsigned int eax, ebx, ecx, edx;
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) return false;
+		// CPUID.01H:ECX.AES[bit 25]
+		return (ecx & (1 << 25)) != 0;
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 25)) != 0;
+#elif defined __linux__ && defined __aarch64__ && defined HWCAP_AES
+		return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+		return false;
+#endif
+	}
+
+	char const* default_ssl_cipher_list()
+	{
+		static bool const aes = cpu_has_aes();
+		return aes ? aes_first_ciphers : chacha_first_ciphers;
+	}
+
+	char const* default_tls13_cipher_suites()
+	{
+		static bool const aes = cpu_has_aes();
+		return aes ? aes_first_suites : chacha_first_suites;
+	}
+
+	bool set_ssl_cipher_policy(SSL_CTX* ctx, std::string const& ciphers)
+	{
+		char const* list = ciphers.empty() ? default_ssl_cipher_list() : ciphers.c_str();
+		if (SSL_CTX_set_cipher_list(ctx, list) != 1)
+		{
+			ERR_clear_error();
+			return false;
+		}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined LIBRESSL_VERSION_NUMBER
+		// the TLS 1.3 suites are all AEAD, only their order is ours to pick
+		if (ciphers.empty())
+			SSL_CTX_set_ciphersuites(ctx, default_tls13_cipher_suites());
+#endif
+
+		// pick by our order rather than the peer's. A peer that put
+		// ChaCha20 first most likely lacks AES instructions, and gets it
+		SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+#ifdef SSL_OP_PRIORITIZE_CHACHA
+		SSL_CTX_set_options(ctx, SSL_OP_PRIORITIZE_CHACHA);
+#endif
+
+		// ephemeral elliptic curve keys. OpenSSL 1.1.0 and later enable
+		// them by default
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L && OPENSSL_VERSION_NUMBER < 0x10100000L
+		SSL_CTX_set_ecdh_auto(ctx, 1);
+#elif OPENSSL_VERSION_NUMBER < 0x10002000L && !defined OPENSSL_NO_ECDH
+		EC_KEY* ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+		if (ecdh)
+		{
+			SSL_CTX_set_tmp_ecdh(ctx, ecdh);
+			EC_KEY_free(ecdh);
+		}
+#endif
+#ifdef SSL_OP_SINGLE_ECDH_USE
+		SSL_CTX_set_options(ctx, SSL_OP_SINGLE_ECDH_USE);
+#endif
+		return true;
+	}
+}
+
+#endif // TORRENT_USE_OPENSSL
+
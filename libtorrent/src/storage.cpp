@@ -441,6 +441,9 @@ namespace libtorrent
 		, m_pool(fp)
 		, m_page_size(page_size())
 		, m_allocate_files(false)
+		, m_hint_slot(-1)
+		, m_hint_start(0)
+		, m_hint_end(0)
 	{
 		if (mapped) m_mapped_files.reset(new file_storage(*mapped));
 
@@ -1038,26 +1041,29 @@ ret:
 
 	void default_storage::hint_read(int slot, int offset, int size)
 	{
-		size_type start = slot * (size_type)m_files.piece_length() + offset;
-		TORRENT_ASSERT(start + size <= m_files.total_size());
+		// the blocks of a piece are usually requested one at a time,
+		// hint a whole read cache line with the first one and skip
+		// the others instead of issuing a system call for each
+		if (slot == m_hint_slot && offset >= m_hint_start
+			&& offset + size <= m_hint_end)
+			return;
 
-		size_type file_offset = start;
-		file_storage::iterator file_iter;
+		int slot_size = static_cast<int>(m_files.piece_size(slot));
+		if (m_settings)
+			size = (std::max)(size, settings().read_cache_line_size * 16 * 1024);
+		if (offset + size > slot_size) size = slot_size - offset;
+		m_hint_slot = slot;
+		m_hint_start = offset;
+		m_hint_end = offset + size;
 
-		// TODO: use binary search!
-		for (file_iter = files().begin();;)
-		{
-			if (file_offset < file_iter->size)
-				break;
+		size_type start = slot * (size_type)m_files.piece_length() + offset;
+		TORRENT_ASSERT(start + size <= m_files.total_size());
 
-			file_offset -= file_iter->size;
-			++file_iter;
-			TORRENT_ASSERT(file_iter != files().end());
-		}
+		file_storage::iterator file_iter = files().file_at_offset(start);
+		size_type file_offset = start - file_iter->offset;
 
 		boost::intrusive_ptr<file> file_handle;
 		int bytes_left = size;
-		int slot_size = static_cast<int>(m_files.piece_size(slot));
 
 		if (offset + bytes_left > slot_size)
 			bytes_left = slot_size - offset;
@@ -1147,19 +1153,9 @@ ret:
 		TORRENT_ASSERT(start + size <= m_files.total_size());
 
 		// find the file iterator and file offset
-		size_type file_offset = start;
-		file_storage::iterator file_iter;
-
-		// TODO: use binary search!
-		for (file_iter = files().begin();;)
-		{
-			if (file_offset < file_iter->size)
-				break;
-
-			file_offset -= file_iter->size;
-			++file_iter;
-			TORRENT_ASSERT(file_iter != files().end());
-		}
+		file_storage::iterator file_iter = files().file_at_offset(start);
+		size_type file_offset = start - file_iter->offset;
+		TORRENT_ASSERT(file_offset < file_iter->size);
 
 		int buf_pos = 0;
 		error_code ec;
@@ -1270,8 +1266,10 @@ ret:
 			}
 			else
 			{
+				int num_syscalls = 0;
 				bytes_transferred = (int)((*file_handle).*op.regular_op)(adjusted_offset
-					, tmp_bufs, num_tmp_bufs, ec);
+					, tmp_bufs, num_tmp_bufs, ec, &num_syscalls);
+				if (disk_pool()) disk_pool()->add_disk_syscalls(num_syscalls);
 			}
 			file_offset = 0;
 
@@ -1620,7 +1618,8 @@ ret:
 	void piece_manager::async_read_and_hash(
 		peer_request const& r
 		, boost::function<void(int, disk_io_job const&)> const& handler
-		, int cache_expiry)
+		, int cache_expiry
+		, int cache_priority)
 	{
 		disk_io_job j;
 		j.storage = this;
@@ -1630,6 +1629,7 @@ ret:
 		j.buffer_size = r.length;
 		j.buffer = 0;
 		j.cache_min_time = cache_expiry;
+		j.cache_priority = cache_priority;
 		TORRENT_ASSERT(r.length <= 16 * 1024);
 		m_io_thread.add_job(j, handler);
 #ifdef TORRENT_DEBUG
@@ -1642,7 +1642,8 @@ ret:
 
 	void piece_manager::async_cache(int piece
 		, boost::function<void(int, disk_io_job const&)> const& handler
-		, int cache_expiry)
+		, int cache_expiry
+		, int cache_priority)
 	{
 		disk_io_job j;
 		j.storage = this;
@@ -1652,6 +1653,7 @@ ret:
 		j.buffer_size = 0;
 		j.buffer = 0;
 		j.cache_min_time = cache_expiry;
+		j.cache_priority = cache_priority;
 		m_io_thread.add_job(j, handler);
 	}
 
@@ -1659,7 +1661,8 @@ ret:
 		peer_request const& r
 		, boost::function<void(int, disk_io_job const&)> const& handler
 		, int cache_line_size
-		, int cache_expiry)
+		, int cache_expiry
+		, int cache_priority)
 	{
 		disk_io_job j;
 		j.storage = this;
@@ -1670,6 +1673,7 @@ ret:
 		j.buffer = 0;
 		j.max_cache_line = cache_line_size;
 		j.cache_min_time = cache_expiry;
+		j.cache_priority = cache_priority;
 
 		// if a buffer is not specified, only one block can be read
 		// since that is the size of the pool allocator's buffers
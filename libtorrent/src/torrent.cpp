@@ -205,6 +205,43 @@ namespace
 
 		peer_id const& pid;
 	};
+
+#ifdef TORRENT_USE_OPENSSL
+	// what an outgoing SSL connection was made for, kept with its SSL
+	// object for ssl_new_session()
+	struct ssl_session_owner
+	{
+		ssl_session_owner(boost::weak_ptr<torrent> t, tcp::endpoint const& ep)
+			: tor(t), remote(ep) {}
+		boost::weak_ptr<torrent> tor;
+		tcp::endpoint remote;
+	};
+
+	void free_ssl_session_owner(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+	{
+		delete static_cast<ssl_session_owner*>(ptr);
+	}
+
+	int ssl_session_owner_index()
+	{
+		static int index = SSL_get_ex_new_index(0, 0, 0, 0, &free_ssl_session_owner);
+		return index;
+	}
+
+	// OpenSSL calls this for every session the peer hands out. With TLS 1.2
+	// that's during the handshake, the NewSessionTicket messages of TLS 1.3
+	// only arrive after it, so the session of a just connected socket can't
+	// be resumed yet
+	int ssl_new_session(SSL* ssl, SSL_SESSION* sess)
+	{
+		ssl_session_owner* owner = static_cast<ssl_session_owner*>(
+			SSL_get_ex_data(ssl, ssl_session_owner_index()));
+		if (owner == 0) return 0;
+		boost::shared_ptr<torrent> t = owner->tor.lock();
+		if (!t) return 0;
+		return t->save_ssl_session(owner->remote, sess) ? 1 : 0;
+	}
+#endif
 }
 
 namespace libtorrent
@@ -398,6 +435,7 @@ namespace libtorrent
 		, m_num_uploads(0)
 		, m_block_size_shift(root2(block_size))
 		, m_has_incoming(false)
+		, m_in_state_updates(false)
 		, m_files_checked(false)
 		, m_queued_for_checking(false)
 		, m_max_connections(~0)
@@ -431,6 +469,7 @@ namespace libtorrent
 		, m_merge_resume_trackers(p.merge_resume_trackers)
 		, m_in_encrypted_list(false)
 		, m_allow_rfc1918_conections (p.allow_rfc1918_connections)
+		, m_cache_priority(0)
 	{
 #if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 		m_resume_data_loaded = false;
@@ -662,8 +701,8 @@ namespace libtorrent
 			// insert this torrent in the uuid index
 			if (!m_uuid.empty() || !m_url.empty())
 			{
-				m_ses.m_uuids.insert(std::make_pair(m_uuid.empty()
-					? m_url : m_uuid, i->second));
+				m_ses.m_uuids.insert(m_uuid.empty()
+					? m_url : m_uuid, i->second);
 			}
 			set_error(error_code(errors::duplicate_torrent, get_libtorrent_category()), "");
 			abort();
@@ -671,7 +710,8 @@ namespace libtorrent
 		}
 
 		m_ses.m_torrents.insert(std::make_pair(m_torrent_file->info_hash(), me));
-		if (!m_uuid.empty()) m_ses.m_uuids.insert(std::make_pair(m_uuid, me));
+		m_ses.m_torrent_index.insert(m_torrent_file->info_hash(), this);
+		if (!m_uuid.empty()) m_ses.m_uuids.insert(m_uuid, me);
 
 		TORRENT_ASSERT(num_torrents == int(m_ses.m_torrents.size()));
 
@@ -749,8 +789,10 @@ namespace libtorrent
 		int num_torrents = m_ses.m_torrents.size();
 #endif
 		m_ses.m_torrents.erase(m_torrent_file->info_hash());
+		m_ses.m_torrent_index.erase(m_torrent_file->info_hash());
 		m_torrent_file = tf;
 		m_ses.m_torrents.insert(std::make_pair(m_torrent_file->info_hash(), shared_from_this()));
+		m_ses.m_torrent_index.insert(m_torrent_file->info_hash(), this);
 
 		TORRENT_ASSERT(num_torrents == m_ses.m_torrents.size());
 
@@ -790,6 +832,9 @@ namespace libtorrent
 #endif
 		TORRENT_ASSERT(!m_picker);
 
+		// report newly added torrents in the next status update
+		state_updated();
+
 		if (!m_seed_mode)
 		{
 			m_picker.reset(new piece_picker());
@@ -923,6 +968,12 @@ namespace libtorrent
 		TORRENT_ASSERT(m_abort);
 		if (!m_connections.empty())
 			disconnect_all(errors::torrent_aborted);
+
+#ifdef TORRENT_USE_OPENSSL
+		for (std::map<tcp::endpoint, SSL_SESSION*>::iterator i = m_ssl_sessions.begin()
+			, end(m_ssl_sessions.end()); i != end; ++i)
+			SSL_SESSION_free(i->second);
+#endif
 	}
 
 	void torrent::read_piece(int piece)
@@ -1006,6 +1057,7 @@ namespace libtorrent
 
 		m_upload_mode = b;
 
+		state_updated();
 		send_upload_only();
 
 		if (m_upload_mode)
@@ -1348,6 +1400,9 @@ namespace libtorrent
 		SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_COMPRESSION);
 #endif
 
+		m_ses.setup_ssl_context(ssl_ctx, false);
+		SSL_CTX_sess_set_new_cb(ssl_ctx, &ssl_new_session);
+
 		// create a new x.509 certificate store
 		X509_STORE* cert_store = X509_STORE_new();
 		if (!cert_store)
@@ -1434,6 +1489,55 @@ while (certBeginPos != std::string::npos)
 		alerts().post_alert(torrent_need_cert_alert(get_handle()));
 	}
 
+	void torrent::resume_ssl_session(tcp::endpoint const& ep, SSL* ssl)
+	{
+		if (ssl == 0) return;
+
+		ssl_session_owner* owner = new ssl_session_owner(shared_from_this(), ep);
+		if (!SSL_set_ex_data(ssl, ssl_session_owner_index(), owner))
+			delete owner;
+
+		std::map<tcp::endpoint, SSL_SESSION*>::iterator i = m_ssl_sessions.find(ep);
+		if (i == m_ssl_sessions.end()) return;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+		// the connection the session came from ended in an error
+		if (!SSL_SESSION_is_resumable(i->second))
+		{
+			SSL_SESSION_free(i->second);
+			m_ssl_sessions.erase(i);
+			return;
+		}
+#endif
+		SSL_set_session(ssl, i->second);
+	}
+
+	bool torrent::save_ssl_session(tcp::endpoint const& ep, SSL_SESSION* sess)
+	{
+		int limit = settings().ssl_session_cache_size;
+		std::map<tcp::endpoint, SSL_SESSION*>::iterator i = m_ssl_sessions.find(ep);
+		if (i != m_ssl_sessions.end())
+		{
+			SSL_SESSION_free(i->second);
+			m_ssl_sessions.erase(i);
+		}
+		if (limit <= 0) return false;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+		if (!SSL_SESSION_is_resumable(sess)) return false;
+#endif
+
+		// the map is not kept in any particular order, evicting the
+		// first entry is as good as any when the cache is full
+		while (int(m_ssl_sessions.size()) >= limit)
+		{
+			SSL_SESSION_free(m_ssl_sessions.begin()->second);
+			m_ssl_sessions.erase(m_ssl_sessions.begin());
+		}
+		m_ssl_sessions.insert(std::make_pair(ep, sess));
+		return true;
+	}
+
 #endif // TORRENT_USE_OPENSSL
 
 	// this may not be called from a constructor because of the call to
@@ -2353,6 +2457,7 @@ while (certBeginPos != std::string::npos)
  		if (incomplete >= 0) m_incomplete = incomplete;
  		if (downloaders >= 0) m_downloaders = downloaders;
  		if (uploaded >= 0) m_uploaded = uploaded;
+		state_updated();
  
  		if (m_ses.m_alerts.should_post<scrape_reply_alert>())
  		{
@@ -2416,6 +2521,7 @@ while (certBeginPos != std::string::npos)
 		if (incomplete >= 0) m_incomplete = incomplete;
 		if (complete >= 0 && incomplete >= 0)
 			m_last_scrape = 0;
+		state_updated();
 
 #if (defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING) && TORRENT_USE_IOSTREAM || defined TORRENT_MINIMAL_LOGGING
 		std::stringstream s;
@@ -3053,6 +3159,7 @@ while (certBeginPos != std::string::npos)
 		}
 
 		m_need_save_resume_data = true;
+		state_updated();
 
 		remove_time_critical_piece(index, true);
 
@@ -4118,6 +4225,8 @@ while (certBeginPos != std::string::npos)
 			if (alerts().should_post<torrent_error_alert>())
 				alerts().post_alert(torrent_error_alert(get_handle(), ec));
 		}
+		// DH parameters are only needed by peers that can't do ECDHE
+		if (dh_params.empty()) return;
 		m_ssl_ctx->use_tmp_dh_file(dh_params, ec);
 		if (ec)
 		{
@@ -4194,6 +4303,7 @@ while (certBeginPos != std::string::npos)
 		p->set_peer_info(0);
 		TORRENT_ASSERT(i != m_connections.end());
 		m_connections.erase(i);
+		state_updated();
 	}
 
 	void torrent::remove_web_seed(std::list<web_seed_entry>::iterator web)
@@ -4756,8 +4866,8 @@ while (certBeginPos != std::string::npos)
 			boost::shared_ptr<torrent> me(shared_from_this());
 
 			// insert this torrent in the uuid index
-			m_ses.m_uuids.insert(std::make_pair(m_uuid.empty()
-				? m_url : m_uuid, me));
+			m_ses.m_uuids.insert(m_uuid.empty()
+				? m_url : m_uuid, me);
 		}
 
 		m_added_time = rd.dict_find_int_value("added_time", m_added_time);
@@ -5382,6 +5492,9 @@ while (certBeginPos != std::string::npos)
                                        CASE(utp_stream)
                                        default: break;
                                };
+
+                               // offer the session of the last connection to this peer
+                               resume_ssl_session(a, s->native_ssl());
                        }
 #endif
 
@@ -5421,6 +5534,7 @@ while (certBeginPos != std::string::npos)
 		m_connections.insert(boost::get_pointer(c));
 		m_ses.m_connections.insert(c);
 		m_policy.set_connection(peerinfo, c.get());
+		state_updated();
 		c->start();
 
 		int timeout = settings().peer_connect_timeout;
@@ -5549,6 +5663,25 @@ while (certBeginPos != std::string::npos)
                                p->disconnect(errors::invalid_ssl_cert);
                                return false;
                        }
+
+                       if (SSL_session_reused(ssl_conn))
+                       {
+                               // the server side session cache is shared by all torrents.
+                               // A session resumed under the name of another torrent was
+                               // never verified against this torrent's certificate
+                               SSL_SESSION* sess = SSL_get_session(ssl_conn);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+                               char const* sess_name = sess ? SSL_SESSION_get0_hostname(sess) : 0;
+#else
+                               char const* sess_name = sess ? sess->tlsext_hostname : 0;
+#endif
+                               char const* name = SSL_get_servername(ssl_conn, TLSEXT_NAMETYPE_host_name);
+                               if (sess_name == 0 || name == 0 || strcmp(sess_name, name) != 0)
+                               {
+                                       p->disconnect(errors::invalid_ssl_cert);
+                                       return false;
+                               }
+                       }
                }
 #endif // TORRENT_USE_OPENSSL
 
@@ -5627,6 +5760,7 @@ while (certBeginPos != std::string::npos)
 		}
 		TORRENT_ASSERT(m_connections.find(p) == m_connections.end());
 		peer_iterator ci = m_connections.insert(p).first;
+		state_updated();
 #ifdef TORRENT_DEBUG
 		error_code ec;
 		TORRENT_ASSERT(p->remote() == p->get_socket()->remote_endpoint(ec) || ec);
@@ -6436,6 +6570,7 @@ while (certBeginPos != std::string::npos)
 			m_ses.m_auto_manage_time_scaler = 2;
 		m_error = error_code();
 		m_error_file.clear();
+		state_updated();
 
 		// if we haven't downloaded the metadata from m_url, try again
 		if (!m_url.empty() && !m_torrent_file->is_valid())
@@ -6456,6 +6591,7 @@ while (certBeginPos != std::string::npos)
 		bool checking_files = should_check_files();
 		m_error = ec;
 		m_error_file = error_file;
+		state_updated();
 
 		if (alerts().should_post<torrent_error_alert>())
 			alerts().post_alert(torrent_error_alert(get_handle(), ec));
@@ -6682,6 +6818,8 @@ while (certBeginPos != std::string::npos)
 		TORRENT_ASSERT(m_ses.is_network_thread());
 		if (!is_paused()) return;
 
+		state_updated();
+
 #ifdef TORRENT_USE_OPENSSL
 		if (m_torrent_file->is_valid() && m_torrent_file->encryption_key().size() == 32 && m_in_encrypted_list)
 		{
@@ -6840,6 +6978,8 @@ while (certBeginPos != std::string::npos)
 		TORRENT_ASSERT(m_ses.is_network_thread());
 		if (is_paused()) return;
 
+		state_updated();
+
 #ifdef TORRENT_USE_OPENSSL
 		if (m_torrent_file->is_valid() && m_torrent_file->encryption_key().size() == 32 && !m_in_encrypted_list)
 		{
@@ -7192,6 +7332,11 @@ while (certBeginPos != std::string::npos)
 		if (m_ses.m_alerts.should_post<stats_alert>())
 			m_ses.m_alerts.post_alert(stats_alert(get_handle(), tick_interval_ms, m_stat));
 
+		// transfer rates and totals are part of the status, if
+		// anything moved this second the status has changed
+		if (m_stat.low_pass_upload_rate() > 0 || m_stat.low_pass_download_rate() > 0)
+			state_updated();
+
 		accumulator += m_stat;
 		m_total_uploaded += m_stat.last_payload_uploaded();
 		m_total_downloaded += m_stat.last_payload_downloaded();
@@ -7427,7 +7572,7 @@ while (certBeginPos != std::string::npos)
 			for (std::vector<int>::iterator i = avail_vec.begin()
 				, end(avail_vec.end()); i != end; ++i)
 				filesystem().async_cache(*i, boost::bind(&torrent::on_disk_cache_complete
-					, shared_from_this(), _1, _2));
+					, shared_from_this(), _1, _2), 0, m_cache_priority);
 		}
 	}
 
@@ -7859,6 +8004,14 @@ while (certBeginPos != std::string::npos)
 		}
 	}
 	
+	void torrent::state_updated()
+	{
+		TORRENT_ASSERT(m_ses.is_network_thread());
+		if (m_in_state_updates) return;
+		m_ses.add_to_update_queue(shared_from_this());
+		m_in_state_updates = true;
+	}
+
 	void torrent::set_state(torrent_status::state_t s)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -7889,6 +8042,7 @@ while (certBeginPos != std::string::npos)
 		if (m_ses.m_alerts.should_post<state_changed_alert>())
 			m_ses.m_alerts.post_alert(state_changed_alert(get_handle(), s, (torrent_status::state_t)m_state));
 		m_state = s;
+		state_updated();
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		for (extension_list_t::iterator i = m_extensions.begin()
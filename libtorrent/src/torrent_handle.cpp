@@ -429,6 +429,19 @@ namespace libtorrent
 		TORRENT_ASYNC_CALL1(set_priority, p);
 	}
 
+	void torrent_handle::set_cache_priority(int p) const
+	{
+		INVARIANT_CHECK;
+		TORRENT_ASYNC_CALL1(set_cache_priority, p);
+	}
+
+	int torrent_handle::cache_priority() const
+	{
+		INVARIANT_CHECK;
+		TORRENT_SYNC_CALL_RET(int, 0, cache_priority);
+		return r;
+	}
+
 	int torrent_handle::queue_position() const
 	{
 		INVARIANT_CHECK;
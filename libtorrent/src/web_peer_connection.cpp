@@ -664,6 +664,7 @@ namespace libtorrent
 				{
 					m_piece.resize(piece_size + copy_size);
 					std::memcpy(&m_piece[0] + piece_size, recv_buffer.begin, copy_size);
+					m_ses.add_copied_payload(copy_size);
 					TORRENT_ASSERT(int(m_piece.size()) <= front_request.length);
 					recv_buffer.begin += copy_size;
 					m_received_body += copy_size;
@@ -742,6 +743,7 @@ namespace libtorrent
 					{
 						m_piece.resize(piece_size + copy_size);
 						std::memcpy(&m_piece[0] + piece_size, recv_buffer.begin, copy_size);
+						m_ses.add_copied_payload(copy_size);
 						recv_buffer.begin += copy_size;
 						m_received_body += copy_size;
 						m_body_start += copy_size;
@@ -0,0 +1,158 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/alert.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/io_service.hpp"
+#include "libtorrent/time.hpp"
+#include "test.hpp"
+
+#include <deque>
+#include <cstdio>
+
+using namespace libtorrent;
+
+// larger than any of the pooled size classes
+struct big_alert : alert
+{
+	virtual int type() const { return 0; }
+	virtual char const* what() const { return "big"; }
+	virtual std::string message() const { return "big"; }
+	virtual int category() const { return status_notification; }
+	virtual std::auto_ptr<alert> clone() const
+	{ return std::auto_ptr<alert>(new big_alert(*this)); }
+	char payload[1024];
+};
+
+void test_mask()
+{
+	io_service ios;
+	alert_manager mgr(ios, 100, alert::error_notification | alert::tracker_notification);
+
+	TEST_CHECK(mgr.should_post<tracker_error_alert>());
+	TEST_CHECK(mgr.should_post<tracker_reply_alert>());
+	TEST_CHECK(!mgr.should_post<peer_connect_alert>());
+	TEST_CHECK(!mgr.should_post<stats_alert>());
+
+	mgr.set_alert_mask(mgr.alert_mask() | alert::stats_notification);
+	TEST_CHECK(mgr.should_post<stats_alert>());
+}
+
+void test_pool()
+{
+	torrent_handle h;
+
+	// a freed alert's block is handed out again
+	alert* a = new torrent_paused_alert(h);
+	void* block = a;
+	delete a;
+	a = new torrent_resumed_alert(h);
+	TEST_CHECK((void*)a == block);
+	delete a;
+
+	// different size classes don't share blocks
+	std::deque<alert*> alerts;
+	for (int i = 0; i < 1000; ++i)
+	{
+		alerts.push_back(new torrent_paused_alert(h));
+		alerts.push_back(new peer_disconnected_alert(h, tcp::endpoint(), peer_id(), error_code()));
+		alerts.push_back(new big_alert);
+	}
+	for (std::deque<alert*>::iterator i = alerts.begin(); i != alerts.end(); ++i)
+	{
+		TEST_CHECK((*i)->timestamp() <= time_now());
+		delete *i;
+	}
+}
+
+void test_batch_pop()
+{
+	io_service ios;
+	alert_manager mgr(ios, 1000, alert::all_categories);
+	torrent_handle h;
+
+	for (int i = 0; i < 1500; ++i)
+		mgr.post_alert(torrent_paused_alert(h));
+
+	// discardable alerts beyond the queue limit are dropped
+	std::deque<alert*> batch;
+	mgr.get_all(&batch);
+	TEST_EQUAL(batch.size(), 1000);
+	TEST_CHECK(!mgr.pending());
+
+	for (std::deque<alert*>::iterator i = batch.begin(); i != batch.end(); ++i)
+		delete *i;
+	batch.clear();
+
+	// the emptied batch is swapped back in on the next pop
+	mgr.post_alert(torrent_resumed_alert(h));
+	mgr.get_all(&batch);
+	TEST_EQUAL(batch.size(), 1);
+	TEST_CHECK(alert_cast<torrent_resumed_alert>(batch.front()) != 0);
+	delete batch.front();
+}
+
+// posts and pops alerts the way a gtserver session does, in batches
+void bench_post_pop()
+{
+	io_service ios;
+	alert_manager mgr(ios, 10000, alert::all_categories);
+	torrent_handle h;
+	std::deque<alert*> batch;
+	const int rounds = 200;
+	const int batch_size = 5000;
+
+	ptime start = time_now_hires();
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int i = 0; i < batch_size; ++i)
+			mgr.post_alert(peer_disconnected_alert(h, tcp::endpoint(), peer_id(), error_code()));
+		mgr.get_all(&batch);
+		for (std::deque<alert*>::iterator i = batch.begin(); i != batch.end(); ++i)
+			delete *i;
+		batch.clear();
+	}
+	int us = total_microseconds(time_now_hires() - start);
+
+	fprintf(stderr, "post, pop and free %d alerts: %.1f ns per alert\n"
+		, rounds * batch_size, us * 1000. / (rounds * batch_size));
+}
+
+int test_main()
+{
+	test_mask();
+	test_pool();
+	test_batch_pop();
+	bench_post_pop();
+	return 0;
+}
+
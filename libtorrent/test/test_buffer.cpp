@@ -31,14 +31,19 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <cassert>
 #include <boost/timer.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <iostream>
 #include <vector>
 #include <utility>
 #include <set>
+#include <list>
+#include <cstdio>
 
 #include "libtorrent/buffer.hpp"
 #include "libtorrent/chained_buffer.hpp"
 #include "libtorrent/socket.hpp"
+#include "libtorrent/time.hpp"
 
 #include "test.hpp"
 
@@ -169,7 +174,7 @@ void test_buffer()
 
 std::set<char*> buffer_list;
 
-void free_buffer(char* m)
+void free_buffer(char* m, void*)
 {
 	std::set<char*>::iterator i = buffer_list.find(m);
 	TEST_CHECK(i != buffer_list.end());
@@ -203,7 +208,7 @@ bool compare_chained_buffer(chained_buffer& b, char const* mem, int size)
 {
 	if (size == 0) return true;
 	std::vector<char> flat(size);
-	std::list<libtorrent::asio::const_buffer> const& iovec2 = b.build_iovec(size);
+	chained_buffer::iovec_t iovec2 = b.build_iovec(size);
 	int copied = copy_buffers(iovec2, &flat[0]);
 	TEST_CHECK(copied == size);
 	return std::memcmp(&flat[0], mem, size) == 0;
@@ -223,7 +228,7 @@ void test_chained_buffer()
 
 		char* b1 = allocate_buffer(512);
 		std::memcpy(b1, data, 6);
-		b.append_buffer(b1, 512, 6, (void(*)(char*))&free_buffer);
+		b.append_buffer(b1, 512, 6, &free_buffer);
 		TEST_CHECK(buffer_list.size() == 1);
 
 		TEST_CHECK(b.capacity() == 512);
@@ -252,12 +257,12 @@ void test_chained_buffer()
 
 		char* b2 = allocate_buffer(512);
 		std::memcpy(b2, data, 6);
-		b.append_buffer(b2, 512, 6, (void(*)(char*))&free_buffer);
+		b.append_buffer(b2, 512, 6, &free_buffer);
 		TEST_CHECK(buffer_list.size() == 2);
 
 		char* b3 = allocate_buffer(512);
 		std::memcpy(b3, data, 6);
-		b.append_buffer(b3, 512, 6, (void(*)(char*))&free_buffer);
+		b.append_buffer(b3, 512, 6, &free_buffer);
 		TEST_CHECK(buffer_list.size() == 3);
 
 		TEST_CHECK(b.capacity() == 512 * 3);
@@ -292,7 +297,7 @@ void test_chained_buffer()
 		char* b4 = allocate_buffer(20);
 		std::memcpy(b4, data, 6);
 		std::memcpy(b4 + 6, data, 6);
-		b.append_buffer(b4, 20, 12, (void(*)(char*))&free_buffer);
+		b.append_buffer(b4, 20, 12, &free_buffer);
 		TEST_CHECK(b.space_in_last_buffer() == 8);
 
 		ret = b.append(data, 6);
@@ -306,7 +311,7 @@ void test_chained_buffer()
 		
 		char* b5 = allocate_buffer(20);
 		std::memcpy(b4, data, 6);
-		b.append_buffer(b5, 20, 6, (void(*)(char*))&free_buffer);
+		b.append_buffer(b5, 20, 6, &free_buffer);
 
 		b.pop_front(22);
 		TEST_CHECK(b.size() == 5);
@@ -314,10 +319,179 @@ void test_chained_buffer()
 	TEST_CHECK(buffer_list.empty());
 }
 
+// more buffers than fit inline, wrapping around the ring
+void test_chained_buffer_ring()
+{
+	{
+		chained_buffer b;
+		int next = 0;
+		int popped = 0;
+		for (int round = 0; round < 10; ++round)
+		{
+			for (int i = 0; i < 7 + round * 3; ++i)
+			{
+				char* buf = allocate_buffer(4);
+				for (int k = 0; k < 4; ++k) buf[k] = char(next++);
+				b.append_buffer(buf, 4, 4, &free_buffer);
+			}
+
+			// the iovec covers at most max_iovec buffers
+			int queued = b.size();
+			chained_buffer::iovec_t vec = b.build_iovec(queued);
+			TEST_CHECK(vec.size() == (std::min)((queued + 3) / 4, int(chained_buffer::max_iovec)));
+
+			std::vector<char> flat(queued);
+			int copied = copy_buffers(vec, &flat[0]);
+			for (int k = 0; k < copied; ++k)
+				TEST_CHECK(flat[k] == char(popped + k));
+
+			// leave part of a buffer behind
+			b.pop_front(copied - 2);
+			popped += copied - 2;
+			TEST_CHECK(b.size() == queued - copied + 2);
+			TEST_CHECK(int(buffer_list.size()) == (b.size() + 3) / 4);
+		}
+	}
+	TEST_CHECK(buffer_list.empty());
+}
+
+// the list based chain with boost::function destructors that
+// chained_buffer replaced, to compare against
+struct list_chained_buffer
+{
+	struct buffer_t
+	{
+		boost::function<void(char*)> free;
+		char* start;
+		int used_size;
+	};
+
+	list_chained_buffer(): m_bytes(0) {}
+
+	~list_chained_buffer()
+	{
+		for (std::list<buffer_t>::iterator i = m_vec.begin()
+			, end(m_vec.end()); i != end; ++i)
+			i->free(i->start);
+	}
+
+	void append_buffer(char* buffer, int used_size
+		, boost::function<void(char*)> const& destructor)
+	{
+		buffer_t b;
+		b.free = destructor;
+		b.start = buffer;
+		b.used_size = used_size;
+		m_vec.push_back(b);
+		m_bytes += used_size;
+	}
+
+	std::list<asio::const_buffer> const& build_iovec(int to_send)
+	{
+		m_tmp_vec.clear();
+		for (std::list<buffer_t>::iterator i = m_vec.begin()
+			, end(m_vec.end()); to_send > 0 && i != end; ++i)
+		{
+			int s = (std::min)(i->used_size, to_send);
+			m_tmp_vec.push_back(asio::const_buffer(i->start, s));
+			to_send -= s;
+		}
+		return m_tmp_vec;
+	}
+
+	void pop_front(int bytes_to_pop)
+	{
+		while (bytes_to_pop > 0 && !m_vec.empty())
+		{
+			buffer_t& b = m_vec.front();
+			if (b.used_size > bytes_to_pop)
+			{
+				b.start += bytes_to_pop;
+				b.used_size -= bytes_to_pop;
+				m_bytes -= bytes_to_pop;
+				break;
+			}
+			b.free(b.start);
+			m_bytes -= b.used_size;
+			bytes_to_pop -= b.used_size;
+			m_vec.pop_front();
+		}
+	}
+
+	std::list<buffer_t> m_vec;
+	std::list<asio::const_buffer> m_tmp_vec;
+	int m_bytes;
+};
+
+struct bench_pool
+{
+	void free(char*) { ++freed; }
+	int freed;
+};
+
+void bench_free(char*, void* pool) { ++static_cast<bench_pool*>(pool)->freed; }
+
+template <class Vec>
+int iovec_bytes(Vec const& vec)
+{
+	int ret = 0;
+	for (typename Vec::const_iterator i = vec.begin(); i != vec.end(); ++i)
+		ret += asio::buffer_size(*i);
+	return ret;
+}
+
+// the send pattern of a seeding peer: a message header and a
+// 16 kiB block per request, written out 4 blocks at a time,
+// with the socket taking a little less than what's queued
+void bench_chained_buffer()
+{
+	const int rounds = 1000000;
+	std::vector<char> block(16 * 1024);
+	char header[13];
+	bench_pool pool;
+
+	pool.freed = 0;
+	ptime start = time_now_hires();
+	{
+		list_chained_buffer b;
+		for (int r = 0; r < rounds; ++r)
+		{
+			b.append_buffer(header, 13, boost::bind(&bench_pool::free, &pool, _1));
+			b.append_buffer(&block[0], block.size(), boost::bind(&bench_pool::free, &pool, _1));
+			if ((r & 3) != 3) continue;
+			int sent = iovec_bytes(b.build_iovec(b.m_bytes)) - 100;
+			b.pop_front(sent);
+		}
+	}
+	int list_us = total_microseconds(time_now_hires() - start);
+	int list_freed = pool.freed;
+
+	pool.freed = 0;
+	start = time_now_hires();
+	{
+		chained_buffer b;
+		for (int r = 0; r < rounds; ++r)
+		{
+			b.append_buffer(header, 13, 13, &bench_free, &pool);
+			b.append_buffer(&block[0], block.size(), block.size(), &bench_free, &pool);
+			if ((r & 3) != 3) continue;
+			int sent = iovec_bytes(b.build_iovec(b.size())) - 100;
+			b.pop_front(sent);
+		}
+	}
+	int ring_us = total_microseconds(time_now_hires() - start);
+	TEST_EQUAL(pool.freed, list_freed);
+
+	fprintf(stderr, "queue, send and free %d blocks: list %.1f ns, ring %.1f ns per block\n"
+		, rounds, list_us * 1000. / rounds, ring_us * 1000. / rounds);
+}
+
 int test_main()
 {
 	test_buffer();
 	test_chained_buffer();
+	test_chained_buffer_ring();
+	bench_chained_buffer();
 	return 0;
 }
 
@@ -0,0 +1,212 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/disk_buffer_pool.hpp"
+#include "libtorrent/allocator.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/time.hpp"
+#include "test.hpp"
+
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <boost/bind.hpp>
+
+#ifdef TORRENT_LINUX
+#include <sys/mman.h>
+#endif
+
+using namespace libtorrent;
+
+const int test_block_size = 16 * 1024;
+const int num_rounds = 200000;
+
+// gives the test access to the pool's settings, the
+// way disk_io_thread sets them
+struct test_pool : disk_buffer_pool
+{
+	test_pool(): disk_buffer_pool(test_block_size) {}
+	session_settings& settings() { return m_settings; }
+};
+
+void test_thread_cache()
+{
+	test_pool pool;
+	std::vector<char*> bufs;
+	for (int i = 0; i < 100; ++i)
+	{
+		char* b = pool.allocate_buffer("test");
+		TEST_CHECK(b);
+		memset(b, i, test_block_size);
+		bufs.push_back(b);
+	}
+	TEST_EQUAL(pool.in_use(), 100);
+
+	for (int i = 0; i < 100; ++i) pool.free_buffer(bufs[i]);
+	TEST_EQUAL(pool.in_use(), 0);
+
+	size_type hits, locks, contended;
+	pool.pool_stats(hits, locks, contended);
+	// 100 allocations refill the cache 16 at a time and
+	// 100 frees flush it 16 at a time
+	TEST_CHECK(locks < 20);
+	TEST_EQUAL(hits + locks, 200);
+	TEST_EQUAL(contended, 0);
+
+	// the same buffers come back out of the cache
+	char* b = pool.allocate_buffer("test");
+	TEST_CHECK(std::find(bufs.begin(), bufs.end(), b) != bufs.end());
+	pool.free_buffer(b);
+
+	// buffers from free_multiple_buffers go straight to the pool
+	bufs.clear();
+	for (int i = 0; i < 40; ++i) bufs.push_back(pool.allocate_buffer("test"));
+	pool.free_multiple_buffers(&bufs[0], bufs.size());
+	TEST_EQUAL(pool.in_use(), 0);
+
+	pool.release_memory();
+	TEST_EQUAL(pool.in_use(), 0);
+
+	// with a locked cache, every buffer goes through the pool
+	pool.settings().lock_disk_cache = true;
+	pool.pool_stats(hits, locks, contended);
+	size_type locks_before = locks;
+	b = pool.allocate_buffer("test");
+	pool.free_buffer(b);
+	pool.pool_stats(hits, locks, contended);
+	TEST_EQUAL(locks - locks_before, 2);
+}
+
+// a pair of threads passing buffers from the one that allocates them
+// to the one that frees them, like the network and the disk thread
+struct handoff
+{
+	handoff(disk_buffer_pool& p): pool(p), done(false) {}
+	disk_buffer_pool& pool;
+	mutex m;
+	condition cond;
+	std::deque<char*> queue;
+	bool done;
+
+	void produce()
+	{
+		std::vector<char*> batch;
+		for (int i = 0; i < num_rounds; ++i)
+		{
+			char* b = pool.allocate_buffer("receive buffer");
+			b[0] = char(i);
+			batch.push_back(b);
+			if (batch.size() < 8) continue;
+			mutex::scoped_lock l(m);
+			queue.insert(queue.end(), batch.begin(), batch.end());
+			cond.signal_all(l);
+			batch.clear();
+		}
+		mutex::scoped_lock l(m);
+		queue.insert(queue.end(), batch.begin(), batch.end());
+		done = true;
+		cond.signal_all(l);
+	}
+
+	void consume()
+	{
+		mutex::scoped_lock l(m);
+		for (;;)
+		{
+			while (queue.empty() && !done) cond.wait(l);
+			if (queue.empty()) return;
+			std::deque<char*> bufs;
+			bufs.swap(queue);
+			l.unlock();
+			for (std::deque<char*>::iterator i = bufs.begin()
+				, end(bufs.end()); i != end; ++i)
+				pool.free_buffer(*i);
+			l.lock();
+		}
+	}
+};
+
+void bench_handoff()
+{
+	test_pool pool;
+	handoff h(pool);
+
+	ptime start = time_now_hires();
+	thread consumer(boost::bind(&handoff::consume, &h));
+	thread producer(boost::bind(&handoff::produce, &h));
+	producer.join();
+	consumer.join();
+	int us = total_microseconds(time_now_hires() - start);
+
+	TEST_EQUAL(pool.in_use(), 0);
+	size_type hits, locks, contended;
+	pool.pool_stats(hits, locks, contended);
+	TEST_EQUAL(hits + locks, num_rounds * 2);
+
+	fprintf(stderr, "%d buffers handed between threads: %.1f ns per buffer, "
+		"%d pool locks (%d contended), %d cache hits\n", num_rounds
+		, us * 1000. / num_rounds, int(locks), int(contended), int(hits));
+}
+
+void test_huge_pages()
+{
+	char* b = huge_page_allocator::malloc(huge_page_allocator::huge_page_size);
+	TEST_CHECK(b);
+#if defined TORRENT_LINUX && defined MADV_HUGEPAGE && !defined TORRENT_DEBUG_BUFFERS
+	TEST_CHECK((uintptr_t(b) & (huge_page_allocator::huge_page_size - 1)) == 0);
+#endif
+	memset(b, 0, huge_page_allocator::huge_page_size);
+	huge_page_allocator::free(b);
+
+	b = huge_page_allocator::malloc(test_block_size);
+	TEST_CHECK(b);
+	TEST_CHECK((uintptr_t(b) & (page_size() - 1)) == 0);
+	huge_page_allocator::free(b);
+
+	// a pool growing in 2 MiB chunks
+	test_pool pool;
+	pool.settings().disk_cache_huge_pages = true;
+	std::vector<char*> bufs;
+	for (int i = 0; i < 300; ++i) bufs.push_back(pool.allocate_buffer("test"));
+	TEST_EQUAL(pool.in_use(), 300);
+	for (int i = 0; i < 300; ++i) pool.free_buffer(bufs[i]);
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+int test_main()
+{
+	test_thread_cache();
+	test_huge_pages();
+	bench_handoff();
+	return 0;
+}
+
@@ -0,0 +1,166 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/hash_index.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/escape_string.hpp" // to_hex, from_hex
+#include "libtorrent/time.hpp"
+#include "test.hpp"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+
+using namespace libtorrent;
+
+// the number of torrents in the routing benchmark, in the range
+// of what a busy gtserver session serves
+const int num_torrents = 10000;
+const int num_lookups = 1000000;
+
+sha1_hash make_hash(int i)
+{
+	std::string s = boost::lexical_cast<std::string>(i);
+	return hasher(s.c_str(), s.size()).final();
+}
+
+// compares the index against a std::map through a
+// sequence of inserts and erases
+void test_consistency()
+{
+	hash_index<sha1_hash, int, info_hash_hash> index;
+	std::map<sha1_hash, int> reference;
+
+	TEST_CHECK(index.find(make_hash(0)) == 0);
+	TEST_CHECK(!index.erase(make_hash(0)));
+
+	for (int i = 0; i < 5000; ++i)
+	{
+		TEST_CHECK(index.insert(make_hash(i), i));
+		reference[make_hash(i)] = i;
+	}
+	TEST_CHECK(!index.insert(make_hash(17), -1));
+	TEST_EQUAL(*index.find(make_hash(17)), 17);
+
+	// erase every third entry, which exercises moving entries
+	// back into the holes, including across the end of the array
+	for (int i = 0; i < 5000; i += 3)
+	{
+		TEST_CHECK(index.erase(make_hash(i)));
+		reference.erase(make_hash(i));
+	}
+	TEST_EQUAL(index.size(), int(reference.size()));
+
+	for (int i = 0; i < 6000; ++i)
+	{
+		int* v = index.find(make_hash(i));
+		std::map<sha1_hash, int>::iterator j = reference.find(make_hash(i));
+		TEST_CHECK((v == 0) == (j == reference.end()));
+		if (v && j != reference.end()) TEST_EQUAL(*v, j->second);
+	}
+
+	index.clear();
+	TEST_CHECK(index.empty());
+	TEST_CHECK(index.find(make_hash(1)) == 0);
+
+	hash_index<std::string, boost::shared_ptr<int>, string_hash> uuids;
+	boost::shared_ptr<int> p(new int(42));
+	TEST_CHECK(uuids.insert("4f8ad5e8-9d1b-4a3c-8bd3-0d9c1e0f5b11", p));
+	TEST_CHECK(uuids.find("4f8ad5e8-9d1b-4a3c-8bd3-0d9c1e0f5b11") != 0);
+	TEST_CHECK(uuids.find("4f8ad5e8-9d1b-4a3c-8bd3-0d9c1e0f5b12") == 0);
+	TEST_EQUAL(p.use_count(), 2);
+	TEST_CHECK(uuids.erase("4f8ad5e8-9d1b-4a3c-8bd3-0d9c1e0f5b11"));
+	TEST_EQUAL(p.use_count(), 1);
+}
+
+// routes incoming handshakes the way servername_callback does, from the
+// hex encoded info-hash in the SNI to the torrent, with the torrents
+// in a std::map and in the index
+void bench_routing()
+{
+	std::map<sha1_hash, boost::shared_ptr<int> > torrents;
+	hash_index<sha1_hash, int*, info_hash_hash> index;
+	std::vector<std::string> server_names;
+
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		sha1_hash ih = make_hash(i);
+		boost::shared_ptr<int> t(new int(i));
+		torrents.insert(std::make_pair(ih, t));
+		index.insert(ih, t.get());
+		server_names.push_back(to_hex(ih.to_string()));
+	}
+
+	// visit the torrents in a scattered order
+	std::vector<int> order;
+	for (int i = 0; i < num_lookups; ++i)
+		order.push_back(int((i * 7919LL) % num_torrents));
+
+	int found = 0;
+	ptime start = time_now_hires();
+	for (int i = 0; i < num_lookups; ++i)
+	{
+		sha1_hash ih;
+		from_hex(server_names[order[i]].c_str(), 40, (char*)&ih[0]);
+		std::map<sha1_hash, boost::shared_ptr<int> >::iterator j = torrents.find(ih);
+		if (j != torrents.end() && *j->second == order[i]) ++found;
+	}
+	int map_us = total_microseconds(time_now_hires() - start);
+	TEST_EQUAL(found, num_lookups);
+
+	found = 0;
+	start = time_now_hires();
+	for (int i = 0; i < num_lookups; ++i)
+	{
+		sha1_hash ih;
+		from_hex(server_names[order[i]].c_str(), 40, (char*)&ih[0]);
+		int** t = index.find(ih);
+		if (t && **t == order[i]) ++found;
+	}
+	int index_us = total_microseconds(time_now_hires() - start);
+	TEST_EQUAL(found, num_lookups);
+
+	fprintf(stderr, "routing %d handshakes to %d torrents: std::map %.1f ns, "
+		"hash_index %.1f ns per handshake\n", num_lookups, num_torrents
+		, map_us * 1000. / num_lookups, index_us * 1000. / num_lookups);
+}
+
+int test_main()
+{
+	test_consistency();
+	bench_routing();
+	return 0;
+}
+
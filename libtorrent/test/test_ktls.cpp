@@ -0,0 +1,330 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/ktls.hpp"
+#include "test.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined TORRENT_USE_OPENSSL && TORRENT_USE_KTLS && OPENSSL_VERSION_NUMBER >= 0x10100000L
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+extern "C"
+{
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+}
+
+using namespace libtorrent;
+
+EVP_PKEY* generate_key()
+{
+	EVP_PKEY* key = EVP_PKEY_new();
+	RSA* rsa = RSA_new();
+	BIGNUM* e = BN_new();
+	BN_set_word(e, RSA_F4);
+	RSA_generate_key_ex(rsa, 2048, e, 0);
+	BN_free(e);
+	EVP_PKEY_assign_RSA(key, rsa);
+	return key;
+}
+
+X509* self_signed_cert(EVP_PKEY* key)
+{
+	X509* cert = X509_new();
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_get_notBefore(cert), 0);
+	X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME* name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC
+		, (unsigned char const*)"test_ktls", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+	return cert;
+}
+
+// runs the handshake of a client and a server SSL object until both
+// are done. Returns false if it fails
+bool handshake(SSL* client, SSL* server)
+{
+	SSL_set_connect_state(client);
+	SSL_set_accept_state(server);
+	for (int i = 0; i < 100; ++i)
+	{
+		int rc = SSL_do_handshake(client);
+		int rs = SSL_do_handshake(server);
+		if (rc == 1 && rs == 1) return true;
+
+		int ec = rc == 1 ? SSL_ERROR_NONE : SSL_get_error(client, rc);
+		int es = rs == 1 ? SSL_ERROR_NONE : SSL_get_error(server, rs);
+		if (ec != SSL_ERROR_NONE && ec != SSL_ERROR_WANT_READ && ec != SSL_ERROR_WANT_WRITE)
+			return false;
+		if (es != SSL_ERROR_NONE && es != SSL_ERROR_WANT_READ && es != SSL_ERROR_WANT_WRITE)
+			return false;
+	}
+	return false;
+}
+
+// decrypts the TLS 1.2 AES-GCM record rec with the send state st, which
+// is what the kernel would have sealed it with. Returns the plaintext,
+// empty if the record doesn't authenticate
+std::string open_record(ktls_send_state const& st, unsigned char const* rec, int len)
+{
+	// header, explicit nonce, ciphertext, tag
+	if (len < 5 + 8 + 16 || rec[0] != 23 || rec[1] != 3 || rec[2] != 3) return std::string();
+	int plain_len = len - 5 - 8 - 16;
+	if ((rec[3] << 8 | rec[4]) != len - 5) return std::string();
+
+	unsigned char nonce[12];
+	std::memcpy(nonce, st.salt, 4);
+	std::memcpy(nonce + 4, rec + 5, 8);
+
+	// sequence number, type, version and plaintext length
+	unsigned char aad[13];
+	std::memcpy(aad, st.rec_seq, 8);
+	std::memcpy(aad + 8, rec, 3);
+	aad[11] = plain_len >> 8;
+	aad[12] = plain_len & 0xff;
+
+	std::string plain(plain_len, '\0');
+	EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+	int out_len = 0;
+	int final_len = 0;
+	bool ok = EVP_DecryptInit_ex(ctx, st.key_len == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm()
+			, 0, 0, 0) == 1
+		&& EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, 12, 0) == 1
+		&& EVP_DecryptInit_ex(ctx, 0, 0, st.key, nonce) == 1
+		&& EVP_DecryptUpdate(ctx, 0, &out_len, aad, sizeof(aad)) == 1
+		&& EVP_DecryptUpdate(ctx, (unsigned char*)&plain[0], &out_len
+			, rec + 5 + 8, plain_len) == 1
+		&& EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16
+			, (void*)(rec + len - 16)) == 1
+		&& EVP_DecryptFinal_ex(ctx, (unsigned char*)&plain[0] + out_len, &final_len) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+	return ok ? plain : std::string();
+}
+
+SSL_CTX* server_context(EVP_PKEY* key, X509* cert)
+{
+	SSL_CTX* ctx = SSL_CTX_new(SSLv23_server_method());
+	SSL_CTX_use_certificate(ctx, cert);
+	SSL_CTX_use_PrivateKey(ctx, key);
+	return ctx;
+}
+
+// the first record each side sends after the handshake has to open with
+// the key, implicit nonce and sequence number derive_ktls_send_state()
+// hands the kernel
+void test_derivation(EVP_PKEY* key, X509* cert, char const* cipher, int key_len)
+{
+	SSL_CTX* server_ctx = server_context(key, cert);
+	SSL_CTX* client_ctx = SSL_CTX_new(SSLv23_client_method());
+	SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+	TEST_CHECK(SSL_CTX_set_cipher_list(client_ctx, cipher) == 1);
+
+	SSL* client = SSL_new(client_ctx);
+	SSL* server = SSL_new(server_ctx);
+	BIO* client_bio = 0;
+	BIO* server_bio = 0;
+	BIO_new_bio_pair(&client_bio, 64 * 1024, &server_bio, 64 * 1024);
+	SSL_set_bio(client, client_bio, client_bio);
+	SSL_set_bio(server, server_bio, server_bio);
+	TEST_CHECK(handshake(client, server));
+	TEST_EQUAL(std::string(SSL_get_cipher_name(client)), cipher);
+
+	SSL* sides[2] = { client, server };
+	BIO* peer_bio[2] = { server_bio, client_bio };
+	for (int i = 0; i < 2; ++i)
+	{
+		ktls_send_state st;
+		error_code ec;
+		TEST_CHECK(derive_ktls_send_state(sides[i], st, ec));
+		TEST_EQUAL(st.key_len, key_len);
+
+		std::string payload = i == 0 ? "sent by the client" : "sent by the server";
+		TEST_EQUAL(SSL_write(sides[i], payload.c_str(), int(payload.size())), int(payload.size()));
+
+		// the record as it would have gone out on the socket
+		unsigned char rec[1024];
+		int len = BIO_read(peer_bio[i], rec, sizeof(rec));
+		TEST_EQUAL(open_record(st, rec, len), payload);
+	}
+
+	SSL_free(client);
+	SSL_free(server);
+	ERR_clear_error();
+	SSL_CTX_free(client_ctx);
+	SSL_CTX_free(server_ctx);
+}
+
+// TLS 1.3, and TLS 1.2 suites other than AES-GCM, are left to OpenSSL
+void test_unsupported(EVP_PKEY* key, X509* cert, char const* cipher)
+{
+	SSL_CTX* server_ctx = server_context(key, cert);
+	SSL_CTX* client_ctx = SSL_CTX_new(SSLv23_client_method());
+	if (*cipher)
+	{
+		SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+		TEST_CHECK(SSL_CTX_set_cipher_list(client_ctx, cipher) == 1);
+	}
+
+	SSL* client = SSL_new(client_ctx);
+	SSL* server = SSL_new(server_ctx);
+	BIO* client_bio = 0;
+	BIO* server_bio = 0;
+	BIO_new_bio_pair(&client_bio, 64 * 1024, &server_bio, 64 * 1024);
+	SSL_set_bio(client, client_bio, client_bio);
+	SSL_set_bio(server, server_bio, server_bio);
+	TEST_CHECK(handshake(client, server));
+
+	ktls_send_state st;
+	error_code ec;
+	TEST_CHECK(!derive_ktls_send_state(client, st, ec));
+	TEST_CHECK(ec == asio::error::operation_not_supported);
+
+	SSL_free(client);
+	SSL_free(server);
+	ERR_clear_error();
+	SSL_CTX_free(client_ctx);
+	SSL_CTX_free(server_ctx);
+}
+
+// once the kernel encrypts what the client sends, OpenSSL must not write
+// anything to the socket anymore, not even the close_notify of a shutdown
+void test_no_writes_after_switch(EVP_PKEY* key, X509* cert)
+{
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addr_len = sizeof(addr);
+	TEST_CHECK(bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0);
+	TEST_CHECK(listen(listener, 1) == 0);
+	getsockname(listener, (sockaddr*)&addr, &addr_len);
+
+	int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+	TEST_CHECK(connect(client_fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+	int server_fd = accept(listener, 0, 0);
+	close(listener);
+	TEST_CHECK(server_fd >= 0);
+	fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+	fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+
+	SSL_CTX* server_ctx = server_context(key, cert);
+	SSL_CTX* client_ctx = SSL_CTX_new(SSLv23_client_method());
+	SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+	SSL_CTX_set_cipher_list(client_ctx, "ECDHE-RSA-AES128-GCM-SHA256");
+	SSL* client = SSL_new(client_ctx);
+	SSL* server = SSL_new(server_ctx);
+	SSL_set_fd(client, client_fd);
+	SSL_set_fd(server, server_fd);
+	TEST_CHECK(handshake(client, server));
+
+	error_code ec;
+	if (!enable_ktls_send(client, client_fd, ec))
+	{
+		std::printf("kernel TLS not available: %s\n", ec.message().c_str());
+	}
+	else
+	{
+		// plaintext written to the socket arrives encrypted
+		char const msg[] = "sent by the kernel";
+		TEST_EQUAL(send(client_fd, msg, sizeof(msg), 0), int(sizeof(msg)));
+		char buf[100];
+		int ret = -1;
+		for (int i = 0; i < 100 && ret <= 0; ++i)
+		{
+			ret = SSL_read(server, buf, sizeof(buf));
+			if (ret <= 0) usleep(10000);
+		}
+		TEST_EQUAL(ret, int(sizeof(msg)));
+		TEST_CHECK(ret == int(sizeof(msg)) && std::memcmp(buf, msg, sizeof(msg)) == 0);
+
+		// and the shutdown sends nothing
+		SSL_shutdown(client);
+		usleep(50000);
+		TEST_EQUAL(recv(server_fd, buf, sizeof(buf), 0), -1);
+		TEST_EQUAL(errno, EAGAIN);
+	}
+
+	SSL_free(client);
+	SSL_free(server);
+	close(client_fd);
+	close(server_fd);
+	ERR_clear_error();
+	SSL_CTX_free(client_ctx);
+	SSL_CTX_free(server_ctx);
+}
+
+int test_main()
+{
+	SSL_library_init();
+	SSL_load_error_strings();
+	OpenSSL_add_all_algorithms();
+
+	EVP_PKEY* key = generate_key();
+	X509* cert = self_signed_cert(key);
+
+	test_derivation(key, cert, "ECDHE-RSA-AES128-GCM-SHA256", 16);
+	test_derivation(key, cert, "ECDHE-RSA-AES256-GCM-SHA384", 32);
+	test_unsupported(key, cert, "");
+	test_unsupported(key, cert, "ECDHE-RSA-CHACHA20-POLY1305");
+	test_no_writes_after_switch(key, cert);
+
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return 0;
+}
+
+#else
+
+int test_main()
+{
+	return 0;
+}
+
+#endif
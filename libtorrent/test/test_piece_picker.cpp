@@ -33,6 +33,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/piece_picker.hpp"
 #include "libtorrent/policy.hpp"
 #include "libtorrent/bitfield.hpp"
+#include "libtorrent/time.hpp"
 #include <boost/shared_ptr.hpp>
 #include <boost/bind.hpp>
 #include <algorithm>
@@ -219,6 +220,85 @@ int test_pick(boost::shared_ptr<piece_picker> const& p, int options = piece_pick
 	return picked[0].piece_index;
 }
 
+// a peer's bitfield where each piece is set with the probability
+// percent / 100, in runs the way peers tend to download them
+bitfield random_bitfield(int num_pieces, int percent)
+{
+	bitfield ret(num_pieces, false);
+	for (int i = 0; i < num_pieces;)
+	{
+		bool have = std::rand() % 100 < percent;
+		int run = 1 + std::rand() % 200;
+		for (; run > 0 && i < num_pieces; --run, ++i)
+			if (have) ret.set_bit(i);
+	}
+	return ret;
+}
+
+// peers with large and small bitfields joining and leaving a
+// picker for a large torrent, with a pick after every change
+void test_peer_churn()
+{
+	const int num_pieces = 100000;
+	const int num_peers = 300;
+	const int num_events = 2000;
+
+	boost::shared_ptr<piece_picker> p(new piece_picker);
+	p->init(blocks_per_piece, blocks_per_piece, num_pieces);
+
+	std::vector<int> avail(num_pieces, 0);
+	std::vector<bitfield> peers;
+	for (int i = 0; i < num_peers; ++i)
+	{
+		// every third peer has just joined and has a few pieces
+		peers.push_back(i % 3 == 0 ? random_bitfield(num_pieces, 0) : random_bitfield(num_pieces, 20 + i % 70));
+		if (i % 3 == 0) for (int k = 0; k < 20; ++k) peers.back().set_bit(std::rand() % num_pieces);
+		p->inc_refcount(peers.back());
+		for (int k = 0; k < num_pieces; ++k) avail[k] += peers.back()[k];
+	}
+
+	bitfield want(num_pieces, true);
+	const std::vector<int> empty_vector;
+	std::vector<piece_block> picked;
+
+	time_duration refcount_time = seconds(0);
+	time_duration pick_time = seconds(0);
+	for (int i = 0; i < num_events; ++i)
+	{
+		int peer = std::rand() % num_peers;
+		bitfield next = i % 3 == 0 ? random_bitfield(num_pieces, 0) : random_bitfield(num_pieces, 10 + i % 80);
+		if (i % 3 == 0) for (int k = 0; k < 20; ++k) next.set_bit(std::rand() % num_pieces);
+
+		ptime start = time_now_hires();
+		p->dec_refcount(peers[peer]);
+		p->inc_refcount(next);
+		ptime picking = time_now_hires();
+		picked.clear();
+		p->pick_pieces(want, picked, 16, 0, 0, piece_picker::fast
+			, piece_picker::rarest_first, empty_vector, 20);
+		ptime done = time_now_hires();
+
+		refcount_time += picking - start;
+		pick_time += done - picking;
+		peers[peer] = next;
+		TEST_CHECK(!picked.empty());
+	}
+
+	std::fill(avail.begin(), avail.end(), 0);
+	for (int i = 0; i < num_peers; ++i)
+		for (int k = 0; k < num_pieces; ++k) avail[k] += peers[i][k];
+	std::vector<int> availability;
+	p->get_availability(availability);
+	TEST_CHECK(availability == avail);
+#ifdef TORRENT_DEBUG
+	p->check_invariant();
+#endif
+
+	std::cerr << "peer churn on " << num_pieces << " pieces, per peer replaced: "
+		<< total_microseconds(refcount_time) / num_events << " us updating availability, "
+		<< total_microseconds(pick_time) / num_events << " us in the next pick" << std::endl;
+}
+
 int test_main()
 {
 
@@ -931,6 +1011,12 @@ int test_main()
 	for (int i = 1; i < int(picked.size()); ++i)
 		TEST_CHECK(picked[i] == piece_block(5, i));
 	
+// ========================================================
+
+	// test peer churn
+	print_title("test peer churn");
+	test_peer_churn();
+
 // MISSING TESTS:
 // 1. abort_download
 // 2. write_failed
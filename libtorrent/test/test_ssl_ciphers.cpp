@@ -0,0 +1,247 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/size_type.hpp"
+#include "test.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef TORRENT_USE_OPENSSL
+
+#include "libtorrent/ssl_ciphers.hpp"
+
+extern "C"
+{
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+}
+
+using namespace libtorrent;
+
+// bytes pushed through each connection, in SSL records of
+// the size peer connections send
+const size_type bytes_to_transfer = 64 * 1024 * 1024;
+const int record_size = 16 * 1024;
+
+EVP_PKEY* generate_key()
+{
+	EVP_PKEY* key = EVP_PKEY_new();
+	RSA* rsa = RSA_new();
+	BIGNUM* e = BN_new();
+	BN_set_word(e, RSA_F4);
+	RSA_generate_key_ex(rsa, 2048, e, 0);
+	BN_free(e);
+	EVP_PKEY_assign_RSA(key, rsa);
+	return key;
+}
+
+X509* self_signed_cert(EVP_PKEY* key)
+{
+	X509* cert = X509_new();
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_get_notBefore(cert), 0);
+	X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME* name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC
+		, (unsigned char const*)"test_ssl_ciphers", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+	return cert;
+}
+
+// connects a client and a server SSL object back to back through a
+// BIO pair and runs the handshake. Returns false if it fails
+bool handshake(SSL_CTX* client_ctx, SSL_CTX* server_ctx, SSL*& client, SSL*& server)
+{
+	client = SSL_new(client_ctx);
+	server = SSL_new(server_ctx);
+
+	BIO* client_bio = 0;
+	BIO* server_bio = 0;
+	BIO_new_bio_pair(&client_bio, 4 * record_size, &server_bio, 4 * record_size);
+	SSL_set_bio(client, client_bio, client_bio);
+	SSL_set_bio(server, server_bio, server_bio);
+	SSL_set_connect_state(client);
+	SSL_set_accept_state(server);
+
+	for (int i = 0; i < 100; ++i)
+	{
+		int rc = SSL_do_handshake(client);
+		int rs = SSL_do_handshake(server);
+		if (rc == 1 && rs == 1) return true;
+
+		int ec = rc == 1 ? SSL_ERROR_NONE : SSL_get_error(client, rc);
+		int es = rs == 1 ? SSL_ERROR_NONE : SSL_get_error(server, rs);
+		if (ec != SSL_ERROR_NONE && ec != SSL_ERROR_WANT_READ && ec != SSL_ERROR_WANT_WRITE)
+			return false;
+		if (es != SSL_ERROR_NONE && es != SSL_ERROR_WANT_READ && es != SSL_ERROR_WANT_WRITE)
+			return false;
+	}
+	return false;
+}
+
+// returns the throughput in MB/s of one connection, -1 on failure
+double transfer(SSL* client, SSL* server)
+{
+	char send_buf[record_size];
+	char recv_buf[record_size];
+	std::memset(send_buf, 0x5a, sizeof(send_buf));
+
+	ptime start = time_now_hires();
+	size_type transferred = 0;
+	while (transferred < bytes_to_transfer)
+	{
+		int sent = SSL_write(client, send_buf, sizeof(send_buf));
+		if (sent <= 0) return -1.;
+
+		int received = 0;
+		while (received < sent)
+		{
+			int ret = SSL_read(server, recv_buf, sizeof(recv_buf));
+			if (ret <= 0) return -1.;
+			received += ret;
+		}
+		transferred += sent;
+	}
+	int ms = total_milliseconds(time_now_hires() - start);
+	if (ms == 0) ms = 1;
+	return double(transferred) / 1000. / ms;
+}
+
+SSL_CTX* server_context(EVP_PKEY* key, X509* cert)
+{
+	SSL_CTX* ctx = SSL_CTX_new(SSLv23_server_method());
+	SSL_CTX_use_certificate(ctx, cert);
+	SSL_CTX_use_PrivateKey(ctx, key);
+	set_ssl_cipher_policy(ctx, std::string());
+	return ctx;
+}
+
+// runs one connection where the client only offers cipher, or the
+// default policy if it's empty. Returns the negotiated cipher name
+std::string run_connection(EVP_PKEY* key, X509* cert, char const* cipher)
+{
+	SSL_CTX* server_ctx = server_context(key, cert);
+	SSL_CTX* client_ctx = SSL_CTX_new(SSLv23_client_method());
+
+	std::string negotiated;
+	if (!set_ssl_cipher_policy(client_ctx, cipher))
+	{
+		std::printf("%-32s not supported by this OpenSSL\n", cipher);
+	}
+	else
+	{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		// a single TLS 1.2 cipher is only honored below TLS 1.3
+		if (*cipher) SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+#endif
+		SSL* client = 0;
+		SSL* server = 0;
+		if (!handshake(client_ctx, server_ctx, client, server))
+		{
+			std::printf("%-32s handshake failed\n", *cipher ? cipher : "default policy");
+		}
+		else
+		{
+			negotiated = SSL_get_cipher_name(client);
+			double rate = transfer(client, server);
+			std::printf("%-32s %-32s %-8s %8.1f MB/s\n", *cipher ? cipher : "default policy"
+				, negotiated.c_str(), SSL_get_version(client), rate);
+			TEST_CHECK(rate > 0.);
+		}
+		if (client) SSL_free(client);
+		if (server) SSL_free(server);
+	}
+	ERR_clear_error();
+	SSL_CTX_free(client_ctx);
+	SSL_CTX_free(server_ctx);
+	return negotiated;
+}
+
+int test_main()
+{
+	SSL_library_init();
+	SSL_load_error_strings();
+	OpenSSL_add_all_algorithms();
+
+	std::printf("AES instructions: %s\n", cpu_has_aes() ? "yes" : "no");
+	std::printf("default cipher list: %s\n", default_ssl_cipher_list());
+
+	SSL_CTX* ctx = SSL_CTX_new(SSLv23_method());
+	TEST_CHECK(!set_ssl_cipher_policy(ctx, "NO-SUCH-CIPHER"));
+	TEST_CHECK(set_ssl_cipher_policy(ctx, std::string()));
+	SSL_CTX_free(ctx);
+
+	EVP_PKEY* key = generate_key();
+	X509* cert = self_signed_cert(key);
+
+	char const* ciphers[] =
+	{
+		"ECDHE-RSA-AES128-GCM-SHA256",
+		"ECDHE-RSA-AES256-GCM-SHA384",
+		"ECDHE-RSA-CHACHA20-POLY1305",
+		"ECDHE-RSA-AES128-SHA",
+		"ECDHE-RSA-AES256-SHA",
+		"AES128-SHA",
+	};
+
+	for (int i = 0; i < int(sizeof(ciphers) / sizeof(ciphers[0])); ++i)
+		run_connection(key, cert, ciphers[i]);
+
+	// peers that both use the default policy have to end up on an AEAD suite
+	std::string negotiated = run_connection(key, cert, "");
+	TEST_CHECK(negotiated.find("GCM") != std::string::npos
+		|| negotiated.find("CHACHA20") != std::string::npos);
+
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return 0;
+}
+
+#else
+
+int test_main()
+{
+	return 0;
+}
+
+#endif // TORRENT_USE_OPENSSL
+
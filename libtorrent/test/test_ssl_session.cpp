@@ -0,0 +1,285 @@
+/*
+
+Copyright (c) 2014, Annai Systems, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "test.hpp"
+
+#ifdef TORRENT_USE_OPENSSL
+
+#include "setup_transfer.hpp"
+#include "libtorrent/session.hpp"
+#include "libtorrent/session_status.hpp"
+#include "libtorrent/create_torrent.hpp"
+#include "libtorrent/torrent_info.hpp"
+#include "libtorrent/bencode.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/ip_filter.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+}
+
+using namespace libtorrent;
+
+// writes a self signed certificate and its key, which both peers present
+// and the torrent has as its root certificate. Returns the certificate
+std::string write_certificate(std::string const& cert_file, std::string const& key_file)
+{
+	EVP_PKEY* key = EVP_PKEY_new();
+	RSA* rsa = RSA_new();
+	BIGNUM* e = BN_new();
+	BN_set_word(e, RSA_F4);
+	RSA_generate_key_ex(rsa, 2048, e, 0);
+	BN_free(e);
+	EVP_PKEY_assign_RSA(key, rsa);
+
+	X509* cert = X509_new();
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_get_notBefore(cert), -3600);
+	X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME* name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC
+		, (unsigned char const*)"test_ssl_session", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+
+	FILE* f = std::fopen(cert_file.c_str(), "w");
+	PEM_write_X509(f, cert);
+	std::fclose(f);
+	f = std::fopen(key_file.c_str(), "w");
+	PEM_write_PrivateKey(f, key, 0, 0, 0, 0, 0);
+	std::fclose(f);
+
+	BIO* bio = BIO_new(BIO_s_mem());
+	PEM_write_bio_X509(bio, cert);
+	char* data;
+	long size = BIO_get_mem_data(bio, &data);
+	std::string pem(data, size);
+	BIO_free(bio);
+
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return pem;
+}
+
+boost::intrusive_ptr<torrent_info> make_ssl_torrent(std::string const& root_cert)
+{
+	std::vector<char> data(1024 * 1024);
+	for (int i = 0; i < int(data.size()); ++i) data[i] = char(i * 7);
+	std::ofstream out("tmp1_ssl_session/data", std::ios::binary);
+	out.write(&data[0], data.size());
+	out.close();
+
+	file_storage fs;
+	fs.add_file("data", data.size());
+	libtorrent::create_torrent t(fs, 16 * 1024);
+	t.set_root_cert(root_cert);
+	error_code ec;
+	set_piece_hashes(t, "tmp1_ssl_session", ec);
+	TEST_CHECK(!ec);
+
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), t.generate());
+	return boost::intrusive_ptr<torrent_info>(new torrent_info(&buf[0], buf.size(), ec));
+}
+
+torrent_handle add_ssl_torrent(session& ses, boost::intrusive_ptr<torrent_info> ti
+	, std::string const& save_path)
+{
+	add_torrent_params p;
+	p.ti = new torrent_info(*ti);
+	p.save_path = save_path;
+	p.auto_managed = false;
+	error_code ec;
+	torrent_handle h = ses.add_torrent(p, ec);
+	TEST_CHECK(!ec);
+	h.set_ssl_certificate("tmp1_ssl_session/cert.pem", "tmp1_ssl_session/key.pem", "");
+	return h;
+}
+
+// waits for the seed to have accepted and the downloader to have made
+// the given number of SSL connections, or for the downloader to have no
+// peers when both are 0
+bool wait_for_handshakes(session& ses1, session& ses2, torrent_handle h
+	, int incoming, int outgoing)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+		print_alerts(ses1, "ses1", true, true);
+		print_alerts(ses2, "ses2", true, true);
+		if (incoming == 0 && outgoing == 0)
+		{
+			if (h.status().num_peers == 0) return true;
+		}
+		else if (ses1.status().total_ssl_handshakes >= incoming
+			&& ses2.status().total_outgoing_ssl_handshakes >= outgoing)
+		{
+			return true;
+		}
+		test_sleep(100);
+	}
+	return false;
+}
+
+// connects the downloader to the seed, ends the connection and connects
+// again. When reject is set, the seed ends the first connection by banning
+// the downloader, otherwise the downloader pauses
+void test_resume(boost::intrusive_ptr<torrent_info> ti, int port, bool reject)
+{
+	std::printf("\n==== %s ====\n\n", reject ? "rejected connection" : "paused connection");
+
+	error_code ec;
+	remove_all("tmp2_ssl_session", ec);
+
+	session ses1(fingerprint("LT", 0, 1, 0, 0), std::make_pair(port, port + 1000), "0.0.0.0", 0);
+	session ses2(fingerprint("LT", 0, 1, 0, 0), std::make_pair(port + 1000, port + 2000), "0.0.0.0", 0);
+	wait_for_listen(ses1, "ses1");
+	wait_for_listen(ses2, "ses2");
+
+	// the download is throttled so it doesn't finish, a seed doesn't
+	// connect to a seed
+	session_settings settings;
+	settings.ignore_limits_on_local_network = false;
+	// a session ticket is resumed without the seed's cache, which is what
+	// forgets the session of a rejected connection
+	if (reject) settings.ssl_session_tickets = false;
+	ses1.set_settings(settings);
+	settings.download_rate_limit = 16 * 1024;
+	settings.ssl_listen = 0;
+	ses2.set_settings(settings);
+
+	torrent_handle seed = add_ssl_torrent(ses1, ti, "tmp1_ssl_session");
+	torrent_handle downloader = add_ssl_torrent(ses2, ti, "tmp2_ssl_session");
+	TEST_CHECK(seed.is_valid());
+	TEST_CHECK(downloader.is_valid());
+	test_sleep(500);
+
+	tcp::endpoint seed_ep(address::from_string("127.0.0.1"), ses1.ssl_listen_port());
+
+	// the first connection does a full handshake. It has to stay up long
+	// enough for a TLS 1.3 peer's session tickets, which come after it
+	downloader.connect_peer(seed_ep);
+	TEST_CHECK(wait_for_handshakes(ses1, ses2, downloader, 1, 1));
+	test_sleep(1000);
+
+	session_status st1 = ses1.status();
+	session_status st2 = ses2.status();
+	TEST_EQUAL(st1.total_ssl_handshakes, 1);
+	TEST_EQUAL(st1.total_ssl_handshakes_resumed, 0);
+	TEST_EQUAL(st2.total_outgoing_ssl_handshakes, 1);
+	TEST_EQUAL(st2.total_outgoing_ssl_handshakes_resumed, 0);
+
+	if (reject)
+	{
+		ip_filter filter;
+		filter.add_rule(address::from_string("127.0.0.1")
+			, address::from_string("127.0.0.1"), ip_filter::blocked);
+		ses1.set_ip_filter(filter);
+		TEST_CHECK(wait_for_handshakes(ses1, ses2, downloader, 0, 0));
+		ses1.set_ip_filter(ip_filter());
+	}
+	else
+	{
+		downloader.pause();
+		TEST_CHECK(wait_for_handshakes(ses1, ses2, downloader, 0, 0));
+		downloader.resume();
+	}
+
+	// the second connection resumes the session of the first, both sides
+	// count the handshakes SSL_session_reused() is true for
+	downloader.connect_peer(seed_ep);
+	TEST_CHECK(wait_for_handshakes(ses1, ses2, downloader, 2, 2));
+
+	st1 = ses1.status();
+	st2 = ses2.status();
+	std::printf("incoming: %d resumed: %d outgoing: %d resumed: %d\n"
+		, int(st1.total_ssl_handshakes), int(st1.total_ssl_handshakes_resumed)
+		, int(st2.total_outgoing_ssl_handshakes), int(st2.total_outgoing_ssl_handshakes_resumed));
+
+	// the session of a connection the seed dropped isn't resumed, the
+	// downloader may have tried it in between while it was still banned
+	if (reject)
+	{
+		TEST_CHECK(st1.total_ssl_handshakes >= 2);
+		TEST_EQUAL(st1.total_ssl_handshakes_resumed, 0);
+		TEST_EQUAL(st2.total_outgoing_ssl_handshakes_resumed, 0);
+		return;
+	}
+
+	TEST_CHECK(st1.total_ssl_handshakes >= 2);
+	TEST_CHECK(st1.total_ssl_handshakes_resumed >= 1);
+	TEST_CHECK(st2.total_outgoing_ssl_handshakes >= 2);
+	TEST_CHECK(st2.total_outgoing_ssl_handshakes_resumed >= 1);
+	TEST_EQUAL(st1.total_ssl_handshakes - st1.total_ssl_handshakes_resumed, 1);
+	TEST_EQUAL(st2.total_outgoing_ssl_handshakes - st2.total_outgoing_ssl_handshakes_resumed, 1);
+}
+
+int test_main()
+{
+	error_code ec;
+	remove_all("tmp1_ssl_session", ec);
+	remove_all("tmp2_ssl_session", ec);
+	create_directory("tmp1_ssl_session", ec);
+
+	std::string root_cert = write_certificate("tmp1_ssl_session/cert.pem"
+		, "tmp1_ssl_session/key.pem");
+	boost::intrusive_ptr<torrent_info> ti = make_ssl_torrent(root_cert);
+
+	test_resume(ti, 48000, false);
+	test_resume(ti, 51000, true);
+
+	remove_all("tmp1_ssl_session", ec);
+	remove_all("tmp2_ssl_session", ec);
+	return 0;
+}
+
+#else
+
+int test_main()
+{
+	return 0;
+}
+
+#endif // TORRENT_USE_OPENSSL
+
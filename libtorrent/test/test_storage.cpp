@@ -661,6 +661,90 @@ void test_remove(std::string const& test_path, bool unbuffered)
 	TEST_CHECK(!exists(combine_path(test_path, "temp_storage")));	
 }
 
+void test_vectored_io(std::string const& test_path)
+{
+	error_code ec;
+	remove_all(combine_path(test_path, "temp_storage"), ec);
+	create_directory(combine_path(test_path, "temp_storage"), ec);
+
+	// a read or write of several buffers is a single system call
+	// (plus a seek without preadv), and a short read stops at the
+	// end of the file
+	char out[3][100];
+	char in[3][100];
+	for (int i = 0; i < 3; ++i) std::memset(out[i], 'a' + i, 100);
+	file::iovec_t ob[3] = { { out[0], 100 }, { out[1], 100 }, { out[2], 100 } };
+	file::iovec_t ib[3] = { { in[0], 100 }, { in[1], 100 }, { in[2], 100 } };
+
+	file f;
+	TEST_CHECK(f.open(combine_path(test_path, "temp_storage/vectored.tmp"), file::read_write, ec));
+	int syscalls = 0;
+	TEST_EQUAL(f.writev(1000, ob, 3, ec, &syscalls), 300);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(f.readv(1000, ib, 3, ec, &syscalls), 300);
+	TEST_CHECK(!ec);
+	TEST_CHECK(std::memcmp(in, out, sizeof(in)) == 0);
+	TEST_EQUAL(f.readv(1150, ib, 3, ec, &syscalls), 150);
+	TEST_CHECK(std::memcmp(in[0], out[1] + 50, 50) == 0);
+#ifndef TORRENT_WINDOWS
+	TEST_EQUAL(syscalls, (TORRENT_USE_PREADV ? 3 : 6));
+#endif
+	f.close();
+
+	// a large file followed by small sidecar files, the last piece
+	// spans all three of them
+	file_storage fs;
+	fs.set_piece_length(16 * 1024);
+	fs.add_file("temp_storage/data.bam", 40000);
+	fs.add_file("temp_storage/data.bam.bai", 100);
+	fs.add_file("temp_storage/data.bam.md5", 33);
+	fs.set_num_pieces(3);
+	const int last_piece = fs.piece_size(2);
+	TEST_EQUAL(last_piece, 40133 - 2 * 16 * 1024);
+
+	std::vector<char> data(last_piece);
+	for (int i = 0; i < last_piece; ++i) data[i] = char(i * 7);
+	std::vector<char> back(last_piece);
+	file::iovec_t wb[8];
+	file::iovec_t rb[8];
+	int num_bufs = 0;
+	for (int offset = 0; offset < last_piece; offset += 1000, ++num_bufs)
+	{
+		wb[num_bufs].iov_base = &data[offset];
+		wb[num_bufs].iov_len = (std::min)(1000, last_piece - offset);
+		rb[num_bufs].iov_base = &back[offset];
+		rb[num_bufs].iov_len = wb[num_bufs].iov_len;
+	}
+	TEST_EQUAL(num_bufs, 8);
+
+	session_settings set;
+	file_pool fp;
+	disk_buffer_pool dp(16 * 1024);
+	boost::scoped_ptr<storage_interface> s(
+		default_storage_constructor(fs, 0, test_path, fp, std::vector<boost::uint8_t>()));
+	s->m_settings = &set;
+	s->m_disk_pool = &dp;
+	s->initialize(false);
+
+	TEST_EQUAL(s->writev(wb, 2, 0, num_bufs), last_piece);
+	TEST_CHECK(!s->error());
+#ifndef TORRENT_WINDOWS
+	TEST_EQUAL(dp.disk_syscalls(), (TORRENT_USE_PREADV ? 3 : 6));
+#endif
+	TEST_EQUAL(s->readv(rb, 2, 0, num_bufs), last_piece);
+	TEST_CHECK(!s->error());
+	TEST_CHECK(data == back);
+
+	// reading from the middle of the piece starts in the right file
+	std::fill(back.begin(), back.end(), 0);
+	file::iovec_t mid = { &back[0], 150 };
+	TEST_EQUAL(s->readv(&mid, 2, 7200, 1), 150);
+	TEST_CHECK(std::memcmp(&back[0], &data[7200], 150) == 0);
+
+	s->delete_files();
+	remove_all(combine_path(test_path, "temp_storage"), ec);
+}
+
 namespace
 {
 	void check_files_fill_array(int ret, disk_io_job const& j, bool* array, bool* done)
@@ -1053,6 +1137,7 @@ int test_main()
 
 	std::for_each(test_paths.begin(), test_paths.end(), boost::bind(&test_fastresume, _1));
 	std::for_each(test_paths.begin(), test_paths.end(), boost::bind(&test_rename_file_in_fastresume, _1));
+	std::for_each(test_paths.begin(), test_paths.end(), boost::bind(&test_vectored_io, _1));
 	std::for_each(test_paths.begin(), test_paths.end(), boost::bind(&run_test, _1, true));
 	std::for_each(test_paths.begin(), test_paths.end(), boost::bind(&run_test, _1, false));
 
@@ -42,7 +42,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "setup_transfer.hpp"
 #include <iostream>
 
-void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode = false, bool time_critical = false)
+void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode = false, bool time_critical = false
+	, bool affinity = false)
 {
 	using namespace libtorrent;
 
@@ -65,6 +66,9 @@ void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode
 	settings.allow_multiple_connections_per_ip = true;
 	settings.ignore_limits_on_local_network = false;
 	settings.strict_super_seeding = strict;
+	settings.peer_affinity_picking = affinity;
+	// let end game start before every piece is requested
+	if (affinity) settings.strict_end_game_mode = false;
 
 	settings.upload_rate_limit = rate_limit;
 	ses1.set_settings(settings);
@@ -105,6 +109,13 @@ void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode
 		tor2.set_piece_deadline(8, 2000);
 	}
 
+	if (affinity)
+	{
+		// the way split gtdownload children download
+		tor2.set_sequential_download(true);
+		tor3.set_sequential_download(true);
+	}
+
 	float sum_dl_rate2 = 0.f;
 	float sum_dl_rate3 = 0.f;
 	int count_dl_rates2 = 0;
@@ -151,6 +162,10 @@ void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode
 	TEST_CHECK(tor2.status().is_seeding);
 	TEST_CHECK(tor3.status().is_seeding);
 
+	// blocks are received straight into disk buffers
+	TEST_EQUAL(ses2.status().total_payload_copied, 0);
+	TEST_EQUAL(ses3.status().total_payload_copied, 0);
+
 	float average2 = sum_dl_rate2 / float(count_dl_rates2);
 	float average3 = sum_dl_rate3 / float(count_dl_rates3);
 
@@ -223,6 +238,9 @@ int test_main()
 	// with strict super seeding
 	test_swarm(true, true);
 
+	// with peer affinity picking
+	test_swarm(false, false, false, false, true);
+
 	return 0;
 }
 
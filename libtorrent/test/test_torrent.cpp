@@ -64,6 +64,33 @@ void test_running_torrent(boost::intrusive_ptr<torrent_info> info, size_type fil
 	std::cout << "total_wanted_done: " << st.total_wanted_done << " : 0" << std::endl;
 	TEST_CHECK(st.total_wanted_done == 0);
 
+	// a newly added torrent is included in the first batch of status updates
+	ses.post_torrent_updates();
+	bool got_update = false;
+	alert const* ua = ses.wait_for_alert(seconds(10));
+	while (ua)
+	{
+		std::auto_ptr<alert> al = ses.pop_alert();
+		if (state_update_alert* su = alert_cast<state_update_alert>(al.get()))
+		{
+			TEST_CHECK(su->status.size() == 1);
+			if (!su->status.empty())
+			{
+				TEST_CHECK(su->status[0].info_hash == info->info_hash());
+				TEST_CHECK(su->status[0].total_wanted == st.total_wanted);
+			}
+			got_update = true;
+			break;
+		}
+		ua = ses.wait_for_alert(seconds(10));
+	}
+	TEST_CHECK(got_update);
+
+	TEST_EQUAL(h.cache_priority(), 0);
+	h.set_cache_priority(3);
+	TEST_EQUAL(h.cache_priority(), 3);
+	h.set_cache_priority(0);
+
 	std::vector<int> prio(3, 1);
 	prio[0] = 0;
 	h.prioritize_files(prio);
@@ -129,6 +129,9 @@ void test_transfer(boost::intrusive_ptr<torrent_info> torrent_file
 			test_sleep(1000);
 			TEST_EQUAL(ses.status().total_payload_download - ses.status().total_redundant_bytes
 				, total_size);
+			// every block from a web seed is copied out of the http
+			// receive buffer
+			TEST_CHECK(ses.status().total_payload_copied >= total_size);
 			break;
 		}
 		test_sleep(500);
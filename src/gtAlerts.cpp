@@ -50,13 +50,69 @@ void gtBase::checkAlerts (libtorrent::session &torrSession)
    checkAlerts (&torrSession);
 }
 
+// The alert categories sessions are created with.  libtorrent does not
+// construct alerts of the other categories at all, so only the ones that
+// are logged with the current log mask are asked for.  Errors and tracker
+// replies are always needed, tracker replies track _successfulTrackerComms.
+// Resume data and torrent status updates are explicitly requested and
+// are posted regardless of the mask.
+uint32_t gtBase::alertMask ()
+{
+   uint32_t mask = libtorrent::alert::error_notification | libtorrent::alert::tracker_notification;
+
+   if (_logMask & LOG_DEBUG_NOTIFICATION)
+      mask |= libtorrent::alert::debug_notification;
+   if (_logMask & LOG_PEER_NOTIFICATION)
+      mask |= libtorrent::alert::peer_notification;
+   if (_logMask & LOG_IP_BLOCK_NOTIFICATION)
+      mask |= libtorrent::alert::ip_block_notification;
+   if (_logMask & LOG_PERFORMANCE_WARNING)
+      mask |= libtorrent::alert::performance_warning;
+   if (_logMask & LOG_STATUS_NOTIFICATION)
+      mask |= libtorrent::alert::status_notification;
+   if (_logMask & LOG_STATS_NOTIFICATION)
+      mask |= libtorrent::alert::stats_notification;
+   if (_logMask & LOG_STORAGE_NOTIFICATION)
+      mask |= libtorrent::alert::storage_notification;
+   if (_logMask & LOG_PROGRESS_NOTIFICATION)
+      mask |= libtorrent::alert::progress_notification;
+   if (_logMask & LOG_UNIMPLEMENTED_ALERTS)
+      mask |= libtorrent::alert::port_mapping_notification | libtorrent::alert::dht_notification | libtorrent::alert::rss_notification;
+
+   return mask;
+}
+
 void gtBase::checkAlerts (libtorrent::session *torrSession)
 {
-   std::deque <libtorrent::alert *> alerts;
+   // the session's queue is swapped with _alertBatch, which keeps its
+   // storage between calls, so popping does not allocate
+   std::deque <libtorrent::alert *> &alerts = _alertBatch;
    torrSession->pop_alerts (&alerts);
 
    for (std::deque<libtorrent::alert *>::iterator dequeIter = alerts.begin(), end(alerts.end()); dequeIter != end; ++dequeIter)
    {
+      // Replies to session::post_torrent_updates () are consumed here
+      // regardless of the log mask
+      if ((*dequeIter)->type() == libtorrent::state_update_alert::alert_type)
+      {
+         processTorrentStatusUpdates (libtorrent::alert_cast<libtorrent::state_update_alert> (*dequeIter)->status);
+         continue;
+      }
+
+      // Replies to torrent_handle::save_resume_data (), failures are
+      // passed on without resume data and logged below
+      if ((*dequeIter)->type() == libtorrent::save_resume_data_alert::alert_type)
+      {
+         libtorrent::save_resume_data_alert *resumeAlert = libtorrent::alert_cast<libtorrent::save_resume_data_alert> (*dequeIter);
+         processResumeData (resumeAlert->handle, resumeAlert->resume_data);
+         continue;
+      }
+
+      if ((*dequeIter)->type() == libtorrent::save_resume_data_failed_alert::alert_type)
+      {
+         processResumeData (libtorrent::alert_cast<libtorrent::save_resume_data_failed_alert> (*dequeIter)->handle, boost::shared_ptr <libtorrent::entry> ());
+      }
+
       bool haveError = (*dequeIter)->category() & libtorrent::alert::error_notification;
 
       switch ((*dequeIter)->category() & ~libtorrent::alert::error_notification)
@@ -116,15 +172,27 @@ void gtBase::checkAlerts (libtorrent::session *torrSession)
       }
    }
 
-   while (!alerts.empty())
+   // alerts are returned to libtorrent's alert pool
+   for (std::deque<libtorrent::alert *>::iterator dequeIter = alerts.begin(), end(alerts.end()); dequeIter != end; ++dequeIter)
    {
-      libtorrent::alert *deleteMe = alerts.front();
-      alerts.pop_front();
-      delete (deleteMe);
+      delete (*dequeIter);
    }
    alerts.clear();
 }
 
+// Called with the status of the torrents that changed since the last
+// post_torrent_updates () on a session.  Modes that monitor torrents
+// override this to cache the status instead of calling status () per torrent.
+void gtBase::processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates)
+{
+}
+
+// Called with the resume data requested by torrent_handle::save_resume_data (),
+// resumeData is empty if it could not be saved.
+void gtBase::processResumeData (libtorrent::torrent_handle &torrentHandle, boost::shared_ptr <libtorrent::entry> resumeData)
+{
+}
+
 void gtBase::getGtoNameAndInfoHash (libtorrent::torrent_alert *alert, std::string &gtoName, std::string &infoHash)
 {
    if (alert->handle.is_valid())
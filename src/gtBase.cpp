@@ -45,6 +45,9 @@
 #include <cstdio>
 #include <algorithm>
 
+#include <sys/stat.h>
+#include <utime.h>
+
 #ifdef __CYGWIN__
 #include <sys/cygwin.h>
 #endif /* __CYGWIN__ */
@@ -52,6 +55,7 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/rand.h>
+#include <openssl/x509.h>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -60,6 +64,7 @@
 
 #include "libtorrent/entry.hpp"
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/hasher.hpp"
 
 #include "libtorrent/create_torrent.hpp"
 
@@ -88,6 +93,10 @@ void *geneTorrCallBackPtr;
 // at the saem time another thread is trying to add to a buffer
 static pthread_mutex_t callBackLoggerLock;
 
+// XQilla initializes Xerces when constructed, which is not thread safe.
+// gtserver signs CSRs on several threads.
+static pthread_mutex_t httpErrorLock = PTHREAD_MUTEX_INITIALIZER;
+
 gtBase::gtBase (gtBaseOpts &opts, opMode mode):
    _progName (opts.m_progName),
    _verbosityLevel (VERBOSE_1), 
@@ -95,6 +104,7 @@ gtBase::gtBase (gtBaseOpts &opts, opMode mode):
    _tmpDir (""), 
    _startUpComplete (false),
    _operatingMode (mode), 
+   _certCacheDir (""),
    _successfulTrackerComms (false),
 
    // Protected members obtained from CLI or CFG.
@@ -102,6 +112,8 @@ gtBase::gtBase (gtBaseOpts &opts, opMode mode):
    _allowedServersSet (opts.m_allowedServersSet),
    _authToken (""),
    _curlVerifySSL (opts.m_curlVerifySSL),
+   _directIO (opts.m_directIO),
+   _httpClient (opts.m_curlVerifySSL),
    _exposedPortDelta (opts.m_exposedPortDelta),
    _inactiveTimeout (opts.m_inactiveTimeout),
    _ipFilter (opts.m_ipFilter),
@@ -112,13 +124,16 @@ gtBase::gtBase (gtBaseOpts &opts, opMode mode):
    _rateLimit (opts.m_rateLimit),
    _use_null_storage (opts.m_use_null_storage),
    _use_zero_storage (opts.m_use_zero_storage),
+   _use_uring_storage (opts.m_use_uring_storage),
+   _use_mmap_storage (opts.m_use_mmap_storage),
 
    // Private members obtained from CLI or CFG.
    _bindIP (opts.m_bindIP),
    _resourceDir (opts.m_resourceDir),
    _exposedIP (opts.m_exposedIP),
    _logMask (opts.m_logMask),
-   _peerTimeout (opts.m_peerTimeout)
+   _peerTimeout (opts.m_peerTimeout),
+   _sslCiphers (opts.m_sslCiphers)
 {
    geneTorrCallBackPtr = (void *) this;          // Set the global geneTorr pointer that allows fileFilter callbacks from libtorrent
 
@@ -155,6 +170,11 @@ gtBase::gtBase (gtBaseOpts &opts, opMode mode):
 
    loadCredentialFile (opts.m_credentialPath);
 
+   if (!_devMode)
+   {
+      setCertCacheDir ();
+   }
+
    std::string gtTag;
    if (_operatingMode != SERVER_MODE)
    {
@@ -257,49 +277,6 @@ void gtBase::mkTempDir ()
    _tmpDir += "/";
 }
 
-// 
-std::string gtBase::loadCSRfile (std::string csrFileName)
-{
-   std::string fileContent = "";
-   
-   std::ifstream csrFile;
-
-   csrFile.open (csrFileName.c_str (), std::ifstream::in);
-
-   if (!csrFile.good ())
-   {
-      if (_operatingMode != SERVER_MODE)
-      {
-         gtError ("Failure opening " + csrFileName + " for input.", 202, ERRNO_ERROR, errno);
-      }
-      else
-      {
-         gtError ("Failure opening " + csrFileName + " for input.", ERROR_NO_EXIT, ERRNO_ERROR, errno);
-         return "";
-      }
-   }
-
-   char inLine[100];
-
-   while (csrFile.good())
-   {
-      std::istream &in = csrFile.getline (inLine, sizeof (inLine)-1);
-
-      if (in.gcount() <= 0 || csrFile.eof())
-      {
-         break;
-      }
-
-      inLine[in.gcount()] = '\0';
-
-      fileContent += std::string (inLine) + "\n";
-   }
-
-   csrFile.close ();
-
-   return fileContent;
-}
-
 // 
 gtBase::~gtBase ()
 {
@@ -502,7 +479,7 @@ libtorrent::session * gtBase::makeTorrentSession ()
 
    try
    {
-      torrentSession = new libtorrent::session(*_gtFingerPrint, 0, libtorrent::alert::all_categories);
+      torrentSession = new libtorrent::session(*_gtFingerPrint, 0, alertMask ());
       optimizeSession (torrentSession);
       bindSession (torrentSession);
    }
@@ -533,13 +510,17 @@ void gtBase::bindSession (libtorrent::session *torrentSession)
    // update the IP we bind on.  
    //
 
+   // a restarted or handed off server gets the ports of the previous
+   // instance back, even while its connections linger in TIME_WAIT
+   int listenFlags = (_operatingMode == SERVER_MODE) ? libtorrent::session::listen_reuse_address : 0;
+
    if (_bindIP.size () > 0)
    {
-      torrentSession->listen_on (std::make_pair (_portStart, _portEnd), torrentError, _bindIP.c_str (), 0);
+      torrentSession->listen_on (std::make_pair (_portStart, _portEnd), torrentError, _bindIP.c_str (), listenFlags);
    }
    else
    {
-      torrentSession->listen_on (std::make_pair (_portStart, _portEnd), torrentError, NULL, 0);
+      torrentSession->listen_on (std::make_pair (_portStart, _portEnd), torrentError, NULL, listenFlags);
    }
 
    if (torrentError)
@@ -557,6 +538,9 @@ void gtBase::bindSession (libtorrent::session *torrentSession)
    if (_peerTimeout > 0)
       settings.peer_timeout = _peerTimeout;
 
+   // empty selects libtorrent's AEAD-first policy
+   settings.ssl_ciphers = _sslCiphers;
+
    torrentSession->set_settings (settings);
 }
 
@@ -566,26 +550,17 @@ void gtBase::bindSession (libtorrent::session &torrentSession)
    bindSession (&torrentSession);
 }
 
-// 
-void gtBase::optimizeSession (libtorrent::session *torrentSession)
+// The session settings of an operating mode that don't depend on the
+// options, gtbench uses them to benchmark the same configuration
+void gtBase::tuneSessionSettings (libtorrent::session_settings &settings, opMode operatingMode)
 {
-   libtorrent::session_settings settings = torrentSession->settings ();
-
    settings.allow_multiple_connections_per_ip = true;
-#ifdef TORRENT_CALLBACK_LOGGER
-   settings.loggingCallBack = &gtBase::loggingCallBack;
-#endif
    settings.max_allowed_in_request_queue = 1000;
    settings.max_out_request_queue = 1000;
    settings.mixed_mode_algorithm = libtorrent::session_settings::prefer_tcp;
    settings.enable_outgoing_utp = false;
    settings.enable_incoming_utp = false;
 
-   if (_operatingMode != SERVER_MODE && _allowedServersSet)
-      settings.apply_ip_filter_to_trackers = true;
-   else
-      settings.apply_ip_filter_to_trackers = false;
-
    settings.no_atime_storage = false;
    settings.max_queued_disk_bytes = 256 * 1024 * 1024;
 
@@ -606,14 +581,20 @@ void gtBase::optimizeSession (libtorrent::session *torrentSession)
    //
    // TODO: probably a good idea to set this in ALL modes, but for now
    // we don't want to risk introducing a new bug to server mode
-   if (_operatingMode != SERVER_MODE)
+   if (operatingMode != SERVER_MODE)
    { 
       settings.inhibit_keepalives = true;
    }
 
+   // when several gtservers seed a GTO, take the end game blocks from whichever is expected to deliver them first
+   if (operatingMode == DOWNLOAD_MODE)
+   {
+      settings.peer_affinity_picking = true;
+   }
+
    settings.alert_queue_size = 10000;
 
-   if (_operatingMode == SERVER_MODE)
+   if (operatingMode == SERVER_MODE)
    {
       settings.send_buffer_watermark = 256 * 1024 * 1024;
 
@@ -622,8 +603,68 @@ void gtBase::optimizeSession (libtorrent::session *torrentSession)
 
       // don't retry peers if they fail once. Let them connect to us if they want to
       settings.max_failcount = 1;
+
+      // favor popular GTOs in the read cache, see gtServer::processTorrentStatusUpdates
+      settings.read_cache_hit_age = SERVER_READ_CACHE_HIT_AGE;
+      settings.read_cache_priority_age = SERVER_READ_CACHE_PRIORITY_AGE;
+
+      // the server's disk cache is large, back it with huge pages where the kernel has them
+      settings.disk_cache_huge_pages = true;
+   }
+}
+
+// Files of a GTO that start at a page boundary, in practice the large ones, are read and written
+// with O_DIRECT.  The others stay in the page cache:  without it, writing the pages they share
+// with a neighbouring file would be a read-modify-write that the download children, each
+// writing its own pieces, could race on.
+//
+// libtorrent's disk cache is then all the caching there is.  It keeps the blocks of a piece
+// until the piece has been hashed and writes it whole, so it's sized to hold the pieces in
+// flight, and bounded so memory use doesn't follow the size of the GTO.  Each session has a
+// cache of its own, so the server's budget is split between the sessions it runs at once.
+void gtBase::directIOSettings (libtorrent::session_settings &settings, opMode operatingMode, unsigned int sessions)
+{
+   settings.disk_io_write_mode = libtorrent::session_settings::disable_os_cache_for_aligned_files;
+   settings.disk_io_read_mode = libtorrent::session_settings::disable_os_cache_for_aligned_files;
+
+   int cacheMB = DIRECT_IO_DOWNLOAD_CACHE_MB;
+
+   if (operatingMode == SERVER_MODE)
+   {
+      cacheMB = std::max (DIRECT_IO_SERVER_CACHE_MB / (int) std::max (sessions, 1u), DIRECT_IO_MIN_CACHE_MB);
    }
 
+   settings.cache_size = cacheMB * 1024 * 1024 / (16 * 1024);
+}
+
+// 
+void gtBase::optimizeSession (libtorrent::session *torrentSession)
+{
+   libtorrent::session_settings settings = torrentSession->settings ();
+
+   tuneSessionSettings (settings, _operatingMode);
+
+   if (_directIO)
+   {
+      directIOSettings (settings, _operatingMode, maxSessions ());
+   }
+
+   // mmap storage reads straight from the page cache, a read cache would
+   // only hold a second copy of the same blocks
+   if (_use_mmap_storage)
+   {
+      settings.use_read_cache = false;
+   }
+
+#ifdef TORRENT_CALLBACK_LOGGER
+   settings.loggingCallBack = &gtBase::loggingCallBack;
+#endif
+
+   if (_operatingMode != SERVER_MODE && _allowedServersSet)
+      settings.apply_ip_filter_to_trackers = true;
+   else
+      settings.apply_ip_filter_to_trackers = false;
+
    torrentSession->set_settings (settings);
 
    if (_bindIP.size() || _exposedIP.size())
@@ -669,23 +710,30 @@ void gtBase::optimizeSession (libtorrent::session &torrentSession)
    optimizeSession (&torrentSession);
 }
 
+// libtorrent's own timestamp, compiled once rather than per message
+static const boost::regex timeStampPattern ("[0-9][0-9]:[0-9][0-9]:[0-9][0-9].[0-9][0-9][0-9]");
+
 // 
 void gtBase::loggingCallBack (std::string message)
 {
+   if (!(((gtBase *)geneTorrCallBackPtr)->getLogMask() & LOG_LT_CALL_BACK_LOGGER))
+   {
+      return;
+   }
+
    pthread_mutex_lock (&callBackLoggerLock);
 
-   static std::ostringstream messageBuff;
-   messageBuff << message;
+   static std::string messageBuff;
+   messageBuff += message;
 
    if (std::string::npos != message.find ('\n'))
    {
-      std::string logMessage = messageBuff.str().substr(0, messageBuff.str().size() - 1);
-      messageBuff.str("");
+      std::string logMessage;
+      logMessage.swap (messageBuff);
+      logMessage.erase (logMessage.size() - 1);
       pthread_mutex_unlock (&callBackLoggerLock);
 
-      boost::regex searchPattern ("[0-9][0-9]:[0-9][0-9]:[0-9][0-9].[0-9][0-9][0-9]");
-
-      if (regex_search (logMessage, searchPattern))
+      if (regex_search (logMessage, timeStampPattern))
       {
          logMessage = logMessage.substr(12);
       }
@@ -697,10 +745,7 @@ void gtBase::loggingCallBack (std::string message)
 
       if (logMessage.size() > 2)
       {
-         if (((gtBase *)geneTorrCallBackPtr)->getLogMask() & LOG_LT_CALL_BACK_LOGGER)
-         {
-            Log (PRIORITY_NORMAL, "%s", logMessage.c_str());
-         }
+         Log (PRIORITY_NORMAL, "%s", logMessage.c_str());
       }
       return;
    }
@@ -732,185 +777,51 @@ void gtBase::processSSLError (std::string message)
    }
 }
 
-// 
-bool gtBase::generateCSR (std::string uuid)
+// Takes a pre-generated key and CSR from the key pool, or builds them here
+// if the pool is empty.  The CSR is only needed in memory for the signing
+// request, the key is written to the temp directory for libtorrent.
+bool gtBase::generateCSR (std::string uuid, std::string &csrData)
 {
-   RSA *rsaKey;
-
-   // Generate RSA Key
-   rsaKey =  RSA_generate_key(RSA_KEY_SIZE, RSA_F4, NULL, NULL);
-
-   if (NULL == rsaKey)
-   {
-      processSSLError ("Failure generating OpenSSL Key:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }
-
-   EVP_PKEY *pKey;
-
-   // Initialize private key store
-   pKey = EVP_PKEY_new();
-
-   if (NULL == pKey)
-   {
-      RSA_free(rsaKey);
-      processSSLError ("Failure initializing OpenSSL EVP object:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }    
-
-   // Add key to private key store
-   if (!(EVP_PKEY_set1_RSA (pKey, rsaKey)))
-   {
-      EVP_PKEY_free (pKey);
-      RSA_free (rsaKey);
-      processSSLError ("Failure adding OpenSSL key to EVP object:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }    
-
-   X509_REQ *csr;
-
-   // Allocate a CSR
-   csr = X509_REQ_new();
-
-   if (NULL == csr)
-   {
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure allocating OpenSSL CSR:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }    
-
-   // set the public key part of the SCR
-   if (!(X509_REQ_set_pubkey (csr, pKey)))
-   {
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free (rsaKey);
-      processSSLError ("Failure adding public key to OpenSSL CSR:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }    
-  
-   // allocate subject attribute structure 
-   X509_NAME *subject;
+   gtKeyPair keyPair;
 
-   subject = X509_NAME_new();
-
-   if (NULL == subject)
+   if (!_keyPool.takeKeyPair (keyPair))
    {
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure allocating OpenSSL X509 Name Structure:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }    
+      std::string failureStage;
 
-   // Add attributes to subject
-   for (int i = 0; i < CSR_ATTRIBUTE_ENTRY_COUNT; i++)
-   {
-      if (!X509_NAME_add_entry_by_txt(subject, attributes[i].key.c_str(), MBSTRING_ASC, (const unsigned char *)attributes[i].value.c_str(), -1, -1, 0))
+      if (!gtKeyPool::generateKeyPair (attributes, CSR_ATTRIBUTE_ENTRY_COUNT, keyPair, failureStage))
       {
-         X509_NAME_free (subject);
-         X509_REQ_free (csr); 
-         EVP_PKEY_free (pKey);
-         RSA_free(rsaKey);
-         processSSLError ("Failure adding " + attributes[i].key + " to OpenSSL X509 Name Structure:  ");   // if this returns server mode is active and we bail on this attempt
+         processSSLError (failureStage);   // if this returns server mode is active and we bail on this attempt
          return false;
       }
    }
 
-   // Add the subject to the CSR
-   if (!(X509_REQ_set_subject_name(csr, subject)))
-   {
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure adding X509 Name Structure to CSR:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }
-
-   EVP_MD *digest;
-
-   digest = (EVP_MD *)EVP_sha1();
-
-   if (NULL == digest)
-   {
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure allocating OpenSSL sha1 digest:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }
-
-   if (!(X509_REQ_sign(csr, pKey, digest)))
-   {
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure creating OpenSSL CSR:  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }
-
    FILE *outputFile;
-   std::string csrPathAndFile = _tmpDir + uuid + ".csr";
-
-   if (NULL == (outputFile = fopen(csrPathAndFile.c_str(), "w")))
-   {
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure opening " + csrPathAndFile + " for output.  Unable to write OpenSSL CSR.");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }
- 
-   if (PEM_write_X509_REQ(outputFile, csr) != 1)
-   {
-      fclose(outputFile);
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
-      processSSLError ("Failure writing OpenSSL CSR to " + csrPathAndFile + ":  ");   // if this returns server mode is active and we bail on this attempt
-      return false;
-   }
-   fclose(outputFile);
-
    std::string pKeyPathAndFile = _tmpDir + uuid + ".key";
 
    if (NULL == (outputFile = fopen(pKeyPathAndFile.c_str(), "w")))
    {
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
       processSSLError ("Failure opening " + pKeyPathAndFile + " for output.  Unable to write OpenSSL private key.");   // if this returns server mode is active and we bail on this attempt
       return false;
    }
 
-   if (PEM_write_PrivateKey(outputFile, pKey, NULL, NULL, 0, 0, NULL) != 1)
+   if (fwrite (keyPair.privateKey.data (), 1, keyPair.privateKey.size (), outputFile) != keyPair.privateKey.size ())
    {
       fclose(outputFile);
-      X509_NAME_free (subject);
-      X509_REQ_free (csr); 
-      EVP_PKEY_free (pKey);
-      RSA_free(rsaKey);
       processSSLError ("Failure writing OpenSSL Private Key to " + pKeyPathAndFile + ":  ");   // if this returns server mode is active and we bail on this attempt
       return false;
    }
    fclose(outputFile);
 
-   // Clean up memory allocated
-   X509_NAME_free (subject);
-   X509_REQ_free (csr); 
-   EVP_PKEY_free (pKey);
-   RSA_free (rsaKey);
+   csrData = keyPair.csr;
 
    return true;
 }
 
+bool gtBase::startKeyPool (int poolSize)
+{
+   return _keyPool.start (poolSize, attributes, CSR_ATTRIBUTE_ENTRY_COUNT);
+}
+
 std::string gtBase::getFileName (std::string fileName)
 {
    return boost::filesystem::path(fileName).filename().string();
@@ -1036,24 +947,21 @@ void gtBase::finishCurlTempFile (FILE *curl_stderr_fp, std::string tempFilePath)
 // 
 bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, std::string uuid)
 {
-   bool csrStatus = generateCSR (uuid);
-
-   if (false == csrStatus)
+   if (loadCachedCert (info_hash, uuid))
    {
-      return csrStatus;
+      screenOutput ("Using cached SSL certificate for UUID: " + uuid, VERBOSE_2);
+      return true;
    }
 
-   std::string certFileName = _tmpDir + uuid + ".crt";
-   std::string csrFileName = _tmpDir + uuid + ".csr";
-
-   std::string csrData = loadCSRfile (csrFileName);
+   std::string csrData;
 
-   if (csrData.size() == 0)  // only enounter this in SERVER_MODE, other modes exit.
+   if (!generateCSR (uuid, csrData))
    {
-      gtError ("Operating in Server Mode, empty or missing CSR file encountered.  Discarding GTO from serving qeueue.", ERROR_NO_EXIT);
       return false;
    }
 
+   std::string certFileName = _tmpDir + uuid + ".crt";
+
    FILE *signedCert;
 
    signedCert = fopen (certFileName.c_str (), "w");
@@ -1079,10 +987,12 @@ bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, st
    checkIPFilter (CSRSignURL);
 
    CURL *curl;
-   curl = curl_easy_init ();
+   curl = _httpClient.acquireHandle ();
 
    if (!curl)
    {
+      fclose (signedCert);
+
       if (_operatingMode != SERVER_MODE)
       {
          gtError ("libCurl initialization failure", 201);
@@ -1094,24 +1004,12 @@ bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, st
       }
    }
 
-   if (!_curlVerifySSL)
-   {
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYPEER, 0);
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYHOST, 0);
-   }
-
    curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, errorBuffer);
    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, NULL);
    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, &curlCallBackHeadersWriter);
-   curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 15);
    curl_easy_setopt (curl, CURLOPT_WRITEDATA, signedCert);
    curl_easy_setopt (curl, CURLOPT_WRITEHEADER, &curlResponseHeaders);
-   curl_easy_setopt (curl, CURLOPT_NOSIGNAL, (long)1);
    curl_easy_setopt (curl, CURLOPT_POST, (long)1);
-#ifdef __CYGWIN__
-	std::string winInst = getWinInstallDirectory () + "/cacert.pem";
-	curl_easy_setopt (curl, CURLOPT_CAINFO, winInst.c_str ());
-#endif /* __CYGWIN__ */
 
    struct curl_httppost *post=NULL;
    struct curl_httppost *last=NULL;
@@ -1121,14 +1019,7 @@ bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, st
    curl_formadd (&post, &last, CURLFORM_COPYNAME, "info_hash", CURLFORM_COPYCONTENTS, info_hash.c_str(), CURLFORM_END);
 
    curl_easy_setopt (curl, CURLOPT_HTTPPOST, post);
-
-   // CGHUBDEV-22: Set CURL timeouts to 20 seconds
-   int timeoutVal = 20;
-   int connTime = 20;
-
    curl_easy_setopt (curl, CURLOPT_URL, CSRSignURL.c_str());
-   curl_easy_setopt (curl, CURLOPT_TIMEOUT, timeoutVal);
-   curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, connTime);
 
    std::string tmppath;
    FILE *curl_stderr_fp = createCurlTempFile(tmppath);
@@ -1150,19 +1041,19 @@ bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, st
    {
       res = curl_easy_perform (curl);
 
-      if (res != CURLE_SSL_CONNECT_ERROR && res != CURLE_OPERATION_TIMEDOUT)
+      if (!gtHttpClient::retryable (res))
       {
          // Only retry on SSL connect errors or timeouts in case the other end is temporarily overloaded.
          break;
       }
 
-      // Give the other end time to become less loaded.
-      sleep (2);
-
       retries--;
 
       if (retries)
       {
+         // Give the other end time to become less loaded.
+         _httpClient.backoff (4 - retries);
+
          screenOutput ("Retrying CSR signing for UUID: " + uuid, VERBOSE_1);
       }
    }
@@ -1172,7 +1063,7 @@ bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, st
    bool successfulPerform = processCurlResponse (curl, res, certFileName, CSRSignURL, uuid, "Problem communicating with GeneTorrent Executive while attempting a CSR signing transaction for UUID:", retries);
 
    curl_formfree (post);
-   curl_easy_cleanup (curl);
+   _httpClient.releaseHandle (curl);
 
    finishCurlTempFile (curl_stderr_fp, tmppath);
    screenOutput ("Headers received from the client:  '" << curlResponseHeaders << "'" << std::endl, VERBOSE_2);
@@ -1184,10 +1075,227 @@ bool gtBase::acquireSignedCSR (std::string info_hash, std::string CSRSignURL, st
          exit (1);
       }
    }
+   else
+   {
+      storeCachedCert (info_hash, uuid);
+   }
 
    return successfulPerform;
 }
 
+// Signed certificates are kept in a directory shared by all GeneTorrent
+// processes of the user, so restarts, retries and a gtserver serving the
+// same GTO again reuse them instead of going through CSR signing.  The
+// directory holds private keys, it is only used if no one else can access it.
+void gtBase::setCertCacheDir ()
+{
+   std::ostringstream cacheDir;
+
+   try
+   {
+      cacheDir << boost::filesystem::temp_directory_path().string() << "/" << CERT_CACHE_DIR_PREFIX << getuid();
+   }
+   catch (boost::filesystem::filesystem_error e)
+   {
+      return;
+   }
+
+   std::string dirName = sanitizePath (cacheDir.str ());
+
+   if (mkdir (dirName.c_str(), 0700) != 0 && errno != EEXIST)
+   {
+      Log (PRIORITY_NORMAL, "Not caching signed certificates, failure creating %s:  %s (%d)", dirName.c_str(), strerror (errno), errno);
+      return;
+   }
+
+   struct stat dirStat;
+
+   if (lstat (dirName.c_str(), &dirStat) != 0 || !S_ISDIR (dirStat.st_mode) || dirStat.st_uid != getuid() || (dirStat.st_mode & 077) != 0)
+   {
+      Log (PRIORITY_HIGH, "Not caching signed certificates, %s is not a directory private to this user", dirName.c_str());
+      return;
+   }
+
+   _certCacheDir = dirName + "/";
+
+   pruneCertCache ();
+}
+
+// Certificates are signed for an info hash on behalf of a credential, the
+// token is part of the key so a different credential never picks them up
+std::string gtBase::certCacheEntry (std::string info_hash)
+{
+   if (_certCacheDir.size () == 0 || info_hash.size () == 0)
+   {
+      return "";
+   }
+
+   libtorrent::hasher tokenHash (_authToken.c_str(), _authToken.size());
+
+   std::ostringstream tokenScope;
+   tokenScope << tokenHash.final ();
+
+   return _certCacheDir + info_hash + "-" + tokenScope.str ().substr (0, 16);
+}
+
+bool gtBase::loadCachedCert (std::string info_hash, std::string uuid)
+{
+   std::string entry = certCacheEntry (info_hash);
+
+   if (entry.size () == 0)
+   {
+      return false;
+   }
+
+   std::string cachedCert = entry + ".crt";
+   std::string cachedKey = entry + ".key";
+
+   if (statFile (cachedCert) != 0 || statFile (cachedKey) != 0)
+   {
+      return false;
+   }
+
+   if (!certificateUsable (cachedCert, cachedKey))
+   {
+      unlink (cachedCert.c_str());
+      unlink (cachedKey.c_str());
+      return false;
+   }
+
+   if (!copyFileAtomically (cachedKey, _tmpDir + uuid + ".key") || !copyFileAtomically (cachedCert, _tmpDir + uuid + ".crt"))
+   {
+      return false;
+   }
+
+   // keeps entries in use from being pruned
+   utime (cachedCert.c_str(), NULL);
+
+   return true;
+}
+
+void gtBase::storeCachedCert (std::string info_hash, std::string uuid)
+{
+   std::string entry = certCacheEntry (info_hash);
+
+   if (entry.size () == 0)
+   {
+      return;
+   }
+
+   std::string certFile = _tmpDir + uuid + ".crt";
+   std::string keyFile = _tmpDir + uuid + ".key";
+
+   // whatever the signing service returned, only cache certificates that
+   // can actually be used with the key
+   if (!certificateUsable (certFile, keyFile))
+   {
+      return;
+   }
+
+   // the key goes first, an entry without its key is never used
+   if (!copyFileAtomically (keyFile, entry + ".key") || !copyFileAtomically (certFile, entry + ".crt"))
+   {
+      Log (PRIORITY_NORMAL, "Failure adding the signed certificate for UUID %s to the certificate cache", uuid.c_str());
+   }
+}
+
+void gtBase::pruneCertCache ()
+{
+   time_t oldest = time (NULL) - CERT_CACHE_MAX_AGE;
+
+   try
+   {
+      for (boost::filesystem::directory_iterator iter (_certCacheDir), end; iter != end; iter++)
+      {
+         std::string fileName = iter->path().string();
+         time_t modTime;
+
+         if (fileName.size () < 4 || fileName.compare (fileName.size () - 4, 4, ".crt") != 0 || statFile (fileName, modTime) != 0 || modTime >= oldest)
+         {
+            continue;
+         }
+
+         unlink (fileName.c_str());
+         unlink ((fileName.substr (0, fileName.size () - 4) + ".key").c_str());
+      }
+   }
+   catch (boost::filesystem::filesystem_error e)
+   {
+      Log (PRIORITY_NORMAL, "Failed to prune the certificate cache %s", _certCacheDir.c_str());
+   }
+}
+
+// The certificate must be valid now and for a while longer, and match the key
+bool gtBase::certificateUsable (std::string certFile, std::string keyFile)
+{
+   FILE *inputFile;
+   X509 *cert = NULL;
+   EVP_PKEY *pKey = NULL;
+
+   if (NULL != (inputFile = fopen (certFile.c_str(), "r")))
+   {
+      cert = PEM_read_X509 (inputFile, NULL, NULL, NULL);
+      fclose (inputFile);
+   }
+
+   if (NULL != (inputFile = fopen (keyFile.c_str(), "r")))
+   {
+      pKey = PEM_read_PrivateKey (inputFile, NULL, NULL, NULL);
+      fclose (inputFile);
+   }
+
+   bool usable = false;
+
+   if (cert && pKey)
+   {
+      time_t validUntil = time (NULL) + CERT_CACHE_MIN_VALIDITY;
+
+      usable = X509_cmp_current_time (X509_get_notBefore (cert)) < 0 &&
+               X509_cmp_time (X509_get_notAfter (cert), &validUntil) > 0 &&
+               X509_check_private_key (cert, pKey) == 1;
+   }
+
+   if (cert)
+      X509_free (cert);
+   if (pKey)
+      EVP_PKEY_free (pKey);
+
+   ERR_clear_error ();
+
+   return usable;
+}
+
+// Copies under a temporary name first, concurrent readers either see the
+// complete file or none
+bool gtBase::copyFileAtomically (std::string source, std::string destination)
+{
+   std::string t = destination + ".XXXXXX";
+   char tmpname[4096];
+
+   strncpy (tmpname, t.c_str(), sizeof (tmpname) - 1);
+   tmpname[sizeof (tmpname) - 1] = '\0';
+
+   int tmpFd = mkstemp (tmpname);
+
+   if (tmpFd < 0)
+   {
+      return false;
+   }
+
+   close (tmpFd);
+
+   libtorrent::error_code ec;
+   boost::filesystem::copy_file (source, tmpname, boost::filesystem::copy_option::overwrite_if_exists, ec);
+
+   if (ec || rename (tmpname, destination.c_str()) != 0)
+   {
+      unlink (tmpname);
+      return false;
+   }
+
+   return true;
+}
+
 void gtBase::curlCleanupOnFailure (std::string fileName, FILE *gtoFile)
 {
    fclose (gtoFile);
@@ -1377,7 +1485,11 @@ bool gtBase::processCurlResponse (CURL *curl, CURLcode result, std::string fileN
    {
       // returns true if successfully used the XML in the file,
       // otherwise log generic error with GTError
-      if (!processHTTPError (fileName, retryCount, ERROR_NO_EXIT))
+      pthread_mutex_lock (&httpErrorLock);
+      bool usedErrorXML = processHTTPError (fileName, retryCount, ERROR_NO_EXIT);
+      pthread_mutex_unlock (&httpErrorLock);
+
+      if (!usedErrorXML)
       {
          gtError (defaultMessage + uuid, ERROR_NO_EXIT, gtBase::HTTP_ERROR, code, "URL:  " + url);
       }
@@ -1421,37 +1533,18 @@ std::string gtBase::authTokenFromURI (std::string url)
    checkIPFilter (url);
 
    CURL *curl;
-   curl = curl_easy_init ();
+   curl = _httpClient.acquireHandle ();
 
    if (!curl)
       gtError ("libCurl initialization failure", 201);
 
-   if (!_curlVerifySSL)
-   {
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYPEER, 0);
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYHOST, 0);
-   }
-
    curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, errorBuffer);
    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, &curlCallBackHeadersWriter);
    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, &curlCallBackHeadersWriter);
-   curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 15);
    curl_easy_setopt (curl, CURLOPT_WRITEDATA, &curlResponseData);
    curl_easy_setopt (curl, CURLOPT_WRITEHEADER, &curlResponseHeaders);
-   curl_easy_setopt (curl, CURLOPT_NOSIGNAL, (long)1);
    curl_easy_setopt (curl, CURLOPT_HTTPGET, (long)1);
-#ifdef __CYGWIN__
-	std::string winInst = getWinInstallDirectory () + "/cacert.pem";
-	curl_easy_setopt (curl, CURLOPT_CAINFO, winInst.c_str ());
-#endif /* __CYGWIN__ */
-
-   // CGHUBDEV-22: Set CURL timeouts to 20 seconds
-   int timeoutVal = 20;
-   int connTime = 20;
-
    curl_easy_setopt (curl, CURLOPT_URL, url.c_str());
-   curl_easy_setopt (curl, CURLOPT_TIMEOUT, timeoutVal);
-   curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, connTime);
 
    std::string tmppath;
    FILE *curl_stderr_fp = createCurlTempFile(tmppath);
@@ -1484,7 +1577,7 @@ std::string gtBase::authTokenFromURI (std::string url)
       gtError (errormsg.str(), 65);
    }
 
-   curl_easy_cleanup (curl);
+   _httpClient.releaseHandle (curl);
 
    finishCurlTempFile (curl_stderr_fp, tmppath);
    screenOutput ("Headers received from the client:  '" << curlResponseHeaders << "'" << std::endl, VERBOSE_2);
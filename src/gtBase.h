@@ -43,6 +43,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/program_options.hpp>
@@ -58,12 +59,8 @@
 #include "gtDefs.h"
 #include "gtUtils.h"
 #include "gtLog.h"
-
-typedef struct attributeEntry_
-{
-    std::string key;
-    std::string value;
-}attributeEntry;
+#include "gtKeyPool.h"
+#include "gtHttpClient.h"
 
 class gtBase
 {
@@ -84,9 +81,15 @@ class gtBase
          libtorrent::add_torrent_params torrentParams;
          libtorrent::torrent_handle torrentHandle;
          time_t expires;            // When the torrent expires
+         time_t nextExpiryCheck;    // When the server expiry queue next looks at this torrent
          time_t mtime;              // file modification time
          std::string infoHash;         
          bool overTimeAlertIssued;  // tracks if the overtime message has been reported to syslog
+         libtorrent::torrent_status::state_t state;   // as of the last status update from the session
+         int numPeers;                                // as of the last status update from the session
+         int64_t totalPayloadUpload;                  // as of the last status update from the session
+         int cachePriority;                           // read cache priority hint last given to the session
+         unsigned int signingJob;                     // gtserver CSR signing job the torrent waits on, 0 if none
          bool downloadGTO;
       } activeTorrentRec;
 
@@ -110,6 +113,9 @@ class gtBase
 
       static std::string version_str;
 
+      static void tuneSessionSettings (libtorrent::session_settings &settings, opMode operatingMode);
+      static void directIOSettings (libtorrent::session_settings &settings, opMode operatingMode, unsigned int sessions);
+
       virtual void run () = 0;
       uint32_t getLogMask() {return _logMask;}
       gtLogLevel logLevelFromBool (bool high) {return high? PRIORITY_HIGH : PRIORITY_NORMAL;}
@@ -133,6 +139,8 @@ class gtBase
       void gtError (std::string errorMessage, int exitValue, gtErrorType errorType = gtBase::DEFAULT_ERROR, long errorCode = 0, std::string errorMessageLine2 = "", std::string errorMessageErrorLine = "");
       void checkAlerts (libtorrent::session &torrSession);
       void checkAlerts (libtorrent::session *torrSession);
+      virtual void processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates);
+      virtual void processResumeData (libtorrent::torrent_handle &torrentHandle, boost::shared_ptr <libtorrent::entry> resumeData);
       void getGtoNameAndInfoHash (libtorrent::torrent_alert *alert, std::string &gtoName, std::string &infoHash);
 
       libtorrent::session *makeTorrentSession ();
@@ -141,8 +149,15 @@ class gtBase
       void optimizeSession (libtorrent::session *torrentSession);
       void optimizeSession (libtorrent::session &torrentSession);
 
+      // the most sessions the process runs at once
+      virtual unsigned int maxSessions () { return 1; }
+
       std::string makeTimeStamp ();
       bool generateSSLcertAndGetSigned (std::string torrentFile, std::string signUrl, std::string torrentUUID);
+      bool acquireSignedCSR (std::string info_hash, std::string CSRsigningURL, std::string uuid);
+      bool startKeyPool (int poolSize);
+
+      gtKeyPool _keyPool;          // pre-generated SSL keys, only started by gtserver
 
       static int curlCallBackHeadersWriter (char *data, size_t size, size_t nmemb, std::string *buffer);
       bool processCurlResponse (CURL *curl, CURLcode result, std::string fileName, std::string url, std::string uuid, std::string defaultMessage, int retryCount);
@@ -166,19 +181,27 @@ class gtBase
    private:
       attributeEntry attributes[CSR_ATTRIBUTE_ENTRY_COUNT];
       opMode _operatingMode;
+      std::string _certCacheDir;   // empty if signed certificates are not cached
 
       bool _successfulTrackerComms;
 
+      std::deque <libtorrent::alert *> _alertBatch;   // reused by checkAlerts ()
+
       static void loggingCallBack (std::string);
 
       std::string getHttpErrorMessage (int code);
 
-      bool generateCSR (std::string uuid);
-      bool acquireSignedCSR (std::string info_hash, std::string CSRsigningURL, std::string uuid);
+      bool generateCSR (std::string uuid, std::string &csrData);
       void processSSLError (std::string message);
       void initSSLattributes ();
-      std::string loadCSRfile (std::string csrFileName);
       std::string getInfoHash (libtorrent::torrent_info *torrentInfo);
+      void setCertCacheDir ();
+      std::string certCacheEntry (std::string info_hash);
+      bool loadCachedCert (std::string info_hash, std::string uuid);
+      void storeCachedCert (std::string info_hash, std::string uuid);
+      void pruneCertCache ();
+      bool certificateUsable (std::string certFile, std::string keyFile);
+      bool copyFileAtomically (std::string source, std::string destination);
       std::string authTokenFromURI (std::string url);
       void loadCredentialFile (std::string credsPathAndFile);
 
@@ -186,6 +209,7 @@ class gtBase
       void setTempDir ();
       void mkTempDir ();
       
+      uint32_t alertMask ();
       void processUnimplementedAlert (bool haveError, libtorrent::alert *alrt);
       void processPeerNotification (bool haveError, libtorrent::alert *alrt);
       void processDebugNotification (bool haveError, libtorrent::alert *alrt);
@@ -206,6 +230,8 @@ class gtBase
       bool _allowedServersSet;
       std::string _authToken;
       bool _curlVerifySSL;
+      bool _directIO;              // GTO files bypass the page cache
+      gtHttpClient _httpClient;    // shared by all calls to the Executive and security API
       int _exposedPortDelta;
       int _inactiveTimeout;        // amount of time (in minutes) after
                                    // which downloads and uploads are
@@ -227,9 +253,10 @@ class gtBase
                                    // value is performed in
                                    // processCfgCli_RateLimit()
 
-      bool _use_null_storage;      // Null and Zero storage are
-      bool _use_zero_storage;      // mutually exclusive. Neither
-                                   // should be used in production.
+      bool _use_null_storage;      // Null, Zero, io_uring and mmap
+      bool _use_zero_storage;      // storage are mutually exclusive.
+      bool _use_uring_storage;     // Neither Null nor Zero should
+      bool _use_mmap_storage;      // be used in production.
 
    private:
       std::string _bindIP;
@@ -243,5 +270,7 @@ class gtBase
                                    // classes
       int _peerTimeout;            // peer timeout in seconds for
                                    // libtorrent session settings
+      std::string _sslCiphers;     // OpenSSL cipher list for peer
+                                   // connections, empty for the default
 };
 #endif /* GT_BASE_H_ */
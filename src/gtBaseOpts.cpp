@@ -46,6 +46,9 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
 namespace bpo = boost::program_options;
 namespace bfs = boost::filesystem;
 
@@ -79,6 +82,7 @@ gtBaseOpts::gtBaseOpts (std::string progName, std::string usage_msg_hdr, std::st
     m_resourceDir (RESOURCE_DIR_DEFAULT),
     m_credentialPath (""),
     m_curlVerifySSL (true),
+    m_directIO (false),
     m_exposedIP (""),
     m_exposedPortDelta (0),
     m_inactiveTimeout (0),
@@ -87,11 +91,14 @@ gtBaseOpts::gtBaseOpts (std::string progName, std::string usage_msg_hdr, std::st
     m_logMask (0),
     m_logToStdErr (false),
     m_peerTimeout (0),
+    m_sslCiphers (""),
     m_portEnd (20900),
     m_portStart (20892),
     m_rateLimit (-1),
     m_use_null_storage (false),
-    m_use_zero_storage (false)
+    m_use_zero_storage (false),
+    m_use_uring_storage (false),
+    m_use_mmap_storage (false)
 {
 }
 
@@ -350,6 +357,8 @@ gtBaseOpts::add_options ()
         (OPT_INTERNAL_PORT     ",i", opt_string(), "Local IP port to bind on.")
         (OPT_LOGGING           ",l", opt_string(), "Path/file to log file, follow"
                                                    " by the log level.")
+        (OPT_LOG_OVERFLOW,           opt_string(), "When a log file falls behind, 'block' or"
+                                                   " 'drop' messages.")
         (OPT_RATE_LIMIT        ",r", opt_float(),  "Transfer rate limiter in MB/s.")
         (OPT_TIMESTAMP         ",t",               "Add timestamps to messages"
                                                    " logged to the screen.")
@@ -359,6 +368,7 @@ gtBaseOpts::add_options ()
         (OPT_CURL_NO_VERIFY_SSL,                   "Do not verify SSL certificates"
                                                    " of web services.")
         (OPT_PEER_TIMEOUT,           opt_int(),    "Set libtorrent peer timeout in seconds.")
+        (OPT_SSL_CIPHERS,            opt_string(), "OpenSSL cipher list for transfers.")
         (OPT_NO_USER_CFG_FILE,                     "Do not allow users to specify a config file.")
         (OPT_ALLOWED_MODES,          opt_string(), "Allowed modes in this GeneTorrent"
                                                    " installation.")
@@ -394,6 +404,8 @@ gtBaseOpts::add_options ()
         m_cli_desc.add_options ()
             (OPT_NULL_STORAGE,                     "Enable use of null storage.")
             (OPT_ZERO_STORAGE,                     "Enable use of zero storage.")
+            (OPT_URING_STORAGE,                    "Read and write GTO files through io_uring.")
+            (OPT_MMAP_STORAGE,                     "Read GTO files through memory mappings.")
             ;
     }
     add_desc (m_cli_desc, VISIBLE, CLI_ONLY);
@@ -426,6 +438,13 @@ gtBaseOpts::add_options_hidden (const char app)
             ;
     }
 
+    if (app != 'D' && app != 'S')
+    {
+        hidden_desc.add_options ()
+            (OPT_DIRECT_IO,                           "hidden, ignored")
+            ;
+    }
+
     if (app != 'S')
     {
         hidden_desc.add_options ()
@@ -471,6 +490,7 @@ gtBaseOpts::processOptions ()
     processOption_Timestamps ();
     processOption_StorageFlags ();
     processOption_PeerTimeout ();
+    processOption_SslCiphers ();
     processOption_AllowedServers ();
     processOption_AllowedMode ();
 }
@@ -697,6 +717,25 @@ gtBaseOpts::processOption_Log ()
         }
     }
 
+    if (m_vm.count (OPT_LOG_OVERFLOW))
+    {
+        std::string overflow = m_vm[OPT_LOG_OVERFLOW].as<std::string>();
+
+        if ("drop" == overflow)
+        {
+            gtLogger::set_overflow_policy (LOG_OVERFLOW_DROP);
+        }
+        else if ("block" == overflow)
+        {
+            gtLogger::set_overflow_policy (LOG_OVERFLOW_BLOCK);
+        }
+        else
+        {
+            commandLineError ("Invalid value '" + overflow + "' for '"
+                              OPT_LOG_OVERFLOW "', use 'block' or 'drop'.");
+        }
+    }
+
     m_logToStdErr = gtLogger::create_globallog (m_progName, m_logDestination);
 }
 
@@ -766,6 +805,16 @@ gtBaseOpts::processOption_InactiveTimeout ()
     m_inactiveTimeout = inactiveTimeout;
 }
 
+// Used by download and server modes
+void
+gtBaseOpts::processOption_DirectIO ()
+{
+    if (m_vm.count (OPT_DIRECT_IO))
+    {
+        m_directIO = true;
+    }
+}
+
 void
 gtBaseOpts::processOption_SecurityAPI ()
 {
@@ -821,11 +870,28 @@ gtBaseOpts::processOption_StorageFlags ()
         m_use_zero_storage = true;
     }
 
-    if (m_use_null_storage && m_use_zero_storage)
+    if (m_vm.count (OPT_URING_STORAGE))
     {
-        commandLineError ("Use of both '--" OPT_NULL_STORAGE "' and '--"
-                          OPT_ZERO_STORAGE "' options at same time is not"
-                          " allowed.");
+        m_use_uring_storage = true;
+    }
+
+    if (m_vm.count (OPT_MMAP_STORAGE))
+    {
+        // A download writes the files that would be mapped, only seeding
+        // reads complete files.
+        if (m_mode == "DOWNLOAD")
+        {
+            commandLineError ("'--" OPT_MMAP_STORAGE "' may only be used with gtserver or gtupload.");
+        }
+
+        m_use_mmap_storage = true;
+    }
+
+    if (m_use_null_storage + m_use_zero_storage + m_use_uring_storage + m_use_mmap_storage > 1)
+    {
+        commandLineError ("Only one of the '--" OPT_NULL_STORAGE "', '--"
+                          OPT_ZERO_STORAGE "', '--" OPT_URING_STORAGE "' and '--"
+                          OPT_MMAP_STORAGE "' options may be used at the same time.");
     }
 }
 
@@ -838,6 +904,30 @@ gtBaseOpts::processOption_PeerTimeout ()
     }
 }
 
+// The list is checked against the OpenSSL in use here, libtorrent would
+// silently fall back to its default policy
+void
+gtBaseOpts::processOption_SslCiphers ()
+{
+    if (m_vm.count (OPT_SSL_CIPHERS) < 1)
+        return;
+
+    m_sslCiphers = m_vm[OPT_SSL_CIPHERS].as<std::string>();
+
+    SSL_library_init ();
+    SSL_CTX *ctx = SSL_CTX_new (SSLv23_method ());
+
+    if (ctx == NULL)
+        return;
+
+    int supported = SSL_CTX_set_cipher_list (ctx, m_sslCiphers.c_str ());
+    SSL_CTX_free (ctx);
+    ERR_clear_error ();
+
+    if (supported != 1)
+        commandLineError ("'--" OPT_SSL_CIPHERS "' does not contain any cipher supported by OpenSSL: " + m_sslCiphers);
+}
+
 // Checks whether an IP address string is valid, exits with command line error
 // if it is not
 void
@@ -101,6 +101,7 @@ protected:
     std::string processOption_Path ();
     void processOption_InactiveTimeout ();
     void processOption_SecurityAPI ();
+    void processOption_DirectIO ();
 
 private:
     void displayHelp ();
@@ -124,6 +125,7 @@ private:
     void processOption_CurlNoVerifySSL ();
     void processOption_InternalPort ();
     void processOption_PeerTimeout ();
+    void processOption_SslCiphers ();
     void processOption_StorageFlags ();
     void processOption_Timestamps ();
     void processOption_Verbosity ();
@@ -148,6 +150,7 @@ public:
     std::string m_credentialPath;
     std::string m_csrSigningUrl;
     bool m_curlVerifySSL;
+    bool m_directIO;
     std::string m_exposedIP;
     int m_exposedPortDelta;
     int m_inactiveTimeout;
@@ -156,11 +159,14 @@ public:
     int m_logMask;
     bool m_logToStdErr;
     int m_peerTimeout;
+    std::string m_sslCiphers;
     int m_portEnd;
     int m_portStart;
     long m_rateLimit;
     bool m_use_null_storage;
     bool m_use_zero_storage;
+    bool m_use_uring_storage;
+    bool m_use_mmap_storage;
 };
 
 #endif  // BASE_OPTS_HPP
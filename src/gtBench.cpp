@@ -0,0 +1,726 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ */
+
+/*
+ * gtBench.cpp
+ *
+ * Loopback transfer benchmark.
+ *
+ * Builds a torrent in memory and transfers it over the loopback interface
+ * from seeder sessions configured like gtserver to downloader sessions
+ * configured like gtdownload.  Each downloader is split into children that
+ * download a range of pieces each, the way gtdownload splits a GTO.  The
+ * seeders' addresses are handed to the downloaders directly, standing in for
+ * the tracker, so no GeneTorrent Executive or CSR signing is involved.
+ *
+ * The data is zeros for zero and null storage and a fixed pseudo-random
+ * pattern for files (file, uring and mmap storage), so runs with the same options
+ * transfer the same bytes.  Every run prints one line, as JSON or CSV:
+ * throughput, the CPU time of the process (seeders and downloaders together)
+ * per GB transferred, the payload copies per byte the downloaders received,
+ * the time each child took to its first complete piece and to completion,
+ * and how much the page cache grew during the run.
+ */
+
+#include "gt_config.h"
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include "libtorrent/session.hpp"
+#include "libtorrent/create_torrent.hpp"
+#include "libtorrent/torrent_info.hpp"
+#include "libtorrent/bencode.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/file.hpp"
+
+#include "gtBase.h"
+#include "gtLog.h"
+#include "gtZeroStorage.h"
+#include "gtNullStorage.h"
+#include "gtUringStorage.h"
+#include "gtMmapStorage.h"
+
+namespace po = boost::program_options;
+
+typedef struct benchConfig_
+{
+   int sizeMB;
+   int pieceSizeKB;
+   int files;
+   int seeders;
+   int downloaders;
+   int children;
+   int runs;
+   int timeout;                 // seconds per run
+   std::string storage;         // zero, null, file, uring, or mmap
+   std::string path;            // working directory for files and SSL certs
+   std::string format;          // json or csv
+   bool ssl;
+   bool directIO;               // like gtdownload and gtserver --direct-io
+} benchConfig;
+
+typedef struct childResult_
+{
+   libtorrent::session *session;
+   libtorrent::torrent_handle handle;
+   int64_t wanted;
+   double firstPieceMs;         // < 0 until the first piece completed
+   double completeMs;           // < 0 until all wanted pieces completed
+} childResult;
+
+static double elapsedMs (struct timeval &start, struct timeval &end)
+{
+   return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+}
+
+static double cpuSeconds ()
+{
+   struct rusage usage;
+   getrusage (RUSAGE_SELF, &usage);
+
+   return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+// The size of the page cache in MiB, -1 where /proc/meminfo isn't there
+static double pageCacheMB ()
+{
+   std::ifstream meminfo ("/proc/meminfo");
+   std::string name;
+   long long kB;
+
+   while (meminfo >> name >> kB)
+   {
+      if (name == "Cached:")
+      {
+         return kB / 1024.0;
+      }
+
+      meminfo.ignore (256, '\n');
+   }
+
+   return -1;
+}
+
+static double median (std::vector <double> values)
+{
+   if (values.empty ())
+   {
+      return -1;
+   }
+
+   std::sort (values.begin (), values.end ());
+
+   return values[values.size () / 2];
+}
+
+static void benchError (std::string message)
+{
+   std::cerr << "gtbench: " << message << std::endl;
+   exit (9);
+}
+
+// A self-signed certificate serves as the root certificate of the torrent
+// and as the certificate of every peer
+static void makeCertificate (std::string certFile, std::string keyFile, std::string &certPem)
+{
+   EVP_PKEY *pKey = EVP_PKEY_new ();
+   RSA *rsaKey = RSA_generate_key (RSA_KEY_SIZE, RSA_F4, NULL, NULL);
+   X509 *cert = X509_new ();
+
+   if (!pKey || !rsaKey || !cert || !EVP_PKEY_assign_RSA (pKey, rsaKey))
+   {
+      benchError ("unable to generate an SSL key");
+   }
+
+   X509_set_version (cert, 2);
+   ASN1_INTEGER_set (X509_get_serialNumber (cert), 1);
+   X509_gmtime_adj (X509_get_notBefore (cert), -3600);
+   X509_gmtime_adj (X509_get_notAfter (cert), 24 * 3600);
+   X509_set_pubkey (cert, pKey);
+
+   X509_NAME *name = X509_get_subject_name (cert);
+   X509_NAME_add_entry_by_txt (name, "CN", MBSTRING_ASC, (const unsigned char *) "gtbench", -1, -1, 0);
+   X509_set_issuer_name (cert, name);
+
+   if (!X509_sign (cert, pKey, EVP_sha256 ()))
+   {
+      benchError ("unable to sign the SSL certificate");
+   }
+
+   FILE *certFp = fopen (certFile.c_str (), "w");
+   FILE *keyFp = fopen (keyFile.c_str (), "w");
+
+   if (!certFp || !keyFp || !PEM_write_X509 (certFp, cert) || !PEM_write_PrivateKey (keyFp, pKey, NULL, NULL, 0, NULL, NULL))
+   {
+      benchError ("unable to write " + certFile + " or " + keyFile);
+   }
+
+   fclose (certFp);
+   fclose (keyFp);
+
+   BIO *bio = BIO_new (BIO_s_mem ());
+   PEM_write_bio_X509 (bio, cert);
+   char *data;
+   long size = BIO_get_mem_data (bio, &data);
+   certPem.assign (data, size);
+   BIO_free (bio);
+
+   X509_free (cert);
+   EVP_PKEY_free (pKey);
+}
+
+// File, uring and mmap storage read and write real files, uring through
+// io_uring and mmap reading through memory mappings
+static bool filesOnDisk (benchConfig &config)
+{
+   return config.storage == "file" || config.storage == "uring" || config.storage == "mmap";
+}
+
+// Writes the files seeded in file storage mode, the same bytes every time
+static void makeSeedFiles (libtorrent::file_storage &fs, std::string seedPath)
+{
+   std::vector <char> buffer (1024 * 1024);
+   uint32_t state = 2463534242u;
+
+   for (int fileIndex = 0; fileIndex < fs.num_files (); fileIndex++)
+   {
+      std::string fileName = libtorrent::combine_path (seedPath, fs.at (fileIndex).path);
+      boost::filesystem::create_directories (libtorrent::parent_path (fileName));
+
+      std::ofstream out (fileName.c_str (), std::ios::binary | std::ios::trunc);
+      libtorrent::size_type remaining = fs.at (fileIndex).size;
+
+      while (remaining > 0 && out)
+      {
+         for (std::vector <char>::size_type i = 0; i < buffer.size (); i += 4)
+         {
+            // xorshift32
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            memcpy (&buffer[i], &state, 4);
+         }
+
+         int chunk = remaining < (libtorrent::size_type) buffer.size () ? (int) remaining : buffer.size ();
+         out.write (&buffer[0], chunk);
+         remaining -= chunk;
+      }
+
+      if (!out)
+      {
+         benchError ("unable to write " + fileName);
+      }
+   }
+}
+
+static boost::intrusive_ptr <libtorrent::torrent_info> makeTorrent (benchConfig &config, std::string seedPath, std::string certPem)
+{
+   libtorrent::file_storage fs;
+   int64_t totalSize = (int64_t) config.sizeMB * 1024 * 1024;
+
+   for (int fileIndex = 0; fileIndex < config.files; fileIndex++)
+   {
+      char fileName[64];
+      snprintf (fileName, sizeof (fileName), "gtbench/data-%d", fileIndex);
+
+      int64_t fileSize = totalSize / config.files + (fileIndex < totalSize % config.files ? 1 : 0);
+      fs.add_file (fileName, fileSize);
+   }
+
+   libtorrent::create_torrent torrent (fs, config.pieceSizeKB * 1024);
+
+   if (config.ssl)
+   {
+      torrent.set_root_cert (certPem);
+   }
+
+   if (filesOnDisk (config))
+   {
+      makeSeedFiles (fs, seedPath);
+
+      libtorrent::error_code ec;
+      libtorrent::set_piece_hashes (torrent, seedPath, ec);
+
+      if (ec)
+      {
+         benchError ("unable to hash " + seedPath + ":  " + ec.message ());
+      }
+   }
+   else
+   {
+      // every piece but the last holds the same zeros
+      std::vector <char> zeros (torrent.piece_length (), 0);
+      libtorrent::sha1_hash pieceHash = libtorrent::hasher (&zeros[0], zeros.size ()).final ();
+
+      for (int piece = 0; piece < torrent.num_pieces (); piece++)
+      {
+         if (torrent.piece_size (piece) == torrent.piece_length ())
+         {
+            torrent.set_hash (piece, pieceHash);
+         }
+         else
+         {
+            torrent.set_hash (piece, libtorrent::hasher (&zeros[0], torrent.piece_size (piece)).final ());
+         }
+      }
+   }
+
+   std::vector <char> buffer;
+   libtorrent::bencode (std::back_inserter (buffer), torrent.generate ());
+
+   libtorrent::error_code ec;
+   boost::intrusive_ptr <libtorrent::torrent_info> torrentInfo = new libtorrent::torrent_info (&buffer[0], buffer.size (), ec);
+
+   if (ec)
+   {
+      benchError ("unable to load the generated torrent:  " + ec.message ());
+   }
+
+   return torrentInfo;
+}
+
+static libtorrent::session *makeSession (benchConfig &config, gtBase::opMode mode)
+{
+   libtorrent::session *session = new libtorrent::session (libtorrent::fingerprint (mode == gtBase::SERVER_MODE ? "Gt" : "GT", 0, 0, 0, 0), 0, libtorrent::alert::error_notification);
+
+   libtorrent::session_settings settings = session->settings ();
+   gtBase::tuneSessionSettings (settings, mode);
+
+   if (config.directIO)
+   {
+      gtBase::directIOSettings (settings, mode, mode == gtBase::SERVER_MODE ? config.seeders : 1);
+   }
+
+   // like gtserver --mmap-storage
+   if (config.storage == "mmap")
+   {
+      settings.use_read_cache = false;
+   }
+
+   if (mode != gtBase::SERVER_MODE && config.storage == "null")
+   {
+      settings.disable_hash_checks = true;
+   }
+
+   session->set_settings (settings);
+
+   libtorrent::error_code ec;
+   session->listen_on (std::make_pair (0, 0), ec, "127.0.0.1");
+
+   if (ec)
+   {
+      benchError ("unable to listen on the loopback interface:  " + ec.message ());
+   }
+
+   return session;
+}
+
+static libtorrent::torrent_handle addTorrent (benchConfig &config, libtorrent::session *session, boost::intrusive_ptr <libtorrent::torrent_info> torrentInfo, std::string savePath, bool seed)
+{
+   libtorrent::add_torrent_params torrentParams;
+   torrentParams.ti = new libtorrent::torrent_info (*torrentInfo);
+   torrentParams.save_path = savePath;
+   torrentParams.auto_managed = false;
+   torrentParams.allow_rfc1918_connections = true;
+
+   if (seed)
+   {
+      torrentParams.seed_mode = true;
+      torrentParams.disable_seed_hash = true;
+   }
+   else
+   {
+      torrentParams.force_download = true;
+   }
+
+   if (config.storage == "zero")
+   {
+      torrentParams.storage = zero_storage_constructor;
+   }
+   else if (config.storage == "null")
+   {
+      torrentParams.storage = null_storage_constructor;
+   }
+   else if (config.storage == "uring")
+   {
+      torrentParams.storage = uring_storage_constructor;
+   }
+   else if (config.storage == "mmap" && seed)
+   {
+      // like gtdownload, downloaders write through file storage
+      torrentParams.storage = mmap_storage_constructor;
+   }
+
+   libtorrent::error_code ec;
+   libtorrent::torrent_handle handle = session->add_torrent (torrentParams, ec);
+
+   if (ec)
+   {
+      benchError ("unable to add the torrent:  " + ec.message ());
+   }
+
+   if (config.ssl)
+   {
+      handle.set_ssl_certificate (libtorrent::combine_path (config.path, "gtbench.crt"), libtorrent::combine_path (config.path, "gtbench.key"), "");
+   }
+
+   return handle;
+}
+
+static void runBenchmark (benchConfig &config, int run, boost::intrusive_ptr <libtorrent::torrent_info> torrentInfo, std::string seedPath)
+{
+   std::vector <libtorrent::session *> seeders;
+   std::vector <libtorrent::tcp::endpoint> seederEndpoints;
+
+   for (int seeder = 0; seeder < config.seeders; seeder++)
+   {
+      libtorrent::session *session = makeSession (config, gtBase::SERVER_MODE);
+      libtorrent::torrent_handle handle = addTorrent (config, session, torrentInfo, seedPath, true);
+      handle.resume ();
+
+      seeders.push_back (session);
+      seederEndpoints.push_back (libtorrent::tcp::endpoint (libtorrent::address::from_string ("127.0.0.1"), config.ssl ? session->ssl_listen_port () : session->listen_port ()));
+   }
+
+   // the children of a downloader share its save path, like gtdownload's
+   std::vector <childResult> children;
+   int pieces = torrentInfo->num_pieces ();
+   int childrenPerDownloader = std::min (config.children, pieces);
+
+   for (int downloader = 0; downloader < config.downloaders; downloader++)
+   {
+      char dirName[64];
+      snprintf (dirName, sizeof (dirName), "download-%d", downloader);
+      std::string savePath = libtorrent::combine_path (config.path, dirName);
+
+      int chunkSize = pieces / childrenPerDownloader;
+
+      for (int childID = 1; childID <= childrenPerDownloader; childID++)
+      {
+         childResult child;
+         child.session = makeSession (config, gtBase::DOWNLOAD_MODE);
+         child.handle = addTorrent (config, child.session, torrentInfo, savePath, false);
+         child.firstPieceMs = -1;
+         child.completeMs = -1;
+         child.wanted = 0;
+
+         int startPiece = (childID - 1) * chunkSize;
+         int endPiece = childID == childrenPerDownloader ? pieces : childID * chunkSize;
+
+         for (int piece = 0; piece < pieces; piece++)
+         {
+            if (piece < startPiece || piece >= endPiece)
+            {
+               child.handle.piece_priority (piece, 0);
+            }
+            else
+            {
+               child.wanted += torrentInfo->piece_size (piece);
+            }
+         }
+
+         child.handle.set_sequential_download (true);
+         child.handle.set_max_uploads (0);
+
+         children.push_back (child);
+      }
+   }
+
+   struct timeval start;
+   gettimeofday (&start, NULL);
+   double cpuStart = cpuSeconds ();
+   double pageCacheStart = pageCacheMB ();
+   double pageCacheGrowth = 0;
+   int polls = 0;
+
+   for (std::vector <childResult>::iterator childIter = children.begin (); childIter != children.end (); childIter++)
+   {
+      childIter->handle.resume ();
+
+      for (std::vector <libtorrent::tcp::endpoint>::iterator epIter = seederEndpoints.begin (); epIter != seederEndpoints.end (); epIter++)
+      {
+         childIter->handle.connect_peer (*epIter);
+      }
+   }
+
+   int64_t transferred = 0;
+   int pending = children.size ();
+   struct timeval now = start;
+
+   while (pending > 0 && elapsedMs (start, now) < config.timeout * 1000.0)
+   {
+      usleep (5000);
+      gettimeofday (&now, NULL);
+
+      // how far the run pushed the page cache, sampled about every 100 ms
+      if (pageCacheStart >= 0 && ++polls % 20 == 0)
+      {
+         pageCacheGrowth = std::max (pageCacheGrowth, pageCacheMB () - pageCacheStart);
+      }
+
+      for (std::vector <childResult>::iterator childIter = children.begin (); childIter != children.end (); childIter++)
+      {
+         if (childIter->completeMs >= 0)
+         {
+            continue;
+         }
+
+         libtorrent::torrent_status status = childIter->handle.status (0);
+
+         if (childIter->firstPieceMs < 0 && status.total_wanted_done > 0)
+         {
+            childIter->firstPieceMs = elapsedMs (start, now);
+         }
+
+         if (status.total_wanted_done >= childIter->wanted)
+         {
+            childIter->completeMs = elapsedMs (start, now);
+            pending--;
+         }
+      }
+   }
+
+   struct timeval end;
+   gettimeofday (&end, NULL);
+   double cpu = cpuSeconds () - cpuStart;
+
+   std::vector <double> firstPiece;
+   std::vector <double> complete;
+   libtorrent::size_type payloadReceived = 0;
+   libtorrent::size_type payloadCopied = 0;
+
+   for (std::vector <childResult>::iterator childIter = children.begin (); childIter != children.end (); childIter++)
+   {
+      transferred += childIter->handle.status (0).total_wanted_done;
+
+      libtorrent::session_status sessionStatus = childIter->session->status ();
+      payloadReceived += sessionStatus.total_payload_download;
+      payloadCopied += sessionStatus.total_payload_copied;
+
+      if (childIter->firstPieceMs >= 0)
+      {
+         firstPiece.push_back (childIter->firstPieceMs);
+      }
+
+      if (childIter->completeMs >= 0)
+      {
+         complete.push_back (childIter->completeMs);
+      }
+   }
+
+   // sessions are torn down outside of the measurement
+   for (std::vector <childResult>::iterator childIter = children.begin (); childIter != children.end (); childIter++)
+   {
+      delete childIter->session;
+   }
+
+   for (std::vector <libtorrent::session *>::iterator seedIter = seeders.begin (); seedIter != seeders.end (); seedIter++)
+   {
+      delete *seedIter;
+   }
+
+   if (filesOnDisk (config))
+   {
+      for (int downloader = 0; downloader < config.downloaders; downloader++)
+      {
+         char dirName[64];
+         snprintf (dirName, sizeof (dirName), "download-%d", downloader);
+         boost::filesystem::remove_all (libtorrent::combine_path (config.path, dirName));
+      }
+   }
+
+   double seconds = elapsedMs (start, end) / 1000.0;
+   double throughput = transferred / seconds / 1000000.0;
+   double cpuPerGB = transferred > 0 ? cpu / (transferred / 1000000000.0) : -1;
+   double firstPieceMax = firstPiece.empty () ? -1 : *std::max_element (firstPiece.begin (), firstPiece.end ());
+   double completeMax = complete.empty () ? -1 : *std::max_element (complete.begin (), complete.end ());
+   double copiesPerByte = payloadReceived > 0 ? double (payloadCopied) / payloadReceived : 0;
+   bool completed = pending == 0;
+
+   char line[1024];
+
+   if (config.format == "csv")
+   {
+      if (run == 1)
+      {
+         printf ("run,storage,ssl,direct_io,size_mb,piece_kb,files,seeders,downloaders,children,completed,bytes,seconds,"
+                 "throughput_mbps,cpu_seconds,cpu_seconds_per_gb,copies_per_byte,first_piece_ms_median,first_piece_ms_max,"
+                 "complete_ms_median,complete_ms_max,page_cache_growth_mb\n");
+      }
+
+      snprintf (line, sizeof (line), "%d,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%lld,%.3f,%.1f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f",
+                run, config.storage.c_str (), config.ssl, config.directIO, config.sizeMB, config.pieceSizeKB, config.files,
+                config.seeders, config.downloaders, childrenPerDownloader, completed, (long long) transferred, seconds, throughput,
+                cpu, cpuPerGB, copiesPerByte, median (firstPiece), firstPieceMax, median (complete), completeMax, pageCacheGrowth);
+   }
+   else
+   {
+      snprintf (line, sizeof (line), "{\"run\": %d, \"storage\": \"%s\", \"ssl\": %s, \"direct_io\": %s, \"size_mb\": %d, "
+                "\"piece_kb\": %d, \"files\": %d, \"seeders\": %d, \"downloaders\": %d, \"children\": %d, \"completed\": %s, "
+                "\"bytes\": %lld, \"seconds\": %.3f, \"throughput_mbps\": %.1f, \"cpu_seconds\": %.3f, "
+                "\"cpu_seconds_per_gb\": %.3f, \"copies_per_byte\": %.3f, \"first_piece_ms_median\": %.1f, \"first_piece_ms_max\": %.1f, "
+                "\"complete_ms_median\": %.1f, \"complete_ms_max\": %.1f, \"page_cache_growth_mb\": %.1f}",
+                run, config.storage.c_str (), config.ssl ? "true" : "false", config.directIO ? "true" : "false", config.sizeMB,
+                config.pieceSizeKB, config.files, config.seeders, config.downloaders, childrenPerDownloader,
+                completed ? "true" : "false", (long long) transferred, seconds, throughput, cpu, cpuPerGB, copiesPerByte,
+                median (firstPiece), firstPieceMax, median (complete), completeMax, pageCacheGrowth);
+   }
+
+   printf ("%s\n", line);
+   fflush (stdout);
+}
+
+static void checkRange (const char *option, int value, int low, int high)
+{
+   if (value < low || value > high)
+   {
+      char message[256];
+      snprintf (message, sizeof (message), "'--%s' is out of range, use %d to %d.", option, low, high);
+      benchError (message);
+   }
+}
+
+int main (int argc, char **argv)
+{
+   benchConfig config;
+
+   po::options_description desc ("gtbench options");
+   desc.add_options ()
+      ("help,h",                                                                     "Show this help.")
+      ("size",        po::value<int>(&config.sizeMB)->default_value (1024),          "Size of the torrent in MiB.")
+      ("piece-size",  po::value<int>(&config.pieceSizeKB)->default_value (4096),     "Piece size in KiB, a power of 2.")
+      ("files",       po::value<int>(&config.files)->default_value (1),              "Number of files in the torrent.")
+      ("seeders",     po::value<int>(&config.seeders)->default_value (1),            "Number of seeder sessions.")
+      ("downloaders", po::value<int>(&config.downloaders)->default_value (1),        "Number of downloaders.")
+      ("children",    po::value<int>(&config.children)->default_value (8),           "Children per downloader, like gtdownload --max-children.")
+      ("storage",     po::value<std::string>(&config.storage)->default_value ("zero"), "zero, null, file, uring, or mmap.")
+      ("ssl",                                                                        "Transfer over SSL.")
+      ("direct-io",                                                                  "Bypass the page cache, like gtdownload and gtserver --direct-io.")
+      ("runs",        po::value<int>(&config.runs)->default_value (3),               "Number of runs.")
+      ("timeout",     po::value<int>(&config.timeout)->default_value (600),          "Seconds before a run is abandoned.")
+      ("path",        po::value<std::string>(&config.path)->default_value ("gtbench.tmp"), "Working directory for files and SSL certificates.")
+      ("format",      po::value<std::string>(&config.format)->default_value ("json"), "json or csv.")
+      ;
+
+   po::variables_map vm;
+
+   try
+   {
+      po::store (po::parse_command_line (argc, argv, desc), vm);
+      po::notify (vm);
+   }
+   catch (std::exception &e)
+   {
+      benchError (e.what ());
+   }
+
+   if (vm.count ("help"))
+   {
+      std::cout << desc << std::endl;
+      return 0;
+   }
+
+   config.ssl = vm.count ("ssl") > 0;
+   config.directIO = vm.count ("direct-io") > 0;
+
+   checkRange ("size", config.sizeMB, 1, 1024 * 1024);
+   checkRange ("piece-size", config.pieceSizeKB, 16, 64 * 1024);
+   checkRange ("files", config.files, 1, 10000);
+   checkRange ("seeders", config.seeders, 1, 100);
+   checkRange ("downloaders", config.downloaders, 1, 100);
+   checkRange ("children", config.children, 1, 64);
+   checkRange ("runs", config.runs, 1, 1000);
+   checkRange ("timeout", config.timeout, 1, 24 * 3600);
+
+   if ((config.pieceSizeKB & (config.pieceSizeKB - 1)) != 0)
+   {
+      benchError ("'--piece-size' must be a power of 2.");
+   }
+
+   if (config.storage != "zero" && config.storage != "null" && !filesOnDisk (config))
+   {
+      benchError ("'--storage' must be zero, null, file, uring, or mmap.");
+   }
+
+   if (config.format != "json" && config.format != "csv")
+   {
+      benchError ("'--format' must be json or csv.");
+   }
+
+   gtLogger::create_globallog ("gtbench", "none");
+
+   boost::system::error_code ec;
+   boost::filesystem::create_directories (config.path, ec);
+
+   if (ec)
+   {
+      benchError ("unable to create " + config.path + ":  " + ec.message ());
+   }
+
+   std::string certPem;
+
+   if (config.ssl)
+   {
+      makeCertificate (libtorrent::combine_path (config.path, "gtbench.crt"), libtorrent::combine_path (config.path, "gtbench.key"), certPem);
+   }
+
+   std::string seedPath = libtorrent::combine_path (config.path, "seed");
+   boost::intrusive_ptr <libtorrent::torrent_info> torrentInfo = makeTorrent (config, seedPath, certPem);
+
+   for (int run = 1; run <= config.runs; run++)
+   {
+      runBenchmark (config, run, torrentInfo, seedPath);
+   }
+
+   boost::filesystem::remove_all (config.path, ec);
+
+   gtLogger::delete_globallog ();
+
+   return 0;
+}
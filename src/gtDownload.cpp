@@ -73,6 +73,7 @@
 #include "gtDownload.h"
 #include "gtNullStorage.h"
 #include "gtZeroStorage.h"
+#include "gtUringStorage.h"
 
 static char const* download_state_str[] = {
    "checking (q)",            // queued_for_checking,
@@ -240,7 +241,7 @@ bool gtDownload::downloadGTO (std::string uri, std::string fileName, std::string
 
    bool curl_status;
    CURL *curl;
-   curl = curl_easy_init ();
+   curl = _httpClient.acquireHandle ();
 
    if (!curl)
    {
@@ -263,24 +264,11 @@ bool gtDownload::downloadGTO (std::string uri, std::string fileName, std::string
 
    std::string curlResponseHeaders = "";
 
-   if (!_curlVerifySSL)
-   {
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYPEER, 0);
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYHOST, 0);
-   }
-
    curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, errorBuffer);
    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, NULL);
    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, &curlCallBackHeadersWriter);
-   curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 15);
    curl_easy_setopt (curl, CURLOPT_WRITEDATA, gtoFile);
    curl_easy_setopt (curl, CURLOPT_WRITEHEADER, &curlResponseHeaders);
-   curl_easy_setopt (curl, CURLOPT_NOSIGNAL, (long)1);
-#ifdef __CYGWIN__
-   std::string winInst = getWinInstallDirectory () + "/cacert.pem";
-   curl_easy_setopt (curl, CURLOPT_CAINFO, winInst.c_str ());
-#endif /* __CYGWIN__ */
-
    curl_easy_setopt (curl, CURLOPT_POST, (long)1);
 
    struct curl_httppost *post=NULL;
@@ -289,26 +277,19 @@ bool gtDownload::downloadGTO (std::string uri, std::string fileName, std::string
    curl_formadd (&post, &last, CURLFORM_COPYNAME, "token", CURLFORM_COPYCONTENTS, _authToken.c_str(), CURLFORM_END);
 
    curl_easy_setopt (curl, CURLOPT_HTTPPOST, post);
-
-   // CGHUBDEV-22: Set CURL timeouts to 20 seconds
-   int timeoutVal = 20;
-   int connTime = 20;
-
    curl_easy_setopt (curl, CURLOPT_URL, uri.c_str());
-   curl_easy_setopt (curl, CURLOPT_TIMEOUT, timeoutVal);
-   curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, connTime);
 
    CURLcode res;
 
    res = curl_easy_perform (curl);
 
-   if (res == CURLE_SSL_CONNECT_ERROR || res == CURLE_OPERATION_TIMEDOUT)
+   if (gtHttpClient::retryable (res) && retryCount > 0)
    {
       // Only retry on SSL connect errors or timeouts in case the
       // other end is temporarily overloaded.
 
       // Give the other end time to become less loaded.
-      sleep (2);
+      _httpClient.backoff (GTO_DOWNLOAD_RETRIES - 1 - retryCount);
    }
 
    fclose (gtoFile);
@@ -318,7 +299,7 @@ bool gtDownload::downloadGTO (std::string uri, std::string fileName, std::string
    curl_status = processCurlResponse (curl, res, tmpFileName, uri, torrUUID, "Problem communicating with GeneTorrent Executive while trying to retrieve GTO for UUID:", retryCount);
 
    curl_formfree(post);
-   curl_easy_cleanup (curl);
+   _httpClient.releaseHandle (curl);
 
    if (curl_status)
    {
@@ -371,7 +352,7 @@ std::string gtDownload::downloadGtoFileByURI (std::string uri, std::string desti
    std::string torrUUID = fileName;
    fileName += GTO_FILE_EXTENSION;
 
-   int retries = 5;
+   int retries = GTO_DOWNLOAD_RETRIES;
 
    while (retries > 0)
    {
@@ -530,6 +511,11 @@ std::string gtDownload::spawnDownloadChildren (childMap &pidList, std::string to
       _resumedDownload = true;
    }
 
+   if (_rateLimit > 0 && !_rateShare.create (_rateLimit, childrenThisGTO))
+   {
+      gtError ("Unable to share the rate limit between download children, splitting it evenly", ERROR_NO_EXIT, ERRNO_ERROR, errno);
+   }
+
    while (childID <= childrenThisGTO)      // Spawn Children that will download this GTO
    {
       if (pipe (pipes[childID]) < 0)
@@ -696,6 +682,7 @@ void gtDownload::performSingleTorrentDownload (std::string torrentName, int64_t
                gtError (buffer, 207, DEFAULT_ERROR);
             }
 
+            _rateShare.release (pidListIter->second->childID - 1);
             totalDataDownloaded += pidListIter->second->dataDownloaded;
             timeout_update (&lastActivity);
             fclose (pidListIter->second->pipeHandle);
@@ -752,6 +739,8 @@ void gtDownload::performSingleTorrentDownload (std::string torrentName, int64_t
       totalXfer = totalDataDownloaded + xfer;
    }
 
+   _rateShare.destroy ();
+
    std::string uuid = torrentName;
    uuid = uuid.substr (0, uuid.rfind ('.'));
    uuid = getFileName (uuid); 
@@ -832,6 +821,15 @@ void gtDownload::performTorrentDownloadsByURI (int64_t &totalBytes, int &totalFi
    }
 }
 
+void gtDownload::processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates)
+{
+   // a download child's session holds a single torrent
+   if (!statusUpdates.empty ())
+   {
+      _childTorrentStatus = statusUpdates.back ();
+   }
+}
+
 int gtDownload::downloadChild (int childID, int totalChildren, std::string torrentName, FILE *fd, std::string tempDownloadPath)
 {
    gtLogger::delete_globallog();
@@ -870,6 +868,10 @@ int gtDownload::downloadChild (int childID, int totalChildren, std::string torre
    {
       torrentParams.storage = zero_storage_constructor;
    }
+   else if (_use_uring_storage)
+   {
+      torrentParams.storage = uring_storage_constructor;
+   }
    else if (_use_null_storage)
    {
       torrentParams.storage = null_storage_constructor;
@@ -964,7 +966,13 @@ std::cerr << "setting name to: " << (torrentParams.ti->name() + TEMP_DOWNLOAD_LO
 
    torrentHandle.resume();
 
-   libtorrent::torrent_status::state_t currentState = torrentHandle.status().state;
+   // Status is polled in bulk with post_torrent_updates (), the replies
+   // are cached in _childTorrentStatus by checkAlerts ()
+   _childTorrentStatus = torrentHandle.status ();
+
+   libtorrent::torrent_status::state_t currentState = _childTorrentStatus.state;
+   libtorrent::ptime nextRateShare = libtorrent::time_now_hires() + libtorrent::seconds (RATE_SHARE_UPDATE_INTERVAL);
+
    while (currentState != libtorrent::torrent_status::seeding && currentState != libtorrent::torrent_status::finished)
    {
       libtorrent::ptime endMonitoring = libtorrent::time_now_hires() + libtorrent::seconds (5);  // 5 seconds
@@ -972,8 +980,17 @@ std::cerr << "setting name to: " << (torrentParams.ti->name() + TEMP_DOWNLOAD_LO
       while (currentState != libtorrent::torrent_status::seeding && currentState != libtorrent::torrent_status::finished && libtorrent::time_now_hires() < endMonitoring)
       {
          checkAlerts (torrentSession);
+         currentState = _childTorrentStatus.state;
+         torrentSession->post_torrent_updates ();
          usleep(ALERT_CHECK_PAUSE_INTERVAL);
-         currentState = torrentHandle.status().state;
+
+         // Children that are held back by their limit get the bandwidth
+         // the others don't use
+         if (_rateShare.active () && libtorrent::time_now_hires() >= nextRateShare)
+         {
+            torrentHandle.set_download_limit (_rateShare.update (childID - 1, _childTorrentStatus.download_rate));
+            nextRateShare = libtorrent::time_now_hires() + libtorrent::seconds (RATE_SHARE_UPDATE_INTERVAL);
+         }
 
          if (getppid() == 1)   // Parent has died, follow course
          {
@@ -984,8 +1001,7 @@ std::cerr << "setting name to: " << (torrentParams.ti->name() + TEMP_DOWNLOAD_LO
 
       checkAlerts (torrentSession);
 
-      // libtorrent::session_status sessionStatus = torrentSession->status ();
-      libtorrent::torrent_status torrentStatus = torrentHandle.status ();
+      libtorrent::torrent_status &torrentStatus = _childTorrentStatus;
 
       fprintf (fd, "%lld\n", (long long) torrentStatus.total_wanted_done);
       fprintf (fd, "%d\n", torrentStatus.download_payload_rate);
@@ -1000,9 +1016,11 @@ std::cerr << "setting name to: " << (torrentParams.ti->name() + TEMP_DOWNLOAD_LO
       {
          screenOutput ("Child " << childID << " " << download_state_str[torrentStatus.state] << "  " << add_suffix (torrentStatus.total_wanted_done).c_str () << "  (" << add_suffix (torrentStatus.download_payload_rate, "/s").c_str () << ")", VERBOSE_2);
       }
-      currentState = torrentHandle.status().state;
+      currentState = torrentStatus.state;
    }
 
+   _rateShare.release (childID - 1);
+
    checkAlerts (torrentSession);
    torrentSession->remove_torrent (torrentHandle);
 
@@ -39,6 +39,7 @@
 
 #include "gtBase.h"
 #include "gtDownloadOpts.h"
+#include "gtRateShare.h"
 
 class gtDownload : public gtBase
 {
@@ -47,6 +48,7 @@ class gtDownload : public gtBase
       void run ();
 
    protected:
+      void processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates);
 
       std::string downloadGtoFileByURI (std::string uri, std::string destinationPath, bool exitOnMoveFailure);
       std::string _downloadSavePath;
@@ -59,6 +61,8 @@ class gtDownload : public gtBase
       std::string _downloadModeCsrSigningUrl;
       std::string _downloadModeWsiUrl;
       bool _resumedDownload;
+      libtorrent::torrent_status _childTorrentStatus;   // last reported status of a download child's torrent
+      gtRateShare _rateShare;                           // --rate-limit shared between the children of one GTO
 
       void runDownloadMode (std::string startupDir);
       void prepareDownloadList ();
@@ -97,6 +97,7 @@ gtDownloadOpts::add_options ()
     m_dl_desc.add_options ()
         (OPT_MAX_CHILDREN,             opt_int(),    "number of download children")
         (OPT_WEBSERV_URL,           opt_string(),    "Full URL to Repository Web Services Interface")
+        (OPT_DIRECT_IO,                              "bypass the page cache for GTO files")
         ;
     add_desc (m_dl_desc);
 
@@ -134,6 +135,7 @@ gtDownloadOpts::processOptions ()
     processOption_InactiveTimeout ();
     processOption_RateLimit();
     processOption_WSI_URL();
+    processOption_DirectIO ();
 
     m_downloadSavePath = processOption_Path ();
 }
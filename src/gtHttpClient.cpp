@@ -0,0 +1,216 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2012, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtHttpClient.cpp
+ */
+
+#include "gt_config.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gtHttpClient.h"
+#include "gtDefs.h"
+#include "gtUtils.h"
+
+gtHttpClient::gtHttpClient (bool verifySSL):
+   _verifySSL (verifySSL),
+   _ownerPid (getpid ()),
+   _caInfo (""),
+   _share (NULL),
+   _idleHandles (),
+   _jitterSeed (getpid () ^ time (NULL))
+{
+   pthread_mutex_init (&_poolLock, NULL);
+
+   for (int lock = 0; lock < CURL_LOCK_DATA_LAST; lock++)
+   {
+      pthread_mutex_init (&_shareLocks[lock], NULL);
+   }
+
+#ifdef __CYGWIN__
+   _caInfo = getWinInstallDirectory () + "/cacert.pem";
+#endif /* __CYGWIN__ */
+
+   // without a share every handle still keeps its own connections
+   _share = curl_share_init ();
+
+   if (_share)
+   {
+      curl_share_setopt (_share, CURLSHOPT_LOCKFUNC, lockShare);
+      curl_share_setopt (_share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+      curl_share_setopt (_share, CURLSHOPT_USERDATA, this);
+      curl_share_setopt (_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt (_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+      curl_share_setopt (_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+   }
+}
+
+gtHttpClient::~gtHttpClient ()
+{
+   if (getpid () != _ownerPid)
+   {
+      return;
+   }
+
+   for (std::vector <CURL *>::iterator handleIter = _idleHandles.begin (); handleIter != _idleHandles.end (); handleIter++)
+   {
+      curl_easy_cleanup (*handleIter);
+   }
+
+   if (_share)
+   {
+      curl_share_cleanup (_share);
+   }
+
+   for (int lock = 0; lock < CURL_LOCK_DATA_LAST; lock++)
+   {
+      pthread_mutex_destroy (&_shareLocks[lock]);
+   }
+
+   pthread_mutex_destroy (&_poolLock);
+}
+
+CURL *gtHttpClient::acquireHandle ()
+{
+   CURL *curl = NULL;
+
+   pthread_mutex_lock (&_poolLock);
+
+   if (_idleHandles.size () > 0)
+   {
+      curl = _idleHandles.back ();
+      _idleHandles.pop_back ();
+   }
+
+   pthread_mutex_unlock (&_poolLock);
+
+   if (!curl)
+   {
+      curl = curl_easy_init ();
+
+      if (!curl)
+      {
+         return NULL;
+      }
+   }
+
+   if (_share)
+   {
+      curl_easy_setopt (curl, CURLOPT_SHARE, _share);
+   }
+
+   if (!_verifySSL)
+   {
+      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYPEER, 0);
+      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYHOST, 0);
+   }
+
+   if (_caInfo.size () > 0)
+   {
+      curl_easy_setopt (curl, CURLOPT_CAINFO, _caInfo.c_str ());
+   }
+
+   curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 15);
+   curl_easy_setopt (curl, CURLOPT_NOSIGNAL, (long)1);
+
+   // CGHUBDEV-22: Set CURL timeouts to 20 seconds
+   curl_easy_setopt (curl, CURLOPT_TIMEOUT, (long) CURL_TRANSFER_TIMEOUT);
+   curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, (long) CURL_TRANSFER_TIMEOUT);
+
+#if LIBCURL_VERSION_NUM >= 0x071900
+   curl_easy_setopt (curl, CURLOPT_TCP_KEEPALIVE, (long)1);
+#endif
+
+   return curl;
+}
+
+// The handle keeps its connections, options are reset so nothing pointing
+// into the previous caller's stack survives
+void gtHttpClient::releaseHandle (CURL *curl)
+{
+   if (!curl)
+   {
+      return;
+   }
+
+   curl_easy_reset (curl);
+
+   pthread_mutex_lock (&_poolLock);
+
+   if (_idleHandles.size () < (unsigned int) HTTP_CLIENT_MAX_IDLE_HANDLES)
+   {
+      _idleHandles.push_back (curl);
+      curl = NULL;
+   }
+
+   pthread_mutex_unlock (&_poolLock);
+
+   if (curl)
+   {
+      curl_easy_cleanup (curl);
+   }
+}
+
+bool gtHttpClient::retryable (CURLcode result)
+{
+   return result == CURLE_SSL_CONNECT_ERROR || result == CURLE_OPERATION_TIMEDOUT;
+}
+
+void gtHttpClient::backoff (int attempt)
+{
+   long delay = CURL_RETRY_MAX_DELAY_MS;
+
+   if (attempt < 16 && (CURL_RETRY_BASE_DELAY_MS << attempt) < CURL_RETRY_MAX_DELAY_MS)
+   {
+      delay = CURL_RETRY_BASE_DELAY_MS << attempt;
+   }
+
+   pthread_mutex_lock (&_poolLock);
+   long jitter = rand_r (&_jitterSeed) % (delay / 2 + 1);
+   pthread_mutex_unlock (&_poolLock);
+
+   // somewhere between half and all of the delay
+   usleep ((delay / 2 + jitter) * 1000);
+}
+
+void gtHttpClient::lockShare (CURL *curl, curl_lock_data data, curl_lock_access access, void *clientPtr)
+{
+   pthread_mutex_lock (&((gtHttpClient *) clientPtr)->_shareLocks[data]);
+}
+
+void gtHttpClient::unlockShare (CURL *curl, curl_lock_data data, void *clientPtr)
+{
+   pthread_mutex_unlock (&((gtHttpClient *) clientPtr)->_shareLocks[data]);
+}
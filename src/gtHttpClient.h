@@ -0,0 +1,94 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2012, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtHttpClient.h
+ *
+ * Process-wide libcurl handle pool for the calls made to the GeneTorrent
+ * Executive and the security API.
+ *
+ * Easy handles are reused across requests and all of them share a CURLSH
+ * holding DNS entries, TLS sessions and, where libcurl supports it, the
+ * connection cache.  Consecutive calls to the same host therefore reuse a
+ * kept-alive connection, or at least resume the TLS session, instead of
+ * paying a full TCP and TLS handshake each time.  Handles are handed out to
+ * one caller at a time, any number of threads may have requests in flight.
+ *
+ * A process forked after using the pool must not clean it up, the pooled
+ * connections belong to the parent.
+ */
+
+#ifndef GT_HTTP_CLIENT_H_
+#define GT_HTTP_CLIENT_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+class gtHttpClient
+{
+   public:
+      gtHttpClient (bool verifySSL);
+      ~gtHttpClient ();
+
+      // returns a handle with the common options set, NULL on failure
+      CURL *acquireHandle ();
+      void releaseHandle (CURL *curl);
+
+      // transfers failing this way are retried, in case the other end is
+      // temporarily overloaded
+      static bool retryable (CURLcode result);
+
+      // sleeps before retry number attempt (0 based), exponentially longer
+      // with every attempt and with random jitter so clients that failed
+      // together do not retry together
+      void backoff (int attempt);
+
+   private:
+      bool _verifySSL;
+      pid_t _ownerPid;
+      std::string _caInfo;
+
+      CURLSH *_share;
+      pthread_mutex_t _shareLocks[CURL_LOCK_DATA_LAST];
+
+      pthread_mutex_t _poolLock;
+      std::vector <CURL *> _idleHandles;
+      unsigned int _jitterSeed;
+
+      static void lockShare (CURL *curl, curl_lock_data data, curl_lock_access access, void *clientPtr);
+      static void unlockShare (CURL *curl, curl_lock_data data, void *clientPtr);
+};
+
+#endif /* GT_HTTP_CLIENT_H_ */
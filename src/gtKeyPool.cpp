@@ -0,0 +1,343 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2012, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtKeyPool.cpp
+ */
+
+#include "gt_config.h"
+
+#include <unistd.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include "gtKeyPool.h"
+#include "gtDefs.h"
+#include "gtLog.h"
+
+gtKeyPool::gtKeyPool ():
+   _running (false),
+   _keyPairs (),
+   _poolSize (0),
+   _subject (NULL),
+   _subjectEntries (0),
+   _poolHits (0),
+   _poolMisses (0)
+{
+   pthread_mutex_init (&_poolLock, NULL);
+   pthread_cond_init (&_poolDrained, NULL);
+}
+
+gtKeyPool::~gtKeyPool ()
+{
+   stop ();
+   pthread_cond_destroy (&_poolDrained);
+   pthread_mutex_destroy (&_poolLock);
+   delete [] _subject;
+}
+
+bool gtKeyPool::start (int poolSize, const attributeEntry *subject, int subjectEntries)
+{
+   if (_running || poolSize < 1)
+   {
+      return false;
+   }
+
+   delete [] _subject;
+   _subject = new attributeEntry[subjectEntries];
+   _subjectEntries = subjectEntries;
+
+   for (int i = 0; i < subjectEntries; i++)
+   {
+      _subject[i] = subject[i];
+   }
+
+   _poolSize = poolSize;
+   _running = true;
+
+   if (pthread_create (&_generatorThread, NULL, generatorThread, this) != 0)
+   {
+      _running = false;
+      return false;
+   }
+
+   return true;
+}
+
+void gtKeyPool::stop ()
+{
+   if (!_running)
+   {
+      return;
+   }
+
+   pthread_mutex_lock (&_poolLock);
+   _running = false;
+   pthread_cond_signal (&_poolDrained);
+   pthread_mutex_unlock (&_poolLock);
+
+   // an RSA key being generated is finished first
+   pthread_join (_generatorThread, NULL);
+
+   _keyPairs.clear ();
+}
+
+bool gtKeyPool::takeKeyPair (gtKeyPair &keyPair)
+{
+   bool found = false;
+
+   pthread_mutex_lock (&_poolLock);
+
+   if (_keyPairs.size () > 0)
+   {
+      keyPair = _keyPairs.front ();
+      _keyPairs.pop_front ();
+      _poolHits++;
+      found = true;
+
+      pthread_cond_signal (&_poolDrained);
+   }
+   else
+   {
+      _poolMisses++;
+   }
+
+   pthread_mutex_unlock (&_poolLock);
+
+   return found;
+}
+
+int64_t gtKeyPool::poolHits ()
+{
+   pthread_mutex_lock (&_poolLock);
+   int64_t hits = _poolHits;
+   pthread_mutex_unlock (&_poolLock);
+
+   return hits;
+}
+
+int64_t gtKeyPool::poolMisses ()
+{
+   pthread_mutex_lock (&_poolLock);
+   int64_t misses = _poolMisses;
+   pthread_mutex_unlock (&_poolLock);
+
+   return misses;
+}
+
+void *gtKeyPool::generatorThread (void *keyPoolPtr)
+{
+   ((gtKeyPool *) keyPoolPtr)->fillPool ();
+   return NULL;
+}
+
+void gtKeyPool::fillPool ()
+{
+   pthread_mutex_lock (&_poolLock);
+
+   while (_running)
+   {
+      if (_keyPairs.size () >= _poolSize)
+      {
+         pthread_cond_wait (&_poolDrained, &_poolLock);
+         continue;
+      }
+
+      // keys are generated without holding the lock
+      pthread_mutex_unlock (&_poolLock);
+
+      gtKeyPair keyPair;
+      std::string failureStage;
+      bool generated = generateKeyPair (_subject, _subjectEntries, keyPair, failureStage);
+
+      if (!generated)
+      {
+         char sslErrorBuf[256];
+         ERR_error_string_n (ERR_get_error (), sslErrorBuf, sizeof (sslErrorBuf));
+         ERR_clear_error ();
+
+         Log (PRIORITY_HIGH, "Key pool:  %s%s", failureStage.c_str (), sslErrorBuf);
+         sleep (KEY_POOL_RETRY_INTERVAL);
+      }
+
+      pthread_mutex_lock (&_poolLock);
+
+      if (generated)
+      {
+         _keyPairs.push_back (keyPair);
+      }
+   }
+
+   pthread_mutex_unlock (&_poolLock);
+}
+
+static bool pemFromBio (BIO *bio, std::string &pem)
+{
+   char *data;
+   long size = BIO_get_mem_data (bio, &data);
+
+   if (size <= 0)
+   {
+      return false;
+   }
+
+   pem.assign (data, size);
+
+   return true;
+}
+
+bool gtKeyPool::generateKeyPair (const attributeEntry *subject, int subjectEntries, gtKeyPair &keyPair, std::string &failureStage)
+{
+   BIGNUM *exponent = NULL;
+   RSA *rsaKey = NULL;
+   EVP_PKEY *pKey = NULL;
+   X509_REQ *csr = NULL;
+   X509_NAME *subjectName = NULL;
+   BIO *keyBio = NULL;
+   BIO *csrBio = NULL;
+   bool success = false;
+
+   do
+   {
+      // Generate RSA Key
+      if (NULL == (exponent = BN_new ()) || !BN_set_word (exponent, RSA_F4) ||
+          NULL == (rsaKey = RSA_new ()) || !RSA_generate_key_ex (rsaKey, RSA_KEY_SIZE, exponent, NULL))
+      {
+         failureStage = "Failure generating OpenSSL Key:  ";
+         break;
+      }
+
+      // Initialize private key store and add the key to it
+      if (NULL == (pKey = EVP_PKEY_new ()))
+      {
+         failureStage = "Failure initializing OpenSSL EVP object:  ";
+         break;
+      }
+
+      if (!EVP_PKEY_set1_RSA (pKey, rsaKey))
+      {
+         failureStage = "Failure adding OpenSSL key to EVP object:  ";
+         break;
+      }
+
+      // Allocate a CSR and set its public key
+      if (NULL == (csr = X509_REQ_new ()))
+      {
+         failureStage = "Failure allocating OpenSSL CSR:  ";
+         break;
+      }
+
+      if (!X509_REQ_set_pubkey (csr, pKey))
+      {
+         failureStage = "Failure adding public key to OpenSSL CSR:  ";
+         break;
+      }
+
+      if (NULL == (subjectName = X509_NAME_new ()))
+      {
+         failureStage = "Failure allocating OpenSSL X509 Name Structure:  ";
+         break;
+      }
+
+      int entry;
+
+      for (entry = 0; entry < subjectEntries; entry++)
+      {
+         if (!X509_NAME_add_entry_by_txt (subjectName, subject[entry].key.c_str(), MBSTRING_ASC, (const unsigned char *)subject[entry].value.c_str(), -1, -1, 0))
+         {
+            failureStage = "Failure adding " + subject[entry].key + " to OpenSSL X509 Name Structure:  ";
+            break;
+         }
+      }
+
+      if (entry < subjectEntries)
+      {
+         break;
+      }
+
+      if (!X509_REQ_set_subject_name (csr, subjectName))
+      {
+         failureStage = "Failure adding X509 Name Structure to CSR:  ";
+         break;
+      }
+
+      if (!X509_REQ_sign (csr, pKey, EVP_sha1 ()))
+      {
+         failureStage = "Failure creating OpenSSL CSR:  ";
+         break;
+      }
+
+      // PEM encode both in memory
+      keyBio = BIO_new (BIO_s_mem ());
+      csrBio = BIO_new (BIO_s_mem ());
+
+      if (NULL == keyBio || NULL == csrBio)
+      {
+         failureStage = "Failure allocating OpenSSL memory BIO:  ";
+         break;
+      }
+
+      if (PEM_write_bio_PrivateKey (keyBio, pKey, NULL, NULL, 0, 0, NULL) != 1 || !pemFromBio (keyBio, keyPair.privateKey))
+      {
+         failureStage = "Failure writing OpenSSL Private Key:  ";
+         break;
+      }
+
+      if (PEM_write_bio_X509_REQ (csrBio, csr) != 1 || !pemFromBio (csrBio, keyPair.csr))
+      {
+         failureStage = "Failure writing OpenSSL CSR:  ";
+         break;
+      }
+
+      success = true;
+   } while (0);
+
+   // Clean up memory allocated
+   if (csrBio)
+      BIO_free (csrBio);
+   if (keyBio)
+      BIO_free (keyBio);
+   if (subjectName)
+      X509_NAME_free (subjectName);
+   if (csr)
+      X509_REQ_free (csr);
+   if (pKey)
+      EVP_PKEY_free (pKey);
+   if (rsaKey)
+      RSA_free (rsaKey);
+   if (exponent)
+      BN_free (exponent);
+
+   return success;
+}
@@ -0,0 +1,105 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2012, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtKeyPool.h
+ *
+ * Pool of pre-generated private keys and matching CSRs.
+ *
+ * Generating an RSA key takes tens of milliseconds of CPU.  Once started,
+ * a background thread keeps up to poolSize key pairs ready so a GTO that
+ * needs a signed certificate only pays for the signing round trip.  Keys
+ * and CSRs are held in memory in PEM format.  When the pool is empty, or
+ * was never started, generateKeyPair () builds one on the caller's thread.
+ *
+ * The pool is only started by gtserver, gtdownload forks its children and
+ * must not have threads of its own running at that point.
+ */
+
+#ifndef GT_KEY_POOL_H_
+#define GT_KEY_POOL_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+#include <deque>
+
+typedef struct attributeEntry_
+{
+    std::string key;
+    std::string value;
+}attributeEntry;
+
+typedef struct gtKeyPair_
+{
+   std::string privateKey;    // PEM
+   std::string csr;           // PEM
+} gtKeyPair;
+
+class gtKeyPool
+{
+   public:
+      gtKeyPool ();
+      ~gtKeyPool ();
+
+      // the subject is copied, it is used for every CSR the pool builds
+      bool start (int poolSize, const attributeEntry *subject, int subjectEntries);
+      void stop ();
+
+      // false if no pre-generated key pair is available
+      bool takeKeyPair (gtKeyPair &keyPair);
+
+      // on failure, failureStage describes the step that failed and the
+      // OpenSSL error queue of the calling thread holds the details
+      static bool generateKeyPair (const attributeEntry *subject, int subjectEntries, gtKeyPair &keyPair, std::string &failureStage);
+
+      int64_t poolHits ();
+      int64_t poolMisses ();
+
+   private:
+      pthread_t _generatorThread;
+      pthread_mutex_t _poolLock;
+      pthread_cond_t _poolDrained;
+      bool _running;
+
+      std::deque <gtKeyPair> _keyPairs;
+      unsigned int _poolSize;
+      attributeEntry *_subject;
+      int _subjectEntries;
+
+      int64_t _poolHits;
+      int64_t _poolMisses;
+
+      static void *generatorThread (void *keyPoolPtr);
+      void fillPool ();
+};
+
+#endif /* GT_KEY_POOL_H_ */
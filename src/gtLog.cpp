@@ -43,15 +43,32 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <syslog.h>
+#include <signal.h>
 #include <sys/time.h>
 #include <unistd.h>
 #include <iostream>
 #include <sstream>
 
 #include "gtLog.h" 
+#include "gtDefs.h"
 
 gtLogger *GlobalLog = NULL;
 int gtLogger::s_global_refcnt = 0;
+gtLogOverflow gtLogger::s_overflow = LOG_OVERFLOW_BLOCK;
+
+// A message is written to its slot by the thread that claimed it, the
+// sequence tells the writer thread when it is complete, and the claiming
+// threads when the writer is done with it (bounded MPMC queue, Vyukov)
+struct gtLogger::logSlot
+{
+   volatile uint32_t sequence;
+   uint32_t length;
+   char text[LOG_SLOT_SIZE];
+};
+
+// the time stamp only needs localtime_r () and strftime () once per second
+static __thread time_t cachedSecond = -1;
+static __thread char cachedTime[32];
 
 inline const char *filebase(const char *file)
 {
@@ -68,6 +85,15 @@ bool gtLogger::create_globallog(std::string progName, std::string log, int child
 {
    if (GlobalLog == NULL)
    {
+      static bool hooksInstalled = false;
+
+      if (!hooksInstalled)
+      {
+         pthread_atfork (NULL, NULL, childAfterFork);
+         atexit (exitHandler);
+         hooksInstalled = true;
+      }
+
       GlobalLog = new gtLogger(progName, log, childID, UUID);
    }
 
@@ -86,7 +112,8 @@ void gtLogger::delete_globallog()
 }
 
 // priority determines if messages are sent to stderr if logging to a file, syslog, or none
-gtLogger::gtLogger (std::string progName, std::string log, int childID, std::string UUID) : m_mode (gtLoggerOutputNone), m_fd (NULL), m_last_timestamp (0)
+gtLogger::gtLogger (std::string progName, std::string log, int childID, std::string UUID) : m_mode (gtLoggerOutputNone), m_fd (NULL), m_last_timestamp (0), m_ring (NULL),
+  m_enqueuePos (0), m_dequeuePos (0), m_dropped (0), m_writerState (WRITER_NONE), m_stopWriter (false)
 {
    m_progname = strdup (progName.c_str());
    m_filename = strdup (log.c_str());
@@ -175,6 +202,14 @@ gtLogger::gtLogger (std::string progName, std::string log, int childID, std::str
       fprintf(m_fd, "Process id: %d\n", getpid());
       fputs("=============================================================\n", m_fd);
       fflush(m_fd);
+
+      m_ring = new logSlot[LOG_RING_SLOTS];
+      resetRing ();
+      pthread_mutex_init (&m_writerLock, NULL);
+      pthread_cond_init (&m_writerWake, NULL);
+
+      // without a writer thread, messages are written directly
+      startWriter ();
    }
 }
 
@@ -185,6 +220,12 @@ gtLogger::~gtLogger()
    // Write a log footer
    if (m_mode == gtLoggerOutputFile) 
    {
+      stopWriter ();
+      pthread_cond_destroy (&m_writerWake);
+      pthread_mutex_destroy (&m_writerLock);
+      delete [] m_ring;
+      m_ring = NULL;
+
       fputs("=============================================================\n", m_fd);
       time(&clocktime);
       fprintf(m_fd, "Log file closed normally at %s", ctime(&clocktime));
@@ -236,30 +277,30 @@ void gtLogger::__Log (gtLogLevel priority, const char *fmt, ...)
          break;
    }
 
+   va_list ap;
+   va_start (ap, fmt);
+
+   if (m_mode == gtLoggerOutputFile)
+   {
+      logToFile (priority, lvl, fmt, ap);
+      va_end (ap);
+      return;
+   }
+
    char buffer[1024];
 
    if (m_mode != gtLoggerOutputSyslog) 
    {
-      char timebuf[1024];
-      struct timeval now;
-      struct tm time_tm;
+      char prefix[64];
+      formatPrefix (prefix, sizeof (prefix), lvl);
 
-      gettimeofday(&now,  NULL);
-      time_t nowSec = now.tv_sec;
-      localtime_r(&nowSec, &time_tm);
-      strftime(timebuf, sizeof(timebuf), "%m/%d %H:%M:%S", &time_tm);
-
-      snprintf (buffer, sizeof(buffer), "%s.%03d %s:  %s\n", timebuf,
-                static_cast<int>(now.tv_usec/1000), lvl, fmt);
+      snprintf (buffer, sizeof(buffer), "%s%s\n", prefix, fmt);
    }
    else
    {
       snprintf (buffer, sizeof(buffer), "%s:  %s", lvl, fmt);
    }
 
-   va_list ap;
-   va_start (ap, fmt);
-
    if (m_mode != gtLoggerOutputSyslog && m_fd != NULL)
    {
       vfprintf(m_fd, buffer, ap);
@@ -278,3 +319,374 @@ void gtLogger::__Log (gtLogLevel priority, const char *fmt, ...)
       fflush(m_fd);
    }
 }
+
+int gtLogger::formatPrefix (char *buffer, int size, const char *lvl)
+{
+   struct timeval now;
+   gettimeofday (&now, NULL);
+
+   if (now.tv_sec != cachedSecond)
+   {
+      struct tm time_tm;
+      time_t nowSec = now.tv_sec;
+      localtime_r (&nowSec, &time_tm);
+      strftime (cachedTime, sizeof (cachedTime), "%m/%d %H:%M:%S", &time_tm);
+      cachedSecond = now.tv_sec;
+   }
+
+   int length = snprintf (buffer, size, "%s.%03d %s:  ", cachedTime, static_cast<int>(now.tv_usec/1000), lvl);
+
+   return length < size ? length : size - 1;
+}
+
+void gtLogger::logToFile (gtLogLevel priority, const char *lvl, const char *fmt, va_list ap)
+{
+   if (m_writerState == WRITER_NONE)
+   {
+      startWriter ();
+   }
+
+   if (m_writerState == WRITER_RUNNING)
+   {
+      uint32_t position;
+      bool dropped = false;
+      logSlot *slot;
+
+      // the first message with room after some were dropped reports them,
+      // the writer thread stays clear of localtime_r () and its lock
+      if (m_dropped > 0 && (slot = claimSlot (position, dropped)) != NULL)
+      {
+         uint32_t droppedCount = __sync_fetch_and_and (&m_dropped, 0);
+         int length = formatPrefix (slot->text, LOG_SLOT_SIZE, "Error");
+         length += snprintf (slot->text + length, LOG_SLOT_SIZE - length, "%u log messages were dropped, the log file could not be written fast enough\n", droppedCount);
+         slot->length = length < LOG_SLOT_SIZE ? length : LOG_SLOT_SIZE;
+         publishSlot (slot, position);
+      }
+      else if (dropped)
+      {
+         // still full, this message was counted as dropped
+         return;
+      }
+
+      slot = claimSlot (position, dropped);
+
+      if (dropped)
+      {
+         return;
+      }
+
+      if (slot)
+      {
+         va_list slotAp;
+         va_copy (slotAp, ap);
+         int length = formatPrefix (slot->text, LOG_SLOT_SIZE, lvl);
+         int textLength = vsnprintf (slot->text + length, LOG_SLOT_SIZE - length - 1, fmt, slotAp);
+         va_end (slotAp);
+
+         bool fits = textLength >= 0 && length + textLength < LOG_SLOT_SIZE - 1;
+
+         if (fits)
+         {
+            length += textLength;
+            slot->text[length++] = '\n';
+         }
+
+         // a message too long for a slot leaves it empty and is
+         // written directly, after the messages queued before it
+         slot->length = fits ? length : 0;
+         publishSlot (slot, position);
+
+         if (fits)
+         {
+            if (priority == PRIORITY_HIGH || position - m_dequeuePos == LOG_RING_SLOTS / 2)
+            {
+               wakeWriter ();
+            }
+            return;
+         }
+
+         flush ();
+      }
+   }
+
+   char prefix[64];
+   int prefixLength = formatPrefix (prefix, sizeof (prefix), lvl);
+
+   va_list sizeAp;
+   va_copy (sizeAp, ap);
+   int textLength = vsnprintf (NULL, 0, fmt, sizeAp);
+   va_end (sizeAp);
+
+   if (textLength < 0)
+   {
+      return;
+   }
+
+   std::string message (prefixLength + textLength + 1, '\n');
+   memcpy (&message[0], prefix, prefixLength);
+   vsnprintf (&message[prefixLength], textLength + 1, fmt, ap);
+   message[prefixLength + textLength] = '\n';
+
+   writeFile (message.data (), message.size ());
+}
+
+void gtLogger::writeFile (const char *data, size_t length)
+{
+   int fd = fileno (m_fd);
+
+   while (length > 0)
+   {
+      ssize_t written = write (fd, data, length);
+
+      if (written < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         return;
+      }
+
+      data += written;
+      length -= written;
+   }
+}
+
+gtLogger::logSlot *gtLogger::claimSlot (uint32_t &position, bool &dropped)
+{
+   const uint32_t mask = LOG_RING_SLOTS - 1;
+
+   dropped = false;
+
+   while (m_writerState == WRITER_RUNNING)
+   {
+      position = m_enqueuePos;
+      logSlot *slot = &m_ring[position & mask];
+      __sync_synchronize ();
+      int32_t diff = (int32_t) (slot->sequence - position);
+
+      if (diff == 0)
+      {
+         if (__sync_bool_compare_and_swap (&m_enqueuePos, position, position + 1))
+         {
+            return slot;
+         }
+      }
+      else if (diff < 0)
+      {
+         // the writer thread is a full ring behind
+         wakeWriter ();
+
+         if (s_overflow == LOG_OVERFLOW_DROP)
+         {
+            __sync_fetch_and_add (&m_dropped, 1);
+            dropped = true;
+            return NULL;
+         }
+
+         usleep (100);
+      }
+   }
+
+   return NULL;
+}
+
+void gtLogger::publishSlot (logSlot *slot, uint32_t position)
+{
+   __sync_synchronize ();
+   slot->sequence = position + 1;
+}
+
+void gtLogger::flush ()
+{
+   if (m_writerState != WRITER_RUNNING)
+   {
+      return;
+   }
+
+   uint32_t target = m_enqueuePos;
+
+   while (m_writerState == WRITER_RUNNING && (int32_t) (m_dequeuePos - target) < 0)
+   {
+      wakeWriter ();
+      usleep (1000);
+   }
+}
+
+void gtLogger::resetRing ()
+{
+   for (uint32_t slot = 0; slot < (uint32_t) LOG_RING_SLOTS; slot++)
+   {
+      m_ring[slot].sequence = slot;
+      m_ring[slot].length = 0;
+   }
+
+   m_enqueuePos = 0;
+   m_dequeuePos = 0;
+   m_dropped = 0;
+}
+
+bool gtLogger::startWriter ()
+{
+   if (!__sync_bool_compare_and_swap (&m_writerState, WRITER_NONE, WRITER_STARTING))
+   {
+      return m_writerState == WRITER_RUNNING;
+   }
+
+   m_stopWriter = false;
+
+   // signals are left to the threads that handle them
+   sigset_t allSignals;
+   sigset_t oldSignals;
+   sigfillset (&allSignals);
+   pthread_sigmask (SIG_SETMASK, &allSignals, &oldSignals);
+
+   bool started = pthread_create (&m_writer, NULL, writerThread, this) == 0;
+
+   pthread_sigmask (SIG_SETMASK, &oldSignals, NULL);
+
+   m_writerState = started ? WRITER_RUNNING : WRITER_STOPPED;
+
+   return started;
+}
+
+void gtLogger::stopWriter ()
+{
+   int state = m_writerState;
+
+   // messages logged from now on are written directly
+   m_writerState = WRITER_STOPPED;
+
+   if (state != WRITER_RUNNING)
+   {
+      return;
+   }
+
+   pthread_mutex_lock (&m_writerLock);
+   m_stopWriter = true;
+   pthread_cond_signal (&m_writerWake);
+   pthread_mutex_unlock (&m_writerLock);
+
+   pthread_join (m_writer, NULL);
+
+   // messages queued while the writer was finishing
+   writeQueued ();
+
+   uint32_t dropped = __sync_fetch_and_and (&m_dropped, 0);
+
+   if (dropped > 0)
+   {
+      char notice[256];
+      int length = formatPrefix (notice, sizeof (notice), "Error");
+      length += snprintf (notice + length, sizeof (notice) - length, "%u log messages were dropped, the log file could not be written fast enough\n", dropped);
+      writeFile (notice, length < (int) sizeof (notice) ? length : sizeof (notice) - 1);
+   }
+}
+
+// wakeups are not synchronized with the writer going to sleep, one that
+// is missed delays the writer by at most LOG_WRITER_INTERVAL_MS
+void gtLogger::wakeWriter ()
+{
+   pthread_cond_signal (&m_writerWake);
+}
+
+void *gtLogger::writerThread (void *loggerPtr)
+{
+   gtLogger *logger = (gtLogger *) loggerPtr;
+
+   while (1)
+   {
+      bool stopping = logger->m_stopWriter;
+
+      logger->writeQueued ();
+
+      if (stopping)
+      {
+         break;
+      }
+
+      struct timeval now;
+      gettimeofday (&now, NULL);
+
+      long nsec = now.tv_usec * 1000L + LOG_WRITER_INTERVAL_MS * 1000000L;
+      struct timespec deadline;
+      deadline.tv_sec = now.tv_sec + nsec / 1000000000L;
+      deadline.tv_nsec = nsec % 1000000000L;
+
+      pthread_mutex_lock (&logger->m_writerLock);
+
+      if (!logger->m_stopWriter)
+      {
+         pthread_cond_timedwait (&logger->m_writerWake, &logger->m_writerLock, &deadline);
+      }
+
+      pthread_mutex_unlock (&logger->m_writerLock);
+   }
+
+   return NULL;
+}
+
+// Only ever called by one thread at a time, the writer thread or,
+// once it has exited, the thread stopping it
+void gtLogger::writeQueued ()
+{
+   const uint32_t mask = LOG_RING_SLOTS - 1;
+
+   char batch[LOG_BATCH_SIZE];
+   int batchLength = 0;
+
+   while (1)
+   {
+      uint32_t position = m_dequeuePos;
+      logSlot *slot = &m_ring[position & mask];
+
+      if (slot->sequence != position + 1)
+      {
+         break;
+      }
+
+      __sync_synchronize ();
+
+      if (batchLength + (int) slot->length > LOG_BATCH_SIZE)
+      {
+         writeFile (batch, batchLength);
+         batchLength = 0;
+      }
+
+      memcpy (batch + batchLength, slot->text, slot->length);
+      batchLength += slot->length;
+
+      __sync_synchronize ();
+      slot->sequence = position + LOG_RING_SLOTS;
+      m_dequeuePos = position + 1;
+   }
+
+   if (batchLength > 0)
+   {
+      writeFile (batch, batchLength);
+   }
+}
+
+void gtLogger::exitHandler ()
+{
+   if (GlobalLog != NULL && GlobalLog->m_mode == gtLoggerOutputFile)
+   {
+      GlobalLog->stopWriter ();
+   }
+}
+
+// runs in the child of a fork, where only the forking thread exists
+void gtLogger::childAfterFork ()
+{
+   if (GlobalLog == NULL || GlobalLog->m_mode != gtLoggerOutputFile)
+   {
+      return;
+   }
+
+   // the parent writes the messages it had queued
+   GlobalLog->resetRing ();
+   pthread_mutex_init (&GlobalLog->m_writerLock, NULL);
+   pthread_cond_init (&GlobalLog->m_writerWake, NULL);
+   GlobalLog->m_stopWriter = false;
+   GlobalLog->m_writerState = WRITER_NONE;
+}
@@ -42,6 +42,9 @@
 #include <inttypes.h>
 #endif
 
+#include <pthread.h>
+#include <stdarg.h>
+
 #include <string>
 
 #ifndef __STRING
@@ -77,18 +80,39 @@ enum gtLogLevel {
    PRIORITY_DEBUG,
 };
 
+// What a thread logging to a file does when the writer thread has
+// fallen LOG_RING_SLOTS messages behind
+enum gtLogOverflow {
+   LOG_OVERFLOW_BLOCK,     // wait for the writer
+   LOG_OVERFLOW_DROP,      // discard the message, the number dropped is logged later
+};
+
 
 #define LogNormal(fmt, ...) Log(PRIORITY_NORMAL, (fmt), ## __VA_ARGS__)
 #define LogDebug(fmt, ...)  Log(PRIORITY_DEBUG,  (fmt), ## __VA_ARGS__)
 
+// Messages logged to a file are formatted by the calling thread into a
+// slot of a lock-free ring and written out in batches by a writer thread,
+// so logging never waits for the disk.  stdout, stderr and syslog are
+// written synchronously, as they are interleaved with screen output or,
+// for syslog, use a lock of the C library that must not be held by a
+// thread when gtdownload forks.
+//
+// A forked child discards the messages its parent had queued, the parent
+// writes those, and starts its own writer thread when it next logs.
+// Queued messages are written out when the process exits.
 class gtLogger 
 {
    public:
       static bool create_globallog (std::string, std::string, int childID = 0, std::string UUID = "");
       static void delete_globallog();
+      static void set_overflow_policy (gtLogOverflow policy) { s_overflow = policy; }
 
       void __Log (gtLogLevel priority, const char *string, ...);
 
+      // returns once every message logged before the call is written
+      void flush ();
+
       const char *log_file_name() { return m_filename; }
       bool logToStdErr() { return m_mode == gtLoggerOutputStderr; }
       int get_fd() { return m_fd ? fileno (m_fd) : -1; }
@@ -103,10 +127,38 @@ class gtLogger
          gtLoggerOutputFile, 
       };
 
+      struct logSlot;
+
       gtLogger (std::string progName, std::string log, int childID, std::string UUID);
       ~gtLogger();
 
       static int s_global_refcnt;
+      static gtLogOverflow s_overflow;
+
+      enum WriterState
+      {
+         WRITER_NONE,         // not started in this process yet
+         WRITER_STARTING,
+         WRITER_RUNNING,
+         WRITER_STOPPED,      // messages are written directly
+      };
+
+      static void exitHandler ();
+      static void childAfterFork ();
+
+      int formatPrefix (char *buffer, int size, const char *lvl);
+      void logToFile (gtLogLevel priority, const char *lvl, const char *fmt, va_list ap);
+      void writeFile (const char *data, size_t length);
+
+      logSlot *claimSlot (uint32_t &position, bool &dropped);
+      void publishSlot (logSlot *slot, uint32_t position);
+
+      bool startWriter ();
+      void stopWriter ();
+      void resetRing ();
+      void wakeWriter ();
+      static void *writerThread (void *loggerPtr);
+      void writeQueued ();
 
       OutputType m_mode;
       char *m_filename;
@@ -114,6 +166,17 @@ class gtLogger
       FILE *m_fd;
 
       int64_t m_last_timestamp;
+
+      logSlot *m_ring;
+      volatile uint32_t m_enqueuePos;
+      volatile uint32_t m_dequeuePos;
+      volatile uint32_t m_dropped;
+
+      pthread_t m_writer;
+      volatile int m_writerState;
+      volatile bool m_stopWriter;
+      pthread_mutex_t m_writerLock;
+      pthread_cond_t m_writerWake;
 };
 
 extern gtLogger *GlobalLog;
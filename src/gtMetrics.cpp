@@ -0,0 +1,294 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2012, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtMetrics.cpp
+ */
+
+#include "gt_config.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gtMetrics.h"
+#include "gtDefs.h"
+#include "gtLog.h"
+
+gtMetricsHistogram::gtMetricsHistogram (std::string name, std::string help, const double *bounds, int numBounds):
+   _name (name),
+   _help (help),
+   _bounds (bounds, bounds + numBounds),
+   _counts (numBounds + 1, 0),
+   _sum (0.0),
+   _count (0)
+{
+}
+
+void gtMetricsHistogram::observe (double value)
+{
+   std::vector <double>::size_type bucket = 0;
+
+   while (bucket < _bounds.size () && value > _bounds[bucket])
+   {
+      bucket++;
+   }
+
+   _counts[bucket]++;
+   _sum += value;
+   _count++;
+}
+
+void gtMetricsHistogram::render (std::ostringstream &out) const
+{
+   gtMetrics::writeHeader (out, _name, _help, "histogram");
+
+   int64_t cumulative = 0;
+
+   for (std::vector <double>::size_type bucket = 0; bucket < _bounds.size (); bucket++)
+   {
+      char label[64];
+      snprintf (label, sizeof (label), "le=\"%g\"", _bounds[bucket]);
+
+      cumulative += _counts[bucket];
+      gtMetrics::writeSample (out, _name + "_bucket", label, cumulative);
+   }
+
+   gtMetrics::writeSample (out, _name + "_bucket", "le=\"+Inf\"", _count);
+   gtMetrics::writeSample (out, _name + "_sum", "", _sum);
+   gtMetrics::writeSample (out, _name + "_count", "", _count);
+}
+
+gtMetrics::gtMetrics ():
+   _listenFd (-1),
+   _page ()
+{
+   pthread_mutex_init (&_pageLock, NULL);
+}
+
+gtMetrics::~gtMetrics ()
+{
+   stopListener ();
+   pthread_mutex_destroy (&_pageLock);
+}
+
+// Listens on the loopback interface only, the metrics are not meant to
+// leave the host without going through whatever collects them
+bool gtMetrics::startListener (int port)
+{
+   _listenFd = socket (AF_INET, SOCK_STREAM, 0);
+
+   if (_listenFd < 0)
+   {
+      return false;
+   }
+
+   int reuse = 1;
+   setsockopt (_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+
+   struct sockaddr_in addr;
+   memset (&addr, 0, sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons (port);
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+   if (bind (_listenFd, (struct sockaddr *) &addr, sizeof (addr)) < 0 || listen (_listenFd, METRICS_LISTEN_BACKLOG) < 0)
+   {
+      int savedErrno = errno;
+      close (_listenFd);
+      _listenFd = -1;
+      errno = savedErrno;
+      return false;
+   }
+
+   if (pthread_create (&_listenerThread, NULL, listenerThread, this) != 0)
+   {
+      close (_listenFd);
+      _listenFd = -1;
+      return false;
+   }
+
+   Log (PRIORITY_NORMAL, "Serving metrics on http://127.0.0.1:%d/metrics", port);
+
+   return true;
+}
+
+void gtMetrics::stopListener ()
+{
+   if (_listenFd < 0)
+   {
+      return;
+   }
+
+   // wakes the listener thread out of accept ()
+   shutdown (_listenFd, SHUT_RDWR);
+   pthread_join (_listenerThread, NULL);
+
+   close (_listenFd);
+   _listenFd = -1;
+}
+
+void gtMetrics::publish (const std::string &page)
+{
+   pthread_mutex_lock (&_pageLock);
+   _page = page;
+   pthread_mutex_unlock (&_pageLock);
+}
+
+void *gtMetrics::listenerThread (void *metricsPtr)
+{
+   ((gtMetrics *) metricsPtr)->serveConnections ();
+   return NULL;
+}
+
+void gtMetrics::serveConnections ()
+{
+   while (1)
+   {
+      int connFd = accept (_listenFd, NULL, NULL);
+
+      if (connFd < 0)
+      {
+         if (errno == EINTR || errno == ECONNABORTED)
+         {
+            continue;
+         }
+         break;      // listener shut down
+      }
+
+      serveRequest (connFd);
+      close (connFd);
+   }
+}
+
+// Minimal HTTP/1.0 handling, one request per connection
+void gtMetrics::serveRequest (int connFd)
+{
+   struct timeval timeout;
+   timeout.tv_sec = METRICS_REQUEST_TIMEOUT;
+   timeout.tv_usec = 0;
+   setsockopt (connFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+   setsockopt (connFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+   std::string request;
+   char buffer[1024];
+
+   while (request.find ("\r\n\r\n") == std::string::npos && request.find ("\n\n") == std::string::npos && request.size () < 8192)
+   {
+      ssize_t bytesRead = recv (connFd, buffer, sizeof (buffer), 0);
+
+      if (bytesRead <= 0)
+      {
+         break;
+      }
+      request.append (buffer, bytesRead);
+   }
+
+   std::string requestLine = request.substr (0, request.find_first_of ("\r\n"));
+
+   std::string response;
+
+   if (requestLine.compare (0, 13, "GET /metrics ") == 0 || requestLine.compare (0, 13, "GET /metrics?") == 0)
+   {
+      std::string page;
+
+      pthread_mutex_lock (&_pageLock);
+      page = _page;
+      pthread_mutex_unlock (&_pageLock);
+
+      std::ostringstream header;
+      header << "HTTP/1.0 200 OK\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << page.size () << "\r\n"
+             << "Connection: close\r\n\r\n";
+
+      response = header.str () + page;
+   }
+   else
+   {
+      response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+   }
+
+   std::string::size_type sent = 0;
+
+   while (sent < response.size ())
+   {
+      ssize_t bytesSent = send (connFd, response.data () + sent, response.size () - sent, MSG_NOSIGNAL);
+
+      if (bytesSent <= 0)
+      {
+         if (bytesSent < 0 && errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+      sent += bytesSent;
+   }
+}
+
+void gtMetrics::writeHeader (std::ostringstream &out, std::string name, std::string help, std::string type)
+{
+   out << "# HELP " << name << " " << help << "\n"
+       << "# TYPE " << name << " " << type << "\n";
+}
+
+void gtMetrics::writeSample (std::ostringstream &out, std::string name, std::string labels, int64_t value)
+{
+   out << name;
+
+   if (labels.size () > 0)
+   {
+      out << "{" << labels << "}";
+   }
+
+   out << " " << (long long) value << "\n";
+}
+
+void gtMetrics::writeSample (std::ostringstream &out, std::string name, std::string labels, double value)
+{
+   char valueStr[64];
+   snprintf (valueStr, sizeof (valueStr), "%.15g", value);
+
+   out << name;
+
+   if (labels.size () > 0)
+   {
+      out << "{" << labels << "}";
+   }
+
+   out << " " << valueStr << "\n";
+}
@@ -0,0 +1,99 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2012, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtMetrics.h
+ *
+ * Metrics export for gtserver in the Prometheus text exposition format.
+ *
+ * The server's main loop renders a complete page of metrics every
+ * METRICS_REFRESH_INTERVAL seconds and hands it to publish ().  A listener
+ * thread serves the last published page to HTTP GET /metrics requests on
+ * the loopback interface, so scrapes never touch libtorrent or the served
+ * GTO bookkeeping.
+ */
+
+#ifndef GT_METRICS_H_
+#define GT_METRICS_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+class gtMetricsHistogram
+{
+   public:
+      // bounds are the upper bounds of the buckets, in increasing order,
+      // the +Inf bucket is implied
+      gtMetricsHistogram (std::string name, std::string help, const double *bounds, int numBounds);
+
+      void observe (double value);
+      void render (std::ostringstream &out) const;
+
+   private:
+      std::string _name;
+      std::string _help;
+      std::vector <double> _bounds;
+      std::vector <int64_t> _counts;      // per bucket, last entry is +Inf
+      double _sum;
+      int64_t _count;
+};
+
+class gtMetrics
+{
+   public:
+      gtMetrics ();
+      ~gtMetrics ();
+
+      bool startListener (int port);
+      void stopListener ();
+      bool listening () { return _listenFd >= 0; }
+
+      void publish (const std::string &page);
+
+      static void writeHeader (std::ostringstream &out, std::string name, std::string help, std::string type);
+      static void writeSample (std::ostringstream &out, std::string name, std::string labels, int64_t value);
+      static void writeSample (std::ostringstream &out, std::string name, std::string labels, double value);
+
+   private:
+      int _listenFd;
+      pthread_t _listenerThread;
+      pthread_mutex_t _pageLock;
+      std::string _page;
+
+      static void *listenerThread (void *metricsPtr);
+      void serveConnections ();
+      void serveRequest (int connFd);
+};
+
+#endif /* GT_METRICS_H_ */
@@ -0,0 +1,347 @@
+/* -*- mode: C++; c-basic-offset: 2; tab-width: 2; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+#include "gt_config.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "libtorrent/file_pool.hpp"
+#include "libtorrent/session_settings.hpp"
+
+#include "gtMmapStorage.h"
+
+//
+// Memory mapped storage device for libtorrent
+//
+// gtserver mostly seeds data that is complete and verified.  This storage
+// maps each file of a GTO once, the first time it's read, and copies blocks
+// out of the mapping, so a block in the page cache costs a memcpy instead
+// of a system call, and read-ahead hints become madvise(MADV_WILLNEED) on
+// the mapping.  Writes go through default_storage, the mapping is shared
+// and sees them.
+//
+// A file is only mapped once it has its full size, until then (while it is
+// being downloaded) and if mapping fails, the file is read as usual.  A
+// file that is truncated while it's mapped makes the copy fault with
+// SIGBUS, the copy is guarded, the file is unmapped and the range is read
+// as usual, which reports the short file as a storage error.
+//
+using namespace libtorrent;
+
+namespace
+{
+  // the copy the thread is doing out of a mapping, 0 when it isn't
+  __thread sigjmp_buf* volatile copy_guard = 0;
+
+  struct sigaction previous_sigbus;
+  pthread_once_t sigbus_once = PTHREAD_ONCE_INIT;
+
+  void sigbus_handler(int sig, siginfo_t* info, void* context)
+  {
+    if (copy_guard) siglongjmp(*copy_guard, 1);
+
+    // not ours, hand it on
+    if (previous_sigbus.sa_flags & SA_SIGINFO)
+    {
+      previous_sigbus.sa_sigaction(sig, info, context);
+      return;
+    }
+    if (previous_sigbus.sa_handler != SIG_DFL && previous_sigbus.sa_handler != SIG_IGN)
+    {
+      previous_sigbus.sa_handler(sig);
+      return;
+    }
+
+    // the faulting access is retried on return and ends the process
+    signal(SIGBUS, SIG_DFL);
+  }
+
+  void install_sigbus_handler()
+  {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = sigbus_handler;
+    // SIGBUS stays unblocked when the handler jumps out of the copy, so
+    // sigsetjmp doesn't have to save the signal mask with a system call
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, &previous_sigbus);
+  }
+}
+
+class mmap_storage : public default_storage
+{
+public:
+  mmap_storage(file_storage const& fs, file_storage const* mapped, std::string const& path
+    , file_pool& fp, std::vector<boost::uint8_t> const& file_prio)
+    : default_storage(fs, mapped, path, fp, file_prio)
+    , m_maps(files().num_files())
+  {
+    pthread_once(&sigbus_once, install_sigbus_handler);
+  }
+
+  ~mmap_storage() { unmap_all(); }
+
+  int readv(file::iovec_t const* bufs, int slot, int offset, int num_bufs);
+  void hint_read(int slot, int offset, int len);
+  bool release_files();
+  bool delete_files();
+  bool move_storage(std::string const& save_path);
+
+private:
+  struct file_map
+  {
+    file_map(): base(0), size(0), failed(false) {}
+    char* base;
+    size_t size;
+    bool failed;
+  };
+
+  // the mapping of a file, or 0 when it has to be read as usual
+  char const* map_file(int file_index);
+  void unmap_file(int file_index);
+  void unmap_all();
+
+  // copies the range out of the mappings, file is the file being copied
+  void copy_slices(std::vector<file_slice> const& slices
+    , file::iovec_t const* bufs, int volatile& file);
+
+  // the range of the piece that lies in files, clamped like default_storage
+  // does, 0 when there is none
+  int piece_range(int slot, int offset, int size);
+
+  std::vector<file_map> m_maps;
+};
+
+char const* mmap_storage::map_file(int file_index)
+{
+  file_map& m = m_maps[file_index];
+  if (m.base) return m.base;
+  if (m.failed) return 0;
+
+  file_storage::iterator fe = files().begin() + file_index;
+  size_type end = files().file_base(*fe) + fe->size;
+  if (end <= 0) return 0;
+
+  // address space is the limit on 32 bit systems
+  if (size_type(size_t(end)) != end)
+  {
+    m.failed = true;
+    return 0;
+  }
+
+  // errors opening the file are reported by default_storage
+  error_code ec;
+  boost::intrusive_ptr<file> handle = open_file(fe, file::read_only, ec);
+  if (!handle || ec) return 0;
+
+  // a file that isn't complete yet is tried again on the next read
+  struct stat st;
+  if (fstat(handle->native_handle(), &st) != 0 || st.st_size < end) return 0;
+
+  void* base = mmap(0, size_t(end), PROT_READ, MAP_SHARED, handle->native_handle(), 0);
+  if (base == MAP_FAILED)
+  {
+    m.failed = true;
+    return 0;
+  }
+
+#ifdef MADV_DONTDUMP
+  // a core dump of gtserver doesn't need a copy of every GTO it serves
+  madvise(base, size_t(end), MADV_DONTDUMP);
+#endif
+
+  m.base = static_cast<char*>(base);
+  m.size = size_t(end);
+  return m.base;
+}
+
+void mmap_storage::unmap_file(int file_index)
+{
+  file_map& m = m_maps[file_index];
+  if (m.base) munmap(m.base, m.size);
+  m = file_map();
+}
+
+void mmap_storage::unmap_all()
+{
+  for (int i = 0; i < int(m_maps.size()); ++i) unmap_file(i);
+}
+
+int mmap_storage::piece_range(int slot, int offset, int size)
+{
+  int slot_size = files().piece_size(slot);
+  if (offset + size > slot_size) size = slot_size - offset;
+  return (std::max)(size, 0);
+}
+
+int mmap_storage::readv(file::iovec_t const* bufs, int slot, int offset, int num_bufs)
+{
+  int size = 0;
+  for (int i = 0; i < num_bufs; ++i) size += bufs[i].iov_len;
+  size = piece_range(slot, offset, size);
+  if (size == 0) return default_storage::readv(bufs, slot, offset, num_bufs);
+
+  // every file of the range has to be mapped, otherwise the range is read
+  // as usual, which reports errors the way libtorrent expects
+  std::vector<file_slice> slices = files().map_block(slot, offset, size);
+  for (std::vector<file_slice>::iterator i = slices.begin(); i != slices.end(); ++i)
+  {
+    if ((files().begin() + i->file_index)->pad_file) continue;
+    if (!map_file(i->file_index)) return default_storage::readv(bufs, slot, offset, num_bufs);
+  }
+
+  sigjmp_buf guard;
+  int volatile file = -1;
+  if (sigsetjmp(guard, 0) == 0)
+  {
+    copy_guard = &guard;
+    copy_slices(slices, bufs, file);
+    copy_guard = 0;
+    return size;
+  }
+  copy_guard = 0;
+
+  // the file is shorter than its mapping, it's read as usual from now on
+  unmap_file(file);
+  m_maps[file].failed = true;
+  return default_storage::readv(bufs, slot, offset, num_bufs);
+}
+
+void mmap_storage::copy_slices(std::vector<file_slice> const& slices
+  , file::iovec_t const* bufs, int volatile& file)
+{
+  int buf = 0;
+  size_t buf_offset = 0;
+  for (std::vector<file_slice>::const_iterator i = slices.begin(); i != slices.end(); ++i)
+  {
+    file = i->file_index;
+
+    // pad files read as zeros
+    char const* src = (files().begin() + i->file_index)->pad_file ? 0
+      : m_maps[i->file_index].base + i->offset;
+
+    size_type left = i->size;
+    while (left > 0)
+    {
+      size_t n = (std::min)(size_t(bufs[buf].iov_len - buf_offset), size_t(left));
+      char* dst = (char*)bufs[buf].iov_base + buf_offset;
+      if (src)
+      {
+        memcpy(dst, src, n);
+        src += n;
+      }
+      else
+      {
+        memset(dst, 0, n);
+      }
+      left -= n;
+      buf_offset += n;
+      if (buf_offset == bufs[buf].iov_len)
+      {
+        ++buf;
+        buf_offset = 0;
+      }
+    }
+  }
+}
+
+void mmap_storage::hint_read(int slot, int offset, int len)
+{
+  // the blocks of a piece are requested one at a time, like
+  // default_storage a read cache line is hinted with the first one
+  if (slot == m_hint_slot && offset >= m_hint_start && offset + len <= m_hint_end)
+    return;
+
+  int size = len;
+  if (m_settings) size = (std::max)(size, settings().read_cache_line_size * 16 * 1024);
+  size = piece_range(slot, offset, size);
+  if (size == 0) return;
+
+  std::vector<file_slice> slices = files().map_block(slot, offset, size);
+  for (std::vector<file_slice>::iterator i = slices.begin(); i != slices.end(); ++i)
+  {
+    if ((files().begin() + i->file_index)->pad_file) continue;
+    if (!map_file(i->file_index))
+    {
+      default_storage::hint_read(slot, offset, len);
+      return;
+    }
+  }
+
+  m_hint_slot = slot;
+  m_hint_start = offset;
+  m_hint_end = offset + size;
+
+  static const size_type page_mask = sysconf(_SC_PAGESIZE) - 1;
+  for (std::vector<file_slice>::iterator i = slices.begin(); i != slices.end(); ++i)
+  {
+    if ((files().begin() + i->file_index)->pad_file) continue;
+
+    // madvise wants a page aligned start
+    size_type start = i->offset & ~page_mask;
+    madvise(m_maps[i->file_index].base + start, size_t(i->offset + i->size - start), MADV_WILLNEED);
+  }
+}
+
+bool mmap_storage::release_files()
+{
+  unmap_all();
+  return default_storage::release_files();
+}
+
+bool mmap_storage::delete_files()
+{
+  // the space of deleted files is only freed once they're unmapped
+  unmap_all();
+  return default_storage::delete_files();
+}
+
+bool mmap_storage::move_storage(std::string const& save_path)
+{
+  unmap_all();
+  return default_storage::move_storage(save_path);
+}
+
+storage_interface* mmap_storage_constructor(file_storage const& fs,
+	file_storage const* mapped, std::string const& path, file_pool& fp,
+	std::vector<boost::uint8_t> const& file_prio)
+{
+  return new mmap_storage(fs, mapped, path, fp, file_prio);
+}
@@ -49,8 +49,10 @@
 #define OPT_PATH                   "path"
 #define OPT_RATE_LIMIT             "rate-limit"
 #define OPT_INACTIVE_TIMEOUT       "inactivity-timeout"
+#define OPT_DIRECT_IO              "direct-io"
 #define OPT_PEER_TIMEOUT           "peer-timeout"
 #define OPT_LOGGING                "log"
+#define OPT_LOG_OVERFLOW           "log-overflow"
 #define OPT_TIMESTAMP              "timestamps"
 #define OPT_VERBOSE                "verbose"
 #define OPT_VERBOSE_INCR           "verbose-incr"
@@ -61,6 +63,9 @@
 #define OPT_ALLOWED_SERVERS        "allowed-servers"
 #define OPT_NULL_STORAGE           "null-storage"
 #define OPT_ZERO_STORAGE           "zero-storage"
+#define OPT_URING_STORAGE          "uring-storage"
+#define OPT_MMAP_STORAGE           "mmap-storage"
+#define OPT_SSL_CIPHERS            "ssl-ciphers"
 
 // Options for gtdownload:
 #define OPT_DOWNLOAD               "download"
@@ -79,5 +84,8 @@
 #define OPT_FORCE_DL_MODE          "force-download-mode"
 #define OPT_FOREGROUND             "foreground"
 #define OPT_PIDFILE                "pidfile"
+#define OPT_METRICS_PORT           "metrics-port"
+#define OPT_KEY_POOL_SIZE          "key-pool-size"
+#define OPT_KERNEL_TLS             "kernel-tls"
 
 #endif  /* GT_OPT_STRINGS_H */
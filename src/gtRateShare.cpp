@@ -0,0 +1,235 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtRateShare.cpp
+ */
+
+#include "gt_config.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtRateShare.h"
+#include "gtDefs.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+gtRateShare::gtRateShare ():
+   _slots (NULL),
+   _numSlots (0),
+   _totalLimit (0)
+{
+}
+
+gtRateShare::~gtRateShare ()
+{
+   destroy ();
+}
+
+bool gtRateShare::create (int64_t totalLimit, int numSlots)
+{
+   destroy ();
+
+   if (totalLimit <= 0 || numSlots < 1)
+   {
+      return false;
+   }
+
+   void *mem = mmap (NULL, sizeof (slotRec) * numSlots, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+   if (mem == MAP_FAILED)
+   {
+      return false;
+   }
+
+   _slots = (slotRec *) mem;
+   _numSlots = numSlots;
+   _totalLimit = totalLimit;
+
+   // children start out with an even split, like they did before the limit was shared
+   for (int i = 0; i < numSlots; i++)
+   {
+      _slots[i].rate = 0;
+      _slots[i].limit = totalLimit / numSlots;
+      _slots[i].running = 1;
+   }
+
+   return true;
+}
+
+void gtRateShare::destroy ()
+{
+   if (_slots)
+   {
+      munmap (_slots, sizeof (slotRec) * _numSlots);
+   }
+
+   _slots = NULL;
+   _numSlots = 0;
+}
+
+int64_t gtRateShare::update (int slot, int64_t rate)
+{
+   if (!_slots || slot < 0 || slot >= _numSlots)
+   {
+      return 0;
+   }
+
+   _slots[slot].rate = rate;
+   _slots[slot].running = 1;
+
+   int running = 0;
+
+   for (int i = 0; i < _numSlots; i++)
+   {
+      running += _slots[i].running ? 1 : 0;
+   }
+
+   int64_t minimum = _totalLimit / running * RATE_SHARE_MINIMUM_PERCENT / 100;
+
+   std::vector <int64_t> demand (_numSlots);
+   std::vector <int64_t> share (_numSlots);
+
+   for (int i = 0; i < _numSlots; i++)
+   {
+      int64_t slotRate = _slots[i].rate;
+      int64_t slotLimit = _slots[i].limit;
+
+      if (!_slots[i].running)
+      {
+         demand[i] = 0;
+      }
+      else if (slotRate * 100 >= slotLimit * RATE_SHARE_SATURATED_PERCENT)
+      {
+         demand[i] = -1;      // held back by its limit, give it all it can get
+      }
+      else
+      {
+         demand[i] = std::max (slotRate * RATE_SHARE_HEADROOM_PERCENT / 100, minimum);
+      }
+   }
+
+   divide (_totalLimit, &demand[0], &share[0], _numSlots);
+
+   // libtorrent treats a limit of 0 as unlimited
+   if (share[slot] < 1)
+   {
+      share[slot] = 1;
+   }
+
+   _slots[slot].limit = share[slot];
+   return share[slot];
+}
+
+void gtRateShare::release (int slot)
+{
+   if (!_slots || slot < 0 || slot >= _numSlots)
+   {
+      return;
+   }
+
+   _slots[slot].running = 0;
+   _slots[slot].rate = 0;
+}
+
+void gtRateShare::divide (int64_t totalLimit, const int64_t *demand, int64_t *share, int numSlots)
+{
+   std::vector <bool> settled (numSlots, false);
+   int64_t remaining = totalLimit;
+   int unsettled = 0;
+   int running = 0;
+
+   for (int i = 0; i < numSlots; i++)
+   {
+      share[i] = 0;
+
+      if (demand[i] == 0)
+      {
+         settled[i] = true;
+      }
+      else
+      {
+         unsettled++;
+         running++;
+      }
+   }
+
+   // settle the smallest demands first, each one below an even split of
+   // what's left frees bandwidth for the others
+   bool changed = true;
+
+   while (changed && unsettled > 0)
+   {
+      changed = false;
+      int64_t even = remaining / unsettled;
+
+      for (int i = 0; i < numSlots; i++)
+      {
+         if (settled[i] || demand[i] < 0 || demand[i] > even)
+         {
+            continue;
+         }
+
+         share[i] = demand[i];
+         remaining -= demand[i];
+         settled[i] = true;
+         unsettled--;
+         changed = true;
+      }
+   }
+
+   if (unsettled > 0)
+   {
+      for (int i = 0; i < numSlots; i++)
+      {
+         if (!settled[i])
+         {
+            share[i] = remaining / unsettled;
+         }
+      }
+   }
+   else if (running > 0)
+   {
+      // everyone got what they asked for, spread the rest so any child can speed up
+      for (int i = 0; i < numSlots; i++)
+      {
+         if (demand[i] != 0)
+         {
+            share[i] += remaining / running;
+         }
+      }
+   }
+}
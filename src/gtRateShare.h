@@ -0,0 +1,92 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtRateShare.h
+ *
+ * Shares a download rate limit between the children of one gtdownload.
+ *
+ * The parent creates the share before forking, the children inherit the
+ * anonymous shared mapping.  Each child reports its measured rate about
+ * once a second and takes a new limit computed from every child's report:
+ * a child that doesn't use its share keeps what it uses plus some headroom,
+ * and what's left is split evenly between the children that run at their
+ * limit.  A child that finishes releases its slot and its share goes to
+ * the others.  Each child writes only its own slot, so there is no lock;
+ * a report read while it's being written costs at most one uneven second.
+ * Children take their new limits on their own schedule, so while one has
+ * raised its limit and another hasn't lowered its own yet, the total rate
+ * can overshoot the limit for about an update interval.
+ */
+
+#ifndef GT_RATE_SHARE_H_
+#define GT_RATE_SHARE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+class gtRateShare
+{
+   public:
+      gtRateShare ();
+      ~gtRateShare ();
+
+      // maps the slots, call before forking the children
+      bool create (int64_t totalLimit, int numSlots);
+      void destroy ();
+
+      bool active () { return _slots != NULL; }
+
+      // called by the child owning the slot with its current download
+      // rate, returns the limit the child should apply from now on
+      int64_t update (int slot, int64_t rate);
+
+      // the slot's child is done, hand its share to the others
+      void release (int slot);
+
+      // max-min fair division of totalLimit: every slot gets its demand
+      // if that is below an even split of what's left, the rest is shared
+      // evenly.  A negative demand means as much as possible.
+      static void divide (int64_t totalLimit, const int64_t *demand, int64_t *share, int numSlots);
+
+   private:
+      struct slotRec
+      {
+         volatile int64_t rate;
+         volatile int64_t limit;
+         volatile int running;
+      };
+
+      slotRec *_slots;
+      int _numSlots;
+      int64_t _totalLimit;
+};
+
+#endif /* GT_RATE_SHARE_H_ */
@@ -43,6 +43,10 @@
 #include <fstream>
 #include <iomanip>
 #include <cstdio>
+#include <algorithm>
+#include <iterator>
+
+#include <sys/stat.h>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -51,6 +55,7 @@
 
 #include "libtorrent/entry.hpp"
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/lazy_entry.hpp"
 
 #include "libtorrent/create_torrent.hpp"
 
@@ -70,6 +75,8 @@
 #include "loggingmask.h"
 #include "gtNullStorage.h"
 #include "gtZeroStorage.h"
+#include "gtUringStorage.h"
+#include "gtMmapStorage.h"
 
 static char const* server_state_str[] = {
    "checking (q)",                    // queued_for_checking,
@@ -82,6 +89,10 @@ static char const* server_state_str[] = {
    "checking (r)"                     // checking_resume_data
 };
 
+// Histogram buckets for the metrics endpoint, in seconds
+static const double csr_signing_buckets[] = {0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+static const double queue_ingest_buckets[] = {1, 2, 5, 10, 30, 60, 120, 300, 600};
+
 extern void *geneTorrCallBackPtr; 
 
 gtServer::gtServer (gtServerOpts &opts):
@@ -94,8 +105,39 @@ gtServer::gtServer (gtServerOpts &opts):
 
    // 1 port for SSL and 1 port for Non SSL per session
    // maximum sessions is 1/2 the allowed port range
-   _maxActiveSessions ((opts.m_portEnd - opts.m_portStart + 1) / 2)
+   _maxActiveSessions ((opts.m_portEnd - opts.m_portStart + 1) / 2),
+   _expiryQueue (),
+   _servedGtoSessions (),
+   _uploadGtos (),
+   _servedInfoHashes (),
+   _queueDirMtime (0),
+   _queueDirScanTime (0),
+   _maintenanceCycles (0),
+   _metricsPort (opts.m_metricsPort),
+   _metrics (),
+   _nextMetricsUpdate (0),
+   _csrSigningLatency ("gtserver_csr_signing_seconds", "Time to generate a CSR and have it signed.",
+                       csr_signing_buckets, sizeof (csr_signing_buckets) / sizeof (csr_signing_buckets[0])),
+   _queueIngestLag ("gtserver_queue_ingest_lag_seconds", "Time from a GTO being written to the queue until it is served.",
+                    queue_ingest_buckets, sizeof (queue_ingest_buckets) / sizeof (queue_ingest_buckets[0])),
+   _csrSigningFailures (0),
+   _gtosAdded (0),
+   _gtosRemoved (0),
+   _keyPoolSize (opts.m_keyPoolSize),
+   _kernelTls (opts.m_kernelTls),
+   _lastSigningJob (0),
+   _signingQueue (),
+   _signedJobs (),
+   _pendingSignings (0),
+   _signingThreads (),
+   _signingShutdown (false),
+   _handoffGtos (),
+   _handoffResumeData (),
+   _pendingResumeData (0)
 {
+   pthread_mutex_init (&_signingLock, NULL);
+   pthread_cond_init (&_signingWork, NULL);
+
    startUpMessage ("gtserver");
 
    _startUpComplete = true;
@@ -117,6 +159,65 @@ void gtServer::getFilesInQueueDirectory (vectOfStr &files)
    }
 }
 
+// The queue directory mtime changes whenever a GTO is added, removed or
+// renamed into place.  Rescan if it differs from the last scan, or if it
+// was modified in the same second as (or after) the last scan started,
+// since mtime granularity may hide a change made just after we looked.
+bool gtServer::queueDirectoryChanged ()
+{
+   time_t dirMtime = 0;
+
+   if (statDirectory (_serverQueuePath, dirMtime) != 0)
+   {
+      return true;      // let the scan report the problem
+   }
+
+   if (dirMtime != _queueDirMtime || dirMtime >= _queueDirScanTime)
+   {
+      _queueDirMtime = dirMtime;
+      return true;
+   }
+
+   return false;
+}
+
+void gtServer::scanQueueDirectory (std::set <std::string> &activeTorrents, bool startUpMode)
+{
+   _queueDirScanTime = time (NULL);
+
+   // Get the collection of .gto files in the queue directory
+   vectOfStr filesInQueue;
+   getFilesInQueueDirectory (filesInQueue);
+
+   std::set <std::string> queuedGtos (filesInQueue.begin (), filesInQueue.end ());
+
+   vectOfStr::iterator vectIter = filesInQueue.begin ();
+
+   while (vectIter != filesInQueue.end ()) // check each .gto file to ensure GeneTorrent is "serving" the file
+   {
+      if (activeTorrents.find (*vectIter) == activeTorrents.end ()) // gto is not in the set of active torrents
+      {
+         if (addTorrentToServingList (*vectIter, startUpMode))  // Successfully added to a serving session
+         {
+            activeTorrents.insert (*vectIter);
+         }
+      } 
+      vectIter++;
+   }
+
+   // Anything being served that is no longer queued has disappeared
+   vectOfStr disappeared;
+   std::set_difference (activeTorrents.begin (), activeTorrents.end (), queuedGtos.begin (), queuedGtos.end (), std::back_inserter (disappeared));
+
+   for (vectIter = disappeared.begin (); vectIter != disappeared.end (); vectIter++)
+   {
+      activeTorrentRec *torrRec = findServedGto (*vectIter);
+
+      Log (PRIORITY_NORMAL, " Stop serving:  GTO disappeared from queue:  %s info hash:  %s",  vectIter->c_str(), torrRec ? torrRec->infoHash.c_str() : "unknown");
+      stopServingGto (*vectIter, activeTorrents, false);
+   }
+}
+
 void gtServer::checkSessions ()
 {
    gtServer::activeSessionRec *workingSessionRec = NULL;
@@ -169,27 +270,35 @@ void gtServer::run ()
       gtError ("Failure changing directory to " + _serverDataPath, 202, ERRNO_ERROR, errno);
    }
 
+   if (_metricsPort > 0 && !_metrics.startListener (_metricsPort))
+   {
+      std::ostringstream portStr;
+      portStr << _metricsPort;
+      gtError ("Failure starting the metrics listener on port " + portStr.str (), 219, ERRNO_ERROR, errno);
+   }
+
    time_t nextMaintTime = time(NULL) + 30;         // next time stamp to perform maintenance -- shorten a bit for startup
    std::set <std::string> activeTorrentCollection; // list of active torrents, tracks if a GTO is being served
                                                    // This list is indirectly duplicated by the list of torrents being served
                                                    // that is maintained inside the list of activeSessions.
                                                    // This list is maintained here for simplicity and speed
 
-   // determine location of stop file on this OS
-   libtorrent::error_code ec;
-   std::string stopPathAndFile;
-   boost::filesystem::path stopFile = boost::filesystem::temp_directory_path(ec);
-   if (!ec)
-   {
-      stopFile /= SERVER_STOP_FILE;
-      stopPathAndFile = stopFile.string();
-   }
-   else
+   std::string stopPathAndFile = getTempDirFile (SERVER_STOP_FILE);
+   std::string handoffPathAndFile = getTempDirFile (SERVER_HANDOFF_FILE);
+
+   if (!_devMode)
    {
-      // An error occurred, use a default
-      stopPathAndFile = "/tmp/" + SERVER_STOP_FILE;
+      if (_keyPoolSize > 0 && !startKeyPool (_keyPoolSize))
+      {
+         Log (PRIORITY_HIGH, "Failure starting the SSL key pool, keys will be generated as needed");
+      }
+
+      startSigningThreads ();
    }
 
+   // pick up where a previous instance handing off to us left
+   loadHandoffState ();
+
    bool isStarting = true;
 
    while (1)
@@ -200,24 +309,26 @@ void gtServer::run ()
             stopPathAndFile.c_str());
          break;
       }
-      // Get the collection of .gto files in the queue directory
-      vectOfStr filesInQueue;
-      getFilesInQueueDirectory (filesInQueue);
-      vectOfStr::iterator vectIter = filesInQueue.begin ();
 
-      while (vectIter != filesInQueue.end ()) // check each .gto file to ensure GeneTorrent is "serving" the file
+      if (!statFile (handoffPathAndFile.c_str()))
       {
-         std::set <std::string>::iterator actTorrentIter;
-         actTorrentIter = activeTorrentCollection.find (*vectIter);
+         Log (PRIORITY_HIGH, "Exiting server and handing off to the next instance due to existence of handoff file %s",
+            handoffPathAndFile.c_str());
+         saveHandoffState ();
+         unlink (handoffPathAndFile.c_str());
+         break;
+      }
 
-         if (actTorrentIter == activeTorrentCollection.end ()) // gto is not in the set of active torrents
-         {
-            if (addTorrentToServingList (*vectIter, isStarting))  // Successfully added to a serving session
-            {
-               activeTorrentCollection.insert (*vectIter);
-            }
-         } 
-         vectIter++;
+      completeSignedGtos (activeTorrentCollection);
+
+      if (queueDirectoryChanged ())
+      {
+         scanQueueDirectory (activeTorrentCollection, isStarting);
+      }
+
+      if (isStarting)
+      {
+         discardHandoffState ();
       }
 
       isStarting = false;
@@ -237,6 +348,9 @@ void gtServer::run ()
       processServerModeAlerts();
    }
 
+   stopSigningThreads ();
+   _keyPool.stop ();
+
    servedGtosMaintenance (time(NULL), activeTorrentCollection, true);
 
    // Note that remove_torrent does at least two things asynchronously: 1) it
@@ -266,6 +380,20 @@ void gtServer::processServerModeAlerts ()
 {
    libtorrent::ptime endMonitoring = libtorrent::time_now_hires() + libtorrent::seconds(2);
 
+   // Ask every session for the torrents whose status changed, the replies
+   // are picked up by checkAlerts () below and cached in the served GTO
+   // records for maintenance
+   for (std::list <activeSessionRec *>::iterator listIter = _activeSessions.begin (); listIter != _activeSessions.end (); listIter++)
+   {
+      (*listIter)->torrentSession->post_torrent_updates ();
+   }
+
+   if (_metrics.listening () && time (NULL) >= _nextMetricsUpdate)
+   {
+      updateMetrics ();
+      _nextMetricsUpdate = time (NULL) + METRICS_REFRESH_INTERVAL;
+   }
+
    while (libtorrent::time_now_hires() < endMonitoring)
    {
       std::list <activeSessionRec *>::iterator listIter = _activeSessions.begin ();
@@ -279,121 +407,435 @@ void gtServer::processServerModeAlerts ()
    }
 }
 
-void gtServer::servedGtosMaintenance (time_t timeNow, std::set <std::string> &activeTorrents, bool shutdownFlag)
+void gtServer::processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates)
 {
-   std::list <activeSessionRec *>::iterator listIter = _activeSessions.begin ();
-   while (listIter != _activeSessions.end ())
+   for (std::vector <libtorrent::torrent_status>::iterator statusIter = statusUpdates.begin (); statusIter != statusUpdates.end (); statusIter++)
+   {
+      std::map <libtorrent::sha1_hash, std::string>::iterator hashIter = _servedInfoHashes.find (statusIter->info_hash);
+
+      if (hashIter == _servedInfoHashes.end ())
+      {
+         continue;      // stopped serving since the update was posted
+      }
+
+      activeTorrentRec *torrRec = findServedGto (hashIter->second);
+
+      if (torrRec)
+      {
+         torrRec->state = statusIter->state;
+         torrRec->numPeers = statusIter->num_peers;
+         torrRec->totalPayloadUpload = statusIter->total_payload_upload;
+
+         // the more actors are pulling a GTO at once, the longer its pieces
+         // are kept in the read cache, leaving disk reads for the long tail
+         int cachePriority = std::min (torrRec->numPeers / SERVER_PEERS_PER_CACHE_PRIORITY, SERVER_MAX_CACHE_PRIORITY);
+
+         if (cachePriority != torrRec->cachePriority)
+         {
+            torrRec->torrentHandle.set_cache_priority (cachePriority);
+            torrRec->cachePriority = cachePriority;
+         }
+      }
+   }
+}
+
+void gtServer::processResumeData (libtorrent::torrent_handle &torrentHandle, boost::shared_ptr <libtorrent::entry> resumeData)
+{
+   std::map <libtorrent::sha1_hash, std::string>::iterator hashIter = _servedInfoHashes.find (torrentHandle.info_hash ());
+
+   if (hashIter == _servedInfoHashes.end ())
    {
-      std::map <std::string, activeTorrentRec *>::iterator mapIter = (*listIter)->mapOfSessionTorrents.begin (); //mapOfSessionTorrents
+      return;
+   }
+
+   if (resumeData)
+   {
+      _handoffResumeData[hashIter->second] = *resumeData;
+   }
+   else
+   {
+      Log (PRIORITY_NORMAL, "Handoff:  failure saving resume data for %s, the next instance will check its data", hashIter->second.c_str());
+   }
+
+   _pendingResumeData--;
+}
+
+// Renders every metric into a new page for the metrics listener.  Per
+// torrent values come from the cached status updates, session and disk
+// cache values take one call into each session.
+void gtServer::updateMetrics ()
+{
+   std::ostringstream page;
+   std::ostringstream sessionPayloadUp, sessionUp, sessionPeers, readBlocks, readHits, readUncached, cacheBlocks, readCacheBlocks, jobQueue, queuedBytes, readQueue, poolLocks, poolContended, diskReads, diskSyscalls;
+   std::ostringstream torrentPayloadUp, torrentPeers;
+
+   int64_t sslHandshakes = 0;
+   int64_t sslFailures = 0;
+   int64_t sslTime = 0;
+   int64_t sslResumed = 0;
+   int64_t kernelTls = 0;
+   int64_t sslBuckets[libtorrent::session_status::num_ssl_handshake_buckets] = {0};
+
+   int sessionIndex = 0;
+
+   for (std::list <activeSessionRec *>::iterator listIter = _activeSessions.begin (); listIter != _activeSessions.end (); listIter++, sessionIndex++)
+   {
+      libtorrent::session_status sessionStatus = (*listIter)->torrentSession->status ();
+      libtorrent::cache_status cacheStatus = (*listIter)->torrentSession->get_cache_status ();
+
+      std::ostringstream labelStr;
+      labelStr << "session=\"" << sessionIndex << "\"";
+      std::string label = labelStr.str ();
+
+      gtMetrics::writeSample (sessionPayloadUp, "gtserver_session_payload_uploaded_bytes_total", label, (int64_t) sessionStatus.total_payload_upload);
+      gtMetrics::writeSample (sessionUp, "gtserver_session_uploaded_bytes_total", label, (int64_t) sessionStatus.total_upload);
+      gtMetrics::writeSample (sessionPeers, "gtserver_session_peers", label, (int64_t) sessionStatus.num_peers);
+      gtMetrics::writeSample (readBlocks, "gtserver_disk_read_blocks_total", label, (int64_t) cacheStatus.blocks_read);
+      gtMetrics::writeSample (readHits, "gtserver_disk_read_cache_hits_total", label, (int64_t) cacheStatus.blocks_read_hit);
+      gtMetrics::writeSample (readUncached, "gtserver_disk_read_uncached_total", label, (int64_t) cacheStatus.blocks_read_uncached);
+      gtMetrics::writeSample (cacheBlocks, "gtserver_disk_cache_blocks", label, (int64_t) cacheStatus.cache_size);
+      gtMetrics::writeSample (readCacheBlocks, "gtserver_disk_read_cache_blocks", label, (int64_t) cacheStatus.read_cache_size);
+      gtMetrics::writeSample (jobQueue, "gtserver_disk_job_queue_length", label, (int64_t) cacheStatus.job_queue_length);
+      gtMetrics::writeSample (queuedBytes, "gtserver_disk_queued_bytes", label, (int64_t) cacheStatus.queued_bytes);
+      gtMetrics::writeSample (readQueue, "gtserver_disk_read_queue_peers", label, (int64_t) sessionStatus.disk_read_queue);
+      gtMetrics::writeSample (poolLocks, "gtserver_disk_buffer_pool_locks_total", label, (int64_t) cacheStatus.buffer_pool_locks);
+      gtMetrics::writeSample (poolContended, "gtserver_disk_buffer_pool_contended_total", label, (int64_t) cacheStatus.buffer_pool_contended);
+      gtMetrics::writeSample (diskReads, "gtserver_disk_reads_total", label, (int64_t) cacheStatus.reads);
+      gtMetrics::writeSample (diskSyscalls, "gtserver_disk_syscalls_total", label, (int64_t) cacheStatus.disk_syscalls);
+
+      sslHandshakes += sessionStatus.total_ssl_handshakes;
+      sslFailures += sessionStatus.total_ssl_handshake_failures;
+      sslTime += sessionStatus.total_ssl_handshake_time;
+      sslResumed += sessionStatus.total_ssl_handshakes_resumed;
+      kernelTls += sessionStatus.total_kernel_tls_connections;
+
+      for (int bucket = 0; bucket < libtorrent::session_status::num_ssl_handshake_buckets; bucket++)
+      {
+         sslBuckets[bucket] += sessionStatus.ssl_handshake_histogram[bucket];
+      }
+
+      std::map <std::string, activeTorrentRec *>::iterator mapIter = (*listIter)->mapOfSessionTorrents.begin ();
 
       while (mapIter != (*listIter)->mapOfSessionTorrents.end ())
       {
-         libtorrent::torrent_status torrentStatus = mapIter->second->torrentHandle.status ();
-         time_t torrentModTime = 0;
+         std::string torrentLabel = label + ",info_hash=\"" + mapIter->second->infoHash + "\"";
+
+         gtMetrics::writeSample (torrentPayloadUp, "gtserver_gto_payload_uploaded_bytes_total", torrentLabel, mapIter->second->totalPayloadUpload);
+         gtMetrics::writeSample (torrentPeers, "gtserver_gto_peers", torrentLabel, (int64_t) mapIter->second->numPeers);
+         mapIter++;
+      }
+   }
+
+   gtMetrics::writeHeader (page, "gtserver_served_gtos", "GTOs currently being served.", "gauge");
+   gtMetrics::writeSample (page, "gtserver_served_gtos", "", (int64_t) _servedGtoSessions.size ());
+   gtMetrics::writeHeader (page, "gtserver_gtos_added_total", "GTOs that started being served.", "counter");
+   gtMetrics::writeSample (page, "gtserver_gtos_added_total", "", _gtosAdded);
+   gtMetrics::writeHeader (page, "gtserver_gtos_removed_total", "GTOs that stopped being served.", "counter");
+   gtMetrics::writeSample (page, "gtserver_gtos_removed_total", "", _gtosRemoved);
+   gtMetrics::writeHeader (page, "gtserver_sessions", "Active libtorrent sessions.", "gauge");
+   gtMetrics::writeSample (page, "gtserver_sessions", "", (int64_t) _activeSessions.size ());
+
+   gtMetrics::writeHeader (page, "gtserver_session_payload_uploaded_bytes_total", "Payload bytes served by a session.", "counter");
+   page << sessionPayloadUp.str ();
+   gtMetrics::writeHeader (page, "gtserver_session_uploaded_bytes_total", "Bytes sent by a session, including protocol overhead.", "counter");
+   page << sessionUp.str ();
+   gtMetrics::writeHeader (page, "gtserver_session_peers", "Peers connected to a session.", "gauge");
+   page << sessionPeers.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_read_blocks_total", "16 KiB blocks read for peers.", "counter");
+   page << readBlocks.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_read_cache_hits_total", "16 KiB blocks read for peers that were served from the read cache.", "counter");
+   page << readHits.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_read_uncached_total", "16 KiB blocks read straight from disk because the read cache was full of protected pieces.", "counter");
+   page << readUncached.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_cache_blocks", "Blocks in the disk cache.", "gauge");
+   page << cacheBlocks.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_read_cache_blocks", "Blocks in the disk cache used for the read cache.", "gauge");
+   page << readCacheBlocks.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_job_queue_length", "Jobs waiting for the disk thread.", "gauge");
+   page << jobQueue.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_queued_bytes", "Bytes waiting to be written by the disk thread.", "gauge");
+   page << queuedBytes.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_read_queue_peers", "Peers waiting on disk reads.", "gauge");
+   page << readQueue.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_buffer_pool_locks_total", "Times the shared disk buffer pool was locked to refill or drain a thread's buffer cache.", "counter");
+   page << poolLocks.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_buffer_pool_contended_total", "Disk buffer pool locks that had to wait for another thread.", "counter");
+   page << poolContended.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_reads_total", "Read operations issued by the disk thread, each covers one or more blocks of a piece.", "counter");
+   page << diskReads.str ();
+   gtMetrics::writeHeader (page, "gtserver_disk_syscalls_total", "Read, write and seek system calls made for the disk thread's reads and writes.", "counter");
+   page << diskSyscalls.str ();
+
+   gtMetrics::writeHeader (page, "gtserver_ssl_handshake_seconds", "Duration of completed incoming SSL handshakes.", "histogram");
+
+   int64_t cumulative = 0;
+
+   for (int bucket = 0; bucket < libtorrent::session_status::num_ssl_handshake_buckets - 1; bucket++)
+   {
+      char label[64];
+      snprintf (label, sizeof (label), "le=\"%g\"", libtorrent::session_status::ssl_handshake_bucket_limit (bucket) / 1000.0);
+
+      cumulative += sslBuckets[bucket];
+      gtMetrics::writeSample (page, "gtserver_ssl_handshake_seconds_bucket", label, cumulative);
+   }
+
+   gtMetrics::writeSample (page, "gtserver_ssl_handshake_seconds_bucket", "le=\"+Inf\"", sslHandshakes);
+   gtMetrics::writeSample (page, "gtserver_ssl_handshake_seconds_sum", "", sslTime / 1000.0);
+   gtMetrics::writeSample (page, "gtserver_ssl_handshake_seconds_count", "", sslHandshakes);
+   gtMetrics::writeHeader (page, "gtserver_ssl_handshake_failures_total", "Incoming SSL handshakes that failed.", "counter");
+   gtMetrics::writeSample (page, "gtserver_ssl_handshake_failures_total", "", sslFailures);
+   gtMetrics::writeHeader (page, "gtserver_ssl_handshakes_resumed_total", "Completed incoming SSL handshakes that resumed a TLS session.", "counter");
+   gtMetrics::writeSample (page, "gtserver_ssl_handshakes_resumed_total", "", sslResumed);
+   gtMetrics::writeHeader (page, "gtserver_kernel_tls_connections_total", "SSL connections whose sent data the kernel encrypts.", "counter");
+   gtMetrics::writeSample (page, "gtserver_kernel_tls_connections_total", "", kernelTls);
+
+   _csrSigningLatency.render (page);
+   gtMetrics::writeHeader (page, "gtserver_csr_signing_failures_total", "CSRs that could not be signed.", "counter");
+   gtMetrics::writeSample (page, "gtserver_csr_signing_failures_total", "", _csrSigningFailures);
+   gtMetrics::writeHeader (page, "gtserver_csr_signing_pending", "GTOs waiting for a signed certificate.", "gauge");
+   gtMetrics::writeSample (page, "gtserver_csr_signing_pending", "", (int64_t) _pendingSignings);
+   gtMetrics::writeHeader (page, "gtserver_key_pool_hits_total", "SSL keys taken from the key pool.", "counter");
+   gtMetrics::writeSample (page, "gtserver_key_pool_hits_total", "", _keyPool.poolHits ());
+   gtMetrics::writeHeader (page, "gtserver_key_pool_misses_total", "SSL keys generated on demand because the key pool was empty.", "counter");
+   gtMetrics::writeSample (page, "gtserver_key_pool_misses_total", "", _keyPool.poolMisses ());
+   _queueIngestLag.render (page);
+
+   gtMetrics::writeHeader (page, "gtserver_gto_payload_uploaded_bytes_total", "Payload bytes served for a GTO.", "counter");
+   page << torrentPayloadUp.str ();
+   gtMetrics::writeHeader (page, "gtserver_gto_peers", "Peers connected for a GTO.", "gauge");
+   page << torrentPeers.str ();
+
+   _metrics.publish (page.str ());
+}
+
+void gtServer::servedGtosMaintenance (time_t timeNow, std::set <std::string> &activeTorrents, bool shutdownFlag)
+{
+   if (shutdownFlag)
+   {
+      while (!_servedGtoSessions.empty ())
+      {
+         std::string pathAndFileName = _servedGtoSessions.begin ()->first;
+         activeTorrentRec *torrRec = findServedGto (pathAndFileName);
+
+         Log (PRIORITY_NORMAL, "Shutting Down (stop servering):  %s info hash:  %s", pathAndFileName.c_str(), torrRec ? torrRec->infoHash.c_str() : "unknown");
+
+         stopServingGto (pathAndFileName, activeTorrents, false);   // If shutting down, keep the GTO files in the queue
+      }
+      return;
+   }
+
+   // GTOs rewritten in place do not change the queue directory, so
+   // periodically look at every served GTO on disk.  GTOs coming due
+   // for expiration are always re-checked below.
+   if (++_maintenanceCycles % SERVER_FULL_QUEUE_SWEEP_CYCLES == 0)
+   {
+      vectOfStr servedGtos;
+      std::map <std::string, activeSessionRec *>::iterator indexIter = _servedGtoSessions.begin ();
+
+      while (indexIter != _servedGtoSessions.end ())
+      {
+         servedGtos.push_back (indexIter->first);
+         indexIter++;
+      }
+
+      for (vectOfStr::iterator vectIter = servedGtos.begin (); vectIter != servedGtos.end (); vectIter++)
+      {
+         checkServedGtoOnDisk (*vectIter, timeNow, activeTorrents);
+      }
+   }
+
+   // if an upload torrent and the current state is seeding, set the overtime flag to true on the first obversation of this stats
+   // on the 2nd observation of this state, the gto will removed from the upload queue and removed from seeding
+   // This gives the upload plenty of time to recognize that the upload has completed (I.E., the upload client recognizes
+   // two seeders are present due to tracker scraping
+   vectOfStr uploadGtos (_uploadGtos.begin (), _uploadGtos.end ());
+
+   for (vectOfStr::iterator vectIter = uploadGtos.begin (); vectIter != uploadGtos.end (); vectIter++)
+   {
+      activeTorrentRec *torrRec = findServedGto (*vectIter);
+
+      if (!torrRec)
+      {
+         continue;
+      }
+
+      if (torrRec->state != libtorrent::torrent_status::seeding)
+      {
+         continue;
+      }
+
+      if (!torrRec->overTimeAlertIssued)   // first pass set true
+      {
+         torrRec->overTimeAlertIssued = true;
+         screenOutput (std::setw (41) << getFileName (*vectIter) << " Status: " << server_state_str[torrRec->state] << "  expires in approximately:  00:01:00.", VERBOSE_1);
+      }
+      else                                         // second pass, remove the torrent from serving
+      {
+         Log (PRIORITY_NORMAL, "Stop serving:  upload complete %s info hash:  %s", vectIter->c_str(), torrRec->infoHash.c_str());
+         stopServingGto (*vectIter, activeTorrents, true);
+      }
+   }
+
+   // Only GTOs that are due are looked at, everything else waits in the queue
+   while (!_expiryQueue.empty () && _expiryQueue.top ().first <= timeNow)
+   {
+      expiryEntry due = _expiryQueue.top ();
+      _expiryQueue.pop ();
+
+      activeTorrentRec *torrRec = findServedGto (due.second);
+
+      if (!torrRec || torrRec->nextExpiryCheck != due.first)
+      {
+         continue;      // no longer served, or rescheduled since this entry was queued
+      }
+
+      // the GTO may have been updated with a new expiration
+      if (!checkServedGtoOnDisk (due.second, timeNow, activeTorrents) || torrRec->nextExpiryCheck != due.first)
+      {
+         continue;
+      }
+
+      if (torrRec->numPeers == 0)
+      {
+         Log (PRIORITY_NORMAL, "Expiring:  %s info hash:  %s", due.second.c_str(), torrRec->infoHash.c_str());
+         stopServingGto (due.second, activeTorrents, true);
+         continue;
+      }
+
+      if (!torrRec->overTimeAlertIssued)
+      {
+         Log (PRIORITY_NORMAL, "Overtime serving:  %s info hash:  %s (%d actor(s) connected)", due.second.c_str(), torrRec->infoHash.c_str(), torrRec->numPeers);
+         torrRec->overTimeAlertIssued = true;
+      }
+
+      screenOutput (std::setw (41) << getFileName (due.second) << " Status: " << server_state_str[torrRec->state] << "  expired, but an actors continue to download", VERBOSE_1);
+
+      scheduleExpiryCheck (due.second, torrRec, timeNow + SERVER_OVERTIME_RECHECK_INTERVAL);
+   }
+}
+
+// Checks a served GTO against the queue directory.  Returns false if the
+// GTO has been removed from serving.
+bool gtServer::checkServedGtoOnDisk (std::string pathAndFileName, time_t timeNow, std::set <std::string> &activeTorrents)
+{
+   activeTorrentRec *torrRec = findServedGto (pathAndFileName);
+
+   if (!torrRec)
+   {
+      return false;
+   }
+
+   time_t torrentModTime = 0;
                
-         if (statFile (mapIter->first, torrentModTime) < 0)
-         {
-            // The torrent has disappeared, stop serving it.
-            Log (PRIORITY_NORMAL, " Stop serving:  GTO disappeared from queue:  %s info hash:  %s",  mapIter->first.c_str(), mapIter->second->infoHash.c_str());
+   if (statFile (pathAndFileName, torrentModTime) < 0)
+   {
+      // The torrent has disappeared, stop serving it.
+      Log (PRIORITY_NORMAL, " Stop serving:  GTO disappeared from queue:  %s info hash:  %s",  pathAndFileName.c_str(), torrRec->infoHash.c_str());
+      stopServingGto (pathAndFileName, activeTorrents, false);
+      return false;
+   }
 
-            (*listIter)->torrentSession->remove_torrent (mapIter->second->torrentHandle);
-            activeTorrents.erase (mapIter->first);
-            delete (mapIter->second);
-            (*listIter)->mapOfSessionTorrents.erase (mapIter++);
+   if (torrentModTime == torrRec->mtime)   // Has the GTO on disk changed
+   {
+      return true;
+   }
 
-            continue;
-         }
+   std::string newInfoHash = getInfoHash (pathAndFileName);
 
-         if (torrentModTime != mapIter->second->mtime)   // Has the GTO on disk changed
-         {
-            if (getInfoHash (mapIter->first) != mapIter->second->infoHash)
-            {
-               Log (PRIORITY_HIGH, "Stop serving:  GTO InfoHash Changed while serving:  %s info hash:  %s (new GTO infoHash %s will not be served)", mapIter->first.c_str(), mapIter->second->infoHash.c_str(), getInfoHash (mapIter->first).c_str()); 
+   if (newInfoHash != torrRec->infoHash)
+   {
+      Log (PRIORITY_HIGH, "Stop serving:  GTO InfoHash Changed while serving:  %s info hash:  %s (new GTO infoHash %s will not be served)", pathAndFileName.c_str(), torrRec->infoHash.c_str(), newInfoHash.c_str()); 
+      stopServingGto (pathAndFileName, activeTorrents, true);
+      return false;
+   }
 
-               (*listIter)->torrentSession->remove_torrent (mapIter->second->torrentHandle);
-               deleteGTOfromQueue (mapIter->first);
-               activeTorrents.erase (mapIter->first);
-               delete (mapIter->second);
-               (*listIter)->mapOfSessionTorrents.erase (mapIter++);
+   torrRec->mtime = torrentModTime;
+   torrRec->expires = getExpirationTime (pathAndFileName);
 
-               continue;
-            }
-           
-            mapIter->second->mtime = torrentModTime;
-            mapIter->second->expires = getExpirationTime (mapIter->first);
+   if (timeNow <  torrRec->expires)
+   {
+      torrRec->overTimeAlertIssued = false;
+   }
 
-            if (timeNow <  mapIter->second->expires)
-            {
-               mapIter->second->overTimeAlertIssued = false;
-            }
+   scheduleExpiryCheck (pathAndFileName, torrRec, torrRec->expires);
 
-            Log (PRIORITY_NORMAL, "Expiration Update:  GTO %s info hash:  %s has a new expiration time %d", mapIter->first.c_str(), mapIter->second->infoHash.c_str(), mapIter->second->expires);
-         }
+   Log (PRIORITY_NORMAL, "Expiration Update:  GTO %s info hash:  %s has a new expiration time %d", pathAndFileName.c_str(), torrRec->infoHash.c_str(), torrRec->expires);
 
-         // if an upload torrent and the current state is seeding, set the overtime flag to true on the first obversation of this stats
-         // on the 2nd observation of this state, the gto will removed from the upload queue and removed from seeding
-         // This gives the upload plenty of time to recognize that the upload has completed (I.E., the upload client recognizes
-         // two seeders are present due to tracker scraping
-         if (mapIter->second->downloadGTO == false && mapIter->second->torrentHandle.status().state == libtorrent::torrent_status::seeding)
-         {
-            if (!mapIter->second->overTimeAlertIssued)   // first pass set true
-            {
-               mapIter->second->overTimeAlertIssued = true;
-               screenOutput (std::setw (41) << getFileName (mapIter->first) << " Status: " << server_state_str[torrentStatus.state] << "  expires in approximately:  00:01:00.", VERBOSE_1);
-               mapIter++;
-            }
-            else                                         // second pass, remove the torrent from serving
-            {
-               Log (PRIORITY_NORMAL, "Stop serving:  upload complete %s info hash:  %s", mapIter->first.c_str(), getInfoHash (mapIter->first).c_str());
+   return true;
+}
 
-               (*listIter)->torrentSession->remove_torrent (mapIter->second->torrentHandle);
-               deleteGTOfromQueue (mapIter->first);
-               activeTorrents.erase (mapIter->first);
-               delete (mapIter->second);
-               (*listIter)->mapOfSessionTorrents.erase (mapIter++);
-            }
+void gtServer::scheduleExpiryCheck (std::string pathAndFileName, activeTorrentRec *torrRec, time_t when)
+{
+   torrRec->nextExpiryCheck = when;
+   _expiryQueue.push (expiryEntry (when, pathAndFileName));
+}
 
-            continue;
-         }
+gtBase::activeTorrentRec *gtServer::findServedGto (std::string pathAndFileName)
+{
+   std::map <std::string, activeSessionRec *>::iterator indexIter = _servedGtoSessions.find (pathAndFileName);
 
-         if (timeNow >= mapIter->second->expires || shutdownFlag)       // This GTO is expired or shutting down
-         {
-            std::vector <libtorrent::peer_info> peers;
+   if (indexIter == _servedGtoSessions.end ())
+   {
+      return NULL;
+   }
 
-            mapIter->second->torrentHandle.get_peer_info (peers);
+   std::map <std::string, activeTorrentRec *>::iterator mapIter = indexIter->second->mapOfSessionTorrents.find (pathAndFileName);
 
-            if (peers.size () == 0 || shutdownFlag)
-            {
-               Log (PRIORITY_NORMAL, "%s:  %s info hash:  %s", (shutdownFlag ? "Shutting Down (stop servering)" : "Expiring"), mapIter->first.c_str(), getInfoHash (mapIter->first).c_str());
+   if (mapIter == indexIter->second->mapOfSessionTorrents.end ())
+   {
+      return NULL;
+   }
 
-               (*listIter)->torrentSession->remove_torrent (mapIter->second->torrentHandle);
-               if (!shutdownFlag)        // If shutting down, keep the GTO files in the queue
-               {
-                  deleteGTOfromQueue (mapIter->first);
-               }
-               activeTorrents.erase (mapIter->first);
-               delete (mapIter->second);
-               (*listIter)->mapOfSessionTorrents.erase (mapIter++);
-            }
-            else
+   return mapIter->second;
+}
+
+void gtServer::stopServingGto (std::string pathAndFileName, std::set <std::string> &activeTorrents, bool removeFromQueue)
+{
+   std::map <std::string, activeSessionRec *>::iterator indexIter = _servedGtoSessions.find (pathAndFileName);
+
+   if (indexIter != _servedGtoSessions.end ())
+   {
+      activeSessionRec *sessionRec = indexIter->second;
+      std::map <std::string, activeTorrentRec *>::iterator mapIter = sessionRec->mapOfSessionTorrents.find (pathAndFileName);
+
+      if (mapIter != sessionRec->mapOfSessionTorrents.end ())
+      {
+         if (mapIter->second->signingJob)
+         {
+            // no point signing a CSR for it anymore, a job already underway
+            // is ignored when it completes
+            pthread_mutex_lock (&_signingLock);
+
+            for (std::deque <signingJob>::iterator jobIter = _signingQueue.begin (); jobIter != _signingQueue.end (); jobIter++)
             {
-               if (!mapIter->second->overTimeAlertIssued)
+               if (jobIter->jobId == mapIter->second->signingJob)
                {
-                  Log (PRIORITY_NORMAL, "Overtime serving:  %s info hash:  %s (%d actor(s) connected)", mapIter->first.c_str(), getInfoHash (mapIter->first).c_str(), peers.size());
-                  mapIter->second->overTimeAlertIssued = true;
+                  _signingQueue.erase (jobIter);
+                  _pendingSignings--;
+                  break;
                }
-   
-               screenOutput (std::setw (41) << getFileName (mapIter->first) << " Status: " << server_state_str[torrentStatus.state] << "  expired, but an actors continue to download", VERBOSE_1);
-               mapIter++;
             }
+
+            pthread_mutex_unlock (&_signingLock);
          }
-         else
-         {
-            mapIter++;
-         }
+
+         _servedInfoHashes.erase (mapIter->second->torrentParams.ti->info_hash ());
+         sessionRec->torrentSession->remove_torrent (mapIter->second->torrentHandle);
+         delete (mapIter->second);
+         sessionRec->mapOfSessionTorrents.erase (mapIter);
+         _gtosRemoved++;
       }
-      listIter++;
+
+      _servedGtoSessions.erase (indexIter);
+   }
+
+   if (removeFromQueue)
+   {
+      deleteGTOfromQueue (pathAndFileName);
    }
+
+   _uploadGtos.erase (pathAndFileName);
+   activeTorrents.erase (pathAndFileName);
 }
 
 bool gtServer::isDownloadModeGetFromGTO (std::string torrentPathAndFileName)
@@ -445,8 +887,12 @@ bool gtServer::addTorrentToServingList (std::string pathAndFileName, bool startU
 
    activeTorrentRec *newTorrRec = new (activeTorrentRec);
 
-   newTorrRec->expires = getExpirationTime (pathAndFileName);
    newTorrRec->overTimeAlertIssued = false;
+   newTorrRec->state = libtorrent::torrent_status::queued_for_checking;
+   newTorrRec->numPeers = 0;
+   newTorrRec->totalPayloadUpload = 0;
+   newTorrRec->cachePriority = 0;
+   newTorrRec->signingJob = 0;
 
    time_t torrentModTime = 0;
    if (statFile (pathAndFileName, torrentModTime) < 0)
@@ -458,14 +904,31 @@ bool gtServer::addTorrentToServingList (std::string pathAndFileName, bool startU
    }
 
    newTorrRec->mtime = torrentModTime;
-   newTorrRec->infoHash = getInfoHash (pathAndFileName);
 
-   std::string uuid = pathAndFileName;
+   // GTOs handed over unchanged by the previous instance skip the gtoinfo
+   // calls, certificate signing and checking of the data
+   std::map <std::string, handoffRec>::iterator handoffIter = _handoffGtos.find (pathAndFileName);
+   handoffRec *handoff = NULL;
 
-   uuid = uuid.substr (0, uuid.rfind ('.'));
-   uuid = getFileName (uuid); 
+   if (handoffIter != _handoffGtos.end () && handoffIter->second.mtime == torrentModTime)
+   {
+      handoff = &handoffIter->second;
+   }
+
+   if (handoff)
+   {
+      newTorrRec->expires = handoff->expires;
+      newTorrRec->infoHash = handoff->infoHash;
+   }
+   else
+   {
+      newTorrRec->expires = getExpirationTime (pathAndFileName);
+      newTorrRec->infoHash = getInfoHash (pathAndFileName);
+   }
 
-   if (isDownloadModeGetFromGTO (pathAndFileName))
+   std::string uuid = getGtoUuid (pathAndFileName);
+
+   if (handoff ? handoff->downloadGTO : isDownloadModeGetFromGTO (pathAndFileName))
    {
       newTorrRec->torrentParams.seed_mode = true;
       newTorrRec->torrentParams.disable_seed_hash = true;
@@ -487,11 +950,24 @@ bool gtServer::addTorrentToServingList (std::string pathAndFileName, bool startU
    {
       newTorrRec->torrentParams.storage = zero_storage_constructor;
    }
+   else if (_use_uring_storage)
+   {
+      newTorrRec->torrentParams.storage = uring_storage_constructor;
+   }
+   else if (_use_mmap_storage)
+   {
+      newTorrRec->torrentParams.storage = mmap_storage_constructor;
+   }
 
    newTorrRec->torrentParams.auto_managed = false;
    newTorrRec->torrentParams.allow_rfc1918_connections = true;
    newTorrRec->torrentParams.save_path = "./";
 
+   if (handoff && handoff->resumeData.size () > 0)
+   {
+      newTorrRec->torrentParams.resume_data = &handoff->resumeData;
+   }
+
    libtorrent::error_code torrentError;
    newTorrRec->torrentParams.ti = new libtorrent::torrent_info (pathAndFileName, torrentError);
 
@@ -504,6 +980,7 @@ bool gtServer::addTorrentToServingList (std::string pathAndFileName, bool startU
    }
 
    newTorrRec->torrentHandle = workSession->torrentSession->add_torrent (newTorrRec->torrentParams, torrentError);
+   newTorrRec->torrentParams.resume_data = NULL;     // consumed by add_torrent ()
 
    if (torrentError)
    {
@@ -515,53 +992,214 @@ bool gtServer::addTorrentToServingList (std::string pathAndFileName, bool startU
 
    int sslCertSize = newTorrRec->torrentParams.ti->ssl_cert().size();
 
-   if (sslCertSize > 0 && _devMode == false)
+   if (sslCertSize > 0 && _devMode == false && !(handoff && handoff->haveCert))
    {
-      bool status = generateSSLcertAndGetSigned(pathAndFileName, _serverModeCsrSigningUrl, uuid); 
-
-      if (status == false)
+      // stays paused until the signing threads return the certificate
+      queueSigningJob (pathAndFileName, newTorrRec, uuid, startUpMode);
+   }
+   else
+   {
+      if (sslCertSize > 0)
       {
-         Log (PRIORITY_HIGH, "Failure adding %s to Served GTOs, GTO file removed.  Error:  unable to obtain a signed SSL Certificate.", pathAndFileName.c_str());
-         delete newTorrRec;
-         deleteGTOfromQueue (pathAndFileName);
-         return false;
+         std::string sslCert = _tmpDir + uuid + ".crt";
+         std::string sslKey = _tmpDir + uuid + ".key";
+
+         newTorrRec->torrentHandle.set_ssl_certificate (sslCert, sslKey, _dhParamsFile);   // no passphrase
       }
+
+      resumeServedGto (newTorrRec, startUpMode);
+   }
+
+   screenOutput ("adding " << getFileName (pathAndFileName) << " to files being served", VERBOSE_1);
+
+   Log (PRIORITY_NORMAL, "Begin serving:  %s info hash:  %s expires:  %d (%s%s)", pathAndFileName.c_str(), newTorrRec->infoHash.c_str(), newTorrRec->expires, (newTorrRec->torrentParams.seed_mode == true ? "download" : "upload"), (handoff ? ", handed off" : ""));
+   workSession->mapOfSessionTorrents[pathAndFileName] = newTorrRec;
+   _servedGtoSessions[pathAndFileName] = workSession;
+   _servedInfoHashes[newTorrRec->torrentParams.ti->info_hash ()] = pathAndFileName;
+   _gtosAdded++;
+
+   // GTOs already in the queue at start up have been waiting on the
+   // previous server instance, not on this one
+   if (!startUpMode)
+   {
+      _queueIngestLag.observe (time (NULL) - torrentModTime);
    }
 
-   if (sslCertSize > 0)
+   if (!newTorrRec->downloadGTO)
    {
-      std::string sslCert = _tmpDir + uuid + ".crt";
-      std::string sslKey = _tmpDir + uuid + ".key";
-            
-      newTorrRec->torrentHandle.set_ssl_certificate (sslCert, sslKey, _dhParamsFile);   // no passphrase
+      _uploadGtos.insert (pathAndFileName);
    }
 
-   // The resume() causes the first announce of the torrent to be sent
-   // to the tracker. If there are a lot of .gto files sitting in the
-   // workqueue which are all added to the session at once, then we
-   // will effectively DOS the tracker (looks like syn flood if N is
-   // large, say 15K). Staggering the announcements with a delay
-   // breaks the burstiness down into smaller groups.
-   // Nov 2013, update to apply delays only during startup
+   scheduleExpiryCheck (pathAndFileName, newTorrRec, newTorrRec->expires);
+
+   return true;
+}
+
+// The resume() causes the first announce of the torrent to be sent
+// to the tracker. If there are a lot of .gto files sitting in the
+// workqueue which are all added to the session at once, then we
+// will effectively DOS the tracker (looks like syn flood if N is
+// large, say 15K). Staggering the announcements with a delay
+// breaks the burstiness down into smaller groups.
+// Nov 2013, update to apply delays only during startup
+void gtServer::resumeServedGto (activeTorrentRec *torrRec, bool startUpMode)
+{
    if (startUpMode)
    {
       static unsigned int stagger_announce_step = 0;
       const boost::int64_t delay_step_ms = 500;
       const int max_steps = 60; // gives max delay of 30s
-      newTorrRec->torrentHandle.resume (delay_step_ms * (stagger_announce_step % max_steps));
+      torrRec->torrentHandle.resume (delay_step_ms * (stagger_announce_step % max_steps));
       stagger_announce_step++;
    }
    else
    {
-      newTorrRec->torrentHandle.resume(0);
+      torrRec->torrentHandle.resume(0);
    }
+}
 
-   screenOutput ("adding " << getFileName (pathAndFileName) << " to files being served", VERBOSE_1);
+void gtServer::queueSigningJob (std::string pathAndFileName, activeTorrentRec *torrRec, std::string uuid, bool startUpMode)
+{
+   signingJob job;
+
+   job.jobId = ++_lastSigningJob;
+   job.pathAndFileName = pathAndFileName;
+   job.infoHash = torrRec->infoHash;
+   job.uuid = uuid;
+   job.startUpMode = startUpMode;
+   job.signedOk = false;
+   job.signingSeconds = 0.0;
+
+   torrRec->signingJob = job.jobId;
+   _pendingSignings++;
+
+   pthread_mutex_lock (&_signingLock);
+   _signingQueue.push_back (job);
+   pthread_cond_signal (&_signingWork);
+   pthread_mutex_unlock (&_signingLock);
+}
 
-   Log (PRIORITY_NORMAL, "Begin serving:  %s info hash:  %s expires:  %d (%s)", pathAndFileName.c_str(), newTorrRec->infoHash.c_str(), newTorrRec->expires, (newTorrRec->torrentParams.seed_mode == true ? "download" : "upload"));
-   workSession->mapOfSessionTorrents[pathAndFileName] = newTorrRec;
+// Called from the main loop, installs the certificates the signing threads
+// obtained and starts serving those GTOs
+void gtServer::completeSignedGtos (std::set <std::string> &activeTorrents)
+{
+   std::deque <signingJob> signedJobs;
 
-   return true;
+   pthread_mutex_lock (&_signingLock);
+   signedJobs.swap (_signedJobs);
+   pthread_mutex_unlock (&_signingLock);
+
+   for (std::deque <signingJob>::iterator jobIter = signedJobs.begin (); jobIter != signedJobs.end (); jobIter++)
+   {
+      _pendingSignings--;
+
+      activeTorrentRec *torrRec = findServedGto (jobIter->pathAndFileName);
+
+      if (!torrRec || torrRec->signingJob != jobIter->jobId)
+      {
+         continue;      // stopped serving the GTO while it was being signed
+      }
+
+      torrRec->signingJob = 0;
+
+      if (!jobIter->signedOk)
+      {
+         _csrSigningFailures++;
+         Log (PRIORITY_HIGH, "Failure adding %s to Served GTOs, GTO file removed.  Error:  unable to obtain a signed SSL Certificate.", jobIter->pathAndFileName.c_str());
+         stopServingGto (jobIter->pathAndFileName, activeTorrents, true);
+         continue;
+      }
+
+      _csrSigningLatency.observe (jobIter->signingSeconds);
+
+      std::string sslCert = _tmpDir + jobIter->uuid + ".crt";
+      std::string sslKey = _tmpDir + jobIter->uuid + ".key";
+
+      torrRec->torrentHandle.set_ssl_certificate (sslCert, sslKey, _dhParamsFile);   // no passphrase
+
+      resumeServedGto (torrRec, jobIter->startUpMode);
+
+      screenOutput ("signed certificate ready for " << getFileName (jobIter->pathAndFileName), VERBOSE_1);
+   }
+}
+
+void gtServer::startSigningThreads ()
+{
+   int createError = 0;
+
+   for (int thread = 0; thread < SERVER_CSR_SIGNING_THREADS; thread++)
+   {
+      pthread_t signingThreadId;
+
+      if ((createError = pthread_create (&signingThreadId, NULL, signingThread, this)) != 0)
+      {
+         break;
+      }
+
+      _signingThreads.push_back (signingThreadId);
+   }
+
+   if (_signingThreads.size () == 0)
+   {
+      gtError ("Failure starting the CSR signing threads", 220, ERRNO_ERROR, createError);
+   }
+}
+
+// Jobs still queued are dropped, their GTOs stay in the queue directory.
+// Signing requests already underway are allowed to finish.
+void gtServer::stopSigningThreads ()
+{
+   pthread_mutex_lock (&_signingLock);
+   _signingShutdown = true;
+   _signingQueue.clear ();
+   pthread_cond_broadcast (&_signingWork);
+   pthread_mutex_unlock (&_signingLock);
+
+   for (std::vector <pthread_t>::iterator threadIter = _signingThreads.begin (); threadIter != _signingThreads.end (); threadIter++)
+   {
+      pthread_join (*threadIter, NULL);
+   }
+
+   _signingThreads.clear ();
+}
+
+void *gtServer::signingThread (void *serverPtr)
+{
+   ((gtServer *) serverPtr)->signQueuedGtos ();
+   return NULL;
+}
+
+void gtServer::signQueuedGtos ()
+{
+   pthread_mutex_lock (&_signingLock);
+
+   while (1)
+   {
+      while (_signingQueue.empty () && !_signingShutdown)
+      {
+         pthread_cond_wait (&_signingWork, &_signingLock);
+      }
+
+      if (_signingShutdown)
+      {
+         break;
+      }
+
+      signingJob job = _signingQueue.front ();
+      _signingQueue.pop_front ();
+
+      pthread_mutex_unlock (&_signingLock);
+
+      libtorrent::ptime signingStart = libtorrent::time_now_hires ();
+
+      job.signedOk = acquireSignedCSR (job.infoHash, _serverModeCsrSigningUrl, job.uuid);
+      job.signingSeconds = libtorrent::total_milliseconds (libtorrent::time_now_hires () - signingStart) / 1000.0;
+
+      pthread_mutex_lock (&_signingLock);
+      _signedJobs.push_back (job);
+   }
+
+   pthread_mutex_unlock (&_signingLock);
 }
 
 gtServer::activeSessionRec *gtServer::findSession ()
@@ -601,6 +1239,13 @@ libtorrent::session *gtServer::addActiveSession ()
    if (!sessionNew)
       return NULL;
 
+   if (_kernelTls)
+   {
+      libtorrent::session_settings settings = sessionNew->settings ();
+      settings.use_kernel_tls = true;
+      sessionNew->set_settings (settings);
+   }
+
    int portUsed = sessionNew->listen_port ();
    int sslPortUsed = sessionNew->ssl_listen_port ();
 
@@ -647,3 +1292,227 @@ time_t gtServer::getExpirationTime (std::string torrentPathAndFileName)
 
    return expireTime;
 }
+
+std::string gtServer::getGtoUuid (std::string torrentPathAndFileName)
+{
+   std::string uuid = torrentPathAndFileName;
+
+   uuid = uuid.substr (0, uuid.rfind ('.'));
+
+   return getFileName (uuid);
+}
+
+// determine location of control files (stop, handoff) on this OS
+std::string gtServer::getTempDirFile (std::string fileName)
+{
+   libtorrent::error_code ec;
+   boost::filesystem::path tempFile = boost::filesystem::temp_directory_path(ec);
+
+   if (ec)
+   {
+      // An error occurred, use a default
+      return "/tmp/" + fileName;
+   }
+
+   tempFile /= fileName;
+   return tempFile.string();
+}
+
+// Leaves everything the next server instance needs to take over serving
+// quickly in SERVER_HANDOFF_DIR in the data path:  the served GTOs with
+// their expiration and mode, resume data of GTOs being uploaded and the
+// signed certificates and keys of SSL GTOs.
+void gtServer::saveHandoffState ()
+{
+   std::string handoffPath = _serverDataPath + "/" + SERVER_HANDOFF_DIR + "/";
+
+   libtorrent::error_code ec;
+   boost::filesystem::remove_all (handoffPath, ec);
+
+   if (mkdir (handoffPath.c_str(), 0700) != 0)
+   {
+      gtError ("Failure creating handoff directory " + handoffPath + ", the next instance will start from scratch", NO_EXIT, ERRNO_ERROR, errno);
+      return;
+   }
+
+   // GTOs in download mode are seeded without checking, only GTOs being
+   // uploaded to this server need resume data to avoid a full check
+   _handoffResumeData.clear ();
+   _pendingResumeData = 0;
+
+   for (std::set <std::string>::iterator setIter = _uploadGtos.begin (); setIter != _uploadGtos.end (); setIter++)
+   {
+      activeTorrentRec *torrRec = findServedGto (*setIter);
+
+      if (torrRec && torrRec->torrentHandle.is_valid ())
+      {
+         torrRec->torrentHandle.save_resume_data (libtorrent::torrent_handle::flush_disk_cache);
+         _pendingResumeData++;
+      }
+   }
+
+   time_t giveUp = time (NULL) + SERVER_HANDOFF_RESUME_TIMEOUT;
+
+   while (_pendingResumeData > 0 && time (NULL) < giveUp)
+   {
+      for (std::list <activeSessionRec *>::iterator listIter = _activeSessions.begin (); listIter != _activeSessions.end (); listIter++)
+      {
+         checkAlerts ((*listIter)->torrentSession);
+      }
+      usleep (ALERT_CHECK_PAUSE_INTERVAL);
+   }
+
+   if (_pendingResumeData > 0)
+   {
+      Log (PRIORITY_HIGH, "Handoff:  timed out waiting for resume data of %d GTO(s)", _pendingResumeData);
+   }
+
+   libtorrent::entry state (libtorrent::entry::dictionary_t);
+   state["version"] = SERVER_HANDOFF_VERSION;
+   state["saved"] = (libtorrent::size_type) time (NULL);
+   libtorrent::entry::list_type &gtoList = state["gtos"].list ();
+
+   for (std::map <std::string, activeSessionRec *>::iterator indexIter = _servedGtoSessions.begin (); indexIter != _servedGtoSessions.end (); indexIter++)
+   {
+      activeTorrentRec *torrRec = findServedGto (indexIter->first);
+
+      if (!torrRec)
+      {
+         continue;
+      }
+
+      libtorrent::entry gto (libtorrent::entry::dictionary_t);
+      gto["path"] = indexIter->first;
+      gto["info-hash"] = torrRec->infoHash;
+      gto["mtime"] = (libtorrent::size_type) torrRec->mtime;
+      gto["expires"] = (libtorrent::size_type) torrRec->expires;
+      gto["download"] = torrRec->downloadGTO ? 1 : 0;
+
+      std::string uuid = getGtoUuid (indexIter->first);
+      std::string sslCert = _tmpDir + uuid + ".crt";
+      std::string sslKey = _tmpDir + uuid + ".key";
+
+      // certificates still being signed are left for the next instance to request
+      if (torrRec->signingJob == 0 && !statFile (sslCert) && !statFile (sslKey))
+      {
+         libtorrent::error_code certError, keyError;
+         boost::filesystem::copy_file (sslCert, handoffPath + uuid + ".crt", certError);
+         boost::filesystem::copy_file (sslKey, handoffPath + uuid + ".key", keyError);
+
+         gto["cert"] = (certError || keyError) ? 0 : 1;
+      }
+
+      std::map <std::string, libtorrent::entry>::iterator resumeIter = _handoffResumeData.find (indexIter->first);
+
+      if (resumeIter != _handoffResumeData.end ())
+      {
+         gto["resume"] = resumeIter->second;
+      }
+
+      gtoList.push_back (gto);
+   }
+
+   // written under a temporary name, a state file is either complete or missing
+   std::string statePathAndFile = handoffPath + SERVER_HANDOFF_STATE_FILE;
+   std::string tmpPathAndFile = statePathAndFile + ".tmp";
+
+   std::ofstream stateFile (tmpPathAndFile.c_str (), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+   libtorrent::bencode (std::ostream_iterator <char> (stateFile), state);
+   stateFile.close ();
+
+   if (stateFile.fail () || rename (tmpPathAndFile.c_str (), statePathAndFile.c_str ()) != 0)
+   {
+      int writeErrno = errno;
+      unlink (tmpPathAndFile.c_str ());
+      gtError ("Failure writing handoff state " + statePathAndFile + ", the next instance will start from scratch", NO_EXIT, ERRNO_ERROR, writeErrno);
+      return;
+   }
+
+   Log (PRIORITY_NORMAL, "Handoff:  saved state of %d served GTO(s) (%d with resume data)", (int) gtoList.size (), (int) _handoffResumeData.size ());
+}
+
+void gtServer::loadHandoffState ()
+{
+   std::string handoffPath = _serverDataPath + "/" + SERVER_HANDOFF_DIR + "/";
+   std::string statePathAndFile = handoffPath + SERVER_HANDOFF_STATE_FILE;
+
+   std::ifstream stateFile (statePathAndFile.c_str (), std::ios_base::in | std::ios_base::binary);
+
+   if (!stateFile.good ())
+   {
+      return;
+   }
+
+   std::vector <char> stateBuffer ((std::istreambuf_iterator <char> (stateFile)), std::istreambuf_iterator <char> ());
+   stateFile.close ();
+
+   libtorrent::lazy_entry state;
+   libtorrent::error_code ec;
+
+   if (stateBuffer.empty () || libtorrent::lazy_bdecode (&stateBuffer[0], &stateBuffer[0] + stateBuffer.size (), state, ec) != 0 ||
+       state.type () != libtorrent::lazy_entry::dict_t || state.dict_find_int_value ("version") != SERVER_HANDOFF_VERSION)
+   {
+      Log (PRIORITY_HIGH, "Handoff:  ignoring unreadable state %s", statePathAndFile.c_str());
+      return;
+   }
+
+   time_t saved = state.dict_find_int_value ("saved");
+
+   if (time (NULL) - saved > SERVER_HANDOFF_MAX_AGE)
+   {
+      Log (PRIORITY_NORMAL, "Handoff:  ignoring state saved %d seconds ago", (int) (time (NULL) - saved));
+      return;
+   }
+
+   libtorrent::lazy_entry const *gtoList = state.dict_find_list ("gtos");
+
+   for (int gtoIndex = 0; gtoList && gtoIndex < gtoList->list_size (); gtoIndex++)
+   {
+      libtorrent::lazy_entry const *gto = gtoList->list_at (gtoIndex);
+
+      if (gto->type () != libtorrent::lazy_entry::dict_t)
+      {
+         continue;
+      }
+
+      std::string pathAndFileName = gto->dict_find_string_value ("path");
+      handoffRec &rec = _handoffGtos[pathAndFileName];
+
+      rec.mtime = gto->dict_find_int_value ("mtime");
+      rec.expires = gto->dict_find_int_value ("expires");
+      rec.infoHash = gto->dict_find_string_value ("info-hash");
+      rec.downloadGTO = gto->dict_find_int_value ("download") != 0;
+      rec.haveCert = false;
+
+      libtorrent::lazy_entry const *resumeData = gto->dict_find_dict ("resume");
+
+      if (resumeData)
+      {
+         std::pair <char const *, int> section = resumeData->data_section ();
+         rec.resumeData.assign (section.first, section.first + section.second);
+      }
+
+      if (gto->dict_find_int_value ("cert"))
+      {
+         std::string uuid = getGtoUuid (pathAndFileName);
+         libtorrent::error_code certError, keyError;
+
+         boost::filesystem::copy_file (handoffPath + uuid + ".crt", _tmpDir + uuid + ".crt", certError);
+         boost::filesystem::copy_file (handoffPath + uuid + ".key", _tmpDir + uuid + ".key", keyError);
+
+         rec.haveCert = !certError && !keyError;
+      }
+   }
+
+   Log (PRIORITY_NORMAL, "Handoff:  taking over %d GTO(s) from the previous instance", (int) _handoffGtos.size ());
+}
+
+// The handoff state is only good for the first queue scan, afterwards
+// GTOs are added the regular way
+void gtServer::discardHandoffState ()
+{
+   _handoffGtos.clear ();
+
+   libtorrent::error_code ec;
+   boost::filesystem::remove_all (_serverDataPath + "/" + SERVER_HANDOFF_DIR, ec);
+}
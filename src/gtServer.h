@@ -38,8 +38,12 @@
 #ifndef GT_SERVER_H_
 #define GT_SERVER_H_
 
+#include <queue>
+#include <deque>
+
 #include "gtBase.h"
 #include "gtServerOpts.h"
+#include "gtMetrics.h"
 
 class gtServer : public gtBase
 {
@@ -49,6 +53,9 @@ class gtServer : public gtBase
       void run ();
 
    protected:
+      void processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates);
+      void processResumeData (libtorrent::torrent_handle &torrentHandle, boost::shared_ptr <libtorrent::entry> resumeData);
+      unsigned int maxSessions () { return _maxActiveSessions; }
 
    private:
       std::string _serverQueuePath;
@@ -58,17 +65,102 @@ class gtServer : public gtBase
       std::list <activeSessionRec *> _activeSessions;
       unsigned int _maxActiveSessions;
 
+      // Served GTOs ordered by the next time maintenance needs to look at
+      // them (expiration or overtime re-check).  Entries are not removed
+      // when a GTO stops being served or is rescheduled, stale entries are
+      // discarded when they reach the top of the queue.
+      typedef std::pair <time_t, std::string> expiryEntry;
+      std::priority_queue <expiryEntry, std::vector <expiryEntry>, std::greater <expiryEntry> > _expiryQueue;
+
+      std::map <std::string, activeSessionRec *> _servedGtoSessions;   // GTO path -> session serving it
+      std::set <std::string> _uploadGtos;                              // served GTOs in upload mode
+      std::map <libtorrent::sha1_hash, std::string> _servedInfoHashes; // info hash -> GTO path, for status updates
+
+      time_t _queueDirMtime;           // queue directory mtime at the last scan
+      time_t _queueDirScanTime;        // time of the last queue directory scan
+      unsigned int _maintenanceCycles;
+
+      // metrics endpoint, disabled unless --metrics-port is given
+      int _metricsPort;
+      gtMetrics _metrics;
+      time_t _nextMetricsUpdate;
+      gtMetricsHistogram _csrSigningLatency;
+      gtMetricsHistogram _queueIngestLag;
+      int64_t _csrSigningFailures;
+      int64_t _gtosAdded;
+      int64_t _gtosRemoved;
+
+      // State handed over by the previous server instance, used while the
+      // queue is first scanned and discarded afterwards
+      typedef struct handoffRec_
+      {
+         time_t mtime;                    // GTO mtime, the state is ignored if the GTO changed since
+         time_t expires;
+         std::string infoHash;
+         bool downloadGTO;
+         bool haveCert;                   // signed certificate and key were restored to _tmpDir
+         std::vector <char> resumeData;   // bencoded, empty for GTOs in download mode
+      } handoffRec;
+
+      // CSRs are signed on their own threads.  GTOs needing a certificate
+      // are added to their session paused and resumed by the main loop
+      // once it arrives.
+      typedef struct signingJob_
+      {
+         unsigned int jobId;
+         std::string pathAndFileName;
+         std::string infoHash;
+         std::string uuid;
+         bool startUpMode;
+         bool signedOk;
+         double signingSeconds;
+      } signingJob;
+
+      int _keyPoolSize;
+      bool _kernelTls;
+      unsigned int _lastSigningJob;
+      std::deque <signingJob> _signingQueue;        // waiting for a signing thread
+      std::deque <signingJob> _signedJobs;          // finished, waiting for the main loop
+      int _pendingSignings;                         // queued or being signed
+      std::vector <pthread_t> _signingThreads;
+      pthread_mutex_t _signingLock;
+      pthread_cond_t _signingWork;
+      bool _signingShutdown;
+
+      std::map <std::string, handoffRec> _handoffGtos;                 // GTO path -> state from the previous instance
+      std::map <std::string, libtorrent::entry> _handoffResumeData;    // GTO path -> resume data collected for the next instance
+      int _pendingResumeData;
+
       void getFilesInQueueDirectory (vectOfStr &files);
+      bool queueDirectoryChanged ();
+      void scanQueueDirectory (std::set <std::string> &activeTorrents, bool startUpMode);
       void checkSessions();
       void runServerMode();
       void processServerModeAlerts();
+      void updateMetrics ();
       void servedGtosMaintenance (time_t timeNow, std::set <std::string> &activeTorrents, bool shutdownFlag = false);
+      bool checkServedGtoOnDisk (std::string pathAndFileName, time_t timeNow, std::set <std::string> &activeTorrents);
+      void scheduleExpiryCheck (std::string pathAndFileName, activeTorrentRec *torrRec, time_t when);
+      void stopServingGto (std::string pathAndFileName, std::set <std::string> &activeTorrents, bool removeFromQueue);
+      activeTorrentRec *findServedGto (std::string pathAndFileName);
       bool isDownloadModeGetFromGTO (std::string torrentPathAndFileName);
       bool addTorrentToServingList (std::string, bool);
       gtBase::activeSessionRec *findSession ();
       void deleteGTOfromQueue (std::string fileName);
       libtorrent::session *addActiveSession ();
       time_t getExpirationTime (std::string torrentPathAndFileName);
+      std::string getGtoUuid (std::string torrentPathAndFileName);
+      std::string getTempDirFile (std::string fileName);
+      void saveHandoffState ();
+      void loadHandoffState ();
+      void discardHandoffState ();
+      void resumeServedGto (activeTorrentRec *torrRec, bool startUpMode);
+      void queueSigningJob (std::string pathAndFileName, activeTorrentRec *torrRec, std::string uuid, bool startUpMode);
+      void completeSignedGtos (std::set <std::string> &activeTorrents);
+      void startSigningThreads ();
+      void stopSigningThreads ();
+      static void *signingThread (void *serverPtr);
+      void signQueuedGtos ();
 };
 
 #endif
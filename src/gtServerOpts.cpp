@@ -64,7 +64,10 @@ gtServerOpts::gtServerOpts ():
     m_serverForceDownload (false),
     m_serverQueuePath (""),
     m_serverForeground(false),
-    m_serverPidFile (DEFAULT_PID_FILE)
+    m_serverPidFile (DEFAULT_PID_FILE),
+    m_metricsPort (0),
+    m_keyPoolSize (SERVER_KEY_POOL_SIZE),
+    m_kernelTls (false)
 {
 }
 
@@ -82,6 +85,10 @@ gtServerOpts::add_options ()
         (OPT_FOREGROUND,                         "run in the foreground (do not deamonize)")
         (OPT_PIDFILE,              opt_string(), "full path and filename of the process's pid (ignored when --" OPT_FOREGROUND " is active")
         (OPT_FORCE_DL_MODE,                      "force added GTOs to download mode")
+        (OPT_METRICS_PORT,         opt_int(),    "serve metrics on http://127.0.0.1:<port>/metrics")
+        (OPT_KEY_POOL_SIZE,        opt_int(),    "number of pre-generated SSL keys to keep ready (0 disables)")
+        (OPT_KERNEL_TLS,                         "have the kernel encrypt data sent on SSL connections (Linux)")
+        (OPT_DIRECT_IO,                          "bypass the page cache for GTO files")
         ;
     add_desc (m_server_desc);
 
@@ -105,6 +112,10 @@ gtServerOpts::processOptions ()
     processOption_Queue ();
     processOption_ServerForceDownload ();
     processOption_Foreground ();
+    processOption_MetricsPort ();
+    processOption_KeyPoolSize ();
+    processOption_KernelTls ();
+    processOption_DirectIO ();
     processOption_SecurityAPI ();
 
     checkCredentials ();
@@ -175,3 +186,41 @@ void gtServerOpts::processOption_Foreground ()
     }
 
 }
+
+void gtServerOpts::processOption_MetricsPort ()
+{
+    if (m_vm.count (OPT_METRICS_PORT) < 1)
+    {
+        return;
+    }
+
+    m_metricsPort = m_vm[OPT_METRICS_PORT].as<int>();
+
+    if (m_metricsPort < 1 || m_metricsPort > 65535)
+    {
+        commandLineError ("--" OPT_METRICS_PORT " out of range (1-65535)");
+    }
+}
+
+void gtServerOpts::processOption_KeyPoolSize ()
+{
+    if (m_vm.count (OPT_KEY_POOL_SIZE) < 1)
+    {
+        return;
+    }
+
+    m_keyPoolSize = m_vm[OPT_KEY_POOL_SIZE].as<int>();
+
+    if (m_keyPoolSize < 0 || m_keyPoolSize > SERVER_MAX_KEY_POOL_SIZE)
+    {
+        commandLineError ("--" OPT_KEY_POOL_SIZE " out of range (0-1024)");
+    }
+}
+
+void gtServerOpts::processOption_KernelTls ()
+{
+    if (m_vm.count (OPT_KERNEL_TLS) > 0)
+    {
+        m_kernelTls = true;
+    }
+}
@@ -52,6 +52,9 @@ private:
     void processOption_Queue ();
     void processOption_Server ();
     void processOption_ServerForceDownload ();
+    void processOption_MetricsPort ();
+    void processOption_KeyPoolSize ();
+    void processOption_KernelTls ();
 
 public:
     // Storage for data extracted from config/cli.
@@ -60,6 +63,9 @@ public:
     std::string m_serverQueuePath;
     bool m_serverForeground;
     std::string m_serverPidFile;
+    int m_metricsPort;
+    int m_keyPoolSize;
+    bool m_kernelTls;
 };
 
 #endif  /* GT_SERVER_OPTS_H */
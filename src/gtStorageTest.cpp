@@ -0,0 +1,461 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ */
+
+/*
+ * gtStorageTest.cpp
+ *
+ * Unit tests for the storages GeneTorrent adds to libtorrent, and for the
+ * division of gtdownload's shared rate limit.
+ *
+ * Each storage test builds a small file_storage whose pieces span several files,
+ * drives the storage the way the disk thread does, and checks what ends up
+ * in the files and the buffers.  Files are created under the directory
+ * given as the only argument, or the current directory.
+ */
+
+#include "gt_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "libtorrent/storage.hpp"
+#include "libtorrent/file_pool.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/disk_buffer_pool.hpp"
+#include "libtorrent/session_settings.hpp"
+#include "libtorrent/file.hpp"
+
+#include "gtUring.h"
+#include "gtUringStorage.h"
+#include "gtMmapStorage.h"
+#include "gtRateShare.h"
+#include "gtDefs.h"
+
+using namespace libtorrent;
+
+static int failures = 0;
+
+#define CHECK(x) \
+   do { if (!(x)) { ++failures; fprintf (stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #x); } } while (0)
+
+#define CHECK_EQUAL(x, y) \
+   do { if ((x) != (y)) { ++failures; fprintf (stderr, "%s:%d: CHECK_EQUAL failed: %s == %s: %lld != %lld\n", \
+      __FILE__, __LINE__, #x, #y, (long long) (x), (long long) (y)); } } while (0)
+
+static std::string testPath;
+
+// a storage as the disk thread sets it up, the settings and buffer pool
+// outlive it
+struct testStorage
+{
+   session_settings settings;
+   file_pool pool;
+   disk_buffer_pool diskPool;
+   boost::scoped_ptr <storage_interface> storage;
+
+   testStorage (storage_constructor_type constructor, file_storage &fs) :
+      diskPool (16 * 1024)
+   {
+      storage.reset (constructor (fs, 0, testPath, pool, std::vector <boost::uint8_t> ()));
+      storage->m_settings = &settings;
+      storage->m_disk_pool = &diskPool;
+      storage->initialize (false);
+   }
+};
+
+static void fillPattern (std::vector <char> &data, int seed)
+{
+   for (size_t i = 0; i < data.size (); ++i)
+   {
+      data[i] = char (i * 7 + seed);
+   }
+}
+
+static std::string readFile (std::string name)
+{
+   std::ifstream in (combine_path (testPath, name).c_str (), std::ios::binary);
+   return std::string ((std::istreambuf_iterator <char> (in)), std::istreambuf_iterator <char> ());
+}
+
+static void removeTestFiles ()
+{
+   error_code ec;
+   remove_all (combine_path (testPath, "temp_storage"), ec);
+   remove_all (combine_path (testPath, "moved"), ec);
+}
+
+// gives name new contents in a new file, a mapping of the old one keeps
+// seeing the old contents
+static void replaceFile (std::string name, std::string const &contents)
+{
+   std::string path = combine_path (testPath, name);
+   std::string tmp = path + ".new";
+   {
+      std::ofstream out (tmp.c_str (), std::ios::binary);
+      out.write (contents.data (), contents.size ());
+   }
+   CHECK_EQUAL (::rename (tmp.c_str (), path.c_str ()), 0);
+}
+
+// splits data into buffers of bufSize bytes
+static std::vector <file::iovec_t> makeBuffers (std::vector <char> &data, int bufSize)
+{
+   std::vector <file::iovec_t> bufs;
+
+   for (size_t offset = 0; offset < data.size (); offset += bufSize)
+   {
+      file::iovec_t b = { &data[offset], std::min (size_t (bufSize), data.size () - offset) };
+      bufs.push_back (b);
+   }
+
+   return bufs;
+}
+
+static bool uringAvailable ()
+{
+   gtUring ring;
+   return ring.init (URING_QUEUE_DEPTH);
+}
+
+// a large file followed by small sidecar files, the last piece spans all
+// three, and a pad file in between the first two pieces
+static void makeMultiFileStorage (file_storage &fs)
+{
+   fs.set_piece_length (16 * 1024);
+   fs.add_file ("temp_storage/data.bam", 30000);
+   fs.add_file ("temp_storage/.pad", 2768, file_storage::pad_file);
+   fs.add_file ("temp_storage/data.bam.bai", 100);
+   fs.add_file ("temp_storage/data.bam.md5", 33);
+   fs.set_num_pieces (3);
+}
+
+static void testUringMultiFile ()
+{
+   removeTestFiles ();
+
+   file_storage fs;
+   makeMultiFileStorage (fs);
+   testStorage ts (uring_storage_constructor, fs);
+
+   // the second piece ends in the data file, then the pad file, the third
+   // is the two sidecar files
+   std::vector <char> second (16 * 1024);
+   std::vector <char> third (133);
+   fillPattern (second, 1);
+   fillPattern (third, 2);
+   std::vector <file::iovec_t> secondBufs = makeBuffers (second, 1000);
+   std::vector <file::iovec_t> thirdBufs = makeBuffers (third, 50);
+
+   CHECK_EQUAL (ts.storage->writev (&secondBufs[0], 1, 0, secondBufs.size ()), 16 * 1024);
+   CHECK (!ts.storage->error ());
+   CHECK_EQUAL (ts.storage->writev (&thirdBufs[0], 2, 0, thirdBufs.size ()), 133);
+   CHECK (!ts.storage->error ());
+
+   // each range is one submission, the second piece only writes to one file
+   // and goes through default_storage
+   if (uringAvailable ())
+   {
+      CHECK_EQUAL (ts.diskPool.disk_syscalls (), 2);
+   }
+
+   std::string bam = readFile ("temp_storage/data.bam");
+   CHECK_EQUAL (bam.size (), 30000);
+   CHECK (bam.size () == 30000 && memcmp (&bam[16 * 1024], &second[0], 30000 - 16 * 1024) == 0);
+   CHECK (readFile ("temp_storage/data.bam.bai") == std::string (&third[0], 100));
+   CHECK (readFile ("temp_storage/data.bam.md5") == std::string (&third[100], 33));
+
+   // pad files read as zeros
+   std::vector <char> back (16 * 1024, 'x');
+   std::vector <file::iovec_t> backBufs = makeBuffers (back, 1000);
+   CHECK_EQUAL (ts.storage->readv (&backBufs[0], 1, 0, backBufs.size ()), 16 * 1024);
+   CHECK (!ts.storage->error ());
+   CHECK (memcmp (&back[0], &second[0], 30000 - 16 * 1024) == 0);
+   CHECK (std::vector <char> (back.begin () + 30000 - 16 * 1024, back.end ()) == std::vector <char> (2768, 0));
+
+   back.assign (133, 'x');
+   backBufs = makeBuffers (back, 50);
+   CHECK_EQUAL (ts.storage->readv (&backBufs[0], 2, 0, backBufs.size ()), 133);
+   CHECK (!ts.storage->error ());
+   CHECK (back == third);
+}
+
+// a range with more buffers in one file than a single system call takes
+// goes through default_storage, and nothing of it is left queued
+static void testUringFallback ()
+{
+#if TORRENT_IOV_MAX < 16 * 1024
+   removeTestFiles ();
+
+   file_storage fs;
+   fs.set_piece_length (16 * 1024);
+   fs.add_file ("temp_storage/first", 1500);
+   fs.add_file ("temp_storage/second", 16 * 1024 - 500);
+   fs.add_file ("temp_storage/third", 16 * 1024 - 1000);
+   fs.set_num_pieces (2);
+   testStorage ts (uring_storage_constructor, fs);
+
+   // one buffer for the first file, and one byte buffers for the second,
+   // the second piece spans the second and third files
+   std::vector <char> first (16 * 1024);
+   fillPattern (first, 3);
+   std::vector <file::iovec_t> bufs;
+   file::iovec_t head = { &first[0], 1500 };
+   bufs.push_back (head);
+   for (int i = 1500; i < 16 * 1024; ++i)
+   {
+      file::iovec_t b = { &first[i], 1 };
+      bufs.push_back (b);
+   }
+   CHECK (bufs.size () - 1 > TORRENT_IOV_MAX);
+
+   CHECK_EQUAL (ts.storage->writev (&bufs[0], 0, 0, bufs.size ()), 16 * 1024);
+   CHECK (!ts.storage->error ());
+   size_type fallbackCalls = ts.diskPool.disk_syscalls ();
+
+   // the next range through the ring must not carry the first file's
+   // request from before
+   std::vector <char> second (16 * 1024);
+   fillPattern (second, 4);
+   std::vector <file::iovec_t> secondBufs = makeBuffers (second, 1000);
+   CHECK_EQUAL (ts.storage->writev (&secondBufs[0], 1, 0, secondBufs.size ()), 16 * 1024);
+   CHECK (!ts.storage->error ());
+
+   if (uringAvailable ())
+   {
+      CHECK_EQUAL (ts.diskPool.disk_syscalls () - fallbackCalls, 1);
+   }
+
+   std::string secondFile = readFile ("temp_storage/second");
+   CHECK (readFile ("temp_storage/first") == std::string (&first[0], 1500));
+   CHECK (secondFile == std::string (&first[1500], 16 * 1024 - 1500) + std::string (&second[0], 1000));
+   CHECK (readFile ("temp_storage/third") == std::string (&second[1000], 16 * 1024 - 1000));
+
+   // and reading it back the same way
+   std::vector <char> back (16 * 1024, 'x');
+   for (int i = 0; i < int (bufs.size ()); ++i)
+   {
+      bufs[i].iov_base = &back[(char *) bufs[i].iov_base - &first[0]];
+   }
+   CHECK_EQUAL (ts.storage->readv (&bufs[0], 0, 0, bufs.size ()), 16 * 1024);
+   CHECK (!ts.storage->error ());
+   CHECK (back == first);
+#endif
+}
+
+// writes all three pieces of makeMultiFileStorage, returns their contents
+static std::vector <char> writeMultiFile (testStorage &ts)
+{
+   std::vector <char> data (2 * 16 * 1024 + 133);
+   fillPattern (data, 5);
+
+   for (int piece = 0; piece < 3; ++piece)
+   {
+      std::vector <char> block (data.begin () + piece * 16 * 1024,
+                                data.begin () + std::min (size_t (piece + 1) * 16 * 1024, data.size ()));
+      std::vector <file::iovec_t> bufs = makeBuffers (block, 1000);
+      CHECK_EQUAL (ts.storage->writev (&bufs[0], piece, 0, bufs.size ()), int (block.size ()));
+      CHECK (!ts.storage->error ());
+   }
+
+   // the pad file isn't written, it reads as zeros
+   std::fill (data.begin () + 30000, data.begin () + 2 * 16 * 1024, 0);
+   return data;
+}
+
+// reads size bytes of piece at offset in buffers of bufSize bytes
+static std::vector <char> readPiece (testStorage &ts, int piece, int offset, int size, int bufSize, int expected)
+{
+   std::vector <char> back (size, 'x');
+   std::vector <file::iovec_t> bufs = makeBuffers (back, bufSize);
+   CHECK_EQUAL (ts.storage->readv (&bufs[0], piece, offset, bufs.size ()), expected);
+   return back;
+}
+
+// complete files are read out of their mappings, without system calls, pad
+// files as zeros
+static void testMmapRead ()
+{
+   removeTestFiles ();
+
+   file_storage fs;
+   makeMultiFileStorage (fs);
+   testStorage ts (mmap_storage_constructor, fs);
+   std::vector <char> data = writeMultiFile (ts);
+
+   size_type calls = ts.diskPool.disk_syscalls ();
+
+   // a whole piece, the data file and the pad file, buffers crossing the
+   // end of the data file
+   std::vector <char> back = readPiece (ts, 1, 0, 16 * 1024, 1000, 16 * 1024);
+   CHECK (!ts.storage->error ());
+   CHECK (back == std::vector <char> (data.begin () + 16 * 1024, data.begin () + 2 * 16 * 1024));
+
+   // a block within a piece and the piece spanning both sidecar files
+   back = readPiece (ts, 0, 5000, 3000, 512, 3000);
+   CHECK (back == std::vector <char> (data.begin () + 5000, data.begin () + 8000));
+   back = readPiece (ts, 2, 0, 133, 50, 133);
+   CHECK (!ts.storage->error ());
+   CHECK (back == std::vector <char> (data.begin () + 2 * 16 * 1024, data.end ()));
+
+   // a block running past the end of the last piece is clamped
+   back = readPiece (ts, 2, 100, 1000, 1000, 33);
+   CHECK (std::vector <char> (back.begin (), back.begin () + 33) ==
+          std::vector <char> (data.begin () + 2 * 16 * 1024 + 100, data.end ()));
+
+   CHECK_EQUAL (ts.diskPool.disk_syscalls (), calls);
+}
+
+// files are unmapped when they're released or moved, a file that is
+// replaced afterwards is read with its new contents
+static void testMmapUnmap ()
+{
+   removeTestFiles ();
+
+   file_storage fs;
+   makeMultiFileStorage (fs);
+   testStorage ts (mmap_storage_constructor, fs);
+   std::vector <char> data = writeMultiFile (ts);
+
+   std::vector <char> back = readPiece (ts, 2, 0, 133, 133, 133);
+   CHECK (back == std::vector <char> (data.begin () + 2 * 16 * 1024, data.end ()));
+
+   std::string bai (100, 'a');
+   CHECK (!ts.storage->release_files ());
+   replaceFile ("temp_storage/data.bam.bai", bai);
+   back = readPiece (ts, 2, 0, 100, 100, 100);
+   CHECK (back == std::vector <char> (bai.begin (), bai.end ()));
+
+   bai.assign (100, 'b');
+   CHECK (ts.storage->move_storage (combine_path (testPath, "moved")));
+   CHECK (!ts.storage->error ());
+   replaceFile ("moved/temp_storage/data.bam.bai", bai);
+   back = readPiece (ts, 2, 0, 100, 100, 100);
+   CHECK (back == std::vector <char> (bai.begin (), bai.end ()));
+
+   // the data file moved with it
+   back = readPiece (ts, 0, 0, 16 * 1024, 1000, 16 * 1024);
+   CHECK (back == std::vector <char> (data.begin (), data.begin () + 16 * 1024));
+}
+
+// a file truncated under its mapping is read short instead of faulting,
+// and as usual from then on
+static void testMmapTruncated ()
+{
+   removeTestFiles ();
+
+   file_storage fs;
+   makeMultiFileStorage (fs);
+   testStorage ts (mmap_storage_constructor, fs);
+   std::vector <char> data = writeMultiFile (ts);
+
+   // map it
+   readPiece (ts, 0, 0, 1000, 1000, 1000);
+
+   std::string bam = combine_path (testPath, "temp_storage/data.bam");
+   CHECK_EQUAL (::truncate (bam.c_str (), 20000), 0);
+
+   std::vector <char> back = readPiece (ts, 1, 0, 16 * 1024, 1000, 20000 - 16 * 1024);
+   CHECK (std::vector <char> (back.begin (), back.begin () + 20000 - 16 * 1024) ==
+          std::vector <char> (data.begin () + 16 * 1024, data.begin () + 20000));
+   size_type calls = ts.diskPool.disk_syscalls ();
+
+   back = readPiece (ts, 0, 0, 1000, 1000, 1000);
+   CHECK (back == std::vector <char> (data.begin (), data.begin () + 1000));
+   CHECK (ts.diskPool.disk_syscalls () > calls);
+}
+
+// divides totalLimit between the demands and compares with expected
+static void checkDivide (int64_t totalLimit, std::vector <int64_t> demand, std::vector <int64_t> expected)
+{
+   std::vector <int64_t> share (demand.size (), -2);
+   gtRateShare::divide (totalLimit, &demand[0], &share[0], demand.size ());
+
+   for (size_t i = 0; i < demand.size (); ++i)
+   {
+      CHECK_EQUAL (share[i], expected[i]);
+   }
+}
+
+static std::vector <int64_t> slots (int64_t a, int64_t b, int64_t c, int64_t d)
+{
+   std::vector <int64_t> v;
+   v.push_back (a);
+   v.push_back (b);
+   v.push_back (c);
+   v.push_back (d);
+   return v;
+}
+
+static void testRateShareDivide ()
+{
+   // a child below an even split keeps its demand, the unlimited ones
+   // share the rest, a finished child gets nothing
+   checkDivide (1000, slots (100, -1, -1, 0), slots (100, 450, 450, 0));
+
+   // every child unlimited
+   checkDivide (1000, slots (-1, -1, -1, -1), slots (250, 250, 250, 250));
+
+   // a small demand raises the even split, so the next one fits too
+   checkDivide (1000, slots (400, 300, -1, 0), slots (350, 300, 350, 0));
+
+   // every demand met, what's left is spread over the running children
+   checkDivide (1000, slots (100, 200, 0, 0), slots (450, 550, 0, 0));
+
+   // nobody running
+   checkDivide (1000, slots (0, 0, 0, 0), slots (0, 0, 0, 0));
+}
+
+int main (int argc, char **argv)
+{
+   testPath = argc > 1 ? argv[1] : ".";
+
+   testUringMultiFile ();
+   testUringFallback ();
+   testMmapRead ();
+   testMmapUnmap ();
+   testMmapTruncated ();
+   testRateShareDivide ();
+
+   removeTestFiles ();
+
+   if (failures)
+   {
+      fprintf (stderr, "%d checks failed\n", failures);
+      return 1;
+   }
+
+   return 0;
+}
@@ -74,6 +74,8 @@
 #include "loggingmask.h"
 #include "gtNullStorage.h"
 #include "gtZeroStorage.h"
+#include "gtUringStorage.h"
+#include "gtMmapStorage.h"
 
 /*
 static char const* upload_state_str[] = {
@@ -225,31 +227,19 @@ void gtUpload::submitTorrentToGTExecutive (std::string torrentFileName)
    checkIPFilter (_uploadSubmissionURL);
 
    CURL *curl;
-   curl = curl_easy_init ();
+   curl = _httpClient.acquireHandle ();
 
    if (!curl)
    {
       gtError ("libCurl initialization failure", 201);
    }
 
-   if (!_curlVerifySSL)
-   {
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYPEER, 0);
-      curl_easy_setopt (curl, CURLOPT_SSL_VERIFYHOST, 0);
-   }
-
    curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, errorBuffer);
    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, NULL);
    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, &curlCallBackHeadersWriter);
-   curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 15);
    curl_easy_setopt (curl, CURLOPT_WRITEDATA, gtoFile);
    curl_easy_setopt (curl, CURLOPT_WRITEHEADER, &curlResponseHeaders);
-   curl_easy_setopt (curl, CURLOPT_NOSIGNAL, (long)1);
    curl_easy_setopt (curl, CURLOPT_POST, (long)1);
-#ifdef __CYGWIN__
-   std::string winInst = getWinInstallDirectory () + "/cacert.pem";
-   curl_easy_setopt (curl, CURLOPT_CAINFO, winInst.c_str ());
-#endif /* __CYGWIN__ */
 
    std::string data = "token=" + _authToken;
 
@@ -261,14 +251,7 @@ void gtUpload::submitTorrentToGTExecutive (std::string torrentFileName)
    curl_formadd (&post, &last, CURLFORM_COPYNAME, "file", CURLFORM_FILE, (_uploadGTODir + torrentFileName).c_str(), CURLFORM_FILENAME, torrentFileName.c_str(), CURLFORM_END);
 
    curl_easy_setopt (curl, CURLOPT_HTTPPOST, post);
-
-   // CGHUBDEV-22: Set CURL timeouts to 20 seconds
-   int timeoutVal = 20;
-   int connTime = 20;
-
    curl_easy_setopt (curl, CURLOPT_URL, _uploadSubmissionURL.c_str());
-   curl_easy_setopt (curl, CURLOPT_TIMEOUT, timeoutVal);
-   curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, connTime);
 
    CURLcode res;
    int retries = 5;
@@ -277,19 +260,19 @@ void gtUpload::submitTorrentToGTExecutive (std::string torrentFileName)
    {
       res = curl_easy_perform (curl);
 
-      if (res != CURLE_SSL_CONNECT_ERROR && res != CURLE_OPERATION_TIMEDOUT)
+      if (!gtHttpClient::retryable (res))
       {
          // Only retry on SSL connect errors or timeouts in case the other end is temporarily overloaded.
          break;
       }
 
-      // Give the other end time to become less loaded.
-      sleep (2);
-
       retries--;
 
       if (retries)
       {
+         // Give the other end time to become less loaded.
+         _httpClient.backoff (4 - retries);
+
          screenOutput ("Retrying to submit gto for UUID: " + _uploadUUID, VERBOSE_1);
       }
    }
@@ -308,7 +291,7 @@ void gtUpload::submitTorrentToGTExecutive (std::string torrentFileName)
    }
 
    curl_formfree(post);
-   curl_easy_cleanup (curl);
+   _httpClient.releaseHandle (curl);
 }
 
 void gtUpload::findDataAndSetWorkingDirectory ()
@@ -676,6 +659,15 @@ void gtUpload::processManifestFile ()
    }
 }
 
+void gtUpload::processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates)
+{
+   // the upload session holds a single torrent
+   if (!statusUpdates.empty ())
+   {
+      _uploadTorrentStatus = statusUpdates.back ();
+   }
+}
+
 void gtUpload::performGtoUpload (std::string torrentFileName, long previousProgress, bool inResumeMode)
 {
    libtorrent::session *torrentSession = makeTorrentSession ();
@@ -703,6 +695,14 @@ void gtUpload::performGtoUpload (std::string torrentFileName, long previousProgr
    {
       torrentParams.storage = zero_storage_constructor;
    }
+   else if (_use_uring_storage)
+   {
+      torrentParams.storage = uring_storage_constructor;
+   }
+   else if (_use_mmap_storage)
+   {
+      torrentParams.storage = mmap_storage_constructor;
+   }
 
    libtorrent::error_code torrentError;
 
@@ -772,8 +772,10 @@ void gtUpload::performGtoUpload (std::string torrentFileName, long previousProgr
 
    bool displayed100Percent = false;
 
-   libtorrent::session_status sessionStatus = torrentSession->status ();
-   libtorrent::torrent_status torrentStatus = torrentHandle.status ();
+   // Status is polled in bulk with post_torrent_updates (), the replies
+   // are cached in _uploadTorrentStatus by checkAlerts ()
+   _uploadTorrentStatus = torrentHandle.status ();
+   libtorrent::torrent_status &torrentStatus = _uploadTorrentStatus;
 
    percentComplete = 0.0;
    time_t lastActivity = timeout_update ();
@@ -781,10 +783,6 @@ void gtUpload::performGtoUpload (std::string torrentFileName, long previousProgr
 
    while (torrentStatus.uploaded < 1)
    {
-      // Update session and torrent status as of last successful tracker scrape
-      sessionStatus = torrentSession->status();
-      torrentStatus = torrentHandle.status();
-
       if (torrentStatus.total_payload_upload > lastScrapeTotalPayUp)
          timeout_update (&lastActivity);
 
@@ -805,10 +803,11 @@ void gtUpload::performGtoUpload (std::string torrentFileName, long previousProgr
       while (torrentStatus.uploaded < 1 && libtorrent::time_now_hires() < endMonitoring)
       {
          checkAlerts (torrentSession);
+         torrentSession->post_torrent_updates ();
          usleep(ALERT_CHECK_PAUSE_INTERVAL);
       }
 
-      // Warning - Asynchronous call does below not update our torrentStatus struct
+      // Asynchronous, the scrape results arrive with a later status update
       torrentHandle.scrape_tracker();
 
       FILE *gtoFile;
@@ -55,6 +55,7 @@ class gtUpload : public gtBase
       void hashCallbackImpl (int piece);
 
    protected:
+      void processTorrentStatusUpdates (std::vector <libtorrent::torrent_status> &statusUpdates);
 
    private:
       std::string _manifestFile;
@@ -65,6 +66,7 @@ class gtUpload : public gtBase
       std::string _dataFilePath;
       std::string _uploadGTODir;  //  This directory is used to store the upload GTO and upload progress state when set (otherwise the uuid directory is used)
       int _piecesInTorrent;       // Used by the hash callback function to display progress
+      libtorrent::torrent_status _uploadTorrentStatus;   // last reported status of the torrent being uploaded
       bool _uploadGTOOnly;        // Use upload client to generate GTO only,
                                   // don't start upload
 
@@ -0,0 +1,324 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtUring.cpp
+ */
+
+#include "gt_config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#if defined HAVE_LINUX_IO_URING_H && defined __NR_io_uring_setup && defined __NR_io_uring_enter
+#define GT_USE_IO_URING 1
+#endif
+
+#include "gtUring.h"
+
+gtUring::gtUring ():
+   _ringFd (-1),
+   _sqRing (MAP_FAILED),
+   _sqRingSize (0),
+   _cqRing (MAP_FAILED),
+   _cqRingSize (0),
+   _sqes (MAP_FAILED),
+   _sqesSize (0),
+   _sqHead (NULL),
+   _sqTail (NULL),
+   _sqMask (NULL),
+   _sqArray (NULL),
+   _sqEntries (0),
+   _cqHead (NULL),
+   _cqTail (NULL),
+   _cqMask (NULL),
+   _cqes (NULL),
+   _queued (0),
+   _inFlight (0),
+   _failed (false)
+{
+}
+
+gtUring::~gtUring ()
+{
+   release ();
+}
+
+void gtUring::release ()
+{
+   if (_sqes != MAP_FAILED)
+   {
+      munmap (_sqes, _sqesSize);
+   }
+
+   if (_cqRing != MAP_FAILED && _cqRing != _sqRing)
+   {
+      munmap (_cqRing, _cqRingSize);
+   }
+
+   if (_sqRing != MAP_FAILED)
+   {
+      munmap (_sqRing, _sqRingSize);
+   }
+
+   if (_ringFd >= 0)
+   {
+      close (_ringFd);
+   }
+
+   _ringFd = -1;
+   _sqRing = _cqRing = _sqes = MAP_FAILED;
+   _queued = _inFlight = 0;
+   _failed = false;
+}
+
+#ifdef GT_USE_IO_URING
+
+bool gtUring::init (unsigned entries)
+{
+   struct io_uring_params params;
+   memset (&params, 0, sizeof (params));
+
+   _ringFd = syscall (__NR_io_uring_setup, entries, &params);
+
+   if (_ringFd < 0)
+   {
+      return false;
+   }
+
+   _sqRingSize = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+   _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+
+   bool singleMap = false;
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+   if (params.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      singleMap = true;
+      _sqRingSize = _cqRingSize = _sqRingSize > _cqRingSize ? _sqRingSize : _cqRingSize;
+   }
+#endif
+
+   _sqRing = mmap (NULL, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+
+   if (_sqRing == MAP_FAILED)
+   {
+      int savedErrno = errno;
+      release ();
+      errno = savedErrno;
+      return false;
+   }
+
+   if (singleMap)
+   {
+      _cqRing = _sqRing;
+   }
+   else
+   {
+      _cqRing = mmap (NULL, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+   }
+
+   _sqesSize = params.sq_entries * sizeof (struct io_uring_sqe);
+   _sqes = mmap (NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+
+   if (_cqRing == MAP_FAILED || _sqes == MAP_FAILED)
+   {
+      int savedErrno = errno;
+      release ();
+      errno = savedErrno;
+      return false;
+   }
+
+   char *sq = (char *) _sqRing;
+   _sqHead = (unsigned *) (sq + params.sq_off.head);
+   _sqTail = (unsigned *) (sq + params.sq_off.tail);
+   _sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+   _sqArray = (unsigned *) (sq + params.sq_off.array);
+   _sqEntries = params.sq_entries;
+
+   char *cq = (char *) _cqRing;
+   _cqHead = (unsigned *) (cq + params.cq_off.head);
+   _cqTail = (unsigned *) (cq + params.cq_off.tail);
+   _cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+   _cqes = cq + params.cq_off.cqes;
+
+   return true;
+}
+
+void gtUring::queue (bool write, int fd, const struct iovec *bufs, int numBufs, int64_t offset, uint64_t userData)
+{
+   unsigned tail = *_sqTail;
+   unsigned index = tail & *_sqMask;
+   struct io_uring_sqe *sqe = (struct io_uring_sqe *) _sqes + index;
+
+   memset (sqe, 0, sizeof (*sqe));
+   sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+   sqe->fd = fd;
+   sqe->addr = (uint64_t) (uintptr_t) bufs;
+   sqe->len = numBufs;
+   sqe->off = offset;
+   sqe->user_data = userData;
+
+   _sqArray[index] = index;
+
+   // the entry must be visible to the kernel before the tail that covers it
+   __atomic_store_n (_sqTail, tail + 1, __ATOMIC_RELEASE);
+   _queued++;
+}
+
+int gtUring::submitAndWait ()
+{
+   int calls = 0;
+
+   while (_queued > 0 || _inFlight > 0)
+   {
+      unsigned completed = __atomic_load_n (_cqTail, __ATOMIC_ACQUIRE) - *_cqHead;
+
+      if (_queued == 0 && completed >= _inFlight)
+      {
+         break;
+      }
+
+      int ret = syscall (__NR_io_uring_enter, _ringFd, _queued, _queued + _inFlight - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+      calls++;
+
+      if (ret < 0)
+      {
+         // EAGAIN and EBUSY mean the kernel is short of memory or
+         // completions for now, it frees them as requests finish
+         if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+         {
+            continue;
+         }
+
+         // anything else is a bad ring:  what wasn't submitted is dropped so
+         // a later call can't submit it, and what was is waited for since it
+         // still reads and writes the caller's buffers
+         int savedErrno = errno;
+         discard ();
+         drain ();
+         _failed = true;
+         errno = savedErrno;
+         return -1;
+      }
+
+      _queued -= ret;
+      _inFlight += ret;
+   }
+
+   return calls;
+}
+
+void gtUring::discard ()
+{
+   // without SQPOLL the kernel only takes entries during io_uring_enter (),
+   // so the unsubmitted ones are the last _queued before the tail
+   __atomic_store_n (_sqTail, *_sqTail - _queued, __ATOMIC_RELEASE);
+   _queued = 0;
+}
+
+void gtUring::drain ()
+{
+   for (;;)
+   {
+      unsigned completed = __atomic_load_n (_cqTail, __ATOMIC_ACQUIRE) - *_cqHead;
+
+      if (completed >= _inFlight)
+      {
+         return;
+      }
+
+      int ret = syscall (__NR_io_uring_enter, _ringFd, 0, _inFlight - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+
+      // there is no other way to wait, when this fails too closing the ring
+      // in release () is what's left, the kernel cancels what's in flight
+      if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+      {
+         return;
+      }
+   }
+}
+
+bool gtUring::next (uint64_t &userData, int &result)
+{
+   // completions of a failed ring are still handed out
+   if (_ringFd < 0)
+   {
+      return false;
+   }
+
+   unsigned head = *_cqHead;
+
+   if (head == __atomic_load_n (_cqTail, __ATOMIC_ACQUIRE))
+   {
+      return false;
+   }
+
+   struct io_uring_cqe *cqe = (struct io_uring_cqe *) _cqes + (head & *_cqMask);
+   userData = cqe->user_data;
+   result = cqe->res;
+
+   __atomic_store_n (_cqHead, head + 1, __ATOMIC_RELEASE);
+   _inFlight--;
+
+   return true;
+}
+
+#else // GT_USE_IO_URING
+
+bool gtUring::init (unsigned entries)
+{
+   errno = ENOSYS;
+   return false;
+}
+
+void gtUring::queue (bool write, int fd, const struct iovec *bufs, int numBufs, int64_t offset, uint64_t userData)
+{
+}
+
+int gtUring::submitAndWait ()
+{
+   errno = ENOSYS;
+   return -1;
+}
+
+bool gtUring::next (uint64_t &userData, int &result)
+{
+   return false;
+}
+
+#endif // GT_USE_IO_URING
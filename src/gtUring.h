@@ -0,0 +1,109 @@
+/* -*- mode: C++; c-basic-offset: 3; tab-width: 3; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+/*
+ * gtUring.h
+ *
+ * Minimal io_uring submission and completion queue.
+ *
+ * Vectored reads and writes are queued with their file offsets, submitted
+ * together with one system call and completed in any order, so the device
+ * sees all of them at once instead of one after the other.  The ring is
+ * driven with the raw system calls, liburing isn't needed.  Builds without
+ * linux/io_uring.h, and kernels without io_uring (before 5.1, or with it
+ * disabled), fail init () and the caller uses plain reads and writes.
+ *
+ * A ring is not thread safe, each thread needs its own.
+ */
+
+#ifndef GT_URING_H_
+#define GT_URING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+class gtUring
+{
+   public:
+      gtUring ();
+      ~gtUring ();
+
+      // false if io_uring isn't available, errno tells why
+      bool init (unsigned entries);
+      bool ready () { return _ringFd >= 0 && !_failed; }
+
+      // queues a preadv () or pwritev (), userData comes back with its result,
+      // bufs must stay valid until submitAndWait () returns, no more than
+      // the init () entries may be queued at once
+      void queue (bool write, int fd, const struct iovec *bufs, int numBufs, int64_t offset, uint64_t userData);
+
+      // submits everything queued and waits for all of it to complete,
+      // returns the number of system calls that took or -1 with errno set,
+      // after which the ring is no longer ready ():  requests that weren't
+      // submitted are dropped, those that were have completed (next ()
+      // returns them) unless waiting for them failed as well
+      int submitAndWait ();
+
+      // the next completion: false when there are none left, result is
+      // the byte count or a negated errno
+      bool next (uint64_t &userData, int &result);
+
+   private:
+      int _ringFd;
+
+      void *_sqRing;
+      size_t _sqRingSize;
+      void *_cqRing;
+      size_t _cqRingSize;
+      void *_sqes;
+      size_t _sqesSize;
+
+      unsigned *_sqHead;
+      unsigned *_sqTail;
+      unsigned *_sqMask;
+      unsigned *_sqArray;
+      unsigned _sqEntries;
+
+      unsigned *_cqHead;
+      unsigned *_cqTail;
+      unsigned *_cqMask;
+      void *_cqes;
+
+      unsigned _queued;      // queued, not submitted yet
+      unsigned _inFlight;    // submitted, not completed yet
+      bool _failed;          // io_uring_enter () failed, see submitAndWait ()
+
+      void release ();
+      void discard ();
+      void drain ();
+};
+
+#endif /* GT_URING_H_ */
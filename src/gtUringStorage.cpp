@@ -0,0 +1,244 @@
+/* -*- mode: C++; c-basic-offset: 2; tab-width: 2; -*-
+ *
+ * Copyright (c) 2014, Annai Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE
+ *
+ * Created under contract by Cardinal Peak, LLC.   www.cardinalpeak.com
+ */
+
+#include "gt_config.h"
+
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+#include "libtorrent/disk_buffer_pool.hpp"
+#include "libtorrent/file_pool.hpp"
+
+#include "gtUringStorage.h"
+#include "gtUring.h"
+#include "gtDefs.h"
+
+//
+// io_uring storage device for libtorrent
+//
+// The disk thread reads and writes one piece range at a time, and the
+// default storage goes through the files of the range one after the other.
+// GTOs are often a large BAM file with small index and checksum files next
+// to it, so a range can cover several files.  This storage queues one read
+// or write per file of the range and submits them together, which lets the
+// device work on all of them at once.  A range within a single file gains
+// nothing from the ring and goes through default_storage, as does
+// everything when the kernel has no io_uring, a file is opened for
+// unbuffered I/O, or a file doesn't open (default_storage creates missing
+// directories and reports the error).
+//
+using namespace libtorrent;
+
+namespace
+{
+  pthread_key_t ring_key;
+  pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+  void delete_ring(void* ring)
+  {
+    delete static_cast<gtUring*>(ring);
+  }
+
+  void make_ring_key()
+  {
+    pthread_key_create(&ring_key, delete_ring);
+  }
+
+  // each disk thread has a ring of its own, the ring of a thread where
+  // io_uring isn't available is kept anyway so setup isn't retried
+  gtUring* thread_ring()
+  {
+    pthread_once(&ring_once, make_ring_key);
+    gtUring* ring = static_cast<gtUring*>(pthread_getspecific(ring_key));
+    if (ring == NULL)
+    {
+      ring = new gtUring;
+      ring->init(URING_QUEUE_DEPTH);
+      pthread_setspecific(ring_key, ring);
+    }
+    return ring->ready() ? ring : NULL;
+  }
+}
+
+class uring_storage : public default_storage
+{
+public:
+  uring_storage(file_storage const& fs, file_storage const* mapped, std::string const& path
+    , file_pool& fp, std::vector<boost::uint8_t> const& file_prio)
+    : default_storage(fs, mapped, path, fp, file_prio)
+  {}
+
+  int readv(file::iovec_t const* bufs, int slot, int offset, int num_bufs);
+  int writev(file::iovec_t const* bufs, int slot, int offset, int num_bufs);
+
+private:
+  // returns -2 when the range can't go through the ring
+  int uring_readwritev(file::iovec_t const* bufs, int slot, int offset
+    , int num_bufs, bool write);
+};
+
+int uring_storage::readv(file::iovec_t const* bufs, int slot, int offset, int num_bufs)
+{
+  int ret = uring_readwritev(bufs, slot, offset, num_bufs, false);
+  if (ret == -2) return default_storage::readv(bufs, slot, offset, num_bufs);
+  return ret;
+}
+
+int uring_storage::writev(file::iovec_t const* bufs, int slot, int offset, int num_bufs)
+{
+  int ret = uring_readwritev(bufs, slot, offset, num_bufs, true);
+  if (ret == -2) return default_storage::writev(bufs, slot, offset, num_bufs);
+  return ret;
+}
+
+int uring_storage::uring_readwritev(file::iovec_t const* bufs, int slot, int offset
+  , int num_bufs, bool write)
+{
+  int size = 0;
+  for (int i = 0; i < num_bufs; ++i) size += bufs[i].iov_len;
+
+  int slot_size = files().piece_size(slot);
+  if (offset + size > slot_size) size = slot_size - offset;
+  if (size <= 0) return -2;
+
+  std::vector<file_slice> slices = files().map_block(slot, offset, size);
+  if (slices.size() < 2 || slices.size() > URING_QUEUE_DEPTH) return -2;
+
+  gtUring* ring = thread_ring();
+  if (ring == NULL) return -2;
+
+  // everything that sends the range to default_storage is checked before
+  // the first request is queued, a queued request can't be taken back and
+  // points into iov, which is gone once this returns
+  std::vector<boost::intrusive_ptr<file> > handles(slices.size());
+  for (size_t i = 0; i < slices.size(); ++i)
+  {
+    file_storage::iterator fe = files().begin() + slices[i].file_index;
+    if (fe->pad_file) continue;
+
+    error_code ec;
+    handles[i] = open_file(fe, write ? file::read_write : file::read_only, ec);
+    if (!handles[i] || ec || (handles[i]->open_mode() & file::no_buffer))
+      return -2;
+  }
+
+  // every buffer ends up in one iovec, plus one for each time a
+  // file boundary splits a buffer, so this never reallocates
+  std::vector<file::iovec_t> iov;
+  iov.reserve(num_bufs + slices.size());
+  std::vector<size_t> first(slices.size() + 1, 0);
+
+  int buf = 0;
+  size_t buf_offset = 0;
+
+  for (size_t i = 0; i < slices.size(); ++i)
+  {
+    first[i] = iov.size();
+    size_type left = slices[i].size;
+    while (left > 0)
+    {
+      size_t n = (std::min)(size_t(bufs[buf].iov_len - buf_offset), size_t(left));
+      file::iovec_t v = { (char*)bufs[buf].iov_base + buf_offset, n };
+      iov.push_back(v);
+      left -= n;
+      buf_offset += n;
+      if (buf_offset == bufs[buf].iov_len)
+      {
+        ++buf;
+        buf_offset = 0;
+      }
+    }
+
+    // a file with more buffers than a single system call takes goes
+    // through default_storage, the disk thread doesn't issue those
+    if (handles[i] && iov.size() - first[i] > TORRENT_IOV_MAX) return -2;
+  }
+  first[slices.size()] = iov.size();
+
+  std::vector<int> results(slices.size(), 0);
+  for (size_t i = 0; i < slices.size(); ++i)
+  {
+    if (!handles[i])
+    {
+      // pad files read as zeros and aren't written
+      if (!write)
+      {
+        for (size_t k = first[i]; k < first[i + 1]; ++k)
+          memset(iov[k].iov_base, 0, iov[k].iov_len);
+      }
+      results[i] = int(slices[i].size);
+      continue;
+    }
+
+    ring->queue(write, handles[i]->native_handle(), &iov[first[i]], int(first[i + 1] - first[i])
+      , slices[i].offset, i);
+  }
+
+  int calls = ring->submitAndWait();
+
+  boost::uint64_t index;
+  int result;
+  while (ring->next(index, result))
+    results[index] = result;
+
+  if (calls > 0 && disk_pool()) disk_pool()->add_disk_syscalls(calls);
+
+  if (calls < 0)
+  {
+    set_error(m_save_path, error_code(errno, get_posix_category()));
+    return -1;
+  }
+
+  // like default_storage, a short read or write ends the range
+  int ret = 0;
+  for (size_t i = 0; i < slices.size(); ++i)
+  {
+    if (results[i] < 0)
+    {
+      file_storage::iterator fe = files().begin() + slices[i].file_index;
+      set_error(combine_path(m_save_path, files().file_path(*fe))
+        , error_code(-results[i], get_posix_category()));
+      return -1;
+    }
+    ret += results[i];
+    if (results[i] < slices[i].size) break;
+  }
+  return ret;
+}
+
+storage_interface* uring_storage_constructor(file_storage const& fs,
+	file_storage const* mapped, std::string const& path, file_pool& fp,
+	std::vector<boost::uint8_t> const& file_prio)
+{
+  return new uring_storage(fs, mapped, path, fp, file_prio);
+}
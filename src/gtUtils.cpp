@@ -61,6 +61,12 @@ int statDirectory (std::string dirFile)
    return statFileOrDirectory (dirFile, DIR_TYPE, dummyArg);
 }
 
+// 
+int statDirectory (std::string dirFile, time_t &dirMtime)
+{
+   return statFileOrDirectory (dirFile, DIR_TYPE, dirMtime);
+}
+
 // 
 int statFile (std::string dirFile)
 {
@@ -94,6 +100,7 @@ int statFileOrDirectory (std::string dirFile, statType sType, time_t &fileMtime)
   
       if (dir != NULL)
       {
+         fileMtime = status.st_mtime;
          closedir (dir);
          return 0;
       }
@@ -46,6 +46,7 @@
       int statFile (std::string, time_t &fileMtime);
 
       int statDirectory (std::string);
+      int statDirectory (std::string, time_t &dirMtime);
 
       // do NOT call this directly
       int statFileOrDirectory (std::string, statType sType, time_t &fileMtime);
@@ -260,6 +260,52 @@ class TestGeneTorrentArguments(GTTestCase):
         self.assertIn("must be greater than 0", serr)
         self.assertEqual(gt.returncode, 9)
 
+    def test_server_metrics_port(self):
+        """
+        Test gtserver metrics port option
+        """
+        for port in ("0", "65536"):
+            gt = GeneTorrentInstance(self.resourcedir + "--server %s -q %s -c %s --metrics-port %s" % (os.getcwd(), os.getcwd(), self.cred_filename, port),
+                instance_type=InstanceType.GT_SERVER, add_defaults=False)
+            (sout, serr) = gt.communicate()
+            self.assertIn("metrics-port", serr)
+            self.assertIn("out of range", serr)
+            self.assertEqual(gt.returncode, 9)
+
+    def test_server_key_pool_size(self):
+        """
+        Test gtserver key pool size option
+        """
+        for size in ("-1", "1025"):
+            gt = GeneTorrentInstance(self.resourcedir + "--server %s -q %s -c %s --key-pool-size %s" % (os.getcwd(), os.getcwd(), self.cred_filename, size),
+                instance_type=InstanceType.GT_SERVER, add_defaults=False)
+            (sout, serr) = gt.communicate()
+            self.assertIn("key-pool-size", serr)
+            self.assertIn("out of range", serr)
+            self.assertEqual(gt.returncode, 9)
+
+    def test_ssl_ciphers(self):
+        """
+        Test the SSL cipher list option
+        """
+        gt = GeneTorrentInstance(self.resourcedir + "--credential-file %s --download xxx --ssl-ciphers NO-SUCH-CIPHER" % (self.cred_filename),
+            instance_type=InstanceType.GT_DOWNLOAD, add_defaults=False)
+        (sout, serr) = gt.communicate()
+        self.assertIn("ssl-ciphers", serr)
+        self.assertIn("NO-SUCH-CIPHER", serr)
+        self.assertEqual(gt.returncode, 9)
+
+    def test_log_overflow(self):
+        """
+        Test the log overflow option
+        """
+        gt = GeneTorrentInstance(self.resourcedir + "--credential-file %s --download xxx --log-overflow wait" % (self.cred_filename),
+            instance_type=InstanceType.GT_DOWNLOAD, add_defaults=False)
+        (sout, serr) = gt.communicate()
+        self.assertIn("log-overflow", serr)
+        self.assertIn("wait", serr)
+        self.assertEqual(gt.returncode, 9)
+
     def test_usage_and_invalid_options(self):
         """
         Test usage and invalid options for GeneTorrent
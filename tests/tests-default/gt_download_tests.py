@@ -40,8 +40,10 @@ from xml.etree.cElementTree import Element, ElementTree, SubElement
 from tempfile import NamedTemporaryFile
 
 from utils.gttestcase import GTTestCase, StreamToLogger
+from utils.genetorrent import GeneTorrentInstance, InstanceType
 from utils.cgdata.datagen import DataGenZero
 from utils.config import TestConfig
+from gtoinfo import read_gto, emit_gto, set_key
 
 class TestGeneTorrentDownload(GTTestCase):
     create_mockhub = True
@@ -104,6 +106,66 @@ class TestGeneTorrentDownload(GTTestCase):
 
         os.remove(f.name)
 
+    def test_32mb_download_after_server_handoff(self):
+        '''Download a randomly-generated 32MB file from a GT server that
+           took the GTO over from the previous server instance.'''
+        # the handoff happens between local server instances
+        if not TestConfig.MOCKHUB:
+            self.skipTest('server handoff needs local server instances'
+                ' (MOCKHUB)')
+        uuid = self.data_upload_test(1024 * 1024 * 32)
+
+        if os.path.isfile(self.client_bam(uuid)):
+            os.remove(self.client_bam(uuid))
+
+        gtodict = read_gto(self.client_gto(uuid))
+        gtodict['gt_download_mode'] = 'true'
+        expiry = time.time() + (1 * 3600 * 24) # expire in 1 day
+        set_key(gtodict, 'expires on', int(expiry))
+        emit_gto(gtodict, self.server_gto(uuid), True)
+
+        server_args = '-s server%sroot -q server%sworkdir -c %s ' \
+            '--security-api %s' \
+            % (
+                os.path.sep,
+                os.path.sep,
+                self.cred_filename,
+                TestConfig.SECURITY_API,
+            )
+
+        # let the first instance pick up the GTO, then hand it off
+        server = GeneTorrentInstance(server_args,
+            instance_type=InstanceType.GT_SERVER)
+        time.sleep(10)
+        self.handoff_server(server)
+
+        self.assertTrue(os.path.isfile(os.path.join('server', 'root',
+            '.gtserver-handoff', 'state')))
+
+        server = GeneTorrentInstance(server_args,
+            instance_type=InstanceType.GT_SERVER)
+
+        client = GeneTorrentInstance('-d %s/cghub/data/analysis/download/%s ' \
+            '-p client2 -c %s' \
+            % (
+                TestConfig.HUB_SERVER,
+                str(uuid),
+                self.cred_filename,
+            ), instance_type=InstanceType.GT_DOWNLOAD)
+
+        client_sout, client_serr = client.communicate()
+
+        self.terminate_server(server)
+
+        self.assertEqual(client.returncode, 0)
+        self.assertTrue('Downloaded' in client_serr)
+        self.assertTrue(self.compare_hashes(
+            self.client_bam2(uuid), self.server_bam(uuid)))
+
+        # the state is only used once
+        self.assertFalse(os.path.exists(os.path.join('server', 'root',
+            '.gtserver-handoff')))
+
 if __name__ == '__main__':
     sys.stdout = StreamToLogger(logging.getLogger('stdout'), logging.INFO)
     sys.stderr = StreamToLogger(logging.getLogger('stderr'), logging.WARN)
@@ -38,6 +38,10 @@ SERVER_STOP_FILE = os.path.join(
     tempfile.gettempdir(),
     'GeneTorrent.stop')
 
+SERVER_HANDOFF_FILE = os.path.join(
+    tempfile.gettempdir(),
+    'GeneTorrent.handoff')
+
 class InstanceType:
     GT_ALL = 0       # no longer provided
     GT_DOWNLOAD = 1
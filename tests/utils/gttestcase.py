@@ -48,7 +48,8 @@ from tempfile import NamedTemporaryFile
 from subprocess import Popen, PIPE
 
 from utils.cgdata.datagen import DataGenRandom
-from utils.genetorrent import GeneTorrentInstance, InstanceType, SERVER_STOP_FILE
+from utils.genetorrent import GeneTorrentInstance, InstanceType, SERVER_STOP_FILE, \
+    SERVER_HANDOFF_FILE
 from utils.mockhubcontrol import MockHub
 from utils.config import TestConfig
 from gtoinfo import read_gto, emit_gto, set_key
@@ -218,6 +219,18 @@ class GTTestCase(unittest.TestCase):
 
         self.assertEqual(server_rc, 0, 'Server return code was non-zero')
 
+    def handoff_server(self, server):
+        handoff_file = open(SERVER_HANDOFF_FILE, 'w')
+        try:
+            handoff_file.close()
+            server_rc = server.wait()
+        finally:
+            # the server removes the handoff file once it acted on it
+            if os.path.isfile(SERVER_HANDOFF_FILE):
+                os.unlink(SERVER_HANDOFF_FILE)
+
+        self.assertEqual(server_rc, 0, 'Server return code was non-zero')
+
     def data_upload_test(self, size, data_generator=DataGenRandom,
         ssl=True, client_options='', server_options='', check_sha1=True):
         server = None